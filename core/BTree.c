@@ -192,11 +192,14 @@ OSStatus BTOpenPath(FCB *filePtr, KeyCompareProcPtr keyCompareProc)
 	}
 
 	/*
-	 * Subsequent opens allow key compare proc to be changed.
+	 * Subsequent opens allow key compare proc to be changed.  A key prefix
+	 * proc made for the old one no longer applies.
 	 */
 	if ( filePtr->fcbBTCBPtr != nil && keyCompareProc != nil) {
 		btreePtr = (BTreeControlBlockPtr) filePtr->fcbBTCBPtr;
 		btreePtr->keyCompareProc = keyCompareProc;
+		FreeNodeSidecars (btreePtr);
+		btreePtr->keyPrefixProc = nil;
 		return noErr;
 	}
 
@@ -400,6 +403,7 @@ OSStatus	BTClosePath			(FCB					*filePtr)
 	err = UpdateHeader (btreePtr, true);
 	M_ExitOnError (err);
 
+	FreeNodeSidecars (btreePtr);
 	hfs_free_type(btreePtr, BTreeControlBlock);
 	filePtr->fcbBTCBPtr = nil;
 
@@ -414,6 +418,50 @@ ErrorExit:
 
 
 
+/*-------------------------------------------------------------------------------
+Routine:	BTSetKeyPrefixProc	-	Enable or disable key prefix sidecars.
+
+Function:	With a key prefix proc, searches keep the key prefixes of recently
+			searched index nodes in memory and only call the key compare proc
+			when two prefixes tie (see SearchNodeSidecar).  The prefix proc must
+			order keys exactly as the tree's key compare proc does.  Passing
+			nil releases the sidecars.
+
+			The caller must hold the b-tree lock exclusively.
+
+Input:		filePtr			- pointer to file opened as a B-tree
+			keyPrefixProc	- client's key prefix function, or nil
+
+Result:		noErr			- success
+			fsBTInvalidFileErr	- no BTreeControlBlock is allocated for the fork
+			memFullErr		- could not allocate the sidecars
+-------------------------------------------------------------------------------*/
+
+OSStatus	BTSetKeyPrefixProc	(FCB					*filePtr,
+								 KeyPrefixProcPtr		 keyPrefixProc)
+{
+	BTreeControlBlockPtr	btreePtr;
+
+	M_ReturnErrorIf (filePtr == nil, 	paramErr);
+
+	btreePtr = (BTreeControlBlockPtr) filePtr->fcbBTCBPtr;
+
+	M_ReturnErrorIf (btreePtr == nil,	fsBTInvalidFileErr);
+
+	FreeNodeSidecars (btreePtr);
+	btreePtr->keyPrefixProc = nil;
+
+	if (keyPrefixProc != nil) {
+		btreePtr->sidecars = hfs_new_zero(BTNodeSidecar, kBTSidecarSlots);
+		M_ReturnErrorIf (btreePtr->sidecars == nil,	memFullErr);
+		btreePtr->keyPrefixProc = keyPrefixProc;
+	}
+
+	return noErr;
+}
+
+
+
 /*-------------------------------------------------------------------------------
 Routine:	BTSearchRecord	-	Search BTree for a record with a matching key.
 
@@ -1349,6 +1397,10 @@ OSStatus	BTInsertRecord		(FCB						*filePtr,
 			err = UpdateNode (btreePtr, &nodeRec, 0, kLockTransaction);
 			M_ExitOnError (err);
 
+			// InsertNode records this itself when we go through InsertTree
+			btreePtr->lastInsertNode  = insertNodeNum;
+			btreePtr->lastInsertIndex = index;
+
 			goto Success;
 		}
 	}
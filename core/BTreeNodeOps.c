@@ -106,6 +106,8 @@
 
 */
 
+#include <libkern/OSAtomic.h>
+
 #include "BTreesPrivate.h"
 
 
@@ -124,6 +126,8 @@
 //	DeleteRecord		- Deletes a record from a BTree node.
 //
 //	SearchNode			- Return index for record that matches key.
+//	SearchNodeSidecar	- SearchNode using cached key prefixes of index nodes.
+//	FreeNodeSidecars	- Release the key prefix caches of a tree.
 //	LocateRecord		- Return pointer to key and data, and size of data.
 //
 //	GetNodeDataSize		- Return the amount of space used for data in the node.
@@ -159,6 +163,9 @@ void		DeleteOffset		(BTreeControlBlockPtr	 btreePtr,
 								 NodeDescPtr			 node,
 								 u_int16_t				 index );
 
+static void	InvalidateNodeSidecar	(BTreeControlBlockPtr	 btreePtr,
+								 u_int32_t				 nodeNum );
+
 
 /////////////////////////////////////////////////////////////////////////////////
 
@@ -363,6 +370,7 @@ OSStatus	TrashNode	(BTreeControlBlockPtr	 btreePtr,
 							   kReleaseBlock | kTrashBlock );
 		PanicIf (err, "TrashNode: releaseNodeProc returned error.");
 		++btreePtr->numReleaseNodes;
+		InvalidateNodeSidecar (btreePtr, nodePtr->blockNum);	// read back from disk next time
 	}
 
 	nodePtr->buffer			= nil;
@@ -404,6 +412,7 @@ OSStatus	UpdateNode	(BTreeControlBlockPtr	 btreePtr,
 	if (nodePtr->buffer != nil)			// Why call UpdateNode if nil ?!?
 	{
 		releaseNodeProc = btreePtr->releaseBlockProc;
+		InvalidateNodeSidecar (btreePtr, nodePtr->blockNum);
 		err = releaseNodeProc (btreePtr->fileRefNum,
 							   nodePtr,
 							   flags | kMarkBlockDirty );
@@ -722,6 +731,286 @@ SearchNode( BTreeControlBlockPtr btreePtr,
 }
 
 
+/*-------------------------------------------------------------------------------
+
+Routine:	CompareKeyPrefixes	-	Order two keys by their BTreeKeyPrefix.
+
+Result:		+n	- search key > trial key
+			 0	- prefixes tie, the key compare proc must decide
+			-n	- search key < trial key
+-------------------------------------------------------------------------------*/
+static int32_t
+CompareKeyPrefixes( const BTreeKeyPrefix *searchPrefix,
+		    const BTreeKeyPrefix *trialPrefix )
+{
+	u_int8_t	count;
+	u_int8_t	i;
+
+	if (searchPrefix->major != trialPrefix->major)
+		return (searchPrefix->major < trialPrefix->major) ? -1 : 1;
+
+	count = (searchPrefix->count < trialPrefix->count) ? searchPrefix->count : trialPrefix->count;
+	for (i = 0; i < count; ++i) {
+		if (searchPrefix->minor[i] != trialPrefix->minor[i])
+			return (searchPrefix->minor[i] < trialPrefix->minor[i]) ? -1 : 1;
+	}
+
+	/* A key that ends here sorts before one that goes on */
+	if (searchPrefix->count < trialPrefix->count && searchPrefix->complete)
+		return -1;
+	if (trialPrefix->count < searchPrefix->count && trialPrefix->complete)
+		return 1;
+
+	return 0;
+}
+
+
+/*-------------------------------------------------------------------------------
+
+Routine:	BuildNodeSidecar	-	Cache the key prefixes of an index node.
+
+Function:	Records share everything the first and last record of the node have
+			in common, so when those have the same major value the minor values
+			they agree on are skipped and each prefix starts where the keys of
+			this node actually differ.
+
+Result:		true	- sidecar is valid for node
+			false	- could not allocate memory for it
+-------------------------------------------------------------------------------*/
+static Boolean
+BuildNodeSidecar( BTreeControlBlockPtr btreePtr,
+		  BTNodeSidecar *sidecar,
+		  NodeDescPtr node )
+{
+	KeyPrefixProcPtr prefixProc = btreePtr->keyPrefixProc;
+	BTreeKeyPrefix	*prefixes;
+	BTreeKeyPrefix	first;
+	BTreeKeyPrefix	last;
+	u_int16_t		*offset;
+	u_int16_t		capacity;
+	u_int16_t		index;
+	u_int16_t		skip;
+	u_int8_t		i;
+
+	if (node->numRecords > sidecar->capacity) {
+		capacity = (node->numRecords + 31) & ~31;
+		prefixes = hfs_new_data(BTreeKeyPrefix, capacity);
+		if (prefixes == NULL)
+			return false;
+		if (sidecar->prefixes != NULL)
+			hfs_delete_data(sidecar->prefixes, BTreeKeyPrefix, sidecar->capacity);
+		sidecar->prefixes = prefixes;
+		sidecar->capacity = capacity;
+	}
+
+	offset = (u_int16_t *) ((u_int8_t *)(node) + (btreePtr)->nodeSize - kOffsetSize);
+
+	skip = 0;
+	if (node->numRecords > 1) {
+		for (;;) {
+			prefixProc((u_int8_t *)node + *offset, skip, &first);
+			prefixProc((u_int8_t *)node + *(offset - (node->numRecords - 1)), skip, &last);
+			if (first.major != last.major)
+				break;
+			for (i = 0; i < first.count && i < last.count; ++i) {
+				if (first.minor[i] != last.minor[i])
+					break;
+			}
+			skip += i;
+			if (i < kBTKeyPrefixLength || skip >= kBTSidecarMaxSkip)
+				break;
+		}
+	}
+
+	for (index = 0; index < node->numRecords; ++index)
+		prefixProc((u_int8_t *)node + *(offset - index), skip, &sidecar->prefixes[index]);
+
+	sidecar->skip = skip;
+	sidecar->numRecords = node->numRecords;
+	++btreePtr->numSidecarBuilds;
+
+	return true;
+}
+
+
+/*-------------------------------------------------------------------------------
+
+Routine:	InvalidateNodeSidecar	-	Forget the key prefixes of a node.
+
+Function:	Called for every node that is marked dirty or trashed.  Searches only
+			run while nothing modifies the tree, so the slot is not busy.
+
+Input:		btreePtr	- pointer to BTree control block
+			nodeNum		- number of the node
+-------------------------------------------------------------------------------*/
+static void
+InvalidateNodeSidecar( BTreeControlBlockPtr btreePtr, u_int32_t nodeNum )
+{
+	BTNodeSidecar	*sidecar;
+
+	if (btreePtr->sidecars == NULL)
+		return;
+
+	sidecar = &btreePtr->sidecars[nodeNum % kBTSidecarSlots];
+	if (sidecar->nodeNum == nodeNum)
+		sidecar->numRecords = 0;
+}
+
+
+/*-------------------------------------------------------------------------------
+
+Routine:	SearchNodeSidecar	-	SearchNode using cached key prefixes of index nodes.
+
+Function:	Same result as SearchNode.  When the tree has a key prefix proc, the
+			prefixes of the keys of an index node that keeps being searched are
+			kept in memory next to the node (nothing changes on disk), so that
+			most probes of the binary search compare integers and the key compare
+			proc only runs when two prefixes tie.
+
+			The sidecar is dropped whenever the node is updated or trashed.  The
+			answer is still checked against the node with at most two key
+			compares, so a sidecar that is out of date, or a search key outside
+			the prefix the node's keys share, costs a plain search rather than
+			a wrong index.
+
+			Searches can run in parallel under a shared tree lock, so a sidecar
+			slot in use by another thread is left alone and SearchNode used.
+
+Input:		btreePtr	- pointer to BTree control block
+			nodeNum		- number of the node being searched
+			node		- pointer to node that contains the record
+			searchKey	- pointer to the key to match
+
+Output:		index		- pointer to beginning of key for record
+
+Result:		true	- success (index = record index)
+			false	- key did not match anything in node (index = insert index)
+-------------------------------------------------------------------------------*/
+Boolean
+SearchNodeSidecar( BTreeControlBlockPtr btreePtr,
+		   u_int32_t nodeNum,
+		   NodeDescPtr node,
+		   KeyPtr searchKey,
+		   u_int16_t *returnIndex )
+{
+	BTNodeSidecar	*sidecar;
+	BTreeKeyPrefix	searchPrefix;
+	KeyCompareProcPtr compareProc = btreePtr->keyCompareProc;
+	int32_t		lowerBound;
+	int32_t		upperBound;
+	int32_t		index;
+	int32_t		result;
+	KeyPtr		trialKey;
+	u_int16_t	*offset;
+	Boolean		lowerChecked;		// key below lowerBound was compared in full
+	Boolean		upperChecked;		// key above upperBound was compared in full
+	Boolean		compared;
+
+	if (btreePtr->sidecars == NULL || node->kind != kBTIndexNode || node->numRecords == 0)
+		return SearchNode(btreePtr, node, searchKey, returnIndex);
+
+	sidecar = &btreePtr->sidecars[nodeNum % kBTSidecarSlots];
+	if (!OSCompareAndSwap(0, 1, &sidecar->busy))
+		return SearchNode(btreePtr, node, searchKey, returnIndex);
+
+	// Nodes that share a slot compete for it; the one searched more keeps it
+	if (sidecar->nodeNum != nodeNum) {
+		if (sidecar->searches > 0) {
+			--sidecar->searches;
+			(void) OSCompareAndSwap(1, 0, &sidecar->busy);
+			return SearchNode(btreePtr, node, searchKey, returnIndex);
+		}
+		sidecar->nodeNum = nodeNum;
+		sidecar->numRecords = 0;
+	}
+	if (sidecar->searches < kBTSidecarMaxSearches)
+		++sidecar->searches;
+
+	// Only nodes searched often enough pay back the cost of building
+	if (sidecar->numRecords != node->numRecords &&
+	    (sidecar->searches < kBTSidecarMinSearches ||
+	     !BuildNodeSidecar(btreePtr, sidecar, node))) {
+		(void) OSCompareAndSwap(1, 0, &sidecar->busy);
+		return SearchNode(btreePtr, node, searchKey, returnIndex);
+	}
+	++btreePtr->numSidecarSearches;
+
+	btreePtr->keyPrefixProc(searchKey, sidecar->skip, &searchPrefix);
+
+	lowerBound = 0;
+	upperBound = node->numRecords - 1;
+	lowerChecked = upperChecked = true;		// nothing beyond either end
+	offset = (u_int16_t *) ((u_int8_t *)(node) + (btreePtr)->nodeSize - kOffsetSize);
+
+	while (lowerBound <= upperBound) {
+		index = (lowerBound + upperBound) >> 1;
+
+		result = CompareKeyPrefixes(&searchPrefix, &sidecar->prefixes[index]);
+		compared = (result == 0);
+		if (compared) {
+			trialKey = (KeyPtr) ((u_int8_t *)node + *(offset - index));
+			result = compareProc(searchKey, trialKey);
+		}
+
+		if (result <  0) {
+			upperBound = index - 1;	  /* search < trial */
+			upperChecked = compared;
+		} else if (result >  0) {
+			lowerBound = index + 1;	  /* search > trial */
+			lowerChecked = compared;
+		} else {
+			(void) OSCompareAndSwap(1, 0, &sidecar->busy);
+			*returnIndex = index;	  /* search == trial */
+			return true;
+		}
+	}
+
+	// The insert index must fall between a smaller and a larger key
+	if ((!upperChecked &&
+	     compareProc(searchKey, (KeyPtr) ((u_int8_t *)node + *(offset - lowerBound))) >= 0) ||
+	    (!lowerChecked &&
+	     compareProc(searchKey, (KeyPtr) ((u_int8_t *)node + *(offset - (lowerBound - 1)))) <= 0)) {
+		++btreePtr->numSidecarMisses;
+		sidecar->numRecords = 0;
+		(void) OSCompareAndSwap(1, 0, &sidecar->busy);
+		return SearchNode(btreePtr, node, searchKey, returnIndex);
+	}
+
+	(void) OSCompareAndSwap(1, 0, &sidecar->busy);
+
+	*returnIndex = lowerBound;	/* lowerBound is insert index */
+	return false;
+}
+
+
+/*-------------------------------------------------------------------------------
+
+Routine:	FreeNodeSidecars	-	Release the key prefix caches of a tree.
+
+Function:	Called with the tree locked exclusively, so no search holds a slot.
+
+Input:		btreePtr	- pointer to BTree control block
+
+Result:		none
+-------------------------------------------------------------------------------*/
+void
+FreeNodeSidecars( BTreeControlBlockPtr btreePtr )
+{
+	BTNodeSidecar	*sidecars = btreePtr->sidecars;
+	int				i;
+
+	if (sidecars == NULL)
+		return;
+
+	btreePtr->sidecars = NULL;
+	for (i = 0; i < kBTSidecarSlots; ++i) {
+		if (sidecars[i].prefixes != NULL)
+			hfs_delete_data(sidecars[i].prefixes, BTreeKeyPrefix, sidecars[i].capacity);
+	}
+	hfs_delete(sidecars, BTNodeSidecar, kBTSidecarSlots);
+}
+
+
 /*-------------------------------------------------------------------------------
 
 Routine:	GetRecordByIndex	-	Return pointer to key and data, and size of data.
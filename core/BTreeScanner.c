@@ -27,7 +27,9 @@
  *
  *	@(#)BTreeScanner.c
  */
+#if !HFS_BTREE_TEST
 #include <sys/kernel.h>
+#endif
 #include "hfs_endian.h"
 
 #include "BTreeScanner.h"
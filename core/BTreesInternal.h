@@ -287,6 +287,29 @@ typedef BTreeIterator *BTreeIteratorPtr;
 */
 //typedef int32_t 				(* KeyCompareProcPtr)(BTreeKeyPtr a, BTreeKeyPtr b);
 
+/*
+	Key Prefix Function ProcPtr Type - for BTSetKeyPrefixProc
+
+	Summarizes a key so that most comparisons can be made without the key
+	compare proc.  Keys order by major first, then by the sequence of minor
+	values as unsigned integers; minor[] holds that sequence from position
+	skip on.  complete is set when the sequence ends within minor[], so that
+	the key sorts before any longer key it is a prefix of.  Ties are left to
+	the key compare proc.
+*/
+enum {
+	kBTKeyPrefixLength = 5
+};
+
+typedef struct BTreeKeyPrefix {
+	u_int32_t				major;			// e.g. catalog parent ID
+	u_int8_t				count;			// valid entries in minor[]
+	u_int8_t				complete;		// sequence ends within minor[]
+	u_int16_t				minor[kBTKeyPrefixLength];
+} BTreeKeyPrefix;
+
+typedef void (* KeyPrefixProcPtr)(void *key, u_int16_t skip, BTreeKeyPrefix *prefix);
+
 
 typedef int32_t (* IterateCallBackProcPtr)(BTreeKeyPtr key, void * record, void * state);
 
@@ -295,6 +318,9 @@ extern OSStatus	BTOpenPath(FCB *filePtr, KeyCompareProcPtr keyCompareProc);
 
 extern OSStatus	BTClosePath			(FCB		 				*filePtr );
 
+extern OSStatus	BTSetKeyPrefixProc	(FCB						*filePtr,
+									 KeyPrefixProcPtr			 keyPrefixProc );
+
 
 extern OSStatus	BTSearchRecord		(FCB		 				*filePtr,
 									 BTreeIterator				*searchIterator,
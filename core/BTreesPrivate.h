@@ -160,6 +160,21 @@ enum {
 			kOffsetSize				= 2
 };
 
+// Percentage of the bytes in a split node that end up in the new left node.
+// Leaf records inserted in key order get the uneven split (see InsertNode).
+enum {
+			kBTEvenSplitPercent		= 50,
+			kBTAppendSplitPercent	= 90
+};
+
+// Key prefix sidecars of index nodes (see SearchNodeSidecar).
+enum {
+			kBTSidecarSlots			= 64,	// nodes cached per tree
+			kBTSidecarMinSearches	= 16,	// searches of a node before building one
+			kBTSidecarMaxSearches	= 256,	// credit against other nodes in the slot
+			kBTSidecarMaxSkip		= 64	// longest shared key prefix skipped
+};
+
 // Insert Operations
 typedef enum {
 			kInsertRecord			= 0,
@@ -188,6 +203,17 @@ typedef enum {
 
 ///////////////////////////////////// Types /////////////////////////////////////
 
+// In-memory key prefixes of one index node; never written to disk.
+typedef struct BTNodeSidecar {
+	volatile u_int32_t			 busy;			// held while building or searching
+	u_int32_t					 nodeNum;
+	u_int16_t					 numRecords;	// 0 until built
+	u_int16_t					 searches;		// recent searches of nodeNum
+	u_int16_t					 skip;			// minor values all keys share
+	u_int16_t					 capacity;		// entries allocated in prefixes
+	BTreeKeyPrefix				*prefixes;
+} BTNodeSidecar;
+
 typedef struct BTreeControlBlock {					// fields specific to BTree CBs
 
 	u_int8_t		keyCompareType;   /* Key string Comparison Type */
@@ -227,6 +253,15 @@ typedef struct BTreeControlBlock {					// fields specific to BTree CBs
 	u_int32_t					 numPossibleHints;	// Looks like a formated hint
 	u_int32_t					 numValidHints;		// Hint used to find correct record.
 	u_int32_t					reservedNodes;
+	u_int32_t					 numSplits;
+	u_int32_t					 numAppendSplits;	// splits that packed the left node
+	u_int32_t					 lastInsertNode;	// where the last leaf record went,
+	u_int16_t					 lastInsertIndex;	//   to detect inserts in key order
+	KeyPrefixProcPtr			 keyPrefixProc;		// optional, see BTSetKeyPrefixProc
+	BTNodeSidecar				*sidecars;			// kBTSidecarSlots, if keyPrefixProc
+	u_int32_t					 numSidecarBuilds;
+	u_int32_t					 numSidecarSearches;
+	u_int32_t					 numSidecarMisses;	// answers the node disagreed with
 	BTreeIterator   iterator; // useable when holding exclusive b-tree lock
 
 #if DEBUG
@@ -450,6 +485,14 @@ Boolean		SearchNode				(BTreeControlBlockPtr	 btree,
 									 KeyPtr					 searchKey,
 									 u_int16_t				*index );
 
+Boolean		SearchNodeSidecar		(BTreeControlBlockPtr	 btree,
+									 u_int32_t				 nodeNum,
+									 NodeDescPtr			 node,
+									 KeyPtr					 searchKey,
+									 u_int16_t				*index );
+
+void		FreeNodeSidecars		(BTreeControlBlockPtr	 btree );
+
 OSStatus	GetRecordByIndex		(BTreeControlBlockPtr	 btree,
 									 NodeDescPtr			 node,
 									 u_int16_t				 index,
@@ -46,7 +46,7 @@
 #include <sys/param.h>
 #include <sys/vnode.h>
 
-#if !HFS_ALLOC_TEST
+#if !HFS_ALLOC_TEST && !HFS_BTREE_TEST
 
 #include "hfs.h"
 #include "hfs_macos_defs.h"
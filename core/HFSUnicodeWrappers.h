@@ -109,6 +109,9 @@ extern int32_t FastUnicodeCompare(register ConstUniCharArrayPtr str1, register I
 extern int32_t UnicodeBinaryCompare (register ConstUniCharArrayPtr str1, register ItemCount length1,
 								 register ConstUniCharArrayPtr str2, register ItemCount length2);
 
+extern ItemCount FastUnicodeFoldPrefix(ConstUniCharArrayPtr str, ItemCount length, ItemCount skip,
+								 u_int16_t *folded, ItemCount maxChars, Boolean *complete);
+
 extern int32_t FastRelString( ConstStr255Param str1, ConstStr255Param str2 );
 
 
@@ -419,6 +419,53 @@ int32_t FastUnicodeCompare ( register ConstUniCharArrayPtr str1, register ItemCo
 		return 1;
 }
 
+/*
+ * FastUnicodeFoldPrefix
+ * Fold the start of a string the way FastUnicodeCompare walks it.
+ *
+ * Skips the first skip values FastUnicodeCompare would compare for str,
+ * stores up to maxChars of the following ones in folded[] and returns how
+ * many were stored.  *complete is set if the comparison would stop before
+ * the end of folded[], either at the end of the string or at a character
+ * that folds to zero.
+ */
+ItemCount FastUnicodeFoldPrefix(ConstUniCharArrayPtr str, ItemCount length, ItemCount skip,
+								u_int16_t *folded, ItemCount maxChars, Boolean *complete)
+{
+	u_int16_t		c;
+	u_int16_t		temp;
+	u_int16_t*		lowerCaseTable;
+	ItemCount		count;
+
+	lowerCaseTable = (u_int16_t*) gLowerCaseTable;
+
+	for (count = 0; count < skip + maxChars; ++count) {
+		c = 0;
+
+		/* Same steps as FastUnicodeCompare */
+		while (length && c == 0) {
+			c = *(str++);
+			--length;
+			if (c < 0x0100) {
+				c = gLatinCaseFold[c];
+				break;
+			}
+			if ((temp = lowerCaseTable[c>>8]) != 0)
+				c = lowerCaseTable[temp + (c & 0x00FF)];
+		}
+
+		if (c == 0) {
+			*complete = true;
+			return (count > skip) ? count - skip : 0;
+		}
+		if (count >= skip)
+			folded[count - skip] = c;
+	}
+
+	*complete = false;
+	return maxChars;
+}
+
 /*
  * UnicodeBinaryCompare
  * Compare two UTF-16 strings and perform case-sensitive (binary) matching against them.
@@ -161,7 +161,15 @@ Optimization Routines
 #include <sys/buf.h>
 
 #if HFS_ALLOC_TEST
-#define KERNEL_DEBUG_CONSTANT(x, a, b, c, d, e) do {} while (0)
+/*
+ * The unit test supplies this so that it can count allocator events
+ * (e.g. free extent cache and summary table hits) when benchmarking.
+ */
+void hfs_alloc_test_trace(uint32_t code, uintptr_t a, uintptr_t b,
+						  uintptr_t c, uintptr_t d);
+#define KERNEL_DEBUG_CONSTANT(x, a, b, c, d, e)	\
+	hfs_alloc_test_trace((x), (uintptr_t)(a), (uintptr_t)(b),	\
+						 (uintptr_t)(c), (uintptr_t)(d))
 #else // !HFS_ALLOC_TEST
 
 #include "hfs_macos_defs.h"
@@ -4294,6 +4302,9 @@ int hfs_find_summary_free (struct hfsmount *hfsmp, uint32_t block,  uint32_t *ne
 	uint32_t bit_index = 0;
 	uint32_t maybe_has_blocks = 0;
 
+	if (hfs_kdebug_allocation & HFSDBG_BITMAP_ENABLED)
+		KERNEL_DEBUG_CONSTANT(HFSDBG_FIND_SUMMARY_FREE | DBG_FUNC_START, block, 0, 0, 0, 0);
+
 	if (hfsmp->hfs_flags & HFS_SUMMARY_TABLE) {
 		uint32_t byte_index;
 		uint8_t curbyte;
@@ -4377,6 +4388,9 @@ summary_exit:
 		err = 0;
 	}
 
+	if (hfs_kdebug_allocation & HFSDBG_BITMAP_ENABLED)
+		KERNEL_DEBUG_CONSTANT(HFSDBG_FIND_SUMMARY_FREE | DBG_FUNC_END, err, block, maybe_has_blocks ? *newblock : 0, 0, 0);
+
 	return err;
 }
 
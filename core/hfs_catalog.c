@@ -3483,6 +3483,45 @@ CompareExtendedCatalogKeys(HFSPlusCatalogKey *searchKey, HFSPlusCatalogKey *tria
 }
 
 
+/*
+ * cat_keyprefix - summarize an HFS Plus catalog key for b-tree searches.
+ *
+ * Orders keys the same way as CompareExtendedCatalogKeys: parent ID, then
+ * the case-folded name characters after the first skip of them.
+ */
+void
+cat_keyprefix(HFSPlusCatalogKey *key, u_int16_t skip, BTreeKeyPrefix *prefix)
+{
+	Boolean complete;
+
+	prefix->major = key->parentID;
+	prefix->count = FastUnicodeFoldPrefix(&key->nodeName.unicode[0],
+	                                      key->nodeName.length, skip,
+	                                      &prefix->minor[0],
+	                                      kBTKeyPrefixLength, &complete);
+	prefix->complete = complete;
+}
+
+
+/*
+ * cat_binarykeyprefix - summarize an HFS Plus catalog key for b-tree
+ * searches, ordered the same way as cat_binarykeycompare.
+ */
+void
+cat_binarykeyprefix(HFSPlusCatalogKey *key, u_int16_t skip, BTreeKeyPrefix *prefix)
+{
+	u_int16_t length = key->nodeName.length;
+	int i;
+
+	length = (length > skip) ? length - skip : 0;
+	prefix->major = key->parentID;
+	prefix->count = MIN(length, kBTKeyPrefixLength);
+	prefix->complete = (length <= kBTKeyPrefixLength);
+	for (i = 0; i < prefix->count; ++i)
+		prefix->minor[i] = key->nodeName.unicode[skip + i];
+}
+
+
 /*
  * buildkey - build a Catalog b-tree key from a cnode descriptor
  */
@@ -418,6 +418,18 @@ extern int CompareExtendedCatalogKeys(
 			HFSPlusCatalogKey *searchKey,
 			HFSPlusCatalogKey *trialKey);
 
+struct BTreeKeyPrefix;
+
+extern void cat_keyprefix(
+			HFSPlusCatalogKey *key,
+			u_int16_t skip,
+			struct BTreeKeyPrefix *prefix);
+
+extern void cat_binarykeyprefix(
+			HFSPlusCatalogKey *key,
+			u_int16_t skip,
+			struct BTreeKeyPrefix *prefix);
+
 extern void cat_convertattr(
 			struct hfsmount *hfsmp,
 			CatalogRecord * recp,
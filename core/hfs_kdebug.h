@@ -69,8 +69,26 @@ enum {
 	HFSDBG_SYNCER_TIMED   		= HFSDBG_CODE(22),	/* 0x03080058 */
 	HFSDBG_UNMAP_SCAN    		= HFSDBG_CODE(23),	/* 0x0308005C */	
 	HFSDBG_UNMAP_SCAN_TRIM   	= HFSDBG_CODE(24),	/* 0x03080060 */
+	HFSDBG_FIND_SUMMARY_FREE	= HFSDBG_CODE(25),	/* 0x03080064 */
 };
 
+/*
+ * Journal tracepoints. DBG_JOURNAL is subclass 0xD of DBG_FSYSTEM, so these
+ * debug codes are of the form 0x030Dnnnn.
+ */
+#define DBG_JOURNAL_FLUSH			FSDBG_CODE(DBG_JOURNAL, 1)	/* 0x030D0004 */
+#define DBG_JOURNAL_TRIM_ADD		FSDBG_CODE(DBG_JOURNAL, 2)	/* 0x030D0008 */
+#define DBG_JOURNAL_TRIM_REMOVE		FSDBG_CODE(DBG_JOURNAL, 3)	/* 0x030D000C */
+#define DBG_JOURNAL_TRIM_REMOVE_PENDING	FSDBG_CODE(DBG_JOURNAL, 4)	/* 0x030D0010 */
+#define DBG_JOURNAL_TRIM_REALLOC	FSDBG_CODE(DBG_JOURNAL, 5)	/* 0x030D0014 */
+#define DBG_JOURNAL_TRIM_FLUSH		FSDBG_CODE(DBG_JOURNAL, 6)	/* 0x030D0018 */
+#define DBG_JOURNAL_TRIM_UNMAP		FSDBG_CODE(DBG_JOURNAL, 7)	/* 0x030D001C */
+#define DBG_JOURNAL_START_TR		FSDBG_CODE(DBG_JOURNAL, 8)	/* 0x030D0020 */
+#define DBG_JOURNAL_END_TR			FSDBG_CODE(DBG_JOURNAL, 9)	/* 0x030D0024 */
+#define DBG_JOURNAL_LOCK_WAIT		FSDBG_CODE(DBG_JOURNAL, 10)	/* 0x030D0028 */
+#define DBG_JOURNAL_COND_WAIT		FSDBG_CODE(DBG_JOURNAL, 11)	/* 0x030D002C */
+#define DBG_JOURNAL_REPLAY			FSDBG_CODE(DBG_JOURNAL, 12)	/* 0x030D0030 */
+
 /*
     Parameters logged by the above tracepoints: 
 ---------------------------------------------------------------------------------------------------------------------------------
@@ -109,6 +127,23 @@ enum {
     22      HFSDBG_SYNCER_TIMED         now, last_write_completed, hfs_mp->mnt_last_write_issued_timestamp, mnt_pending_write_size, 0 ... now, mnt_last_write_completed_timestamp, mnt_last_write_issued_timestamp, hfs_mp->mnt_pending_write_size, 0 
     23      HFSDBG_UNMAP_SCAN           hfs_raw_dev, 0, 0, 0, 0 ... hfs_raw_dev, error, 0, 0, 0
     24      HFSDBG_UNMAP_TRIM           hfs_raw_dev, 0, 0, 0, 0 ... hfs_raw_dev, error, 0, 0, 0  
+    25      HFSDBG_FIND_SUMMARY_FREE    startBlock, 0, 0, 0, 0 ... err, startBlock, suggestedBlock, 0, 0
+
+0x30D0004   DBG_JOURNAL_FLUSH           jnl, options, 0, 0, 0 ... jnl, error, 0, 0, 0 (the kernel only logs jnl)
+0x30D0008   DBG_JOURNAL_TRIM_ADD        jnl, offset, length, extent_count, 0 ... err, 0, 0, extent_count, 0
+0x30D000C   DBG_JOURNAL_TRIM_REMOVE     jnl, offset, length, extent_count, 0 ... err, 0, 0, extent_count, 0
+0x30D0010   DBG_JOURNAL_TRIM_REMOVE_PENDING jnl, offset, length, 0, 0 ... err, 0, 0, async_extent_count, 0
+0x30D0014   DBG_JOURNAL_TRIM_REALLOC    trim, 0, allocated_count, extent_count, 0 ... err, 0, allocated_count, extent_count, 0
+0x30D0018   DBG_JOURNAL_TRIM_FLUSH      jnl, tr, 0, extent_count, 0 ... err, 0, 0, 0, 0
+0x30D001C   DBG_JOURNAL_TRIM_UNMAP      jnl, tr, 0, extent_count, 0 ... err, 0, 0, 0, 0
+0x30D0020   DBG_JOURNAL_START_TR        jnl, nested_count, 0, 0, 0 ... err, nested_count, 0, 0, 0
+0x30D0024   DBG_JOURNAL_END_TR          jnl, total_bytes, num_blhdrs, flush_on_completion, 0 ... err, 0, 0, 0, 0
+0x30D0028   DBG_JOURNAL_LOCK_WAIT       jnl, 0, 0, 0, 0 ... jnl, 0, 0, 0, 0
+0x30D002C   DBG_JOURNAL_COND_WAIT       jnl, condition, 0, 0, 0 ... jnl, condition, 0, 0, 0
+0x30D0030   DBG_JOURNAL_REPLAY          jnl, jhdr start, jhdr end, 0, 0 ... err, 0, 0, 0, 0
+
+    The DBG_JOURNAL_START_TR .. DBG_JOURNAL_REPLAY events are currently only
+    emitted by the livefiles plugin (livefiles_hfs_plugin/lf_hfs_trace.h).
 */
 
 #endif // HFS_KDEBUG_H_
@@ -457,6 +457,16 @@ OSErr hfs_MountHFSPlusVolume(struct hfsmount *hfsmp, HFSPlusVolumeHeader *vhp,
 		}
 	}
 
+	/*
+	 * Let catalog searches compare parent IDs and leading name characters
+	 * cached per index node before falling back to the full key compare.
+	 * Not fatal if the memory isn't there.
+	 */
+	(void) BTSetKeyPrefixProc(VTOF(hfsmp->hfs_catalog_vp),
+	                          (hfsmp->hfs_flags & HFS_CASE_SENSITIVE) ?
+	                          (KeyPrefixProcPtr)cat_binarykeyprefix :
+	                          (KeyPrefixProcPtr)cat_keyprefix);
+
 	hfs_unlock(hfsmp->hfs_catalog_cp);
 
 	/*
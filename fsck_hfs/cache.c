@@ -308,6 +308,10 @@ int CacheDestroy (Cache_t *cache)
 	printf ("\tWrite Requests: %d\n", cache->ReqWrite);
 	printf ("\tDisk Reads:     %d\n", cache->DiskRead);
 	printf ("\tDisk Writes:    %d\n", cache->DiskWrite);
+	printf ("\tBytes Read:     %llu\n", cache->BytesRead);
+	printf ("\tBytes Written:  %llu\n", cache->BytesWritten);
+	printf ("\tCache Hits:     %d\n", cache->Hits);
+	printf ("\tCache Misses:   %d\n", cache->Misses);
 	printf ("\tSpans:          %d\n", cache->Span);
 #endif	
 	/* Shutdown the LRU */
@@ -1266,7 +1270,11 @@ int CacheLookup (Cache_t *cache, uint64_t off, Tag_t **tag)
 	}
 
 	/* Make sure there's a buffer */
-	if (temp->Buffer == NULL) {
+	if (temp->Buffer != NULL) {
+		cache->Hits++;
+	} else {
+		cache->Misses++;
+
 		/* Find a free buffer */
 		temp->Buffer = CacheAllocBlock (cache);
 		if (temp->Buffer == NULL) {
@@ -1329,6 +1337,7 @@ int CacheRawRead (Cache_t *cache, uint64_t off, uint32_t len, void *buf)
 
 	/* Update counters */
 	cache->DiskRead++;
+	cache->BytesRead += nread;
 	
 	return (EOK);
 }
@@ -1360,6 +1369,7 @@ int CacheRawWrite (Cache_t *cache, uint64_t off, uint32_t len, void *buf)
 	
 	/* Update counters */
 	cache->DiskWrite++;
+	cache->BytesWritten += nwritten;
 	
 	return (EOK);
 }
@@ -157,6 +157,11 @@ typedef struct Cache_t
 	
 	uint32_t	DiskRead;	/* Number of actual disk reads */
 	uint32_t	DiskWrite;	/* Number of actual disk writes */
+	uint64_t	BytesRead;	/* Bytes transferred by disk reads */
+	uint64_t	BytesWritten;	/* Bytes transferred by disk writes */
+
+	uint32_t	Hits;		/* Block lookups satisfied from the cache */
+	uint32_t	Misses;		/* Block lookups that went to disk */
 
 	uint32_t	Span;		/* Requests that spanned cache blocks */
 } Cache_t;
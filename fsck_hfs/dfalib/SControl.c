@@ -32,13 +32,6 @@
 	Copyright:	 1985, 1986, 1992-1999 by Apple Computer, Inc., all rights reserved.
 */
 
-#define SHOW_ELAPSED_TIMES  0
-
-
-#if SHOW_ELAPSED_TIMES
-#include <sys/time.h>
-#endif
-
 #include "Scavenger.h"
 #include "fsck_journal.h"
 #include <setjmp.h>
@@ -568,12 +561,14 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 {
 	OSErr			result;
 	unsigned int		stat;
-#if SHOW_ELAPSED_TIMES
-	struct timeval 	myStartTime;
-	struct timeval 	myEndTime;
-	struct timeval 	myElapsedTime;
-	struct timezone zone;
-#endif
+	PhaseMetrics		stageMetrics;
+	PhaseMetrics		phaseMetrics;
+	static const char	*stageNames[] = {
+		[scavInitialize] = "scavInitialize",
+		[scavVerify] = "scavVerify",
+		[scavRepair] = "scavRepair",
+		[scavTerminate] = "scavTerminate",
+	};
 
 	//
 	//	initialize some stuff
@@ -581,6 +576,7 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 	result			= noErr;						//	assume good status
 	*ScavRes		= 0;	
 	GPtr->ScavRes	= 0;
+	PhaseMetricsBegin( &stageMetrics, (ScavOp <= scavTerminate) ? stageNames[ScavOp] : "scavUnknown" );
 	
 	//		
 	//	dispatch next scavenge operation
@@ -721,30 +717,20 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 		case scavVerify:								//	VERIFY
 		{
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myStartTime, &zone );
-#endif
+			PhaseMetricsBegin( &phaseMetrics, "BitMapCheckBegin" );
 
 			/* Initialize volume bitmap structure */
 			if ( BitMapCheckBegin(GPtr) != 0)
 				break;
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myEndTime, &zone );
-			timersub( &myEndTime, &myStartTime, &myElapsedTime );
-			plog( "\n%s - BitMapCheck elapsed time \n", __FUNCTION__ );
-			plog( "########## secs %d msecs %d \n\n", 
-				myElapsedTime.tv_sec, myElapsedTime.tv_usec );
-#endif
+			PhaseMetricsEnd( GPtr, &phaseMetrics );
 
 			if ( IsBlueBoxSharedDrive( GPtr->DrvPtr ) )
 				break;
 			if ( ( result = CheckForStop( GPtr ) ) )
 				break;
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myStartTime, &zone );
-#endif
+			PhaseMetricsBegin( &phaseMetrics, "CreateBTreeControlBlocks" );
 
 			/* Create calculated BTree structures */
 			if ( ( result = CreateExtentsBTreeControlBlock( GPtr ) ) )	
@@ -756,13 +742,7 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 			if ( ( result = CreateExtendedAllocationsFCB( GPtr ) ) )
 				break;
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myEndTime, &zone );
-			timersub( &myEndTime, &myStartTime, &myElapsedTime );
-			plog( "\n%s - create control blocks elapsed time \n", __FUNCTION__ );
-			plog( ">>>>>>>>>>>>> secs %d msecs %d \n\n", 
-				myElapsedTime.tv_sec, myElapsedTime.tv_usec );
-#endif
+			PhaseMetricsEnd( GPtr, &phaseMetrics );
 
 			//	Now that preflight of the BTree structures is calculated, compute the CheckDisk items
 			CalculateItemCount( GPtr, &GPtr->itemsToProcess, &GPtr->onePercent );
@@ -774,21 +754,13 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 			GPtr->itemsProcessed += GPtr->onePercent;	// We do this 4 times as set up in CalculateItemCount() to smooth the scroll
 			fsckPrint(GPtr->context, hfsExtBTCheck);
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myStartTime, &zone );
-#endif
+			PhaseMetricsBegin( &phaseMetrics, "ExtBTChk" );
 				
 			/* Verify extent btree structure */
 			if ((result = ExtBTChk(GPtr)))
 				break;
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myEndTime, &zone );
-			timersub( &myEndTime, &myStartTime, &myElapsedTime );
-			plog( "\n%s - ExtBTChk elapsed time \n", __FUNCTION__ );
-			plog( ">>>>>>>>>>>>> secs %d msecs %d \n\n", 
-				myElapsedTime.tv_sec, myElapsedTime.tv_usec );
-#endif
+			PhaseMetricsEnd( GPtr, &phaseMetrics );
 				
 			if ((result = CheckForStop(GPtr)))
 				break;
@@ -805,9 +777,7 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 			GPtr->itemsProcessed += GPtr->onePercent;
 			fsckPrint(GPtr->context, hfsCatBTCheck);
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myStartTime, &zone );
-#endif
+			PhaseMetricsBegin( &phaseMetrics, "CheckCatalogBTree" );
 				
 			if ( GPtr->chkLevel == kPartialCheck )
 			{
@@ -834,13 +804,7 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 			if ((result = CheckCatalogBTree(GPtr)))
 				break;
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myEndTime, &zone );
-			timersub( &myEndTime, &myStartTime, &myElapsedTime );
-			plog( "\n%s - CheckCatalogBTree elapsed time \n", __FUNCTION__ );
-			plog( ">>>>>>>>>>>>> secs %d msecs %d \n\n", 
-				myElapsedTime.tv_sec, myElapsedTime.tv_usec );
-#endif
+			PhaseMetricsEnd( GPtr, &phaseMetrics );
 
 			if ((result = CheckForStop(GPtr)))
 				break;
@@ -848,21 +812,13 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 			if (scanflag == 0) {
 				fsckPrint(GPtr->context, hfsCatHierCheck);
 
-#if SHOW_ELAPSED_TIMES
-				gettimeofday( &myStartTime, &zone );
-#endif
+				PhaseMetricsBegin( &phaseMetrics, "CatHChk" );
 				
 				/* Check catalog hierarchy */
 				if ((result = CatHChk(GPtr)))
 					break;
 
-#if SHOW_ELAPSED_TIMES
-				gettimeofday( &myEndTime, &zone );
-				timersub( &myEndTime, &myStartTime, &myElapsedTime );
-				plog( "\n%s - CatHChk elapsed time \n", __FUNCTION__ );
-				plog( ">>>>>>>>>>>>> secs %d msecs %d \n\n", 
-					myElapsedTime.tv_sec, myElapsedTime.tv_usec );
-#endif
+				PhaseMetricsEnd( GPtr, &phaseMetrics );
 
 				if ((result = CheckForStop(GPtr)))
 					break;
@@ -880,9 +836,13 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 			 * for extended attributes whose values are stored in 
 			 * allocation blocks
 			 */
+			PhaseMetricsBegin( &phaseMetrics, "AttrBTChk" );
+
 			if ((result = AttrBTChk(GPtr)))
 				break;
 
+			PhaseMetricsEnd( GPtr, &phaseMetrics );
+
 			if ((result = CheckForStop(GPtr)))
 				break;
 
@@ -924,42 +884,26 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 
 			fsckPrint(GPtr->context, hfsVolBitmapCheck);
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myStartTime, &zone );
-#endif
+			PhaseMetricsBegin( &phaseMetrics, "CheckVolumeBitMap" );
 				
 			/* Compare in-memory volume bitmap with on-disk bitmap */
 			if ((result = CheckVolumeBitMap(GPtr, false)))
 				break;
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myEndTime, &zone );
-			timersub( &myEndTime, &myStartTime, &myElapsedTime );
-			plog( "\n%s - CheckVolumeBitMap elapsed time \n", __FUNCTION__ );
-			plog( ">>>>>>>>>>>>> secs %d msecs %d \n\n", 
-				myElapsedTime.tv_sec, myElapsedTime.tv_usec );
-#endif 
+			PhaseMetricsEnd( GPtr, &phaseMetrics );
 
 			if ((result = CheckForStop(GPtr)))
 				break;
 
 			fsckPrint(GPtr->context, hfsVolInfoCheck);
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myStartTime, &zone );
-#endif
+			PhaseMetricsBegin( &phaseMetrics, "VInfoChk" );
 
 			/* Verify volume level information */
 			if ((result = VInfoChk(GPtr)))
 				break;
 
-#if SHOW_ELAPSED_TIMES
-			gettimeofday( &myEndTime, &zone );
-			timersub( &myEndTime, &myStartTime, &myElapsedTime );
-			plog( "\n%s - VInfoChk elapsed time \n", __FUNCTION__ );
-			plog( ">>>>>>>>>>>>> secs %d msecs %d \n\n", 
-				myElapsedTime.tv_sec, myElapsedTime.tv_usec );
-#endif
+			PhaseMetricsEnd( GPtr, &phaseMetrics );
 
 			stat =	GPtr->VIStat  | GPtr->ABTStat | GPtr->EBTStat | GPtr->CBTStat | 
 					GPtr->CatStat | GPtr->JStat;
@@ -1015,6 +959,7 @@ void ScavCtrl( SGlobPtr GPtr, UInt32 ScavOp, short *ScavRes )
 		}
 	}													//	end ScavOp switch
 
+	PhaseMetricsEnd( GPtr, &stageMetrics );
 
 	//
 	//	Map internal error codes to scavenger result codes
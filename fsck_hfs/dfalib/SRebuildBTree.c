@@ -31,15 +31,10 @@
 
 */
 
-#define SHOW_ELAPSED_TIMES  0
 #define DEBUG_REBUILD  0
 
 extern void MyIndirectLog(const char *);
 
-#if SHOW_ELAPSED_TIMES
-#include <sys/time.h>
-#endif
-
 #include "Scavenger.h"
 #include "../cache.h"
 
@@ -137,13 +132,10 @@ OSErr	RebuildBTree( SGlobPtr theSGlobPtr, int FileID )
 	OSErr					myErr;
 	Boolean 				isHFSPlus;
 	UInt32					numRecords = 0;
+	PhaseMetrics			myMetrics;
 	
-#if SHOW_ELAPSED_TIMES 
-	struct timeval 			myStartTime;
-	struct timeval 			myEndTime;
-	struct timeval 			myElapsedTime;
-	struct timezone 		zone;
-#endif
+	PhaseMetricsBegin( &myMetrics, (kHFSCatalogFileID == FileID) ? "RebuildCatalogBTree" :
+								   (kHFSExtentsFileID == FileID) ? "RebuildExtentsBTree" : "RebuildAttributesBTree" );
  
 	theSGlobPtr->TarID = FileID;
 	theSGlobPtr->TarBlock = 0;
@@ -262,10 +254,6 @@ OSErr	RebuildBTree( SGlobPtr theSGlobPtr, int FileID )
 	}
 	myFCBPtr = theSGlobPtr->calculatedRepairFCB;
 
-#if SHOW_ELAPSED_TIMES
-	gettimeofday( &myStartTime, &zone );
-#endif
-	
 #if DEBUG_REBUILD
 	if (debug) {
 		int i;
@@ -343,13 +331,6 @@ OSErr	RebuildBTree( SGlobPtr theSGlobPtr, int FileID )
 #endif
 	}
 
-#if SHOW_ELAPSED_TIMES
-	gettimeofday( &myEndTime, &zone );
-	timersub( &myEndTime, &myStartTime, &myElapsedTime );
-	plog( "\n%s - rebuild btree %u %u records elapsed time \n", __FUNCTION__, FileID, numRecords );
-	plog( ">>>>>>>>>>>>> secs %d msecs %d \n\n", myElapsedTime.tv_sec, myElapsedTime.tv_usec );
-#endif
-
 	if ( btNotFound == myErr )
 		myErr = noErr;
 	if ( noErr != myErr )
@@ -431,6 +412,7 @@ ExitThisRoutine:
 	if ( myErr != noErr && myFCBPtr != NULL ) 
 		(void) DeleteBTree( theSGlobPtr, myFCBPtr );
 	BTScanTerminate( &theSGlobPtr->scanState  );
+	PhaseMetricsEnd( theSGlobPtr, &myMetrics );
 
 	return( myErr );
 	
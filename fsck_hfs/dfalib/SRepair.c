@@ -152,6 +152,7 @@ static int MRepair( SGlobPtr GPtr )
 	SVCB			*calculatedVCB	= GPtr->calculatedVCB;
 	Boolean			isHFSPlus;
 	Boolean			didRebuild = false;
+	PhaseMetrics	metrics;
 
 	isHFSPlus = VolumeObjectIsHFSPlus( );
 
@@ -221,20 +222,26 @@ static int MRepair( SGlobPtr GPtr )
 	 * set up.
 	 */
 	if (GPtr->CatStat & S_FileHardLinkChain) {
+		PhaseMetricsBegin( &metrics, "RepairFileHardLinkChains" );
 		err = RepairHardLinkChains(GPtr, false);
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError(err);
 	}
 
  	err = CheckForStop( GPtr ); ReturnIfError( err );				//	Permit the user to interrupt
 
 	if (GPtr->CatStat & S_DirHardLinkChain) {
+		PhaseMetricsBegin( &metrics, "RepairDirHardLinkChains" );
 		err = RepairHardLinkChains(GPtr, true);
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError(err);
 	}
 
  	err = CheckForStop( GPtr ); ReturnIfError( err );				//	Permit the user to interrupt
 	//  Handle repair orders.  Note that these must be done *BEFORE* the MDB is updated.
+	PhaseMetricsBegin( &metrics, "DoMinorOrders" );
 	err = DoMinorOrders( GPtr );
+	PhaseMetricsEnd( GPtr, &metrics );
 	ReturnIfError( err );
   	err = CheckForStop( GPtr ); ReturnIfError( err );
 
@@ -245,7 +252,9 @@ static int MRepair( SGlobPtr GPtr )
 	 * Fix missing thread records
 	 */
 	if (GPtr->CatStat & S_MissingThread) {
+		PhaseMetricsBegin( &metrics, "FixMissingThreadRecords" );
 		err = FixMissingThreadRecords(GPtr);
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError(err);
 		
 		GPtr->CatStat &= ~S_MissingThread;
@@ -275,7 +284,9 @@ static int MRepair( SGlobPtr GPtr )
 		if (embedded == 1 && debug == 0)
 			return R_RFail;
 
+		PhaseMetricsBegin( &metrics, "FixOverlappingExtents" );
 		err = FixOverlappingExtents( GPtr );						//	Isolate and fix Overlapping Extents
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError( err );
 		
 		GPtr->VIStat &= ~S_OverlappingExtents;
@@ -290,7 +301,9 @@ static int MRepair( SGlobPtr GPtr )
 				
 	if ( (GPtr->CBTStat & S_Orphan) != 0 )
 	{
+		PhaseMetricsBegin( &metrics, "FixOrphanedFiles" );
 		err = FixOrphanedFiles ( GPtr );							//	Orphaned file were found
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError( err );
 		GPtr->CBTStat |= S_BTH;  									// leaf record count may change - 2913311
 	}
@@ -304,7 +317,9 @@ static int MRepair( SGlobPtr GPtr )
 	 * number of thread records.
 	 */
 	if (GPtr->MinorRepairsP) {
+		PhaseMetricsBegin( &metrics, "DoMinorOrders" );
 		err = DoMinorOrders(GPtr);
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError( err );
 	}
 
@@ -313,7 +328,9 @@ static int MRepair( SGlobPtr GPtr )
 	//
 	if ( (GPtr->EBTStat & S_OrphanedExtent) != 0 )					//	Orphaned extents were found
 	{
+		PhaseMetricsBegin( &metrics, "FixOrphanedExtent" );
 		err = FixOrphanedExtent( GPtr );
+		PhaseMetricsEnd( GPtr, &metrics );
 		GPtr->EBTStat &= ~S_OrphanedExtent;
 	//	if ( err == errRebuildBtree )
 	//		goto RebuildBtrees;
@@ -379,7 +396,9 @@ static int MRepair( SGlobPtr GPtr )
 	// Repair orphaned/invalid attribute records 
 	if (  (GPtr->ABTStat & S_AttrRec) ) 
 	{
+		PhaseMetricsBegin( &metrics, "FixOrphanAttrRecord" );
 		err = FixOrphanAttrRecord( GPtr );
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError( err );
 	}
 
@@ -388,7 +407,9 @@ static int MRepair( SGlobPtr GPtr )
 	if ( (GPtr->ABTStat & S_AttributeCount) || 
 	     (GPtr->ABTStat & S_SecurityCount)) 
 	{
+		PhaseMetricsBegin( &metrics, "RepairAttributes" );
 		err = RepairAttributes( GPtr );
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError( err );
 	}
 	
@@ -415,7 +436,9 @@ static int MRepair( SGlobPtr GPtr )
 	 */
 	if ( (GPtr->CBTStat & S_Orphan) != 0 )
 	{
+		PhaseMetricsBegin( &metrics, "FixOrphanedFiles" );
 		err = FixOrphanedFiles ( GPtr );
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError( err );
 	}
 
@@ -429,7 +452,9 @@ static int MRepair( SGlobPtr GPtr )
 
 	if ( (GPtr->VIStat & S_VBM) != 0 )
 	{
+		PhaseMetricsBegin( &metrics, "UpdateVolumeBitMap" );
 		err = UpdateVolumeBitMap( GPtr, false );					//	update VolumeBitMap
+		PhaseMetricsEnd( GPtr, &metrics );
 		ReturnIfError( err );
 		InvalidateCalculatedVolumeBitMap( GPtr );					//	Invalidate our BitMap
 	}
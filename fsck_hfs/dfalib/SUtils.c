@@ -31,6 +31,7 @@
 */
 
 #include "Scavenger.h"
+#include <sys/resource.h>
 
 static void 	CompareVolHeaderBTreeSizes(	SGlobPtr GPtr,
 											VolumeObjectPtr theVOPtr, 
@@ -1582,6 +1583,86 @@ static void CompareVolHeaderBTreeSizes(	SGlobPtr GPtr,
 } /* CompareVolHeaderBTreeSizes */
 
 
+static void GetPhaseTimes( struct timeval *wall, struct timeval *cpu )
+{
+	struct rusage	usage;
+
+	gettimeofday( wall, NULL );
+	if ( getrusage( RUSAGE_SELF, &usage ) == 0 ) {
+		timeradd( &usage.ru_utime, &usage.ru_stime, cpu );
+	} else {
+		timerclear( cpu );
+	}
+}
+
+
+/*------------------------------------------------------------------------------
+
+Routine:	PhaseMetricsBegin
+
+Function:	Start measuring a verify or repair phase.  Does nothing unless
+			per-phase metrics were requested with -M.
+
+Input:		metrics		-	snapshot to fill in
+			name		-	phase name reported by PhaseMetricsEnd
+
+------------------------------------------------------------------------------*/
+
+void PhaseMetricsBegin( PhaseMetrics *metrics, const char *name )
+{
+	if ( metricsflag == 0 ) {
+		metrics->name = NULL;
+		return;
+	}
+
+	metrics->name = name;
+	metrics->bytesRead = fscache.BytesRead;
+	metrics->bytesWritten = fscache.BytesWritten;
+	metrics->diskReads = fscache.DiskRead;
+	metrics->diskWrites = fscache.DiskWrite;
+	metrics->cacheHits = fscache.Hits;
+	metrics->cacheMisses = fscache.Misses;
+	GetPhaseTimes( &metrics->wallStart, &metrics->cpuStart );
+}
+
+
+/*------------------------------------------------------------------------------
+
+Routine:	PhaseMetricsEnd
+
+Function:	Report the wall and CPU time, disk I/O and cache lookups spent
+			since the matching PhaseMetricsBegin as an fsckPhaseMetrics
+			message, so it shows up in every output style including -x.
+
+Input:		GPtr		-	pointer to scavenger global area
+			metrics		-	snapshot from PhaseMetricsBegin
+
+------------------------------------------------------------------------------*/
+
+void PhaseMetricsEnd( SGlobPtr GPtr, PhaseMetrics *metrics )
+{
+	struct timeval	wall, cpu;
+
+	if ( metrics->name == NULL )
+		return;
+
+	GetPhaseTimes( &wall, &cpu );
+	timersub( &wall, &metrics->wallStart, &wall );
+	timersub( &cpu, &metrics->cpuStart, &cpu );
+
+	fsckPrint( GPtr->context, fsckPhaseMetrics, metrics->name,
+			   (off_t)wall.tv_sec * 1000000 + wall.tv_usec,
+			   (off_t)cpu.tv_sec * 1000000 + cpu.tv_usec,
+			   (off_t)(fscache.BytesRead - metrics->bytesRead),
+			   (off_t)(fscache.DiskRead - metrics->diskReads),
+			   (off_t)(fscache.BytesWritten - metrics->bytesWritten),
+			   (off_t)(fscache.DiskWrite - metrics->diskWrites),
+			   (off_t)(fscache.Hits - metrics->cacheHits),
+			   (off_t)(fscache.Misses - metrics->cacheMisses) );
+	metrics->name = NULL;
+}
+
+
 /*
  * This code should be removed after debugging is completed.
  */
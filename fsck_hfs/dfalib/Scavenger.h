@@ -46,6 +46,7 @@
 #include <sys/errno.h>
 #include <sys/syslimits.h>
 #include <sys/param.h>
+#include <sys/time.h>
 #include <sys/sysctl.h>
 #include <sys/mount.h>
 #include <hfs/hfs_mount.h>
@@ -629,6 +630,22 @@ typedef struct PrimeBuckets {
 	UInt32	n31[31];
 } PrimeBuckets;
 
+/* Snapshot taken at the start of a verify or repair phase for the -M
+ * option; PhaseMetricsEnd() reports the difference.  Counters are
+ * taken from fscache, so I/O that bypasses the cache is not included.
+ */
+typedef struct PhaseMetrics {
+	const char	*name;		/* phase name, NULL if metrics are off */
+	struct timeval	wallStart;
+	struct timeval	cpuStart;	/* user + system time */
+	u_int64_t	bytesRead;
+	u_int64_t	bytesWritten;
+	u_int32_t	diskReads;
+	u_int32_t	diskWrites;
+	u_int32_t	cacheHits;
+	u_int32_t	cacheMisses;
+} PhaseMetrics;
+
 /* Record last attribute ID checked, used in CheckAttributeRecord, initialized in ScavSetup */
 typedef struct attributeInfo {
 	Boolean isValid;
@@ -1027,6 +1044,9 @@ void add_prime_bucket_uint64(PrimeBuckets *cur, uint64_t num);
 
 int compare_prime_buckets(PrimeBuckets *bucket1, PrimeBuckets *bucket2); 
 
+extern void PhaseMetricsBegin( PhaseMetrics *metrics, const char *name );
+extern void PhaseMetricsEnd( SGlobPtr GPtr, PhaseMetrics *metrics );
+
 /* ------------------------------- From CatalogCheck.c -------------------------------- */
 
 extern	OSErr	CheckCatalogBTree( SGlobPtr GPtr );	//	catalog btree check
@@ -73,6 +73,7 @@ char	quick;			/* quick check returns clean, dirty, or failure */
 char	debug;			/* output debugging info */
 char	disable_journal;	/* If debug, and set, do not simulate journal replay */
 char	scanflag;		/* Scan entire disk for bad blocks */
+char	metricsflag;		/* Report per-phase time, I/O and cache counters */
 #if	!TARGET_OS_IPHONE
 char	embedded = 0;
 #else
@@ -133,7 +134,7 @@ main(argc, argv)
 	else
 		progname = *argv;
 
-	while ((ch = getopt(argc, argv, "b:B:c:D:e:Edfglm:npqrR:SuyxJ")) != EOF) {
+	while ((ch = getopt(argc, argv, "b:B:c:D:e:EdfglMm:npqrR:SuyxJ")) != EOF) {
 		switch (ch) {
 		case 'b':
 			gBlockSize = atoi(optarg);
@@ -211,6 +212,10 @@ main(argc, argv)
 			xmlControl++;
 			break;
 
+		case 'M':
+			metricsflag++;
+			break;
+
 		case 'l':
 			lflag++;
 			nflag++;
@@ -884,7 +889,7 @@ ExitThisRoutine:
 static void
 usage()
 {
-	(void) fplog(stderr, "usage: %s [-b [size] B [path] c [size] e [mode] ESdfglx m [mode] npqruy] special-device\n", progname);
+	(void) fplog(stderr, "usage: %s [-b [size] B [path] c [size] e [mode] ESdfglMx m [mode] npqruy] special-device\n", progname);
 	(void) fplog(stderr, "  b size = size of physical blocks (in bytes) for -B option\n");
 	(void) fplog(stderr, "  B path = file containing physical block numbers to map to paths\n");
 	(void) fplog(stderr, "  c size = cache size (ex. 512m, 1g)\n");
@@ -895,6 +900,7 @@ usage()
 	(void) fplog(stderr, "  g = GUI output mode\n");
 	(void) fplog(stderr, "  x = XML output mode\n");
 	(void) fplog(stderr, "  l = live fsck (lock down and test-only)\n");
+	(void) fplog(stderr, "  M = report time, I/O and cache counters per phase\n");
 	(void) fplog(stderr, "  m arg = octal mode used when creating lost+found directory \n");
 	(void) fplog(stderr, "  n = assume a no response \n");
 	(void) fplog(stderr, "  p = just fix normal inconsistencies \n");
@@ -35,6 +35,7 @@ extern char	disable_journal;	/* If debug, and set, do not simulate journal repla
 extern char	embedded;		/* built for embedded */
 extern char	hotroot;		/* checking root device */
 extern char	scanflag;		/* Scan disk for bad blocks */
+extern char	metricsflag;		/* Report per-phase time, I/O and cache counters */
 
 extern int	upgrading;		/* upgrading format */
 
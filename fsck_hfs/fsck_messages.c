@@ -248,8 +248,9 @@ convertfmt(const char *in)
 				}
 			}
 		} else if (fs == fPercent) {
+			/* Length modifiers (as in "%llu") are part of the specifier */
 			switch (*in) {
-				case 'd': case 'i': case 'o': case 'u': case 'x': case 'l':
+				case 'd': case 'i': case 'o': case 'u': case 'x':
 				case 'X': case 'D': case 'O': case 'U': case 'e':
 				case 'E': case 'f': case 'F': case 'g': case 'G':
 				case 'a': case 'A': case 'c': case 'C': case 's':
@@ -65,6 +65,7 @@ enum fsck_msgnum {
     fsckVolumeName                      = 121,	/* The volume name is %s */
     fsckVolumeModified			= 122,	/* The volume was modified */
     fsckLimitedRepairs			= 123,	/* Limited repair mode, not all repairs available */
+    fsckPhaseMetrics			= 124,	/* Phase %s: %llu usec elapsed, %llu usec CPU, ... */
 };
 
 #endif
@@ -37,7 +37,8 @@
  * Most messages have no arguments; if a message does have arguments,
  * it needs to be one of the types defined in fsck_msgnums.h (enum
  * fsck_arg_type).  The format specifier in the message string can be a
- * SIMPLE printf-style:  %d, %i, %u, %o, %x, %s, %c, %p; it needs to be
+ * SIMPLE printf-style:  %d, %i, %u, %o, %x, %s, %c, %p, or %llu for
+ * an fsckTypeFileSize argument; it needs to be
  * converted at run-time to a Cocoa-style specifier, and the conversion
  * routine does not handle all of the possible printf variations.
  * (See convertfmt() in fsck_messages.c for details.)
@@ -72,6 +73,8 @@ fsck_messages_common[] = {
     { fsckVolumeName,                       "The volume name is %s",                                                    fsckMsgInfo,        fsckLevel0,   1, (const int[]) { fsckTypeVolume } },
     { fsckVolumeModified,                   "The volume was modified",                                                  fsckMsgNotice,      fsckLevel0,   0 },
     { fsckLimitedRepairs,                   "Limited repair mode, not all repairs available",                           fsckMsgInfo,        fsckLevel0,   0 },
+    { fsckPhaseMetrics,                     "Phase %s: %llu usec elapsed, %llu usec CPU, %llu bytes read in %llu I/Os, %llu bytes written in %llu I/Os, %llu cache hits, %llu cache misses.",
+                                                                                                                        fsckMsgInfo,        fsckLevel1,   9, (const int[]) { fsckTypeString, fsckTypeFileSize, fsckTypeFileSize, fsckTypeFileSize, fsckTypeFileSize, fsckTypeFileSize, fsckTypeFileSize, fsckTypeFileSize, fsckTypeFileSize } },
     { 0, },
 };
 
@@ -180,6 +180,7 @@ typedef struct hfsmount {
     u_int32_t            hfs_summary_bytes;    /* number of BYTES in summary table */
 
     u_int32_t             scan_var;            /* For initializing the summary table */
+    pthread_t             hfs_scan_thread;     /* background bitmap scan, see hfs_scan_blocks */
 
 
     u_int32_t        reserveBlocks;        /* free block reserve */
@@ -245,6 +246,11 @@ typedef struct hfsmount {
 
     pthread_mutex_t      hfs_mutex;      /* protects access to hfsmount data */
     pthread_mutex_t      sync_mutex;     
+
+    /* Cnodes whose catalog record update was deferred, see hfs_defer_update() */
+    pthread_mutex_t      hfs_deferred_mutex;    /* protects the list and cnode c_deferred fields */
+    TAILQ_HEAD(, cnode)  hfs_deferred_cnodes;
+    u_int32_t            hfs_deferred_count;
     
     enum {
         HFS_THAWED,
@@ -287,6 +293,12 @@ typedef struct hfsmount {
     u_long hfs_idhash; /* size of cnid/fileid hash table -1 */
     LIST_HEAD(idhashhead, cat_preflightid) *hfs_idhashtbl; /* base of ID hash */
 
+    /* Free CNID ranges, built on first use after the CNIDs wrapped (protected by catalog lock!) */
+    struct cat_cnid_range *hfs_free_cnids;          /* sorted by start; emptied ranges stay until compaction */
+    u_int32_t             hfs_free_cnids_count;     /* ranges in use */
+    u_int32_t             hfs_free_cnids_size;      /* ranges allocated */
+    u_int32_t             hfs_free_cnids_cursor;    /* range to allocate from next */
+
     // Records the oldest outstanding sync request
     struct timeval    hfs_sync_req_oldest;
 
@@ -371,6 +383,8 @@ enum privdirtype {
 
 #define HFS_ALLOCATOR_SCAN_INFLIGHT     0x0001      /* scan started */
 #define HFS_ALLOCATOR_SCAN_COMPLETED    0x0002      /* initial scan was completed */
+#define HFS_ALLOCATOR_SCAN_THREAD       0x0004      /* background scan thread created and not yet joined */
+#define HFS_ALLOCATOR_SCAN_STOP         0x0008      /* background scan asked to stop (unmount) */
 
 /* HFS mount point flags */
 #define HFS_READ_ONLY             0x00001
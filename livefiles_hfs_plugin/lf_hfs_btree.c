@@ -1212,6 +1212,10 @@ OSStatus    BTInsertRecord        (FCB                        *filePtr,
         {
             err = UpdateNode (btreePtr, &nodeRec, 0, kLockTransaction);
             M_ExitOnError (err);
+
+            // InsertNode records this itself when we go through InsertTree
+            btreePtr->lastInsertNode  = insertNodeNum;
+            btreePtr->lastInsertIndex = index;
             
             goto Success;
         }
@@ -107,6 +107,10 @@ typedef struct BTreeControlBlock {                    // fields specific to BTre
     u_int32_t                     numPossibleHints;    // Looks like a formated hint
     u_int32_t                     numValidHints;        // Hint used to find correct record.
     u_int32_t                    reservedNodes;
+    u_int32_t                     numSplits;
+    u_int32_t                     numAppendSplits;    // splits that packed the left node
+    u_int32_t                     lastInsertNode;     // where the last leaf record went,
+    u_int16_t                     lastInsertIndex;    //   to detect inserts in key order
     BTreeIterator   iterator; // useable when holding exclusive b-tree lock
 
 #if DEBUG
@@ -33,6 +33,7 @@ static OSStatus   RotateLeft        (BTreeControlBlockPtr         btreePtr,
                                      u_int16_t                     recSize,
                                      u_int16_t                    *insertIndex,
                                      u_int32_t                    *insertNodeNum,
+                                     u_int16_t                     splitPercent,
                                      Boolean                    *recordFit,
                                      u_int16_t                    *recsRotated );
 
@@ -50,8 +51,14 @@ static OSStatus       SplitLeft        (BTreeControlBlockPtr         btreePtr,
                                         u_int16_t                     recSize,
                                         u_int16_t                    *insertIndex,
                                         u_int32_t                    *insertNodeNum,
+                                        u_int16_t                     splitPercent,
                                         u_int16_t                    *recsRotated );
 
+static Boolean      IsSequentialInsert (BTreeControlBlockPtr         btreePtr,
+                                        NodeDescPtr                 node,
+                                        u_int32_t                     nodeNum,
+                                        u_int16_t                     index );
+
 
 
 static    OSStatus    InsertLevel        (BTreeControlBlockPtr         btreePtr,
@@ -491,10 +498,12 @@ static OSErr    InsertNode    (BTreeControlBlockPtr     btreePtr,
     BlockDescriptor        *targetNode = NULL;
     u_int32_t             leftNodeNum;
     u_int16_t             recsRotated;
+    u_int16_t             splitPercent;
     OSErr                 err;
     Boolean                 recordFit;
 
     *rootSplit = false;
+    splitPercent = kBTEvenSplitPercent;
 
     if (rightNode->buffer == leftNode->buffer)
     {
@@ -535,6 +544,19 @@ static OSErr    InsertNode    (BTreeControlBlockPtr     btreePtr,
     }
 
 
+    /////////////////////// Check For Sequential Insert //////////////////////
+
+    // Records arriving in key order would otherwise be rotated or evenly split
+    // into the left node again on every overflow.  Pack the left node once
+    // instead and skip the rotate (the left sibling was packed last time).
+
+    if ( !recordFit && targetNode == rightNode &&
+         IsSequentialInsert (btreePtr, rightNode->buffer, node, index) )
+    {
+        splitPercent = kBTAppendSplitPercent;
+    }
+
+
     //////////////////////// Try Rotate Left ////////////////////////////////
 
     if ( !recordFit && leftNodeNum > 0 )
@@ -559,10 +581,10 @@ static OSErr    InsertNode    (BTreeControlBlockPtr     btreePtr,
             hfs_assert(0);
         }
         
-        if ( !key->skipRotate )        // are rotates allowed?
+        if ( !key->skipRotate && splitPercent == kBTEvenSplitPercent )        // are rotates allowed?
         {
             err = RotateLeft (btreePtr, leftNode->buffer, rightNode->buffer, index, key->keyPtr, key->recPtr,
-                              key->recSize, newIndex, newNode, &recordFit, &recsRotated );
+                              key->recSize, newIndex, newNode, kBTEvenSplitPercent, &recordFit, &recsRotated );
             M_ExitOnError (err);
 
             if ( recordFit )
@@ -580,7 +602,7 @@ static OSErr    InsertNode    (BTreeControlBlockPtr     btreePtr,
     {
         // might not have left node...
         err = SplitLeft (btreePtr, leftNode, rightNode, node, index, key->keyPtr,
-                         key->recPtr, key->recSize, newIndex, newNode, &recsRotated);
+                         key->recPtr, key->recSize, newIndex, newNode, splitPercent, &recsRotated);
         M_ExitOnError (err);
 
         // if we split root node - add new root
@@ -600,6 +622,12 @@ static OSErr    InsertNode    (BTreeControlBlockPtr     btreePtr,
         }
     }
 
+    if ( ((NodeDescPtr) rightNode->buffer)->kind == kBTLeafNode )
+    {
+        btreePtr->lastInsertNode  = *newNode;
+        btreePtr->lastInsertIndex = *newIndex;
+    }
+
     return noErr;
 
 ErrorExit:
@@ -609,6 +637,50 @@ ErrorExit:
 } // End of InsertNode
 
 
+/////////////////////////////// IsSequentialInsert //////////////////////////////
+
+/*-------------------------------------------------------------------------------
+ Routine:    IsSequentialInsert    -    Guess whether leaf records are arriving in key order.
+
+ Function:    Returns true if the record about to be inserted at index in node is
+ an append to the last leaf node, or continues a run of inserts near
+ the end of node (e.g. sequentially named files being created in a
+ directory that isn't the last one in the catalog).
+
+ Input:        btreePtr    - pointer to control block
+ node        - full node the record is being inserted into
+ nodeNum        - node number of node
+ index        - insert index within node
+
+ Result:        true if the split should favor the left node
+ -------------------------------------------------------------------------------*/
+
+static Boolean    IsSequentialInsert (BTreeControlBlockPtr     btreePtr,
+                                      NodeDescPtr             node,
+                                      u_int32_t                 nodeNum,
+                                      u_int16_t                 index )
+{
+    u_int32_t    frontSize;
+
+    if ( node->kind != kBTLeafNode )
+        return false;
+
+    if ( (node->fLink == 0) && (index == node->numRecords) )
+        return true;
+
+    if ( (btreePtr->lastInsertNode != nodeNum) || (btreePtr->lastInsertIndex + 1 != index) )
+        return false;
+
+    // The records in front of index have to fill most of a node by themselves,
+    // or packing them into the left node would just leave a poorly filled node
+    // behind every split.
+    frontSize = (u_int32_t)(GetRecordAddress (btreePtr, node, index) - (u_int8_t *) node)
+                + (index + 1) * kOffsetSize;
+
+    return ( frontSize * 100 >= (u_int32_t) btreePtr->nodeSize * kBTAppendSplitPercent );
+}
+
+
 /*-------------------------------------------------------------------------------
  Routine:    DeleteTree    -    One_line_description.
 
@@ -885,6 +957,9 @@ ErrorExit:
  keyPtr                - description
  recPtr                - description
  recSize                - description
+ splitPercent        - kBTEvenSplitPercent to balance the two nodes, or the
+                       minimum share of the bytes to pack into leftNode
+                       ahead of the new record (which stays in rightNode)
 
  Output:        insertIndex
  insertNodeNum        - description
@@ -904,6 +979,7 @@ static OSStatus    RotateLeft        (BTreeControlBlockPtr         btreePtr,
                                       u_int16_t                     recSize,
                                       u_int16_t                    *insertIndex,
                                       u_int32_t                    *insertNodeNum,
+                                      u_int16_t                     splitPercent,
                                       Boolean                    *recordFit,
                                       u_int16_t                    *recsRotated )
 {
@@ -911,6 +987,7 @@ static OSStatus    RotateLeft        (BTreeControlBlockPtr         btreePtr,
     int32_t                insertSize;
     int32_t                nodeSize;
     int32_t                leftSize, rightSize;
+    int32_t                totalSize;
     int32_t                moveSize = 0;
     u_int16_t            keyLength;
     u_int16_t            lengthFieldSize;
@@ -940,7 +1017,27 @@ static OSStatus    RotateLeft        (BTreeControlBlockPtr         btreePtr,
 
     moveIndex    = 0;
 
-    while ( leftSize < rightSize )
+    if ( splitPercent != kBTEvenSplitPercent )
+    {
+        // pack the records in front of the new one into the left node
+        totalSize = leftSize + rightSize;
+
+        while ( moveIndex < rightInsertIndex )
+        {
+            moveSize = GetRecordSize (btreePtr, rightNode, moveIndex) + 2;
+            if ( leftSize + moveSize > nodeSize )
+                break;
+
+            leftSize    += moveSize;
+            rightSize    -= moveSize;
+            ++moveIndex;
+        }
+
+        if ( leftSize * 100 < totalSize * splitPercent )    // not worth it - failure, but not error
+            rightSize = nodeSize + 1;
+    }
+
+    while ( splitPercent == kBTEvenSplitPercent && leftSize < rightSize )
     {
         if ( moveIndex < rightInsertIndex )
         {
@@ -1066,6 +1163,7 @@ static OSStatus    SplitLeft        (BTreeControlBlockPtr         btreePtr,
                                      u_int16_t                     recSize,
                                      u_int16_t                    *insertIndex,
                                      u_int32_t                    *insertNodeNum,
+                                     u_int16_t                     splitPercent,
                                      u_int16_t                    *recsRotated )
 {
     OSStatus            err;
@@ -1152,10 +1250,22 @@ static OSStatus    SplitLeft        (BTreeControlBlockPtr         btreePtr,
     ////////////////////////////// Rotate Left //////////////////////////////////
 
     err = RotateLeft (btreePtr, left, right, index, keyPtr, recPtr, recSize,
-                      insertIndex, insertNodeNum, &recordFit, recsRotated);
-
+                      insertIndex, insertNodeNum, splitPercent, &recordFit, recsRotated);
     M_ExitOnError (err);
 
+    if ( !recordFit && splitPercent != kBTEvenSplitPercent )
+    {
+        // nothing was moved: the uneven split would overfill the right node
+        splitPercent = kBTEvenSplitPercent;
+        err = RotateLeft (btreePtr, left, right, index, keyPtr, recPtr, recSize,
+                          insertIndex, insertNodeNum, splitPercent, &recordFit, recsRotated);
+        M_ExitOnError (err);
+    }
+
+    ++btreePtr->numSplits;
+    if ( splitPercent != kBTEvenSplitPercent )
+        ++btreePtr->numAppendSplits;
+
     return noErr;
 
 ErrorExit:
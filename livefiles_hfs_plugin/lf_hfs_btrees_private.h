@@ -40,6 +40,13 @@ enum {
     kOffsetSize                = 2
 };
 
+// Percentage of the bytes in a split node that end up in the new left node.
+// Leaf records inserted in key order get the uneven split (see InsertNode).
+enum {
+    kBTEvenSplitPercent        = 50,
+    kBTAppendSplitPercent      = 90
+};
+
 // Insert Operations
 typedef enum {
     kInsertRecord               = 0,
@@ -107,6 +114,10 @@ typedef struct {                    // fields specific to BTree CBs
     u_int32_t                       numPossibleHints;       // Looks like a formated hint
     u_int32_t                       numValidHints;          // Hint used to find correct record.
     u_int32_t                       reservedNodes;
+    u_int32_t                       numSplits;
+    u_int32_t                       numAppendSplits;        // splits that packed the left node
+    u_int32_t                       lastInsertNode;         // where the last leaf record went,
+    u_int16_t                       lastInsertIndex;        //   to detect inserts in key order
     BTreeIterator                   iterator;               // useable when holding exclusive b-tree lock
 
 #if DEBUG
@@ -2044,6 +2044,379 @@ int cat_check_idhash (struct hfsmount *hfsmp, cnid_t test_fileid) {
     return found;
 }
 
+/*
+ * Free CNID ranges.
+ *
+ * Before the CNIDs wrap, vcbNxtCNID is above every ID in use and the
+ * first probe in cat_acquire_cnid succeeds.  After the wrap a dense
+ * region of used IDs costs a catalog and an attributes B-tree search
+ * per ID.  So the first allocation after the wrap walks the catalog
+ * thread records once (they are sorted by CNID) and records the gaps.
+ * After that, allocation takes the first ID of the cursor range, and
+ * cat_delete and failed creates give IDs back.
+ *
+ * Everything here is protected by the catalog lock.
+ */
+#define CAT_FREE_CNIDS_MIN      64
+#define CAT_CNID_MAX            ((cnid_t)0xFFFFFFFF)    /* Never handed out */
+
+struct free_cnids_state {
+    struct hfsmount *hfsmp;
+    cnid_t next;        /* lowest ID not known to be used */
+    int error;
+};
+
+void
+cat_free_cnids_destroy (struct hfsmount *hfsmp)
+{
+    if (hfsmp->hfs_free_cnids)
+        hfs_free(hfsmp->hfs_free_cnids);
+    hfsmp->hfs_free_cnids = NULL;
+    hfsmp->hfs_free_cnids_count = 0;
+    hfsmp->hfs_free_cnids_size = 0;
+    hfsmp->hfs_free_cnids_cursor = 0;
+}
+
+/* Drop emptied ranges, keeping the cursor on the same range. */
+static void
+cat_free_cnids_compact (struct hfsmount *hfsmp)
+{
+    cat_cnid_range_t *ranges = hfsmp->hfs_free_cnids;
+    u_int32_t i, j, cursor = 0;
+
+    for (i = 0, j = 0; i < hfsmp->hfs_free_cnids_count; i++)
+    {
+        if (i == hfsmp->hfs_free_cnids_cursor)
+            cursor = j;
+        if (ranges[i].count != 0)
+            ranges[j++] = ranges[i];
+    }
+    hfsmp->hfs_free_cnids_count = j;
+    hfsmp->hfs_free_cnids_cursor = (cursor < j) ? cursor : 0;
+}
+
+/* Make room for one more range.  Returns ENOMEM if the array cannot grow. */
+static int
+cat_free_cnids_reserve (struct hfsmount *hfsmp)
+{
+    cat_cnid_range_t *ranges;
+    u_int32_t size;
+
+    if (hfsmp->hfs_free_cnids_count < hfsmp->hfs_free_cnids_size)
+        return (0);
+
+    if (hfsmp->hfs_free_cnids != NULL)
+    {
+        cat_free_cnids_compact(hfsmp);
+        if (hfsmp->hfs_free_cnids_count < hfsmp->hfs_free_cnids_size / 2)
+            return (0);
+    }
+
+    size = hfsmp->hfs_free_cnids_size ? hfsmp->hfs_free_cnids_size * 2 : CAT_FREE_CNIDS_MIN;
+    ranges = hfs_malloc(size * sizeof(cat_cnid_range_t));
+    if (ranges == NULL)
+        return (ENOMEM);
+
+    if (hfsmp->hfs_free_cnids != NULL)
+    {
+        memcpy(ranges, hfsmp->hfs_free_cnids, hfsmp->hfs_free_cnids_count * sizeof(cat_cnid_range_t));
+        hfs_free(hfsmp->hfs_free_cnids);
+    }
+    hfsmp->hfs_free_cnids = ranges;
+    hfsmp->hfs_free_cnids_size = size;
+    return (0);
+}
+
+/*
+ * Called for each catalog record, in key order, while building the
+ * free CNID ranges.
+ */
+static int
+cat_free_cnids_callback(const CatalogKey *ckp, const CatalogRecord *crp, struct free_cnids_state *state)
+{
+    struct hfsmount *hfsmp = state->hfsmp;
+    cnid_t cnid;
+
+    if ((crp->recordType != kHFSPlusFolderThreadRecord) && (crp->recordType != kHFSPlusFileThreadRecord))
+        return (1);
+
+    /* The key of a thread record is the CNID it describes. */
+    cnid = ckp->hfsPlus.parentID;
+    if (cnid < state->next)
+        return (1);
+
+    if (cnid > state->next)
+    {
+        if ((state->error = cat_free_cnids_reserve(hfsmp)) != 0)
+            return (0);
+        hfsmp->hfs_free_cnids[hfsmp->hfs_free_cnids_count].start = state->next;
+        hfsmp->hfs_free_cnids[hfsmp->hfs_free_cnids_count].count = cnid - state->next;
+        hfsmp->hfs_free_cnids_count++;
+    }
+    if (cnid == CAT_CNID_MAX)
+    {
+        state->next = CAT_CNID_MAX;
+        return (0);
+    }
+    state->next = cnid + 1;
+
+    return (1);
+}
+
+static int
+cat_free_cnids_build (struct hfsmount *hfsmp)
+{
+    FCB *fcb = hfsmp->hfs_catalog_cp->c_datafork;
+    BTreeIterator *iterator;
+    struct free_cnids_state state;
+    u_int32_t i;
+    int result;
+
+    iterator = hfs_mallocz(sizeof(BTreeIterator));
+    if (iterator == NULL)
+        return (ENOMEM);
+
+    state.hfsmp = hfsmp;
+    state.next = kHFSFirstUserCatalogNodeID;
+    state.error = 0;
+
+    result = BTIterateRecords(fcb, kBTreeFirstRecord, iterator, (IterateCallBackProcPtr)cat_free_cnids_callback, &state);
+    hfs_free(iterator);
+
+    if (result == fsBTRecordNotFoundErr)
+        result = 0;
+    if (state.error)
+        result = state.error;
+    else
+        result = MacToVFSError(result);
+
+    /* Everything above the last thread record is free. */
+    if (result == 0 && state.next < CAT_CNID_MAX && (result = cat_free_cnids_reserve(hfsmp)) == 0)
+    {
+        hfsmp->hfs_free_cnids[hfsmp->hfs_free_cnids_count].start = state.next;
+        hfsmp->hfs_free_cnids[hfsmp->hfs_free_cnids_count].count = CAT_CNID_MAX - state.next;
+        hfsmp->hfs_free_cnids_count++;
+    }
+
+    if (result)
+    {
+        LFHFS_LOG(LEVEL_ERROR, "cat_free_cnids_build: failed (%d), probing for free CNIDs instead\n", result);
+        cat_free_cnids_destroy(hfsmp);
+        return (result);
+    }
+
+    /* Keep handing out IDs in order: start at the first free ID at or above vcbNxtCNID. */
+    hfsmp->hfs_free_cnids_cursor = 0;
+    for (i = 0; i < hfsmp->hfs_free_cnids_count; i++)
+    {
+        cat_cnid_range_t *range = &hfsmp->hfs_free_cnids[i];
+
+        if (range->start + range->count > hfsmp->vcbNxtCNID)
+        {
+            if (range->start < hfsmp->vcbNxtCNID)
+            {
+                /* Skip the IDs below vcbNxtCNID; they stay free for the next pass. */
+                u_int32_t skip = hfsmp->vcbNxtCNID - range->start;
+
+                if (cat_free_cnids_reserve(hfsmp) != 0)
+                    break;
+                range = &hfsmp->hfs_free_cnids[i];
+                memmove(range + 1, range, (hfsmp->hfs_free_cnids_count - i) * sizeof(cat_cnid_range_t));
+                hfsmp->hfs_free_cnids_count++;
+                range[0].count = skip;
+                range[1].start += skip;
+                range[1].count -= skip;
+                i++;
+            }
+            hfsmp->hfs_free_cnids_cursor = i;
+            break;
+        }
+    }
+
+    return (0);
+}
+
+/*
+ * Take the next free CNID.  Returns 0 if there are no free IDs left.
+ */
+static cnid_t
+cat_free_cnids_take (struct hfsmount *hfsmp)
+{
+    u_int32_t n;
+    cnid_t cnid;
+
+    for (n = 0; n < hfsmp->hfs_free_cnids_count; n++)
+    {
+        cat_cnid_range_t *range = &hfsmp->hfs_free_cnids[hfsmp->hfs_free_cnids_cursor];
+
+        if (range->count != 0)
+        {
+            cnid = range->start++;
+            range->count--;
+            return (cnid);
+        }
+
+        if (++hfsmp->hfs_free_cnids_cursor == hfsmp->hfs_free_cnids_count)
+            hfsmp->hfs_free_cnids_cursor = 0;
+    }
+
+    return (0);
+}
+
+/*
+ * Give back a CNID that has no thread record.  If the range array cannot
+ * grow the ID is simply not reused until the next mount.
+ *
+ * A deferred ID is not merged into the front of the cursor range, so it
+ * is not handed out again until the cursor comes back around.
+ */
+static void
+cat_free_cnids_release (struct hfsmount *hfsmp, cnid_t cnid, int defer)
+{
+    cat_cnid_range_t *ranges;
+    u_int32_t lo, hi, mid;
+
+    if ((hfsmp->hfs_free_cnids == NULL) || (cnid < kHFSFirstUserCatalogNodeID) || (cnid >= CAT_CNID_MAX))
+        return;
+
+    /* Find the first range starting above cnid. */
+    ranges = hfsmp->hfs_free_cnids;
+    lo = 0;
+    hi = hfsmp->hfs_free_cnids_count;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (ranges[mid].start > cnid)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    /* Extend the range before, or the one after, if cnid is adjacent. */
+    if (lo > 0 && cnid < ranges[lo - 1].start + ranges[lo - 1].count)
+        return;     /* already free */
+    if (lo > 0 && ranges[lo - 1].start + ranges[lo - 1].count == cnid)
+    {
+        ranges[lo - 1].count++;
+        return;
+    }
+    if (lo < hfsmp->hfs_free_cnids_count && ranges[lo].start == cnid + 1 &&
+        !(defer && lo == hfsmp->hfs_free_cnids_cursor))
+    {
+        ranges[lo].start--;
+        ranges[lo].count++;
+        return;
+    }
+
+    if (cat_free_cnids_reserve(hfsmp) != 0)
+        return;
+
+    /* Compaction may have moved things; search again. */
+    ranges = hfsmp->hfs_free_cnids;
+    for (lo = 0, hi = hfsmp->hfs_free_cnids_count; lo < hi; )
+    {
+        mid = lo + (hi - lo) / 2;
+        if (ranges[mid].start > cnid)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    memmove(&ranges[lo + 1], &ranges[lo], (hfsmp->hfs_free_cnids_count - lo) * sizeof(cat_cnid_range_t));
+    ranges[lo].start = cnid;
+    ranges[lo].count = 1;
+    hfsmp->hfs_free_cnids_count++;
+    if (lo <= hfsmp->hfs_free_cnids_cursor && hfsmp->hfs_free_cnids_count > 1)
+        hfsmp->hfs_free_cnids_cursor++;
+}
+
+/*
+ * Give back a CNID from cat_acquire_cnid that never made it into the
+ * catalog.  Only call this once no thread record exists for it.
+ */
+static void
+cat_release_cnid (struct hfsmount *hfsmp, cnid_t cnid)
+{
+    cat_free_cnids_release(hfsmp, cnid, 0);
+}
+
+#define CAT_FREE_CNIDS_MAXSKIP  16
+
+/*
+ * Get the next CNID from the free ranges.  The catalog does not have to
+ * be searched, but an ID can still be held by orphaned EAs, a pending
+ * insert or a lingering cnode.  Such IDs are skipped and given back once
+ * an ID has been picked, so they are retried on the next pass.
+ *
+ * Returns EAGAIN if the caller should fall back to probing: either the
+ * ranges are empty after a rebuild, or too many IDs in a row are busy.
+ * The ranges are dropped in that case, since the probe may hand out an
+ * ID they still list.
+ */
+static int
+cat_acquire_free_cnid (struct hfsmount *hfsmp, cnid_t *new_cnid)
+{
+    cnid_t skipped[CAT_FREE_CNIDS_MAXSKIP];
+    u_int32_t nskipped = 0;
+    int rebuilt = 0;
+    cnid_t cnid;
+    int result;
+
+    for (;;)
+    {
+        cnid = cat_free_cnids_take(hfsmp);
+        if (cnid == 0)
+        {
+            /* IDs may have been lost to allocation failures; look again once. */
+            if (!rebuilt && nskipped == 0)
+            {
+                rebuilt = 1;
+                cat_free_cnids_destroy(hfsmp);
+                if (cat_free_cnids_build(hfsmp) == 0)
+                    continue;
+            }
+            result = EAGAIN;
+            break;
+        }
+
+        hfsmp->vcbNxtCNID = (cnid + 1 == CAT_CNID_MAX) ? kHFSFirstUserCatalogNodeID : cnid + 1;
+        hfs_note_header_minor_change(hfsmp);
+
+        if (cat_check_idhash(hfsmp, cnid))
+            goto skip;
+
+        result = file_attribute_exist(hfsmp, cnid);
+        if (result == EEXIST)
+            goto skip;
+        if (result)
+        {
+            cat_free_cnids_release(hfsmp, cnid, 0);
+            break;
+        }
+
+        if (hfs_chash_snoop(hfsmp, cnid, 1, NULL, NULL) == 0)
+            goto skip;
+
+        *new_cnid = cnid;
+        break;
+
+skip:
+        skipped[nskipped++] = cnid;
+        if (nskipped == CAT_FREE_CNIDS_MAXSKIP)
+        {
+            result = EAGAIN;
+            break;
+        }
+    }
+
+    while (nskipped > 0)
+        cat_free_cnids_release(hfsmp, skipped[--nskipped], 1);
+
+    if (result == EAGAIN)
+        cat_free_cnids_destroy(hfsmp);
+
+    return (result);
+}
+
 int
 cat_acquire_cnid (struct hfsmount *hfsmp, cnid_t *new_cnid)
 {
@@ -2054,6 +2427,16 @@ cat_acquire_cnid (struct hfsmount *hfsmp, cnid_t *new_cnid)
     CatalogRecord *recp;
     int result = 0;
     int wrapped = 0;
+
+    /* Once IDs are being reused, allocate from the free CNID ranges. */
+    if ((hfsmp->vcbAtrb & kHFSCatalogNodeIDsReusedMask) &&
+        (hfsmp->hfs_free_cnids != NULL || cat_free_cnids_build(hfsmp) == 0))
+    {
+        result = cat_acquire_free_cnid(hfsmp, new_cnid);
+        if (result != EAGAIN)
+            return (result);
+    }
+
     /*
      * Get the next CNID. We can change it since we hold the catalog lock.
      */
@@ -2927,6 +3310,10 @@ cat_delete(struct hfsmount *hfsmp, struct cat_desc *descp, struct cat_attr *attr
         LFHFS_LOG(LEVEL_ERROR, "cat_delete: failed to delete thread record id=%u on vol=%s\n", cnid, hfsmp->vcbVN);
         hfs_mark_inconsistent(hfsmp, HFS_OP_INCOMPLETE);
     }
+    else
+    {
+        cat_free_cnids_release(hfsmp, cnid, 0);
+    }
 
 exit:
     (void) BTFlushPath(fcb);
@@ -3020,6 +3407,7 @@ cat_create(struct hfsmount *hfsmp, cnid_t new_fileid, struct cat_desc *descp, st
     u_int32_t encoding = kTextEncodingMacRoman;
 
     /* The caller is expected to reserve a CNID before calling this-> function! */
+    /* If the create fails, the CNID is given back to the free ranges. */
 
     /* Get space for iterator, key and data */
     iterator = hfs_mallocz(sizeof(BTreeIterator));
@@ -3034,7 +3422,10 @@ cat_create(struct hfsmount *hfsmp, cnid_t new_fileid, struct cat_desc *descp, st
 
     result = buildkey(descp, key);
     if (result)
+    {
+        cat_release_cnid(hfsmp, new_fileid);
         goto exit;
+    }
 
     /*
      * Insert the thread record first
@@ -3053,6 +3444,7 @@ cat_create(struct hfsmount *hfsmp, cnid_t new_fileid, struct cat_desc *descp, st
     result = BTInsertRecord(fcb, iterator, &btdata, datalen);
     if (result)
     {
+        cat_release_cnid(hfsmp, new_fileid);
         goto exit;
     }
 
@@ -3082,6 +3474,10 @@ cat_create(struct hfsmount *hfsmp, cnid_t new_fileid, struct cat_desc *descp, st
             LFHFS_LOG(LEVEL_ERROR, "cat_create() failed to delete thread record id=%u on vol=%s\n", new_fileid, hfsmp->vcbVN);
             hfs_mark_inconsistent(hfsmp, HFS_ROLLBACK_FAILED);
         }
+        else
+        {
+            cat_release_cnid(hfsmp, new_fileid);
+        }
         
         goto exit;
     }
@@ -3111,6 +3507,163 @@ exit:
     return MacToVFSError(result);
 }
 
+/*
+ * cat_create_batch - create count catalog nodes in one directory
+ *
+ * The keys are built and sorted up front. Names that are already in the
+ * catalog, or repeated within the batch, fail with EEXIST before a CNID
+ * is spent on them; the rest get CNIDs back to back in name order. All
+ * thread records then go in by ascending CNID, followed by the file and
+ * folder records by name, so consecutive inserts hit the same or
+ * neighbouring leaf nodes.
+ *
+ * results[i] receives the outcome of entry i; on success attrp[i].ca_fileid
+ * holds its CNID. The return value is only non-zero if nothing could be
+ * attempted.
+ *
+ * NOTE: both the catalog file and attribute file locks must
+ *       be held before calling this function.
+ */
+int
+cat_create_batch(struct hfsmount *hfsmp, struct cat_desc *descp, struct cat_attr *attrp, int *results, u_int32_t count)
+{
+    FCB * fcb = hfsmp->hfs_catalog_cp->c_datafork;
+    KeyCompareProcPtr compareProc = ((BTreeControlBlockPtr)(fcb->ff_sysfileinfo))->keyCompareProc;
+    BTreeIterator*     iterator = NULL;
+    HFSPlusCatalogKey* keys = NULL;
+    CatalogRecord*     data = NULL;
+    cnid_t*            cnids = NULL;
+    u_int32_t*         order = NULL;
+    FSBufferDescriptor btdata = {0};
+    u_int32_t datalen;
+    u_int32_t sorted = 0;
+    int result = 0;
+
+    iterator = hfs_mallocz(sizeof(BTreeIterator));
+    keys = hfs_mallocz(count * sizeof(HFSPlusCatalogKey));
+    data = hfs_mallocz(sizeof(CatalogRecord));
+    cnids = hfs_mallocz(count * sizeof(cnid_t));
+    order = hfs_mallocz(count * sizeof(u_int32_t));
+
+    if ( (iterator == NULL) || (keys == NULL) || (data == NULL) || (cnids == NULL) || (order == NULL) )
+    {
+        result = ENOMEM;
+        goto exit;
+    }
+
+    /* Build the keys and insertion-sort the valid ones */
+    for (u_int32_t i = 0; i < count; i++)
+    {
+        results[i] = buildkey(&descp[i], &keys[i]);
+        if (results[i])
+            continue;
+
+        u_int32_t j = sorted++;
+        while ((j > 0) && (compareProc(&keys[order[j - 1]], &keys[i]) > 0))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (u_int32_t j = 0; j < sorted; j++)
+    {
+        u_int32_t i = order[j];
+
+        if ((j > 0) && (compareProc(&keys[order[j - 1]], &keys[i]) == 0))
+        {
+            results[i] = EEXIST;
+            continue;
+        }
+
+        bcopy(&keys[i], &iterator->key, sizeof(HFSPlusCatalogKey));
+        int err = BTSearchRecord(fcb, iterator, NULL, NULL, iterator);
+        if (err != btNotFound)
+        {
+            results[i] = (err == 0) ? EEXIST : MacToVFSError(err);
+            continue;
+        }
+
+        results[i] = cat_acquire_cnid(hfsmp, &cnids[i]);
+    }
+
+    /* Thread records */
+    for (u_int32_t j = 0; j < sorted; j++)
+    {
+        u_int32_t i = order[j];
+        if (results[i])
+            continue;
+
+        datalen = buildthread((void*)&keys[i], data, S_ISDIR(attrp[i].ca_mode));
+        btdata.bufferAddress = data;
+        btdata.itemSize = datalen;
+        btdata.itemCount = 1;
+
+        buildthreadkey(cnids[i], (CatalogKey *) &iterator->key);
+        results[i] = MacToVFSError(BTInsertRecord(fcb, iterator, &btdata, datalen));
+        if (results[i])
+            cat_release_cnid(hfsmp, cnids[i]);
+    }
+
+    /* File and folder records */
+    for (u_int32_t j = 0; j < sorted; j++)
+    {
+        u_int32_t i = order[j];
+        if (results[i])
+            continue;
+
+        buildrecord(&attrp[i], cnids[i], kTextEncodingMacRoman, data, &datalen);
+        btdata.bufferAddress = data;
+        btdata.itemSize = datalen;
+        btdata.itemCount = 1;
+
+        bcopy(&keys[i], &iterator->key, sizeof(HFSPlusCatalogKey));
+
+        int err = BTInsertRecord(fcb, iterator, &btdata, datalen);
+        if (err)
+        {
+            results[i] = (err == btExists) ? EEXIST : MacToVFSError(err);
+
+            /* Back out the thread record */
+            buildthreadkey(cnids[i], (CatalogKey *)&iterator->key);
+            if (BTDeleteRecord(fcb, iterator))
+            {
+                LFHFS_LOG(LEVEL_ERROR, "cat_create_batch() failed to delete thread record id=%u on vol=%s\n", cnids[i], hfsmp->vcbVN);
+                hfs_mark_inconsistent(hfsmp, HFS_ROLLBACK_FAILED);
+            }
+            else
+            {
+                cat_release_cnid(hfsmp, cnids[i]);
+            }
+            continue;
+        }
+
+        attrp[i].ca_fileid = cnids[i];
+    }
+
+exit:
+    if (result)
+    {
+        for (u_int32_t i = 0; i < count; i++)
+            results[i] = result;
+    }
+
+    (void) BTFlushPath(fcb);
+    if (iterator)
+        hfs_free(iterator);
+    if (keys)
+        hfs_free(keys);
+    if (data)
+        hfs_free(data);
+    if (cnids)
+        hfs_free(cnids);
+    if (order)
+        hfs_free(order);
+
+    return result;
+}
+
 /* This function sets kHFSHasChildLinkBit in a directory hierarchy in the
  * catalog btree of given cnid by walking up the parent chain till it reaches
  * either the root folder, or the private metadata directory for storing
@@ -3825,7 +4378,11 @@ exit:
             if (BTDeleteRecord(fcb, &bto->iterator)) {
                 LFHFS_LOG(LEVEL_ERROR, "cat_createlink: failed to delete thread record on volume %s\n", hfsmp->vcbVN);
                 hfs_mark_inconsistent(hfsmp, HFS_ROLLBACK_FAILED);
+            } else {
+                cat_release_cnid(hfsmp, nextCNID);
             }
+        } else {
+            cat_release_cnid(hfsmp, nextCNID);
         }
         if (alias_allocated && rsrcforkp->extents[0].startBlock != 0) {
             (void) BlockDeallocate(hfsmp, rsrcforkp->extents[0].startBlock,
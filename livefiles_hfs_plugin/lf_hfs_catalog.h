@@ -159,6 +159,7 @@ struct cat_fork {
 
 #define HFS_MAXDIRHINTS 32
 #define HFS_DIRHINT_TTL 45
+#define HFS_DIRHINT_HASH_SIZE 8     /* power of 2 */
 
 #define HFS_INDEX_MASK  0x03ffffff
 #define HFS_INDEX_BITS  26
@@ -176,6 +177,7 @@ enum {
  */
 struct directoryhint {
     TAILQ_ENTRY(directoryhint) dh_link; /* chain */
+    LIST_ENTRY(directoryhint) dh_hash;  /* c_hinthash chain, keyed by dh_index */
     int     dh_index;                   /* index into directory (zero relative) */
     u_int32_t  dh_threadhint;           /* node hint of a directory's thread record */
     u_int32_t  dh_time;
@@ -248,6 +250,18 @@ typedef struct cat_preflightid {
 void hfs_idhash_init    (struct hfsmount *hfsmp);
 void hfs_idhash_destroy (struct hfsmount *hfsmp);
 
+/*
+ * A run of unused catalog node IDs [start, start + count).  Once the
+ * volume has wrapped its CNIDs, cat_acquire_cnid hands out IDs from a
+ * sorted array of these instead of probing the catalog one ID at a time.
+ */
+typedef struct cat_cnid_range {
+    cnid_t start;
+    u_int32_t count;
+} cat_cnid_range_t;
+
+void cat_free_cnids_destroy (struct hfsmount *hfsmp);
+
 int     cat_binarykeycompare( HFSPlusCatalogKey *searchKey, HFSPlusCatalogKey *trialKey );
 int     CompareExtendedCatalogKeys( HFSPlusCatalogKey *searchKey, HFSPlusCatalogKey *trialKey );
 void    cat_releasedesc( struct cat_desc *descp );
@@ -273,6 +287,7 @@ int     cat_update(struct hfsmount *hfsmp, struct cat_desc *descp, struct cat_at
                     const struct cat_fork *dataforkp, const struct cat_fork *rsrcforkp);
 int     cat_acquire_cnid (struct hfsmount *hfsmp, cnid_t *new_cnid);
 int     cat_create(struct hfsmount *hfsmp, cnid_t new_fileid, struct cat_desc *descp, struct cat_attr *attrp, struct cat_desc *out_descp);
+int     cat_create_batch(struct hfsmount *hfsmp, struct cat_desc *descp, struct cat_attr *attrp, int *results, u_int32_t count);
 int     cat_set_childlinkbit(struct hfsmount *hfsmp, cnid_t cnid);
 int     cat_check_link_ancestry(struct hfsmount *hfsmp, cnid_t cnid, cnid_t pointed_at_cnid);
 
@@ -315,10 +315,18 @@ loop_with_lock:
     *hflags |= H_ALLOC;
     ncp->c_fileid = (cnid_t) inum;
     TAILQ_INIT(&ncp->c_hintlist); /* make the list empty */
+    for (int i = 0; i < HFS_DIRHINT_HASH_SIZE; i++)
+    {
+        LIST_INIT(&ncp->c_hinthash[i]);
+    }
     TAILQ_INIT(&ncp->c_originlist);
 
     lf_lck_rw_init(&ncp->c_rwlock);
     lf_cond_init(&ncp->c_cacsh_cond);
+    lf_lck_mtx_init(&ncp->c_dirmod_mutex);
+    lf_cond_init(&ncp->c_dirmod_cond);
+    lf_lck_mtx_init(&ncp->c_hint_mutex);
+    lf_lck_mtx_init(&ncp->c_xattr_mutex);
 
     if (!skiplock)
     {
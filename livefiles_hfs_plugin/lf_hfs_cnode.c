@@ -46,6 +46,11 @@ hfs_reclaim_cnode(struct cnode *cp)
 
     lf_lck_rw_destroy(&cp->c_rwlock);
     lf_cond_destroy(&cp->c_cacsh_cond);
+    lf_cond_destroy(&cp->c_dirmod_cond);
+    lf_lck_mtx_destroy(&cp->c_dirmod_mutex);
+    lf_lck_mtx_destroy(&cp->c_hint_mutex);
+    hfs_xattr_cache_purge(cp);
+    lf_lck_mtx_destroy(&cp->c_xattr_mutex);
     lf_lck_rw_destroy(&cp->c_truncatelock);
 
     hfs_free(cp);
@@ -422,6 +427,7 @@ hfs_getnewvnode(struct hfsmount *hfsmp, struct vnode *dvp, struct componentname
             bzero(&fp->ff_data, sizeof(struct cat_fork));
         }
         rl_init(&fp->ff_invalidranges);
+        hfs_rangelock_init(&fp->ff_rangelock);
         fp->ff_sysfileinfo = 0;
 
         if (wantrsrc)
@@ -483,6 +489,7 @@ hfs_getnewvnode(struct hfsmount *hfsmp, struct vnode *dvp, struct componentname
             {
                 if (fp)
                 {
+                    hfs_rangelock_destroy(&fp->ff_rangelock);
                     hfs_free(fp);
                 }
                 retval = ENOMEM;
@@ -497,7 +504,10 @@ hfs_getnewvnode(struct hfsmount *hfsmp, struct vnode *dvp, struct componentname
             if (cp && cp->c_desc.cd_nameptr) {
                 vfsp.vnfs_cnp = hfs_malloc(sizeof(struct componentname));
                 if (vfsp.vnfs_cnp == NULL) {
-                    if (fp) hfs_free(fp);
+                    if (fp) {
+                        hfs_rangelock_destroy(&fp->ff_rangelock);
+                        hfs_free(fp);
+                    }
                     retval = ENOMEM;
                     goto gnv_exit;
                 }
@@ -585,6 +595,7 @@ hfs_getnewvnode(struct hfsmount *hfsmp, struct vnode *dvp, struct componentname
             else
                 cp->c_rsrcfork = NULL;
 
+            hfs_rangelock_destroy(&fp->ff_rangelock);
             hfs_free(fp);
         }
         /*
@@ -908,6 +919,40 @@ hfs_unlock(struct cnode *cp)
     }
 }
 
+/*
+ * Clear C_DIR_MODIFICATION on a directory and wake up any lookups
+ * waiting in hfs_wait_dir_modification.
+ */
+void
+hfs_clear_dir_modification(struct cnode *dcp)
+{
+    lf_lck_mtx_lock(&dcp->c_dirmod_mutex);
+    dcp->c_flag &= ~C_DIR_MODIFICATION;
+    pthread_cond_broadcast(&dcp->c_dirmod_cond);
+    lf_lck_mtx_unlock(&dcp->c_dirmod_mutex);
+}
+
+/*
+ * Drop the (shared) lock on a directory that is being modified and
+ * wait until the modification is done.  The caller must re-lock the
+ * directory and re-check the flag.
+ */
+void
+hfs_wait_dir_modification(struct cnode *dcp)
+{
+    /*
+     * Take the mutex before dropping the cnode lock so a clear that
+     * happens in between cannot be missed.
+     */
+    lf_lck_mtx_lock(&dcp->c_dirmod_mutex);
+    hfs_unlock(dcp);
+    while (dcp->c_flag & C_DIR_MODIFICATION)
+    {
+        pthread_cond_wait(&dcp->c_dirmod_cond, &dcp->c_dirmod_mutex);
+    }
+    lf_lck_mtx_unlock(&dcp->c_dirmod_mutex);
+}
+
 /*
  * hfs_valid_cnode
  *
@@ -1145,6 +1190,63 @@ hfs_unlock_truncate(struct cnode *cp, enum hfs_lockflags flags)
     }
 }
 
+/*
+ * Byte range locks of a fork.
+ *
+ * A writer holding the truncate lock shared cannot see the fork extents
+ * or EOF change underneath it, so an overwrite of allocated space only
+ * needs to exclude writers of the same sectors (raw_readwrite_write does
+ * a read-modify-write of partial sectors).  Ranges are inclusive and the
+ * entry is supplied by the caller, usually on its stack.
+ */
+void
+hfs_rangelock_init(struct hfs_rangelock *rlp)
+{
+    lf_lck_mtx_init(&rlp->rl_mutex);
+    lf_cond_init(&rlp->rl_cond);
+    TAILQ_INIT(&rlp->rl_held);
+}
+
+void
+hfs_rangelock_destroy(struct hfs_rangelock *rlp)
+{
+    hfs_assert(TAILQ_EMPTY(&rlp->rl_held));
+    lf_cond_destroy(&rlp->rl_cond);
+    lf_lck_mtx_destroy(&rlp->rl_mutex);
+}
+
+void
+hfs_range_lock(struct filefork *fp, struct hfs_rangelock_entry *rep, off_t start, off_t end)
+{
+    struct hfs_rangelock *rlp = &fp->ff_rangelock;
+    struct hfs_rangelock_entry *held;
+
+    rep->re_start = start;
+    rep->re_end = end;
+
+    lf_lck_mtx_lock(&rlp->rl_mutex);
+again:
+    TAILQ_FOREACH(held, &rlp->rl_held, re_link) {
+        if (held->re_start <= end && start <= held->re_end) {
+            lf_cond_wait(&rlp->rl_cond, &rlp->rl_mutex);
+            goto again;
+        }
+    }
+    TAILQ_INSERT_TAIL(&rlp->rl_held, rep, re_link);
+    lf_lck_mtx_unlock(&rlp->rl_mutex);
+}
+
+void
+hfs_range_unlock(struct filefork *fp, struct hfs_rangelock_entry *rep)
+{
+    struct hfs_rangelock *rlp = &fp->ff_rangelock;
+
+    lf_lck_mtx_lock(&rlp->rl_mutex);
+    TAILQ_REMOVE(&rlp->rl_held, rep, re_link);
+    lf_cond_wakeup_all(&rlp->rl_cond);
+    lf_lck_mtx_unlock(&rlp->rl_mutex);
+}
+
 /*
  * Lock a pair of cnodes.
  */
@@ -1715,6 +1817,7 @@ hfs_cnode_teardown (struct vnode *vp, int reclaim)
              */
             if (ISSET(cp->c_attr.ca_recflags, kHFSHasAttributesMask))
             {
+                hfs_xattr_cache_purge(cp);
                 ea_error = hfs_removeallattr(hfsmp, cp->c_fileid, &started_tr);
                 if (ea_error)
                     goto out;
@@ -1934,6 +2037,7 @@ hfs_fork_release(struct cnode* cp, struct vnode *vp, bool bIsRsc, int* piErr)
             hfs_free(fp->ff_symlinkptr);
         }
         rl_remove_all(&fp->ff_invalidranges);
+        hfs_rangelock_destroy(&fp->ff_rangelock);
         hfs_free(fp);
     }
     
@@ -2017,6 +2121,7 @@ hfs_vnop_reclaim(struct vnode *vp)
      * If there was only one active fork then we can release the cnode.
      */
     if (reclaim_cnode) {
+        hfs_cancel_deferred_update(hfsmp, cp);
         hfs_unlock(cp);
         hfs_chashwakeup(hfsmp, cp, H_ALLOC);
         hfs_reclaim_cnode(cp);
@@ -2037,3 +2142,122 @@ hfs_vnop_reclaim(struct vnode *vp)
     vp = NULL;
     return (0);
 }
+
+/*
+ * Deferred catalog record updates.
+ *
+ * A data write leaves the cnode C_MODIFIED and puts it on the mount's
+ * deferred list instead of calling hfs_update, so a stream of small
+ * writes costs one catalog update per sync rather than one per write.
+ * hfs_flush_deferred_updates (syncer, unmount) pushes the records; fsync
+ * and reclaim push a single cnode through hfs_update, which takes it off
+ * the list.
+ *
+ * Block allocations are still recorded in the transaction that makes
+ * them.  Until the deferred update lands the catalog only lags behind on
+ * size and times.  LFHFS_Write raises ff_size, under the cnode lock, only
+ * after raw_readwrite_write has returned, so any size a catalog update
+ * picks up already covers written data; a crash loses the tail of the
+ * writes but never exposes uninitialized blocks.
+ *
+ * The cnode must be locked exclusive.
+ */
+void
+hfs_defer_update(struct vnode *vp)
+{
+    struct cnode *cp = VTOC(vp);
+    struct hfsmount *hfsmp = VTOHFS(vp);
+
+    if (!ISSET(cp->c_flag, C_MODIFIED) || ISSET(cp->c_flag, C_NOEXISTS))
+        return;
+
+    /* Resolve the touched times now so getattr sees them before the flush. */
+    hfs_touchtimes(hfsmp, cp);
+
+    lf_lck_mtx_lock(&hfsmp->hfs_deferred_mutex);
+    if (!cp->c_deferred) {
+        TAILQ_INSERT_TAIL(&hfsmp->hfs_deferred_cnodes, cp, c_deferred_link);
+        cp->c_deferred = true;
+        hfsmp->hfs_deferred_count++;
+    }
+    lf_lck_mtx_unlock(&hfsmp->hfs_deferred_mutex);
+}
+
+void
+hfs_cancel_deferred_update(struct hfsmount *hfsmp, struct cnode *cp)
+{
+    /*
+     * c_deferred is only set by a holder of the cnode lock, which the
+     * caller has, so a false read here is stable.
+     */
+    if (!cp->c_deferred)
+        return;
+
+    lf_lck_mtx_lock(&hfsmp->hfs_deferred_mutex);
+    if (cp->c_deferred) {
+        TAILQ_REMOVE(&hfsmp->hfs_deferred_cnodes, cp, c_deferred_link);
+        cp->c_deferred = false;
+        hfsmp->hfs_deferred_count--;
+    }
+    lf_lck_mtx_unlock(&hfsmp->hfs_deferred_mutex);
+}
+
+/*
+ * Push the catalog records of the cnodes on the deferred list.  Only the
+ * cnodes queued on entry are visited, so concurrent writers can't keep
+ * us here.  The list only holds cnodes alive in the cnode hash; entries
+ * are taken off by cnid and looked up again, so a cnode reclaimed in the
+ * meantime (which already did its own update) is simply skipped.
+ */
+int
+hfs_flush_deferred_updates(struct hfsmount *hfsmp)
+{
+    cnid_t puCnids[HFS_DEFERRED_BATCH];
+    int error = 0;
+
+    lf_lck_mtx_lock(&hfsmp->hfs_deferred_mutex);
+    u_int32_t uRemaining = hfsmp->hfs_deferred_count;
+    lf_lck_mtx_unlock(&hfsmp->hfs_deferred_mutex);
+
+    while (uRemaining > 0) {
+        u_int32_t uCount = 0;
+
+        lf_lck_mtx_lock(&hfsmp->hfs_deferred_mutex);
+        while (uCount < MIN(uRemaining, HFS_DEFERRED_BATCH) &&
+               !TAILQ_EMPTY(&hfsmp->hfs_deferred_cnodes)) {
+            struct cnode *cp = TAILQ_FIRST(&hfsmp->hfs_deferred_cnodes);
+            TAILQ_REMOVE(&hfsmp->hfs_deferred_cnodes, cp, c_deferred_link);
+            cp->c_deferred = false;
+            hfsmp->hfs_deferred_count--;
+            puCnids[uCount++] = cp->c_fileid;
+        }
+        lf_lck_mtx_unlock(&hfsmp->hfs_deferred_mutex);
+
+        if (uCount == 0)
+            break;
+        uRemaining -= uCount;
+
+        for (u_int32_t u = 0; u < uCount; u++) {
+            /* Only the resource fork may be open. */
+            struct vnode *vp = hfs_chash_getvnode(hfsmp, puCnids[u], 0, 0, 0);
+            if (vp == NULL)
+                vp = hfs_chash_getvnode(hfsmp, puCnids[u], 1, 0, 0);
+            if (vp == NULL)
+                continue;
+
+            int iErr = hfs_update(vp, 0);
+            if (iErr) {
+                LFHFS_LOG(LEVEL_ERROR, "hfs_flush_deferred_updates: hfs_update of %u failed (%d)\n", puCnids[u], iErr);
+                if (error == 0)
+                    error = iErr;
+                /* Leave it for the next flush. */
+                hfs_defer_update(vp);
+            }
+
+            hfs_unlock(VTOC(vp));
+            hfs_vnop_reclaim(vp);
+        }
+    }
+
+    return (error);
+}
@@ -14,6 +14,7 @@
 #include "lf_hfs_rangelist.h"
 #include "lf_hfs_vnode.h"
 #include <sys/stat.h>
+#include <stdatomic.h>
 
 enum hfs_locktype {
     HFS_SHARED_LOCK = 1,
@@ -40,6 +41,23 @@ enum {
     HFS_FILE_DONE_NO_SYNC     = 1,
 };
 
+/*
+ * Byte range lock of a fork, see hfs_range_lock().  Writers that only
+ * overwrite allocated space hold the truncate lock shared and no cnode
+ * lock, and serialize here against writers of the same sectors.
+ */
+struct hfs_rangelock_entry {
+    TAILQ_ENTRY(hfs_rangelock_entry) re_link;
+    off_t           re_start;
+    off_t           re_end;                 /* inclusive */
+};
+
+struct hfs_rangelock {
+    pthread_mutex_t rl_mutex;
+    pthread_cond_t  rl_cond;
+    TAILQ_HEAD(, hfs_rangelock_entry) rl_held;
+};
+
 /*
  * The filefork is used to represent an HFS file fork (data or resource).
  * Reading or writing any of these fields requires holding cnode lock.
@@ -47,6 +65,7 @@ enum {
 struct filefork {
     struct cnode    *ff_cp;                 /* cnode associated with this fork */
     struct rl_head  ff_invalidranges;       /* Areas of disk that should read back as zeroes */
+    struct hfs_rangelock ff_rangelock;      /* Own locking, see hfs_range_lock() */
     union {
         void        *ffu_sysfileinfo;       /* additional info for system files */
         char        *ffu_symlinkptr;        /* symbolic link pathname */
@@ -98,6 +117,12 @@ typedef struct linkorigin linkorigin_t;
  * file or directory in the HFS filesystem.
  *
  * Reading or writing any of these fields requires holding c_lock.
+ * Exceptions: c_childhint and c_dirthreadhint are atomic since lookups
+ * and readdir update them while holding the directory lock shared, the
+ * directory hints have their own c_hint_mutex, the extended attribute
+ * cache, filled under a shared lock, has c_xattr_mutex, and
+ * C_DIR_MODIFICATION is cleared under c_dirmod_mutex (see
+ * hfs_clear_dir_modification).
  */
 struct cnode {
     pthread_rwlock_t                c_rwlock;                   /* cnode's lock */
@@ -105,18 +130,24 @@ struct cnode {
     pthread_rwlock_t                c_truncatelock;             /* protects file from truncation during read/write */
     pthread_t                       c_truncatelockowner;        /* truncate lock owner (exclusive case only) */
     pthread_cond_t                  c_cacsh_cond;               /* cond for cnode cacsh*/
+    pthread_mutex_t                 c_dirmod_mutex;             /* protects C_DIR_MODIFICATION waits */
+    pthread_cond_t                  c_dirmod_cond;              /* signalled when C_DIR_MODIFICATION is cleared */
     
     LIST_ENTRY(cnode)               c_hash;                     /* cnode's hash chain */
     u_int32_t                       c_flag;                     /* cnode's runtime flags */
     u_int32_t                       c_hflag;                    /* cnode's flags for maintaining hash - protected by global hash lock */
     struct vnode                    *c_vp;                      /* vnode for data fork or dir */
     struct vnode                    *c_rsrc_vp;                 /* vnode for resource fork */
-    u_int32_t                       c_childhint;                /* catalog hint for children (small dirs only) */
-    u_int32_t                       c_dirthreadhint;            /* catalog hint for directory's thread rec */
+    _Atomic u_int32_t               c_childhint;                /* catalog hint for children (small dirs only), updated under a shared lock by lookups */
+    _Atomic u_int32_t               c_dirthreadhint;            /* catalog hint for directory's thread rec */
     struct cat_desc                 c_desc;                     /* cnode's descriptor */
     struct cat_attr                 c_attr;                     /* cnode's attributes */
     TAILQ_HEAD(hfs_originhead, linkorigin)  c_originlist;       /* hardlink origin cache */
-    TAILQ_HEAD(hfs_hinthead, directoryhint) c_hintlist;         /* readdir directory hint list */
+    pthread_mutex_t                 c_xattr_mutex;              /* protects c_xattrcache */
+    struct hfs_xattr_cache          *c_xattrcache;              /* extended attribute cache, see lf_hfs_xattr.h */
+    pthread_mutex_t                 c_hint_mutex;               /* protects c_hintlist, c_hinthash, c_dirhintcnt and c_dirhinttag */
+    TAILQ_HEAD(hfs_hinthead, directoryhint) c_hintlist;         /* readdir directory hint list, newest first */
+    LIST_HEAD(hfs_hintbucket, directoryhint) c_hinthash[HFS_DIRHINT_HASH_SIZE]; /* the same hints, hashed by dh_index */
     int16_t                         c_dirhinttag;               /* directory hint tag */
     union {
         int16_t                     cu_dirhintcnt;              /* directory hint count */
@@ -146,6 +177,10 @@ struct cnode {
      */
     uint32_t c_update_txn;
 
+    // The following are protected by the mount's hfs_deferred_mutex
+    TAILQ_ENTRY(cnode)              c_deferred_link;            /* deferred catalog update list */
+    bool                            c_deferred;                 /* cnode is on the deferred update list */
+
     volatile uint32_t  uOpenLookupRefCount;
 
 };
@@ -261,6 +296,16 @@ typedef struct cnode cnode_t;
 
 #define VNODE_IS_RSRC(vp)    ((vp) == VTOC((vp))->c_rsrc_vp)
 
+// cnode must be locked
+static inline __attribute__((pure))
+bool hfs_has_rsrc(const struct cnode *cp)
+{
+    if (cp->c_rsrcfork)
+        return cp->c_rsrcfork->ff_blocks > 0;
+    else
+        return cp->c_datafork && cp->c_blocks > cp->c_datafork->ff_blocks;
+}
+
 /*
  * The following is the "invisible" bit from the fdFlags field
  * in the FndrFileInfo.
@@ -352,8 +397,14 @@ struct cat_lookup_buffer {
 int hfs_valid_cnode(struct hfsmount *hfsmp, struct vnode *dvp, struct componentname *cnp, cnid_t cnid, struct cat_attr *cattr, int *error);
 int hfs_lock(struct cnode *cp, enum hfs_locktype locktype, enum hfs_lockflags flags);
 void hfs_unlock(struct cnode *cp);
+void hfs_clear_dir_modification(struct cnode *dcp);
+void hfs_wait_dir_modification(struct cnode *dcp);
 void hfs_lock_truncate(struct cnode *cp, enum hfs_locktype locktype, enum hfs_lockflags flags);
 void hfs_unlock_truncate(struct cnode *cp, enum hfs_lockflags flags);
+void hfs_rangelock_init(struct hfs_rangelock *rlp);
+void hfs_rangelock_destroy(struct hfs_rangelock *rlp);
+void hfs_range_lock(struct filefork *fp, struct hfs_rangelock_entry *rep, off_t start, off_t end);
+void hfs_range_unlock(struct filefork *fp, struct hfs_rangelock_entry *rep);
 int hfs_lockpair(struct cnode *cp1, struct cnode *cp2, enum hfs_locktype locktype);
 void hfs_unlockpair(struct cnode *cp1, struct cnode *cp2);
 int  hfs_lockfour(struct cnode *cp1, struct cnode *cp2, struct cnode *cp3, struct cnode *cp4, enum hfs_locktype locktype, struct cnode **error_cnode);
@@ -365,4 +416,10 @@ u_int32_t hfs_get_dateadded(struct cnode *cp);
 void hfs_touchtimes(struct hfsmount *hfsmp, struct cnode* cp);
 void hfs_write_gencount (struct cat_attr *attrp, uint32_t gencount);
 int  hfs_vnop_reclaim(struct vnode *vp);
+
+/* Deferred catalog record updates */
+#define HFS_DEFERRED_BATCH      (64)    /* cnodes picked off the list at a time */
+void hfs_defer_update(struct vnode *vp);
+void hfs_cancel_deferred_update(struct hfsmount *hfsmp, struct cnode *cp);
+int  hfs_flush_deferred_updates(struct hfsmount *hfsmp);
 #endif /* lf_hfs_cnode_h */
@@ -22,6 +22,7 @@
 #define LF_HFS_QOUTA_SUPPORT            0
 #define LF_HFS_FULL_VNODE_SUPPORT       0
 #define LF_HFS_NATIVE_SEARCHFS_SUPPORT  0
+#define LF_HFS_TRACE_SUPPORT            1
 
 #define min MIN
 #define max MAX
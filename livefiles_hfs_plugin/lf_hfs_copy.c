@@ -0,0 +1,325 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_copy.c
+ *  livefiles_hfs
+ *
+ *  In-filesystem file copy: duplicate a regular file, its extended
+ *  attributes, Finder Info and resource fork without passing the data
+ *  through the client.
+ */
+
+#include <string.h>
+#include <sys/xattr.h>
+#include "lf_hfs.h"
+#include "lf_hfs_copy.h"
+#include "lf_hfs_cnode.h"
+#include "lf_hfs_vnode.h"
+#include "lf_hfs_vnops.h"
+#include "lf_hfs_xattr.h"
+#include "lf_hfs_logger.h"
+#include "lf_hfs_vfsutils.h"
+#include "lf_hfs_readwrite_ops.h"
+#include "lf_hfs_raw_read_write.h"
+#include "lf_hfs_fsops_handler.h"
+#include "lf_hfs_fileops_handler.h"
+#include "lf_hfs_dirops_handler.h"
+
+/*
+ * Give the destination fork uLength bytes of storage, contiguous if the
+ * volume has a free run that large.
+ */
+static int
+Copy_Preallocate( struct vnode* vp, uint64_t uLength )
+{
+    LIFilePreallocateArgs_t sReq = {0};
+    LIFilePreallocateArgs_t sRes;
+    int iErr;
+
+    sReq.flags  = LI_PREALLOCATE_ALLOCATECONTIG | LI_PREALLOCATE_ALLOCATEALL;
+    sReq.length = uLength;
+    sRes = sReq;
+
+    iErr = hfs_vnop_preallocate( vp, &sReq, &sRes );
+    if ( iErr == ENOSPC )
+    {
+        sReq.flags = LI_PREALLOCATE_ALLOCATEALL;
+        sRes = sReq;
+        iErr = hfs_vnop_preallocate( vp, &sReq, &sRes );
+    }
+
+    return iErr;
+}
+
+/*
+ * Copy the first uLength bytes, rounded up to whole allocation blocks,
+ * of the data fork of psSrcVp into the preallocated data fork of psDstVp.
+ * Each transfer covers the largest run that is contiguous in both extent
+ * maps, up to LFHFS_COPY_IO_SIZE, so device I/O stays block aligned.
+ */
+static int
+Copy_ForkData( struct vnode* psSrcVp, struct vnode* psDstVp, uint64_t uLength, void* pvBuf )
+{
+    struct hfsmount* hfsmp = VTOHFS( psSrcVp );
+    int iFD = VNODE_TO_IFD( psSrcVp );
+    uint64_t uOffset = 0;
+    int iErr = 0;
+
+    uLength = ROUND_UP( uLength, hfsmp->blockSize );
+
+    while ( uOffset < uLength )
+    {
+        uint64_t uSrcCluster = 0, uSrcContig = 0;
+        uint64_t uDstCluster = 0, uDstContig = 0;
+
+        iErr = raw_readwrite_get_cluster_from_offset( psSrcVp, uOffset, &uSrcCluster, NULL, &uSrcContig );
+        if ( iErr == 0 )
+        {
+            iErr = raw_readwrite_get_cluster_from_offset( psDstVp, uOffset, &uDstCluster, NULL, &uDstContig );
+        }
+        if ( iErr )
+        {
+            LFHFS_LOG( LEVEL_ERROR, "Copy_ForkData: mapping offset %llu failed (%d)\n", uOffset, iErr );
+            break;
+        }
+
+        uint64_t uChunk = MIN( MIN( uSrcContig, uDstContig ), MIN( uLength - uOffset, LFHFS_COPY_IO_SIZE ) );
+        if ( uChunk == 0 )
+        {
+            iErr = EIO;
+            break;
+        }
+
+        ssize_t iBytes = pread( iFD, pvBuf, uChunk, FSOPS_GetOffsetFromClusterNum( psSrcVp, uSrcCluster ) );
+        if ( iBytes != (ssize_t)uChunk )
+        {
+            iErr = (iBytes < 0) ? errno : EIO;
+            LFHFS_LOG( LEVEL_ERROR, "Copy_ForkData: read at %llu failed (%d)\n", uOffset, iErr );
+            break;
+        }
+
+        iBytes = pwrite( iFD, pvBuf, uChunk, FSOPS_GetOffsetFromClusterNum( psDstVp, uDstCluster ) );
+        if ( iBytes != (ssize_t)uChunk )
+        {
+            iErr = (iBytes < 0) ? errno : EIO;
+            LFHFS_LOG( LEVEL_ERROR, "Copy_ForkData: write at %llu failed (%d)\n", uOffset, iErr );
+            break;
+        }
+
+        uOffset += uChunk;
+    }
+
+    return iErr;
+}
+
+/*
+ * Copy the data fork. The source truncate lock is held shared so its
+ * size and extents cannot change, the same as for LFHFS_Read.
+ */
+static int
+Copy_DataFork( struct vnode* psSrcVp, struct vnode* psDstVp )
+{
+    struct cnode* psSrcCp = VTOC( psSrcVp );
+    struct cnode* psDstCp = VTOC( psDstVp );
+    struct filefork* psSrcFp = VTOF( psSrcVp );
+    struct filefork* psDstFp = VTOF( psDstVp );
+    struct hfsmount* hfsmp = VTOHFS( psSrcVp );
+    struct rl_entry* psRange;
+    void* pvBuf = NULL;
+    uint64_t uSize;
+    int iErr = 0;
+
+    hfs_lock_truncate( psSrcCp, HFS_SHARED_LOCK, HFS_LOCK_DEFAULT );
+    uSize = psSrcFp->ff_size;
+    if ( uSize == 0 )
+    {
+        goto exit;
+    }
+
+    iErr = Copy_Preallocate( psDstVp, ROUND_UP( uSize, hfsmp->blockSize ) );
+    if ( iErr )
+    {
+        goto exit;
+    }
+
+    pvBuf = hfs_malloc( LFHFS_COPY_IO_SIZE );
+    if ( pvBuf == NULL )
+    {
+        iErr = ENOMEM;
+        goto exit;
+    }
+
+    hfs_lock_truncate( psDstCp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT );
+
+    iErr = Copy_ForkData( psSrcVp, psDstVp, uSize, pvBuf );
+    if ( iErr == 0 )
+    {
+        hfs_lock( psDstCp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_ALLOW_NOEXISTS );
+
+        psDstFp->ff_size = uSize;
+        // Ranges never written in the source were copied as they read back.
+        TAILQ_FOREACH( psRange, &psSrcFp->ff_invalidranges, rl_link )
+        {
+            if ( psRange->rl_start < (off_t)uSize )
+            {
+                rl_add( psRange->rl_start, MIN( psRange->rl_end, (off_t)uSize - 1 ), &psDstFp->ff_invalidranges );
+            }
+        }
+        psDstCp->c_flag |= C_MODIFIED;
+        psDstCp->c_touch_chgtime = TRUE;
+        psDstCp->c_touch_modtime = TRUE;
+        iErr = hfs_update( psDstVp, 0 );
+
+        hfs_unlock( psDstCp );
+    }
+
+    hfs_unlock_truncate( psDstCp, HFS_LOCK_DEFAULT );
+
+exit:
+    hfs_unlock_truncate( psSrcCp, HFS_LOCK_DEFAULT );
+    if ( pvBuf ) hfs_free( pvBuf );
+    return iErr;
+}
+
+/*
+ * Copy Finder Info and every extended attribute using a single walk of
+ * the source attributes (hfs_vnop_getallxattr), then the resource fork.
+ */
+static int
+Copy_XAttrs( struct vnode* psSrcVp, struct vnode* psDstVp )
+{
+    void* pvBuf = NULL;
+    size_t uSize = 0;
+    int iErr;
+
+    iErr = hfs_vnop_getallxattr( psSrcVp, NULL, 0, &uSize );
+    if ( iErr == 0 && uSize != 0 )
+    {
+        pvBuf = hfs_malloc( uSize );
+        if ( pvBuf == NULL )
+        {
+            return ENOMEM;
+        }
+
+        iErr = hfs_vnop_getallxattr( psSrcVp, pvBuf, uSize, &uSize );
+        for ( LFHFSXAttrEntry_S* psEntry = pvBuf;
+              iErr == 0 && (uint8_t*)psEntry < (uint8_t*)pvBuf + uSize;
+              psEntry = LFHFS_XATTR_ENTRY_NEXT( psEntry ) )
+        {
+            iErr = hfs_vnop_setxattr( psDstVp, psEntry->pcName, LFHFS_XATTR_ENTRY_VALUE( psEntry ),
+                                      psEntry->uValueSize, UVFSXattrHowSet );
+            if ( iErr )
+            {
+                LFHFS_LOG( LEVEL_ERROR, "Copy_XAttrs: setting %s failed (%d)\n", psEntry->pcName, iErr );
+            }
+        }
+
+        hfs_free( pvBuf );
+        pvBuf = NULL;
+    }
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    // The resource fork is not part of the getallxattr buffer.
+    iErr = hfs_vnop_getxattr( psSrcVp, XATTR_RESOURCEFORK_NAME, NULL, 0, &uSize );
+    if ( iErr == ENOATTR )
+    {
+        return 0;
+    }
+    if ( iErr || uSize == 0 )
+    {
+        return iErr;
+    }
+
+    pvBuf = hfs_malloc( uSize );
+    if ( pvBuf == NULL )
+    {
+        return ENOMEM;
+    }
+
+    iErr = hfs_vnop_getxattr( psSrcVp, XATTR_RESOURCEFORK_NAME, pvBuf, uSize, &uSize );
+    if ( iErr == 0 )
+    {
+        iErr = hfs_vnop_setxattr( psDstVp, XATTR_RESOURCEFORK_NAME, pvBuf, uSize, UVFSXattrHowSet );
+    }
+
+    hfs_free( pvBuf );
+    return iErr;
+}
+
+/*
+ * Create pcName in psDstDirNode as a copy of the regular file psSrcNode:
+ * data, extended attributes, Finder Info and resource fork, then the BSD
+ * flags and times. The destination is preallocated contiguously when
+ * possible and the data is copied between the two extent maps with large
+ * aligned device I/O. On failure the destination is removed.
+ */
+int
+LFHFS_CopyFile( UVFSFileNode psSrcNode, UVFSFileNode psDstDirNode, const char* pcName, uint32_t uFlags, UVFSFileNode* ppsOutNode )
+{
+    struct vnode* psSrcVp = (vnode_t) psSrcNode;
+    UVFSFileAttributes sSrcAttr;
+    UVFSFileAttributes sAttr;
+    UVFSFileNode psDstNode = NULL;
+    int iErr;
+
+    *ppsOutNode = NULL;
+
+    if ( !vnode_isreg( psSrcVp ) )
+    {
+        return ( vnode_isdir( psSrcVp ) ? EISDIR : EPERM );
+    }
+    if ( VTOHFS( psSrcVp )->hfs_flags & HFS_READ_ONLY )
+    {
+        return EROFS;
+    }
+
+    iErr = LFHFS_GetAttr( psSrcNode, &sSrcAttr );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    memset( &sAttr, 0, sizeof(sAttr) );
+    sAttr.fa_validmask = UVFS_FA_VALID_MODE | UVFS_FA_VALID_UID | UVFS_FA_VALID_GID;
+    sAttr.fa_type      = UVFS_FA_TYPE_FILE;
+    sAttr.fa_mode      = sSrcAttr.fa_mode;
+    sAttr.fa_uid       = sSrcAttr.fa_uid;
+    sAttr.fa_gid       = sSrcAttr.fa_gid;
+
+    iErr = LFHFS_Create( psDstDirNode, pcName, &sAttr, &psDstNode );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    iErr = Copy_DataFork( psSrcVp, (vnode_t) psDstNode );
+    if ( iErr == 0 && !(uFlags & LFHFS_COPY_DATA_ONLY) )
+    {
+        iErr = Copy_XAttrs( psSrcVp, (vnode_t) psDstNode );
+    }
+
+    // Last, as UF_IMMUTABLE and friends would refuse the changes above.
+    if ( iErr == 0 )
+    {
+        memset( &sAttr, 0, sizeof(sAttr) );
+        sAttr.fa_validmask = UVFS_FA_VALID_BSD_FLAGS | UVFS_FA_VALID_ATIME | UVFS_FA_VALID_MTIME | UVFS_FA_VALID_BIRTHTIME;
+        sAttr.fa_bsd_flags = sSrcAttr.fa_bsd_flags;
+        sAttr.fa_atime     = sSrcAttr.fa_atime;
+        sAttr.fa_mtime     = sSrcAttr.fa_mtime;
+        sAttr.fa_birthtime = sSrcAttr.fa_birthtime;
+        iErr = hfs_vnop_setattr( (vnode_t) psDstNode, &sAttr );
+    }
+
+    if ( iErr )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_CopyFile: copying to %s failed (%d)\n", pcName, iErr );
+        LFHFS_Reclaim( psDstNode, 0 );
+        (void) LFHFS_Remove( psDstDirNode, pcName, NULL );
+        return iErr;
+    }
+
+    *ppsOutNode = psDstNode;
+    return 0;
+}
@@ -0,0 +1,25 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_copy.h
+ *  livefiles_hfs
+ *
+ *  In-filesystem file copy: duplicate a regular file, its extended
+ *  attributes, Finder Info and resource fork without passing the data
+ *  through the client.
+ */
+
+#ifndef lf_hfs_copy_h
+#define lf_hfs_copy_h
+
+#include <stdint.h>
+#include <UserFS/UserVFS.h>
+
+// Size of each read / write used to copy fork data.
+#define LFHFS_COPY_IO_SIZE              (1024 * 1024)
+
+// LFHFS_CopyFile flags
+#define LFHFS_COPY_DATA_ONLY            (0x1)   // Leave out xattrs, Finder Info and the resource fork
+
+int     LFHFS_CopyFile( UVFSFileNode psSrcNode, UVFSFileNode psDstDirNode, const char* pcName, uint32_t uFlags, UVFSFileNode* ppsOutNode );
+
+#endif /* lf_hfs_copy_h */
@@ -0,0 +1,237 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_createbatch.c
+ *  livefiles_hfs
+ *
+ *  Create many files and directories in one directory, sharing the
+ *  journal transaction, catalog reservation and parent update.
+ */
+
+#include <string.h>
+#include "lf_hfs.h"
+#include "lf_hfs_createbatch.h"
+#include "lf_hfs_cnode.h"
+#include "lf_hfs_vnode.h"
+#include "lf_hfs_vnops.h"
+#include "lf_hfs_vfsops.h"
+#include "lf_hfs_catalog.h"
+#include "lf_hfs_logger.h"
+#include "lf_hfs_vfsutils.h"
+
+/*
+ * Create up to LFHFS_CREATE_BATCH entries in dvp, which is locked
+ * exclusive, under a single transaction.
+ */
+static int
+CreateBatch_Chunk( struct vnode* dvp, LFHFSCreateEntry_S* psEntries, uint32_t uCount )
+{
+    struct hfsmount* hfsmp = VTOHFS(dvp);
+    struct cnode* dcp = VTOC(dvp);
+    struct cat_desc* psDescs = hfs_mallocz( uCount * sizeof(struct cat_desc) );
+    struct cat_attr* psAttrs = hfs_mallocz( uCount * sizeof(struct cat_attr) );
+    int piResults[LFHFS_CREATE_BATCH];
+    uint32_t puIdx[LFHFS_CREATE_BATCH];
+    uint32_t uValid = 0;
+    uint32_t uFiles = 0;
+    uint32_t uDirs = 0;
+    cat_cookie_t sCookie;
+    int iLockFlags;
+    int iErr = 0;
+
+    bzero( &sCookie, sizeof(sCookie) );
+
+    if ( psDescs == NULL || psAttrs == NULL )
+    {
+        iErr = ENOMEM;
+        goto fail_all;
+    }
+
+    for ( uint32_t uIdx = 0; uIdx < uCount; uIdx++ )
+    {
+        LFHFSCreateEntry_S* psEntry = &psEntries[uIdx];
+        const UVFSFileAttributes* psAttr = psEntry->psAttr;
+
+        if ( psEntry->pcName == NULL || psAttr == NULL ||
+             (psAttr->fa_type != UVFS_FA_TYPE_FILE && psAttr->fa_type != UVFS_FA_TYPE_DIR) ||
+             ((psAttr->fa_validmask & UVFS_FA_VALID_SIZE) && psAttr->fa_size != 0) ||
+             strcmp( psEntry->pcName, "." ) == 0 || strcmp( psEntry->pcName, ".." ) == 0 )
+        {
+            psEntry->iErr = EINVAL;
+            continue;
+        }
+
+        psEntry->iErr = hfs_makenode_initattr( hfsmp, (UVFSFileAttributes*) psAttr, &psAttrs[uValid] );
+        if ( psEntry->iErr )
+        {
+            continue;
+        }
+
+        psDescs[uValid].cd_nameptr      = (const u_int8_t *) psEntry->pcName;
+        psDescs[uValid].cd_namelen      = strlen( psEntry->pcName );
+        psDescs[uValid].cd_parentcnid   = dcp->c_fileid;
+        psDescs[uValid].cd_flags        = S_ISDIR(psAttrs[uValid].ca_mode) ? CD_ISDIR : 0;
+        puIdx[uValid++] = uIdx;
+    }
+
+    if ( uValid == 0 )
+    {
+        goto exit;
+    }
+
+    /* Check if were out of usable disk space. */
+    if ( hfs_freeblks( hfsmp, 1 ) == 0 )
+    {
+        iErr = ENOSPC;
+        goto fail_all;
+    }
+
+    iErr = hfs_start_transaction( hfsmp );
+    if ( iErr )
+    {
+        goto fail_all;
+    }
+
+    // As in hfs_makenode, the attribute file is locked too since CNIDs
+    // with orphaned attributes are skipped.
+    iLockFlags = hfs_systemfile_lock( hfsmp, SFL_CATALOG | SFL_ATTRIBUTE, HFS_EXCLUSIVE_LOCK );
+
+    /* Reserve space in the Catalog file for the whole batch. */
+    iErr = cat_preflight( hfsmp, CAT_CREATE * uValid, &sCookie );
+    if ( iErr == 0 )
+    {
+        iErr = cat_create_batch( hfsmp, psDescs, psAttrs, piResults, uValid );
+        if ( iErr )
+        {
+            cat_postflight( hfsmp, &sCookie );
+        }
+    }
+    if ( iErr )
+    {
+        hfs_systemfile_unlock( hfsmp, iLockFlags );
+        hfs_end_transaction( hfsmp );
+        goto fail_all;
+    }
+
+    for ( uint32_t uNew = 0; uNew < uValid; uNew++ )
+    {
+        LFHFSCreateEntry_S* psEntry = &psEntries[puIdx[uNew]];
+
+        psEntry->iErr = piResults[uNew];
+        if ( psEntry->iErr )
+        {
+            continue;
+        }
+
+        psEntry->uFileID = psAttrs[uNew].ca_fileid;
+        if ( S_ISDIR(psAttrs[uNew].ca_mode) )
+        {
+            INC_FOLDERCOUNT(hfsmp, dcp->c_attr);
+            uDirs++;
+        }
+        else
+        {
+            uFiles++;
+        }
+    }
+
+    /* Update the parent directory once for the batch */
+    if ( uFiles + uDirs )
+    {
+        dcp->c_entries += uFiles + uDirs;
+        dcp->c_dirchangecnt++;
+        hfs_incr_gencount(dcp);
+
+        dcp->c_touch_chgtime = dcp->c_touch_modtime = true;
+        dcp->c_flag |= C_MODIFIED;
+
+        hfs_update(dcp->c_vp, 0);
+    }
+
+    hfs_systemfile_unlock( hfsmp, iLockFlags );
+    cat_postflight( hfsmp, &sCookie );
+
+    if ( uFiles )
+    {
+        hfs_volupdate_count( hfsmp, VOL_MKFILE, (dcp->c_cnid == kHFSRootFolderID), uFiles );
+    }
+    if ( uDirs )
+    {
+        hfs_volupdate_count( hfsmp, VOL_MKDIR, (dcp->c_cnid == kHFSRootFolderID), uDirs );
+    }
+
+    hfs_end_transaction( hfsmp );
+    goto exit;
+
+fail_all:
+    for ( uint32_t uNew = 0; uNew < uValid; uNew++ )
+    {
+        psEntries[puIdx[uNew]].iErr = iErr;
+    }
+
+exit:
+    hfs_free( psDescs );
+    hfs_free( psAttrs );
+    return iErr;
+}
+
+int
+LFHFS_CreateBatch( UVFSFileNode psDirNode, LFHFSCreateEntry_S* psEntries, uint32_t uCount )
+{
+    struct vnode* dvp = (struct vnode*) psDirNode;
+    struct cnode* dcp;
+    uint32_t uStart = 0;
+    int iErr;
+
+    if ( !vnode_isdir(dvp) )
+    {
+        return ENOTDIR;
+    }
+
+    for ( uint32_t uIdx = 0; uIdx < uCount; uIdx++ )
+    {
+        psEntries[uIdx].iErr    = 0;
+        psEntries[uIdx].uFileID = 0;
+    }
+
+    dcp = VTOC(dvp);
+    iErr = hfs_lock( dcp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    /* Don't allow creation of new entries in open-unlinked directories */
+    if ( dcp->c_flag & (C_DELETED | C_NOEXISTS) )
+    {
+        iErr = ENOENT;
+        goto exit;
+    }
+
+    dcp->c_flag |= C_DIR_MODIFICATION;
+
+    while ( uStart < uCount && iErr == 0 )
+    {
+        uint32_t uChunk = MIN( LFHFS_CREATE_BATCH, uCount - uStart );
+        iErr = CreateBatch_Chunk( dvp, &psEntries[uStart], uChunk );
+        uStart += uChunk;
+    }
+
+    // Entries after a failed chunk were not attempted.
+    for ( ; uStart < uCount; uStart++ )
+    {
+        psEntries[uStart].iErr = iErr;
+    }
+
+    dvp->sExtraData.sDirData.uDirVersion++;
+    hfs_clear_dir_modification( dcp );
+
+exit:
+    hfs_unlock( dcp );
+
+    for ( uint32_t uIdx = 0; uIdx < uCount && iErr == 0; uIdx++ )
+    {
+        iErr = psEntries[uIdx].iErr;
+    }
+
+    return iErr;
+}
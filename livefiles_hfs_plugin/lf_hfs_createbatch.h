@@ -0,0 +1,32 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_createbatch.h
+ *  livefiles_hfs
+ *
+ *  Create many files and directories in one directory, sharing the
+ *  journal transaction, catalog reservation and parent update.
+ */
+
+#ifndef lf_hfs_createbatch_h
+#define lf_hfs_createbatch_h
+
+#include <stdint.h>
+#include <UserFS/UserVFS.h>
+
+// Entries created under one journal transaction.
+#define LFHFS_CREATE_BATCH              (64)
+
+typedef struct
+{
+    const char*                 pcName;
+    const UVFSFileAttributes*   psAttr;     // As for create / mkdir. fa_type is UVFS_FA_TYPE_FILE or
+                                            // UVFS_FA_TYPE_DIR, and a size, if given, must be 0.
+    int                         iErr;       // Out: result for this entry
+    uint64_t                    uFileID;    // Out: file ID of the new entry
+} LFHFSCreateEntry_S;
+
+// Returns the first error hit, per entry results are in iErr. No nodes
+// are returned; look the entries up to open them.
+int     LFHFS_CreateBatch( UVFSFileNode psDirNode, LFHFSCreateEntry_S* psEntries, uint32_t uCount );
+
+#endif /* lf_hfs_createbatch_h */
@@ -0,0 +1,379 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_defrag.c
+ *  livefiles_hfs
+ *
+ *  Offline defragmentation: move the most fragmented files of a mounted
+ *  volume into contiguous free space.
+ */
+
+#include <time.h>
+#include <string.h>
+#include "lf_hfs.h"
+#include "lf_hfs_defrag.h"
+#include "lf_hfs_fsinfo.h"
+#include "lf_hfs_cnode.h"
+#include "lf_hfs_vnode.h"
+#include "lf_hfs_vnops.h"
+#include "lf_hfs_vfsops.h"
+#include "lf_hfs_vfsutils.h"
+#include "lf_hfs_logger.h"
+#include "lf_hfs_file_mgr_internal.h"
+#include "lf_hfs_file_extent_mapping.h"
+#include "lf_hfs_raw_read_write.h"
+
+/*
+ * Copy uLength bytes of fork data from file offset uSrcOffset to
+ * uDstOffset. Both ranges must lie within the fork's allocated blocks.
+ */
+static int
+Defrag_CopyData( struct vnode* vp, uint64_t uSrcOffset, uint64_t uDstOffset, uint64_t uLength, void* pvBuf, uint64_t* puCopied )
+{
+    int iErr = 0;
+
+    while ( uLength > 0 )
+    {
+        uint64_t uChunk    = MIN( uLength, LFHFS_DEFRAG_IO_SIZE );
+        size_t   uRead     = 0;
+        uint64_t uWritten  = 0;
+
+        iErr = raw_readwrite_read( vp, uSrcOffset, pvBuf, uChunk, &uRead, NULL );
+        if ( iErr == 0 && uRead != uChunk )
+        {
+            iErr = EIO;
+        }
+        if ( iErr )
+        {
+            LFHFS_LOG( LEVEL_ERROR, "Defrag_CopyData: read at %llu failed (%d)\n", uSrcOffset, iErr );
+            break;
+        }
+
+        iErr = raw_readwrite_write( vp, uDstOffset, pvBuf, uChunk, &uWritten );
+        if ( iErr == 0 && uWritten != uChunk )
+        {
+            iErr = EIO;
+        }
+        if ( iErr )
+        {
+            LFHFS_LOG( LEVEL_ERROR, "Defrag_CopyData: write at %llu failed (%d)\n", uDstOffset, iErr );
+            break;
+        }
+
+        uSrcOffset += uChunk;
+        uDstOffset += uChunk;
+        uLength    -= uChunk;
+        *puCopied  += uChunk;
+    }
+
+    return iErr;
+}
+
+/*
+ * Move the data fork of vp into one contiguous run of free blocks.
+ *
+ * This follows hfs_relocate: in one transaction, grow the fork by its
+ * size using a single contiguous allocation. Outside the transaction,
+ * copy the data into the new blocks. In a second transaction, head
+ * truncate the original blocks away. If anything fails, the new blocks
+ * are given back and the fork is left as it was.
+ *
+ * The cnode must be locked exclusive; it is still locked on return.
+ */
+static int
+Defrag_RelocateFork( struct vnode* vp, uint32_t uBlockHint, void* pvBuf, uint64_t* puCopied )
+{
+    struct cnode*       cp      = VTOC(vp);
+    struct filefork*    fp      = VTOF(vp);
+    struct hfsmount*    hfsmp   = VTOHFS(vp);
+    u_int32_t           headblks;
+    u_int32_t           datablks;
+    u_int32_t           blksize;
+    off_t               growsize;
+    u_int32_t           nextallocsave;
+    daddr64_t           sector_a, sector_b;
+    int                 eflags;
+    int64_t             newbytes;
+    int                 lockflags  = 0;
+    int                 started_tr = 0;
+    int                 retval     = 0;
+
+    if (!vnode_isreg(vp)) {
+        return (EPERM);
+    }
+    if (hfsmp->hfs_flags & HFS_FRAGMENTED_FREESPACE) {
+        return (ENOSPC);
+    }
+    if (fp->ff_unallocblocks) {
+        return (EINVAL);
+    }
+
+    blksize = hfsmp->blockSize;
+    if (uBlockHint == 0)
+        uBlockHint = hfsmp->nextAllocation;
+
+    hfs_unlock(cp);
+    hfs_lock_truncate(cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT);
+    if ((retval = hfs_lock(cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_ALLOW_NOEXISTS))) {
+        hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+        return (retval);
+    }
+    if (cp->c_flag & C_NOEXISTS) {
+        hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+        return (ENOENT);
+    }
+
+    headblks = fp->ff_blocks;
+    datablks = (u_int32_t)howmany(fp->ff_size, blksize);
+    growsize = (off_t)datablks * blksize;
+    if (datablks == 0) {
+        hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+        return (EINVAL);
+    }
+
+    eflags = kEFContigMask | kEFAllMask | kEFNoClumpMask;
+    if (uBlockHint >= hfsmp->hfs_metazone_start &&
+        uBlockHint <= hfsmp->hfs_metazone_end)
+        eflags |= kEFMetadataMask;
+
+    /*
+     * STEP 1 - acquire new allocation blocks.
+     */
+    if (hfs_start_transaction(hfsmp) != 0) {
+        hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+        return (EINVAL);
+    }
+    started_tr = 1;
+
+    lockflags = hfs_systemfile_lock(hfsmp, SFL_BITMAP | SFL_EXTENTS, HFS_EXCLUSIVE_LOCK);
+
+    retval = MacToVFSError(MapFileBlockC(hfsmp, (FCB *)fp, 1, growsize - 1, &sector_a, NULL));
+    if (retval)
+        goto out;
+
+    nextallocsave = hfsmp->nextAllocation;
+    retval = ExtendFileC(hfsmp, (FCB *)fp, growsize, uBlockHint, eflags, &newbytes);
+    if (eflags & kEFMetadataMask) {
+        hfs_lock_mount(hfsmp);
+        HFS_UPDATE_NEXT_ALLOCATION(hfsmp, nextallocsave);
+        MarkVCBDirty(hfsmp);
+        hfs_unlock_mount(hfsmp);
+    }
+
+    retval = MacToVFSError(retval);
+    if (retval == 0) {
+        cp->c_flag |= C_MODIFIED;
+        if (newbytes < growsize || fp->ff_blocks < (headblks + datablks)) {
+            retval = ENOSPC;
+            goto restore;
+        }
+
+        retval = MacToVFSError(MapFileBlockC(hfsmp, (FCB *)fp, 1, growsize, &sector_b, NULL));
+        if (retval == 0 && (sector_a + 1) == sector_b) {
+            /* The new blocks simply extend the old ones; nothing is gained. */
+            retval = ENOSPC;
+            goto restore;
+        }
+        if (retval == 0 && (eflags & kEFMetadataMask) &&
+            ((((u_int64_t)sector_b * hfsmp->hfs_logical_block_size) / blksize) > hfsmp->hfs_metazone_end)) {
+            retval = ENOSPC;
+            goto restore;
+        }
+    }
+
+    /* Done with system locks and journal for now. */
+    hfs_systemfile_unlock(hfsmp, lockflags);
+    lockflags = 0;
+    hfs_end_transaction(hfsmp);
+    started_tr = 0;
+
+    if (retval) {
+        /* Check to see if failure is due to excessive fragmentation. */
+        if ((retval == ENOSPC) && (hfs_freeblks(hfsmp, 0) > (datablks * 2))) {
+            hfsmp->hfs_flags |= HFS_FRAGMENTED_FREESPACE;
+        }
+        goto out;
+    }
+
+    /*
+     * STEP 2 - copy the file data into the new allocation blocks.
+     */
+    retval = Defrag_CopyData(vp, 0, (uint64_t)headblks * blksize, growsize, pvBuf, puCopied);
+
+    /* The new copy must be on the media before the extents switch is journaled. */
+    if (retval == 0)
+        retval = hfs_flush(hfsmp, HFS_FLUSH_CACHE);
+
+    /* Start transaction for step 3 or for a restore. */
+    if (hfs_start_transaction(hfsmp) != 0) {
+        retval = EINVAL;
+        goto out;
+    }
+    started_tr = 1;
+    if (retval)
+        goto restore;
+
+    /*
+     * STEP 3 - switch to the copied data and remove the old blocks.
+     */
+    lockflags = hfs_systemfile_lock(hfsmp, SFL_BITMAP | SFL_EXTENTS, HFS_EXCLUSIVE_LOCK);
+
+    retval = MacToVFSError(HeadTruncateFile(hfsmp, (FCB *)fp, headblks));
+
+    hfs_systemfile_unlock(hfsmp, lockflags);
+    lockflags = 0;
+    if (retval)
+        goto restore;
+
+out:
+    hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+
+    if (lockflags) {
+        hfs_systemfile_unlock(hfsmp, lockflags);
+        lockflags = 0;
+    }
+
+    /* Push cnode's new extent data to disk. */
+    if (retval == 0) {
+        hfs_update(vp, 0);
+    }
+    if (hfsmp->jnl) {
+        (void) hfs_flushvolumeheader(hfsmp, 0);
+    }
+exit:
+    if (started_tr)
+        hfs_end_transaction(hfsmp);
+
+    return (retval);
+
+restore:
+    if (fp->ff_blocks == headblks) {
+        if (lockflags)
+            hfs_systemfile_unlock(hfsmp, lockflags);
+        hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+        goto exit;
+    }
+
+    /* Give back any newly allocated space. */
+    if (lockflags == 0) {
+        lockflags = hfs_systemfile_lock(hfsmp, SFL_BITMAP | SFL_EXTENTS, HFS_EXCLUSIVE_LOCK);
+    }
+
+    (void) TruncateFileC(hfsmp, (FCB *)fp, fp->ff_size, 0, FORK_IS_RSRC(fp), FTOC(fp)->c_fileid, false);
+
+    hfs_systemfile_unlock(hfsmp, lockflags);
+    lockflags = 0;
+
+    hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+    goto exit;
+}
+
+/*
+ * Relocate up to uMaxFiles of the forks with the most extents overflow
+ * records, most expensive first. With LFHFS_DEFRAG_COMPACT, allocation
+ * starts at the beginning of the volume (past the metadata zone), so
+ * relocated files fill the lowest free runs that are large enough.
+ */
+int
+LFHFS_Defrag( UVFSFileNode psRootNode, uint32_t uMaxFiles, uint32_t uFlags, LFHFSDefragStats_S* psStats )
+{
+    struct hfsmount* hfsmp = VTOHFS( (vnode_t) psRootNode );
+    LFHFSFsInfo_S sInfo;
+    uint32_t uBlockHint = 0;
+    int iErr = 0;
+
+    uint64_t uStartNs = clock_gettime_nsec_np( CLOCK_UPTIME_RAW );
+    memset( psStats, 0, sizeof(*psStats) );
+
+    if ( hfsmp->hfs_flags & HFS_READ_ONLY )
+    {
+        return EROFS;
+    }
+
+    if ( uFlags & LFHFS_DEFRAG_COMPACT )
+    {
+        uBlockHint = (hfsmp->hfs_flags & HFS_METADATA_ZONE) ? hfsmp->hfs_metazone_end + 1 : 1;
+    }
+
+    void* pvBuf = hfs_malloc( LFHFS_DEFRAG_IO_SIZE );
+    if ( pvBuf == NULL )
+    {
+        return ENOMEM;
+    }
+
+    iErr = LFHFS_FsInfoCollect( psRootNode, uMaxFiles, &sInfo );
+    if ( iErr )
+    {
+        goto exit;
+    }
+
+    for ( uint32_t u = 0; u < sInfo.uTopForks; u++ )
+    {
+        const LFHFSFsInfoFork_S* psFork = &sInfo.psTopForks[u];
+        struct vnode* vp = NULL;
+
+        psStats->uCandidates++;
+
+        // The resource fork vnode is not reachable through hfs_vget.
+        if ( psFork->uForkType != 0 )
+        {
+            psStats->uSkipped++;
+            continue;
+        }
+
+        iErr = hfs_vget( hfsmp, psFork->uFileID, &vp, 0, 0 );
+        if ( iErr || vp == NULL )
+        {
+            if ( vp != NULL )
+            {
+                hfs_unlock( VTOC(vp) );
+                hfs_vnop_reclaim( vp );
+            }
+            LFHFS_LOG( LEVEL_ERROR, "LFHFS_Defrag: hfs_vget %u failed (%d)\n", psFork->uFileID, iErr );
+            psStats->uFailed++;
+            continue;
+        }
+
+        iErr = Defrag_RelocateFork( vp, uBlockHint, pvBuf, &psStats->uBytesCopied );
+        hfs_unlock( VTOC(vp) );
+        hfs_vnop_reclaim( vp );
+
+        if ( iErr == 0 )
+        {
+            psStats->uRelocated++;
+            psStats->uExtentsBefore += psFork->uExtents;
+            psStats->uExtentsAfter  += 1;
+        }
+        else if ( iErr == ENOSPC || iErr == EPERM )
+        {
+            psStats->uSkipped++;
+        }
+        else
+        {
+            LFHFS_LOG( LEVEL_ERROR, "LFHFS_Defrag: relocating %u failed (%d)\n", psFork->uFileID, iErr );
+            psStats->uFailed++;
+        }
+    }
+    iErr = 0;
+
+    LFHFS_FsInfoFree( &sInfo );
+    (void) hfs_flush( hfsmp, HFS_FLUSH_FULL );
+
+exit:
+    hfs_free( pvBuf );
+    psStats->uElapsedNs = clock_gettime_nsec_np( CLOCK_UPTIME_RAW ) - uStartNs;
+    return iErr;
+}
+
+void
+LFHFS_DefragDump( const LFHFSDefragStats_S* psStats, FILE* psFile )
+{
+    double dSeconds = (double)psStats->uElapsedNs / 1000000000.0;
+
+    fprintf( psFile, "Candidates: %u, relocated: %u, skipped: %u, failed: %u\n",
+             psStats->uCandidates, psStats->uRelocated, psStats->uSkipped, psStats->uFailed );
+    fprintf( psFile, "Extents of relocated forks: %llu -> %llu\n",
+             psStats->uExtentsBefore, psStats->uExtentsAfter );
+    fprintf( psFile, "Copied %llu bytes in %.3f seconds (%.1f MB/s)\n",
+             psStats->uBytesCopied, dSeconds,
+             (dSeconds > 0) ? (double)psStats->uBytesCopied / dSeconds / (1024 * 1024) : 0.0 );
+}
@@ -0,0 +1,38 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_defrag.h
+ *  livefiles_hfs
+ *
+ *  Offline defragmentation: move the most fragmented files of a mounted
+ *  volume into contiguous free space.
+ */
+
+#ifndef lf_hfs_defrag_h
+#define lf_hfs_defrag_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <UserFS/UserVFS.h>
+
+// Size of each read / write used to copy file data to its new location.
+#define LFHFS_DEFRAG_IO_SIZE            (1024 * 1024)
+
+// LFHFS_Defrag flags
+#define LFHFS_DEFRAG_COMPACT            (0x1)   // Allocate from the start of the volume to pack files low
+
+typedef struct
+{
+    uint32_t    uCandidates;                    // Forks that use the extents overflow B-tree
+    uint32_t    uRelocated;
+    uint32_t    uSkipped;                       // Resource forks, non regular files, too little free space
+    uint32_t    uFailed;
+    uint64_t    uExtentsBefore;                 // Extents of the relocated forks before / after
+    uint64_t    uExtentsAfter;
+    uint64_t    uBytesCopied;
+    uint64_t    uElapsedNs;
+} LFHFSDefragStats_S;
+
+int     LFHFS_Defrag( UVFSFileNode psRootNode, uint32_t uMaxFiles, uint32_t uFlags, LFHFSDefragStats_S* psStats );
+void    LFHFS_DefragDump( const LFHFSDefragStats_S* psStats, FILE* psFile );
+
+#endif /* lf_hfs_defrag_h */
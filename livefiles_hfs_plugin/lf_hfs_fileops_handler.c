@@ -103,6 +103,8 @@ int LFHFS_Write ( UVFSFileNode psNode, uint64_t uOffset, size_t iLength, const v
     int retval = 0;
     int lockflags;
     int cnode_locked = 0;
+    int overlaps_invalid = 0;
+    struct rl_entry *invalid_range;
 
     int took_truncate_lock = 0;
     size_t iActualLengthToWrite = iLength;
@@ -141,21 +143,49 @@ int LFHFS_Write ( UVFSFileNode psNode, uint64_t uOffset, size_t iLength, const v
      *    old EOF and new EOF are in the same block, we still need to
      *    protect that range of bytes until they are written for the
      *    first time.
+     * 3. We are writing over an invalid range.  It is trimmed once the
+     *    data is on disk, and shared holders read ff_invalidranges.
      *
      * If we had a shared lock with the above cases, we need to try to upgrade
      * to an exclusive lock.  If the upgrade fails, we will lose the shared
      * lock, and will need to take the truncate lock again; the took_truncate_lock
      * flag will still be set, causing us to try for an exclusive lock next time.
      */
+    if (iLength > 0 && writelimit <= origFileSize) {
+        overlaps_invalid = (rl_scan(&fp->ff_invalidranges, uOffset, writelimit - 1, &invalid_range) != RL_NOOVERLAP);
+    }
+
     if ((cp->c_truncatelockowner == HFS_SHARED_OWNER) &&
         ((fp->ff_unallocblocks != 0) ||
-         (writelimit > origFileSize)))
+         (writelimit > origFileSize) ||
+         overlaps_invalid))
     {
             lf_lck_rw_lock_shared_to_exclusive(&cp->c_truncatelock);
             /* Store the owner in the c_truncatelockowner field if we successfully upgrade */
             cp->c_truncatelockowner = pthread_self();
     }
 
+    /*
+     * Still shared: this is an overwrite of allocated, initialized space.
+     * The extents and EOF cannot change until we drop the truncate lock,
+     * so skip the cnode lock for the I/O and only exclude other writers
+     * of the same sectors.  The cnode lock is taken at ioerr_exit to
+     * update the times.
+     */
+    if (cp->c_truncatelockowner == HFS_SHARED_OWNER)
+    {
+        struct hfs_rangelock_entry sRange;
+        off_t uSectorSize = hfsmp->hfs_logical_block_size;
+        uint64_t uActuallyWritten;
+
+        hfs_range_lock(fp, &sRange, ROUND_DOWN(uOffset, uSectorSize), ROUND_UP(writelimit, uSectorSize) - 1);
+        retval = raw_readwrite_write(vp, uOffset, (void*)pvBuf, iLength, &uActuallyWritten);
+        hfs_range_unlock(fp, &sRange);
+
+        *iActuallyWrite = uActuallyWritten;
+        goto ioerr_exit;
+    }
+
     if ( (retval = hfs_lock(VTOC(vp), HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT))) {
         goto exit;
     }
@@ -252,6 +282,15 @@ sizeok:
             fp->ff_size = filesize;
         }
         fp->ff_new_size = 0;    /* ff_size now has the correct size */
+
+        /* The written range now reads back from disk. */
+        if (uActuallyWritten > 0) {
+            rl_remove(uOffset, uOffset + uActuallyWritten - 1, &fp->ff_invalidranges);
+            if (TAILQ_EMPTY(&fp->ff_invalidranges)) {
+                cp->c_flag &= ~C_ZFWANTSYNC;
+                cp->c_zftimeout = 0;
+            }
+        }
     }
 
 ioerr_exit:
@@ -268,13 +307,14 @@ ioerr_exit:
         cp->c_touch_modtime = TRUE;
         hfs_incr_gencount(cp);
     }
-    if (retval)
+    if (retval && cp->c_truncatelockowner == pthread_self())
     {
         (void)hfs_truncate(vp, origFileSize, IO_SYNC, 0);
     }
     else if (*iActuallyWrite > 0)
     {
-        retval = hfs_update(vp, 0);
+        /* The catalog record is pushed later, see hfs_defer_update(). */
+        hfs_defer_update(vp);
     }
 
     /* Updating vcbWrCnt doesn't need to be atomic. */
@@ -658,6 +698,24 @@ int LFHFS_ListXAttr ( UVFSFileNode psNode, void *pvOutBuf, size_t iBufSize, size
     return iErr;
 }
 
+/*
+ * Not part of UVFSFSOps: returns every extended attribute of psNode, names
+ * and values, as a sequence of LFHFSXAttrEntry_S (see lf_hfs_xattr.h).
+ * With pvOutBuf NULL, or ERANGE, *iActualSize is the buffer size needed.
+ */
+int LFHFS_GetAllXAttrs ( UVFSFileNode psNode, void *pvOutBuf, size_t iBufSize, size_t *iActualSize )
+{
+    int iErr = 0;
+
+    LFHFS_LOG(LEVEL_DEBUG, "LFHFS_GetAllXAttrs\n");
+
+    VERIFY_NODE_IS_VALID(psNode);
+
+    iErr = hfs_vnop_getallxattr((vnode_t)psNode, pvOutBuf, iBufSize, iActualSize);
+
+    return iErr;
+}
+
 int
 LFHFS_StreamLookup ( UVFSFileNode psFileNode, UVFSStreamNode *ppsOutNode )
 {
@@ -759,3 +817,21 @@ exit:
     return retval;
 }
 
+/*
+ * Not part of UVFSFSOps: writes the resource fork behind a stream node
+ * from LFHFS_StreamLookup, growing it as needed.
+ */
+int
+LFHFS_StreamWrite (UVFSStreamNode psStreamNode, uint64_t uOffset, size_t iLength, const void *pvBuf, size_t *iActuallyWrite )
+{
+    LFHFS_LOG(LEVEL_DEBUG, "LFHFS_StreamWrite (psNode %p, uOffset %llu, iLength %lu)\n", psStreamNode, uOffset, iLength);
+    VERIFY_NODE_IS_VALID(psStreamNode);
+
+    if (!VNODE_IS_RSRC((vnode_t)psStreamNode))
+    {
+        return EINVAL;
+    }
+
+    return LFHFS_Write((UVFSFileNode)psStreamNode, uOffset, iLength, pvBuf, iActuallyWrite);
+}
+
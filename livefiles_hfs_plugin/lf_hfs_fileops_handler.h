@@ -62,8 +62,10 @@ int LFHFS_Link        ( UVFSFileNode psFromNode, UVFSFileNode psToDirNode, const
 int LFHFS_GetXAttr    ( UVFSFileNode psNode, const char *pcAttr, void *pvOutBuf, size_t iBufSize, size_t *iActualSize );
 int LFHFS_SetXAttr    ( UVFSFileNode psNode, const char *pcAttr, const void *pvInBuf, size_t iBufSize, UVFSXattrHow How );
 int LFHFS_ListXAttr   ( UVFSFileNode psNode, void *pvOutBuf, size_t iBufSize, size_t *iActualSize );
+int LFHFS_GetAllXAttrs( UVFSFileNode psNode, void *pvOutBuf, size_t iBufSize, size_t *iActualSize );
 
 int LFHFS_StreamLookup ( UVFSFileNode psFileNode, UVFSStreamNode *ppsOutNode );
 int LFHFS_StreamReclaim (UVFSStreamNode psStreamNode );
 int LFHFS_StreamRead (UVFSStreamNode psStreamNode, uint64_t uOffset, size_t iLength, void *pvBuf, size_t *iActuallyRead );
+int LFHFS_StreamWrite (UVFSStreamNode psStreamNode, uint64_t uOffset, size_t iLength, const void *pvBuf, size_t *iActuallyWrite );
 #endif /* lf_hfs_fileops_handler_h */
@@ -0,0 +1,563 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_fsinfo.c
+ *  livefiles_hfs
+ *
+ *  Offline fragmentation and layout analysis of a mounted (read-only)
+ *  volume: extent histograms, B-tree fill, free space and the forks
+ *  that cost the most extents overflow lookups.
+ */
+
+#include <time.h>
+#include <string.h>
+#include "lf_hfs.h"
+#include "lf_hfs_fsinfo.h"
+#include "lf_hfs_vfsutils.h"
+#include "lf_hfs_logger.h"
+#include "lf_hfs_format.h"
+#include "lf_hfs_cnode.h"
+#include "lf_hfs_btree.h"
+#include "lf_hfs_catalog.h"
+#include "lf_hfs_sbunicode.h"
+#include "lf_hfs_volume_allocation.h"
+
+enum {
+    kFsInfoDataFork     = 0,
+    kFsInfoResourceFork = 0xFF,
+};
+
+// Per-fork totals gathered from the extents overflow B-tree. The tree is
+// ordered by (fileID, forkType), so the array comes out sorted and the
+// catalog pass can binary search it.
+typedef struct
+{
+    uint32_t    uFileID;
+    uint8_t     uForkType;
+    uint32_t    uRecords;
+    uint32_t    uExtents;
+    uint64_t    uBlocks;
+} FsInfoOverflow_S;
+
+typedef struct
+{
+    FsInfoOverflow_S*   psOverflow;
+    uint32_t            uOverflowCount;
+    uint32_t            uOverflowCapacity;
+} FsInfoState_S;
+
+static uint32_t
+FsInfo_Bucket( uint64_t uValue )
+{
+    return 63 - __builtin_clzll( uValue | 1 );
+}
+
+static void
+FsInfo_AddExtentSize( LFHFSFsInfo_S* psInfo, uint32_t uBlockCount )
+{
+    psInfo->puExtentSizeHist[ FsInfo_Bucket( (uint64_t)uBlockCount * psInfo->uBlockSize ) ]++;
+}
+
+/*
+ * Walk every level of a B-tree from the root down, following the fLink
+ * chain at each level, and record node / record / used byte counts.
+ */
+static int
+FsInfo_CollectBTree( struct vnode* psVp, const char* pcName, LFHFSFsInfoBTree_S* psTree )
+{
+    int iErr = 0;
+
+    psTree->pcName = pcName;
+    if ( psVp == NULL )
+    {
+        return 0;
+    }
+
+    BTreeControlBlockPtr psBtcb = (BTreeControlBlockPtr) VTOF(psVp)->fcbBTCBPtr;
+    psTree->uNodeSize    = psBtcb->nodeSize;
+    psTree->uDepth       = psBtcb->treeDepth;
+    psTree->uTotalNodes  = psBtcb->totalNodes;
+    psTree->uFreeNodes   = psBtcb->freeNodes;
+    psTree->uLeafRecords = psBtcb->leafRecords;
+
+    if ( psTree->uDepth > LFHFS_FSINFO_MAX_DEPTH )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "FsInfo_CollectBTree: %s depth %u is too deep\n", pcName, psTree->uDepth );
+        return EFTYPE;
+    }
+
+    uint32_t uLeftmost = psBtcb->rootNode;
+    for ( int32_t iLevel = (int32_t)psTree->uDepth - 1; iLevel >= 0 && uLeftmost != 0; iLevel-- )
+    {
+        uint32_t uNodeNum = uLeftmost;
+        uLeftmost = 0;
+
+        while ( uNodeNum != 0 )
+        {
+            NodeRec sNode = {0};
+            iErr = GetNode( psBtcb, uNodeNum, 0, &sNode );
+            if ( iErr )
+            {
+                LFHFS_LOG( LEVEL_ERROR, "FsInfo_CollectBTree: %s GetNode %u failed (%d)\n", pcName, uNodeNum, iErr );
+                return MacToVFSError( iErr );
+            }
+
+            NodeDescPtr psDesc = (NodeDescPtr) sNode.buffer;
+            psTree->puLevelNodes[iLevel]++;
+            psTree->puLevelRecords[iLevel]   += psDesc->numRecords;
+            psTree->puLevelUsedBytes[iLevel] += psBtcb->nodeSize - GetNodeFreeSize( psBtcb, psDesc );
+
+            if ( uLeftmost == 0 && iLevel > 0 && psDesc->numRecords > 0 )
+            {
+                uLeftmost = GetChildNodeNum( psBtcb, psDesc, 0 );
+            }
+            uNodeNum = psDesc->fLink;
+
+            (void) ReleaseNode( psBtcb, &sNode );
+        }
+    }
+
+    return 0;
+}
+
+static int
+FsInfo_CollectOverflow( struct hfsmount* hfsmp, LFHFSFsInfo_S* psInfo, FsInfoState_S* psState )
+{
+    FCB* psFcb = VTOF(hfsmp->hfs_extents_vp);
+    BTreeControlBlockPtr psBtcb = (BTreeControlBlockPtr) psFcb->fcbBTCBPtr;
+    HFSPlusExtentRecord sExtents;
+    FSBufferDescriptor sBtData;
+    int iErr = 0;
+
+    BTreeIterator* psIterator = hfs_mallocz( sizeof(BTreeIterator) );
+    if ( psIterator == NULL )
+    {
+        return ENOMEM;
+    }
+
+    // Each leaf record belongs to at most one fork, so leafRecords bounds the array.
+    psState->uOverflowCapacity = psBtcb->leafRecords;
+    if ( psState->uOverflowCapacity != 0 )
+    {
+        psState->psOverflow = hfs_mallocz( psState->uOverflowCapacity * sizeof(FsInfoOverflow_S) );
+        if ( psState->psOverflow == NULL )
+        {
+            hfs_free( psIterator );
+            return ENOMEM;
+        }
+    }
+
+    sBtData.bufferAddress = &sExtents;
+    sBtData.itemSize      = sizeof(sExtents);
+    sBtData.itemCount     = 1;
+
+    HFSPlusExtentKey* psKey = (HFSPlusExtentKey*) &psIterator->key;
+    BTreeIterationOperation eOp = kBTreeFirstRecord;
+    for (;;)
+    {
+        iErr = BTIterateRecord( psFcb, eOp, psIterator, &sBtData, NULL );
+        if ( iErr )
+        {
+            break;
+        }
+        eOp = kBTreeNextRecord;
+
+        if ( psKey->fileID == kHFSBadBlockFileID )
+        {
+            continue;
+        }
+
+        FsInfoOverflow_S* psFork = NULL;
+        if ( psState->uOverflowCount != 0 )
+        {
+            psFork = &psState->psOverflow[psState->uOverflowCount - 1];
+            if ( psFork->uFileID != psKey->fileID || psFork->uForkType != psKey->forkType )
+            {
+                psFork = NULL;
+            }
+        }
+        if ( psFork == NULL )
+        {
+            if ( psState->uOverflowCount == psState->uOverflowCapacity )
+            {
+                // leafRecords is out of date; the tree needs a rebuild anyway.
+                iErr = EFTYPE;
+                break;
+            }
+            psFork = &psState->psOverflow[psState->uOverflowCount++];
+            psFork->uFileID   = psKey->fileID;
+            psFork->uForkType = psKey->forkType;
+        }
+
+        psFork->uRecords++;
+        psInfo->uOverflowRecords++;
+        for ( uint32_t u = 0; u < kHFSPlusExtentDensity && sExtents[u].blockCount != 0; u++ )
+        {
+            psFork->uExtents++;
+            psFork->uBlocks += sExtents[u].blockCount;
+            FsInfo_AddExtentSize( psInfo, sExtents[u].blockCount );
+        }
+    }
+
+    if ( iErr == fsBTRecordNotFoundErr )
+    {
+        iErr = 0;
+    }
+    else
+    {
+        iErr = MacToVFSError( iErr );
+    }
+
+    hfs_free( psIterator );
+    return iErr;
+}
+
+static const FsInfoOverflow_S*
+FsInfo_FindOverflow( const FsInfoState_S* psState, uint32_t uFileID, uint8_t uForkType )
+{
+    uint32_t uLow  = 0;
+    uint32_t uHigh = psState->uOverflowCount;
+
+    while ( uLow < uHigh )
+    {
+        uint32_t uMid = uLow + (uHigh - uLow) / 2;
+        const FsInfoOverflow_S* psFork = &psState->psOverflow[uMid];
+
+        if ( psFork->uFileID == uFileID && psFork->uForkType == uForkType )
+        {
+            return psFork;
+        }
+        if ( psFork->uFileID < uFileID || (psFork->uFileID == uFileID && psFork->uForkType < uForkType) )
+        {
+            uLow = uMid + 1;
+        }
+        else
+        {
+            uHigh = uMid;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Keep psInfo->psTopForks sorted by overflow records (then extents),
+ * most expensive first.
+ */
+static void
+FsInfo_RankFork( LFHFSFsInfo_S* psInfo, uint32_t* puUsed, const HFSPlusCatalogKey* psKey,
+                 uint32_t uFileID, uint8_t uForkType, const FsInfoOverflow_S* psOverflow, uint32_t uExtents, uint64_t uBlocks )
+{
+    uint32_t uPos = *puUsed;
+
+    while ( uPos > 0 )
+    {
+        const LFHFSFsInfoFork_S* psPrev = &psInfo->psTopForks[uPos - 1];
+        if ( psPrev->uOverflowRecords > psOverflow->uRecords ||
+             (psPrev->uOverflowRecords == psOverflow->uRecords && psPrev->uExtents >= uExtents) )
+        {
+            break;
+        }
+        uPos--;
+    }
+    if ( uPos >= psInfo->uTopForks )
+    {
+        return;
+    }
+
+    uint32_t uLast = (*puUsed < psInfo->uTopForks) ? (*puUsed)++ : psInfo->uTopForks - 1;
+    memmove( &psInfo->psTopForks[uPos + 1], &psInfo->psTopForks[uPos], (uLast - uPos) * sizeof(LFHFSFsInfoFork_S) );
+
+    LFHFSFsInfoFork_S* psFork = &psInfo->psTopForks[uPos];
+    psFork->uFileID          = uFileID;
+    psFork->uParentID        = psKey->parentID;
+    psFork->uForkType        = uForkType;
+    psFork->uOverflowRecords = psOverflow->uRecords;
+    psFork->uExtents         = uExtents;
+    psFork->uBlocks          = uBlocks;
+
+    size_t uNameLen = 0;
+    if ( utf8_encodestr( psKey->nodeName.unicode, psKey->nodeName.length * 2, (u_int8_t*) psFork->pcName,
+                         &uNameLen, sizeof(psFork->pcName), ':', UTF_ADD_NULL_TERM ) != 0 )
+    {
+        strlcpy( psFork->pcName, "?", sizeof(psFork->pcName) );
+    }
+}
+
+static void
+FsInfo_AddFork( LFHFSFsInfo_S* psInfo, const FsInfoState_S* psState, uint32_t* puTopUsed,
+                const HFSPlusCatalogKey* psKey, uint32_t uFileID, uint8_t uForkType, const HFSPlusForkData* psForkData )
+{
+    uint32_t uExtents = 0;
+    uint64_t uBlocks  = 0;
+
+    if ( psForkData->totalBlocks == 0 )
+    {
+        return;
+    }
+
+    for ( uint32_t u = 0; u < kHFSPlusExtentDensity && psForkData->extents[u].blockCount != 0; u++ )
+    {
+        uExtents++;
+        uBlocks += psForkData->extents[u].blockCount;
+        FsInfo_AddExtentSize( psInfo, psForkData->extents[u].blockCount );
+    }
+
+    const FsInfoOverflow_S* psOverflow = FsInfo_FindOverflow( psState, uFileID, uForkType );
+    if ( psOverflow != NULL )
+    {
+        uExtents += psOverflow->uExtents;
+        uBlocks  += psOverflow->uBlocks;
+        if ( psInfo->uTopForks != 0 )
+        {
+            FsInfo_RankFork( psInfo, puTopUsed, psKey, uFileID, uForkType, psOverflow, uExtents, uBlocks );
+        }
+    }
+
+    psInfo->uForks++;
+    psInfo->uExtents += uExtents;
+    if ( uExtents > 1 )
+    {
+        psInfo->uFragmentedForks++;
+    }
+    psInfo->puExtentCountHist[ FsInfo_Bucket( uExtents ) ]++;
+}
+
+static int
+FsInfo_CollectCatalog( struct hfsmount* hfsmp, LFHFSFsInfo_S* psInfo, const FsInfoState_S* psState )
+{
+    FCB* psFcb = VTOF(hfsmp->hfs_catalog_vp);
+    FSBufferDescriptor sBtData;
+    uint32_t uTopUsed = 0;
+    int iErr = 0;
+
+    BTreeIterator* psIterator = hfs_mallocz( sizeof(BTreeIterator) );
+    CatalogRecord* psRecord   = hfs_malloc( sizeof(CatalogRecord) );
+    if ( psIterator == NULL || psRecord == NULL )
+    {
+        iErr = ENOMEM;
+        goto exit;
+    }
+
+    sBtData.bufferAddress = psRecord;
+    sBtData.itemSize      = sizeof(CatalogRecord);
+    sBtData.itemCount     = 1;
+
+    const HFSPlusCatalogKey* psKey = (const HFSPlusCatalogKey*) &psIterator->key;
+    BTreeIterationOperation eOp = kBTreeFirstRecord;
+    for (;;)
+    {
+        iErr = BTIterateRecord( psFcb, eOp, psIterator, &sBtData, NULL );
+        if ( iErr )
+        {
+            break;
+        }
+        eOp = kBTreeNextRecord;
+
+        if ( psRecord->recordType != kHFSPlusFileRecord )
+        {
+            continue;
+        }
+
+        const HFSPlusCatalogFile* psFile = &psRecord->hfsPlusFile;
+        psInfo->uFiles++;
+        FsInfo_AddFork( psInfo, psState, &uTopUsed, psKey, psFile->fileID, kFsInfoDataFork,     &psFile->dataFork );
+        FsInfo_AddFork( psInfo, psState, &uTopUsed, psKey, psFile->fileID, kFsInfoResourceFork, &psFile->resourceFork );
+    }
+
+    if ( iErr == fsBTRecordNotFoundErr )
+    {
+        iErr = 0;
+    }
+    else
+    {
+        iErr = MacToVFSError( iErr );
+    }
+    psInfo->uTopForks = uTopUsed;
+
+exit:
+    if ( psRecord )
+        hfs_free( psRecord );
+    if ( psIterator )
+        hfs_free( psIterator );
+    return iErr;
+}
+
+static void
+FsInfo_AddFreeExtent( void* pvData, u_int32_t uStartBlock, u_int32_t uBlockCount )
+{
+#pragma unused (uStartBlock)
+    LFHFSFsInfo_S* psInfo = pvData;
+
+    psInfo->uFreeExtents++;
+    psInfo->uFreeBlocks += uBlockCount;
+    if ( uBlockCount > psInfo->uLargestFreeExtent )
+    {
+        psInfo->uLargestFreeExtent = uBlockCount;
+    }
+    psInfo->puFreeExtentSizeHist[ FsInfo_Bucket( (uint64_t)uBlockCount * psInfo->uBlockSize ) ]++;
+}
+
+/*
+ * Gather the report for the volume whose root is psRootNode. The volume
+ * should be mounted read-only so the numbers do not move underneath us.
+ * Up to uTopForks of the forks with the most extents overflow records
+ * are returned in psInfo->psTopForks; release it with LFHFS_FsInfoFree.
+ */
+int
+LFHFS_FsInfoCollect( UVFSFileNode psRootNode, uint32_t uTopForks, LFHFSFsInfo_S* psInfo )
+{
+    struct hfsmount* hfsmp = VTOHFS( (vnode_t) psRootNode );
+    FsInfoState_S sState = {0};
+    int iLockFlags;
+    int iErr = 0;
+
+    uint64_t uStartNs = clock_gettime_nsec_np( CLOCK_UPTIME_RAW );
+
+    memset( psInfo, 0, sizeof(*psInfo) );
+    psInfo->uBlockSize   = hfsmp->blockSize;
+    psInfo->uTotalBlocks = hfsmp->totalBlocks;
+
+    if ( uTopForks != 0 )
+    {
+        psInfo->psTopForks = hfs_mallocz( uTopForks * sizeof(LFHFSFsInfoFork_S) );
+        if ( psInfo->psTopForks == NULL )
+        {
+            return ENOMEM;
+        }
+        psInfo->uTopForks = uTopForks;
+    }
+
+    iLockFlags = hfs_systemfile_lock( hfsmp, SFL_CATALOG | SFL_EXTENTS | SFL_ATTRIBUTE, HFS_SHARED_LOCK );
+
+    iErr = FsInfo_CollectOverflow( hfsmp, psInfo, &sState );
+    if ( !iErr )
+        iErr = FsInfo_CollectCatalog( hfsmp, psInfo, &sState );
+    if ( !iErr )
+        iErr = FsInfo_CollectBTree( hfsmp->hfs_catalog_vp,   "catalog",    &psInfo->sCatalog );
+    if ( !iErr )
+        iErr = FsInfo_CollectBTree( hfsmp->hfs_extents_vp,   "extents",    &psInfo->sExtents );
+    if ( !iErr )
+        iErr = FsInfo_CollectBTree( hfsmp->hfs_attribute_vp, "attributes", &psInfo->sAttributes );
+
+    hfs_systemfile_unlock( hfsmp, iLockFlags );
+
+    if ( !iErr )
+    {
+        iLockFlags = hfs_systemfile_lock( hfsmp, SFL_BITMAP, HFS_SHARED_LOCK );
+        iErr = hfs_find_free_extents( hfsmp, FsInfo_AddFreeExtent, psInfo );
+        hfs_systemfile_unlock( hfsmp, iLockFlags );
+    }
+
+    if ( sState.psOverflow )
+        hfs_free( sState.psOverflow );
+
+    if ( iErr )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_FsInfoCollect failed (%d)\n", iErr );
+        LFHFS_FsInfoFree( psInfo );
+        return iErr;
+    }
+
+    psInfo->uElapsedNs = clock_gettime_nsec_np( CLOCK_UPTIME_RAW ) - uStartNs;
+    return 0;
+}
+
+void
+LFHFS_FsInfoFree( LFHFSFsInfo_S* psInfo )
+{
+    if ( psInfo->psTopForks )
+    {
+        hfs_free( psInfo->psTopForks );
+        psInfo->psTopForks = NULL;
+    }
+    psInfo->uTopForks = 0;
+}
+
+static void
+FsInfo_DumpHist( FILE* psFile, const char* pcTitle, const char* pcUnit, const uint64_t puHist[LFHFS_FSINFO_HIST_BUCKETS] )
+{
+    uint64_t uTotal = 0;
+    for ( uint32_t u = 0; u < LFHFS_FSINFO_HIST_BUCKETS; u++ )
+    {
+        uTotal += puHist[u];
+    }
+
+    fprintf( psFile, "%s:\n", pcTitle );
+    if ( uTotal == 0 )
+    {
+        fprintf( psFile, "    (none)\n" );
+        return;
+    }
+
+    for ( uint32_t u = 0; u < LFHFS_FSINFO_HIST_BUCKETS; u++ )
+    {
+        if ( puHist[u] == 0 )
+        {
+            continue;
+        }
+        fprintf( psFile, "    >= %20llu %-7s %12llu  %5.1f%%\n",
+                 (u == 0) ? 0ULL : (1ULL << u), pcUnit, puHist[u], 100.0 * puHist[u] / uTotal );
+    }
+}
+
+static void
+FsInfo_DumpBTree( FILE* psFile, const LFHFSFsInfoBTree_S* psTree )
+{
+    if ( psTree->uNodeSize == 0 )
+    {
+        fprintf( psFile, "%s B-tree: not present\n", psTree->pcName );
+        return;
+    }
+
+    fprintf( psFile, "%s B-tree: depth %u, node size %u, %u of %u nodes in use, %u leaf records\n",
+             psTree->pcName, psTree->uDepth, psTree->uNodeSize,
+             psTree->uTotalNodes - psTree->uFreeNodes, psTree->uTotalNodes, psTree->uLeafRecords );
+
+    for ( int32_t iLevel = (int32_t)psTree->uDepth - 1; iLevel >= 0; iLevel-- )
+    {
+        uint64_t uNodes = psTree->puLevelNodes[iLevel];
+        fprintf( psFile, "    level %2d (%s): %10llu nodes %12llu records  %5.1f%% full\n",
+                 iLevel + 1, (iLevel == 0) ? "leaf " : "index", uNodes, psTree->puLevelRecords[iLevel],
+                 uNodes ? 100.0 * psTree->puLevelUsedBytes[iLevel] / (uNodes * psTree->uNodeSize) : 0.0 );
+    }
+}
+
+void
+LFHFS_FsInfoDump( const LFHFSFsInfo_S* psInfo, FILE* psFile )
+{
+    fprintf( psFile, "Volume: %u blocks of %u bytes, %llu free (%.1f%%)\n",
+             psInfo->uTotalBlocks, psInfo->uBlockSize, psInfo->uFreeBlocks,
+             psInfo->uTotalBlocks ? 100.0 * psInfo->uFreeBlocks / psInfo->uTotalBlocks : 0.0 );
+    fprintf( psFile, "Files: %llu, forks: %llu, fragmented forks: %llu (%.1f%%), extents: %llu, overflow records: %llu\n",
+             psInfo->uFiles, psInfo->uForks, psInfo->uFragmentedForks,
+             psInfo->uForks ? 100.0 * psInfo->uFragmentedForks / psInfo->uForks : 0.0,
+             psInfo->uExtents, psInfo->uOverflowRecords );
+
+    FsInfo_DumpHist( psFile, "Extents per fork",  "extents", psInfo->puExtentCountHist );
+    FsInfo_DumpHist( psFile, "Extent size",       "bytes",   psInfo->puExtentSizeHist );
+
+    fprintf( psFile, "Free space: %llu extents, largest %llu blocks, average %.1f blocks\n",
+             psInfo->uFreeExtents, psInfo->uLargestFreeExtent,
+             psInfo->uFreeExtents ? (double)psInfo->uFreeBlocks / psInfo->uFreeExtents : 0.0 );
+    FsInfo_DumpHist( psFile, "Free extent size",  "bytes",   psInfo->puFreeExtentSizeHist );
+
+    FsInfo_DumpBTree( psFile, &psInfo->sCatalog );
+    FsInfo_DumpBTree( psFile, &psInfo->sExtents );
+    FsInfo_DumpBTree( psFile, &psInfo->sAttributes );
+
+    fprintf( psFile, "Forks with the most overflow lookups:\n" );
+    if ( psInfo->uTopForks == 0 )
+    {
+        fprintf( psFile, "    (none)\n" );
+    }
+    for ( uint32_t u = 0; u < psInfo->uTopForks; u++ )
+    {
+        const LFHFSFsInfoFork_S* psFork = &psInfo->psTopForks[u];
+        fprintf( psFile, "    %8u records %8u extents %12llu blocks  id %u parent %u %s%s\n",
+                 psFork->uOverflowRecords, psFork->uExtents, psFork->uBlocks,
+                 psFork->uFileID, psFork->uParentID, psFork->pcName,
+                 (psFork->uForkType == kFsInfoResourceFork) ? " (rsrc)" : "" );
+    }
+
+    fprintf( psFile, "Collected in %.3f seconds\n", (double)psInfo->uElapsedNs / 1000000000.0 );
+}
@@ -0,0 +1,87 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_fsinfo.h
+ *  livefiles_hfs
+ *
+ *  Offline fragmentation and layout analysis of a mounted (read-only)
+ *  volume: extent histograms, B-tree fill, free space and the forks
+ *  that cost the most extents overflow lookups.
+ */
+
+#ifndef lf_hfs_fsinfo_h
+#define lf_hfs_fsinfo_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <UserFS/UserVFS.h>
+
+// Histogram bucket i counts values v satisfying 2^i <= v < 2^(i+1).
+// Bucket 0 also counts zero.
+#define LFHFS_FSINFO_HIST_BUCKETS       (64)
+
+#define LFHFS_FSINFO_MAX_DEPTH          (16)
+#define LFHFS_FSINFO_NAME_MAX           (NAME_MAX * 3 + 1)
+
+typedef struct
+{
+    const char* pcName;
+    uint32_t    uNodeSize;
+    uint32_t    uDepth;
+    uint32_t    uTotalNodes;
+    uint32_t    uFreeNodes;
+    uint32_t    uLeafRecords;
+
+    // Index 0 is the leaf level, index uDepth-1 the root.
+    uint64_t    puLevelNodes[LFHFS_FSINFO_MAX_DEPTH];
+    uint64_t    puLevelRecords[LFHFS_FSINFO_MAX_DEPTH];
+    uint64_t    puLevelUsedBytes[LFHFS_FSINFO_MAX_DEPTH];
+} LFHFSFsInfoBTree_S;
+
+typedef struct
+{
+    uint32_t    uFileID;
+    uint32_t    uParentID;
+    uint8_t     uForkType;                              // 0 = data fork, 0xFF = resource fork
+    uint32_t    uOverflowRecords;                       // Extents B-tree records (lookups) for this fork
+    uint32_t    uExtents;
+    uint64_t    uBlocks;
+    char        pcName[LFHFS_FSINFO_NAME_MAX];          // Leaf name only
+} LFHFSFsInfoFork_S;
+
+typedef struct
+{
+    uint32_t            uBlockSize;
+    uint32_t            uTotalBlocks;
+    uint64_t            uFreeBlocks;
+
+    // File forks (catalog + extents overflow B-tree)
+    uint64_t            uFiles;
+    uint64_t            uForks;
+    uint64_t            uFragmentedForks;               // Forks with more than one extent
+    uint64_t            uExtents;
+    uint64_t            uOverflowRecords;
+    uint64_t            puExtentCountHist[LFHFS_FSINFO_HIST_BUCKETS];   // Extents per fork
+    uint64_t            puExtentSizeHist[LFHFS_FSINFO_HIST_BUCKETS];    // Extent size in bytes
+
+    // Free space (volume bitmap)
+    uint64_t            uFreeExtents;
+    uint64_t            uLargestFreeExtent;             // In allocation blocks
+    uint64_t            puFreeExtentSizeHist[LFHFS_FSINFO_HIST_BUCKETS];// Free extent size in bytes
+
+    LFHFSFsInfoBTree_S  sCatalog;
+    LFHFSFsInfoBTree_S  sExtents;
+    LFHFSFsInfoBTree_S  sAttributes;
+
+    // Forks with the most overflow records, most expensive first.
+    uint32_t            uTopForks;
+    LFHFSFsInfoFork_S*  psTopForks;
+
+    uint64_t            uElapsedNs;
+} LFHFSFsInfo_S;
+
+int     LFHFS_FsInfoCollect( UVFSFileNode psRootNode, uint32_t uTopForks, LFHFSFsInfo_S* psInfo );
+void    LFHFS_FsInfoDump( const LFHFSFsInfo_S* psInfo, FILE* psFile );
+void    LFHFS_FsInfoFree( LFHFSFsInfo_S* psInfo );
+
+#endif /* lf_hfs_fsinfo_h */
@@ -25,6 +25,8 @@
 #include "lf_hfs_readwrite_ops.h"
 
 #include "lf_hfs_vnops.h"
+#include "lf_hfs_stats.h"
+#include "lf_hfs_trace.h"
 
 static int
 FSOPS_GetRootVnode(struct vnode* psDevVnode, struct vnode** ppsRootVnode)
@@ -156,6 +158,8 @@ LFHFS_Init ( void )
         goto exit;
     }
 
+    LFHFS_TraceInit();
+
     iErr = raw_readwrite_zero_fill_init();
     if ( iErr != 0 )
     {
@@ -186,11 +190,25 @@ LFHFS_Fini ( void )
     lf_hfs_generic_buf_cache_deinit();
 }
 
-int
-LFHFS_Mount ( int iFd, UVFSVolumeId puVolId, UVFSMountFlags puMountFlags,
-    __unused UVFSVolumeCredential *psVolumeCreds, UVFSFileNode *ppsRootNode )
+static void
+FSOPS_FreeJournalVnode(struct vnode* psJournalVnode)
 {
-    LFHFS_LOG(LEVEL_DEBUG, "HFS_Mount %d\n", iFd);
+    if (psJournalVnode == NULL)
+        return;
+
+    if (psJournalVnode->psFSRecord)
+        hfs_free(psJournalVnode->psFSRecord);
+    hfs_free(psJournalVnode);
+}
+
+/*
+ * iJournalFd is the device holding the journal of a volume whose journal
+ * is not inside the file system (kJIJournalInFSMask clear), or -1.
+ */
+static int
+FSOPS_Mount ( int iFd, int iJournalFd, UVFSVolumeId puVolId, UVFSMountFlags puMountFlags, UVFSFileNode *ppsRootNode )
+{
+    LFHFS_LOG(LEVEL_DEBUG, "HFS_Mount %d (journal %d)\n", iFd, iJournalFd);
     int iError = 0;
 
     struct mount* psMount            = hfs_mallocz(sizeof(struct mount));
@@ -198,6 +216,7 @@ LFHFS_Mount ( int iFd, UVFSVolumeId puVolId, UVFSMountFlags puMountFlags,
     struct cnode* psDevCnode         = hfs_mallocz(sizeof(struct cnode));
     struct filefork* psDevFileFork   = hfs_mallocz(sizeof(struct filefork));
     FileSystemRecord_s *psFSRecord   = hfs_mallocz(sizeof(FileSystemRecord_s));
+    struct vnode* psJournalVnode     = NULL;
 
     if ( psMount == NULL || psDevVnode == NULL || psDevCnode == NULL || psDevFileFork == NULL || psFSRecord == NULL )
     {
@@ -229,6 +248,25 @@ LFHFS_Mount ( int iFd, UVFSVolumeId puVolId, UVFSMountFlags puMountFlags,
     psDevCnode->c_datafork              = psDevFileFork;
     psDevVnode->sFSParams.vnfs_mp       = psMount;
 
+    if (iJournalFd >= 0)
+    {
+        // The journal device is only ever accessed with raw reads and
+        // writes, so it needs no cnode of its own.
+        psJournalVnode = hfs_mallocz(sizeof(struct vnode));
+        if (psJournalVnode == NULL || (psJournalVnode->psFSRecord = hfs_mallocz(sizeof(FileSystemRecord_s))) == NULL)
+        {
+            iError = ENOMEM;
+            LFHFS_LOG(LEVEL_ERROR, "HFS_Mount: failed to malloc the journal device\n");
+            goto fail;
+        }
+
+        psJournalVnode->psFSRecord->iFD         = iJournalFd;
+        psJournalVnode->sFSParams.vnfs_marksystem = 1;
+        psJournalVnode->sFSParams.vnfs_mp       = psMount;
+        psJournalVnode->bIsMountVnode           = true;
+        psMount->psJournalVnode                 = psJournalVnode;
+    }
+
     psMount->mnt_flag = (puMountFlags == UVFS_MOUNT_RDONLY)? MNT_RDONLY : 0;
     // Calling to kext hfs_mount
     iError = hfs_mount(psMount, psDevVnode, 0);
@@ -245,6 +283,7 @@ LFHFS_Mount ( int iFd, UVFSVolumeId puVolId, UVFSMountFlags puMountFlags,
     goto end;
 
 fail:
+    FSOPS_FreeJournalVnode(psJournalVnode);
     if (psFSRecord)
         hfs_free(psFSRecord);
     if (psMount)
@@ -259,6 +298,22 @@ end:
     return iError;
 }
 
+int
+LFHFS_Mount ( int iFd, UVFSVolumeId puVolId, UVFSMountFlags puMountFlags,
+    __unused UVFSVolumeCredential *psVolumeCreds, UVFSFileNode *ppsRootNode )
+{
+    return FSOPS_Mount(iFd, -1, puVolId, puMountFlags, ppsRootNode);
+}
+
+int
+LFHFS_MountWithJournal ( int iFd, int iJournalFd, UVFSMountFlags puMountFlags, UVFSFileNode *ppsRootNode )
+{
+    if (iJournalFd < 0)
+        return EBADF;
+
+    return FSOPS_Mount(iFd, iJournalFd, 0, puMountFlags, ppsRootNode);
+}
+
 int
 LFHFS_Unmount ( UVFSFileNode psRootNode, UVFSUnmountHint hint )
 {
@@ -272,11 +327,21 @@ LFHFS_Unmount ( UVFSFileNode psRootNode, UVFSUnmountHint hint )
     struct cnode       *psDevCnode  = VTOHFS(psRootVnode)->hfs_devvp->sFSParams.vnfs_fsnode;
     struct hfsmount    *psHfsMp     = psMount->psHfsmount;
     psFSRecord->uUnmountHint        = hint;
+    if (psMount->psJournalVnode)
+        psMount->psJournalVnode->psFSRecord->uUnmountHint = hint;
 
     #if HFS_CRASH_TEST
         CRASH_ABORT(CRASH_ABORT_ON_UNMOUNT, psHfsMp, NULL);
     #endif
     
+    // Push the catalog records of files written since the last sync.
+    if (psHfsMp->hfs_deferred_count) {
+        hfs_flush_deferred_updates(psHfsMp);
+        if (psHfsMp->jnl) {
+            hfs_flush(psHfsMp, HFS_FLUSH_JOURNAL_META);
+        }
+    }
+
     hfs_vnop_reclaim(psRootVnode);
 
     if (!psHfsMp->jnl) {
@@ -285,6 +350,7 @@ LFHFS_Unmount ( UVFSFileNode psRootNode, UVFSUnmountHint hint )
 
     hfs_unmount(psMount);
 
+    FSOPS_FreeJournalVnode(psMount->psJournalVnode);
     hfs_free(psFSRecord);
     hfs_free(psMount);
     hfs_free(psDevCnode->c_datafork);
@@ -640,6 +706,8 @@ int LFHFS_Sync(UVFSFileNode psNode) {
 
     lf_lck_mtx_lock(&psMount->sync_mutex);
     psMount->hfs_syncer_thread = pthread_self();
+
+    iErr = hfs_flush_deferred_updates(psMount);
     
     if (psMount->jnl) {
         
@@ -672,49 +740,269 @@ LFHFS_Check( int fdToCheck , __unused UVFSVolumeId volId,
     return fsck_hfs(fdToCheck, how);
 }
 
+//---------------------------------- Statistics Wrappers -----------------------------------------
+// Every HFS_fsOps entry point goes through one of the wrappers below, which
+// account the call, its result, the bytes it moved and its latency (see lf_hfs_stats.h).
+
+#define FSOPS_STATS_CALL(eOp, uBytesOnSuccess, Call)                        \
+    do {                                                                    \
+        uint64_t uStatsStart = LFHFS_StatsStart();                          \
+        int iStatsErr = (Call);                                             \
+        LFHFS_StatsRecord( (eOp), uStatsStart, iStatsErr,                   \
+                           (iStatsErr == 0) ? (uint64_t)(uBytesOnSuccess) : 0 ); \
+        return iStatsErr;                                                   \
+    } while(0)
+
+static int
+FSOPS_StatsInit ( void )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_INIT, 0, LFHFS_Init() );
+}
+
+static void
+FSOPS_StatsFini ( void )
+{
+    uint64_t uStatsStart = LFHFS_StatsStart();
+    LFHFS_Fini();
+    LFHFS_StatsRecord( LFHFS_OP_FINI, uStatsStart, 0, 0 );
+}
+
+static int
+FSOPS_StatsTaste ( int iFd )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_TASTE, 0, LFHFS_Taste(iFd) );
+}
+
+static int
+FSOPS_StatsScanVols ( int iFd, UVFSScanVolsRequest *psRequest, UVFSScanVolsReply *psReply )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_SCANVOLS, 0, LFHFS_ScanVols(iFd, psRequest, psReply) );
+}
+
+static int
+FSOPS_StatsMount ( int iFd, UVFSVolumeId puVolId, UVFSMountFlags puMountFlags,
+    UVFSVolumeCredential *psVolumeCreds, UVFSFileNode *ppsRootNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_MOUNT, 0, LFHFS_Mount(iFd, puVolId, puMountFlags, psVolumeCreds, ppsRootNode) );
+}
+
+static int
+FSOPS_StatsSync ( UVFSFileNode psNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_SYNC, 0, LFHFS_Sync(psNode) );
+}
+
+static int
+FSOPS_StatsUnmount ( UVFSFileNode psRootNode, UVFSUnmountHint hint )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_UNMOUNT, 0, LFHFS_Unmount(psRootNode, hint) );
+}
+
+static int
+FSOPS_StatsGetFSAttr ( UVFSFileNode psNode, const char *pcAttr, UVFSFSAttributeValue *psAttrVal, size_t uLen, size_t *puRetLen )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_GETFSATTR, 0, LFHFS_GetFSAttr(psNode, pcAttr, psAttrVal, uLen, puRetLen) );
+}
+
+static int
+FSOPS_StatsSetFSAttr ( UVFSFileNode psNode, const char *pcAttr, const UVFSFSAttributeValue *psAttrVal, size_t uLen, UVFSFSAttributeValue *psOutAttrVal, size_t uOutLen )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_SETFSATTR, 0, LFHFS_SetFSAttr(psNode, pcAttr, psAttrVal, uLen, psOutAttrVal, uOutLen) );
+}
+
+static int
+FSOPS_StatsGetAttr ( UVFSFileNode psNode, UVFSFileAttributes *psOutAttr )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_GETATTR, 0, LFHFS_GetAttr(psNode, psOutAttr) );
+}
+
+static int
+FSOPS_StatsSetAttr ( UVFSFileNode psNode, const UVFSFileAttributes *psSetAttr, UVFSFileAttributes *psOutAttr )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_SETATTR, 0, LFHFS_SetAttr(psNode, psSetAttr, psOutAttr) );
+}
+
+static int
+FSOPS_StatsLookup ( UVFSFileNode psDirNode, const char *pcUTF8Name, UVFSFileNode *ppsOutNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_LOOKUP, 0, LFHFS_Lookup(psDirNode, pcUTF8Name, ppsOutNode) );
+}
+
+static int
+FSOPS_StatsReclaim ( UVFSFileNode psNode, int flags )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_RECLAIM, 0, LFHFS_Reclaim(psNode, flags) );
+}
+
+static int
+FSOPS_StatsReadLink ( UVFSFileNode psNode, void *pvOutBuf, size_t iBufSize, size_t *iActuallyRead, UVFSFileAttributes *psOutAttr )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_READLINK, *iActuallyRead, LFHFS_ReadLink(psNode, pvOutBuf, iBufSize, iActuallyRead, psOutAttr) );
+}
+
+static int
+FSOPS_StatsRead ( UVFSFileNode psNode, uint64_t uOffset, size_t iLength, void *pvBuf, size_t *iActuallyRead )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_READ, *iActuallyRead, LFHFS_Read(psNode, uOffset, iLength, pvBuf, iActuallyRead) );
+}
+
+static int
+FSOPS_StatsWrite ( UVFSFileNode psNode, uint64_t uOffset, size_t iLength, const void *pvBuf, size_t *iActuallyWrite )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_WRITE, *iActuallyWrite, LFHFS_Write(psNode, uOffset, iLength, pvBuf, iActuallyWrite) );
+}
+
+static int
+FSOPS_StatsCreate ( UVFSFileNode psNode, const char *pcName, const UVFSFileAttributes *psAttr, UVFSFileNode *ppsOutNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_CREATE, 0, LFHFS_Create(psNode, pcName, psAttr, ppsOutNode) );
+}
+
+static int
+FSOPS_StatsMkDir ( UVFSFileNode psDirNode, const char *pcName, const UVFSFileAttributes *psFileAttr, UVFSFileNode *ppsOutNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_MKDIR, 0, LFHFS_MkDir(psDirNode, pcName, psFileAttr, ppsOutNode) );
+}
+
+static int
+FSOPS_StatsSymLink ( UVFSFileNode psNode, const char *pcName, const char *psContent, const UVFSFileAttributes *psAttr, UVFSFileNode *ppsOutNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_SYMLINK, 0, LFHFS_SymLink(psNode, pcName, psContent, psAttr, ppsOutNode) );
+}
+
+static int
+FSOPS_StatsRemove ( UVFSFileNode psDirNode, const char *pcUTF8Name, UVFSFileNode victimNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_REMOVE, 0, LFHFS_Remove(psDirNode, pcUTF8Name, victimNode) );
+}
+
+static int
+FSOPS_StatsRmDir ( UVFSFileNode psDirNode, const char *pcUTF8Name, UVFSFileNode victimNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_RMDIR, 0, LFHFS_RmDir(psDirNode, pcUTF8Name, victimNode) );
+}
+
+static int
+FSOPS_StatsRename ( UVFSFileNode psFromDirNode, UVFSFileNode psFromNode, const char *pcFromName, UVFSFileNode psToDirNode, UVFSFileNode psToNode, const char *pcToName, uint32_t flags )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_RENAME, 0, LFHFS_Rename(psFromDirNode, psFromNode, pcFromName, psToDirNode, psToNode, pcToName, flags) );
+}
+
+static int
+FSOPS_StatsReadDir ( UVFSFileNode psDirNode, void* pvBuf, size_t iBufLen, uint64_t uCookie, size_t *iReadBytes, uint64_t *puVerifier )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_READDIR, *iReadBytes, LFHFS_ReadDir(psDirNode, pvBuf, iBufLen, uCookie, iReadBytes, puVerifier) );
+}
+
+static int
+FSOPS_StatsReadDirAttr ( UVFSFileNode psDirNode, void *pvBuf, size_t iBufLen, uint64_t uCookie, size_t *iReadBytes, uint64_t *puVerifier )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_READDIRATTR, *iReadBytes, LFHFS_ReadDirAttr(psDirNode, pvBuf, iBufLen, uCookie, iReadBytes, puVerifier) );
+}
+
+static int
+FSOPS_StatsLink ( UVFSFileNode psFromNode, UVFSFileNode psToDirNode, const char *pcToName, UVFSFileAttributes* psOutFileAttrs, UVFSFileAttributes* psOutDirAttrs )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_LINK, 0, LFHFS_Link(psFromNode, psToDirNode, pcToName, psOutFileAttrs, psOutDirAttrs) );
+}
+
+static int
+FSOPS_StatsCheck ( int fdToCheck, UVFSVolumeId volId, UVFSVolumeCredential *volumeCreds, check_flags_t how )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_CHECK, 0, LFHFS_Check(fdToCheck, volId, volumeCreds, how) );
+}
+
+static int
+FSOPS_StatsGetXAttr ( UVFSFileNode psNode, const char *pcAttr, void *pvOutBuf, size_t iBufSize, size_t *iActualSize )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_GETXATTR, (pvOutBuf != NULL) ? *iActualSize : 0, LFHFS_GetXAttr(psNode, pcAttr, pvOutBuf, iBufSize, iActualSize) );
+}
+
+static int
+FSOPS_StatsSetXAttr ( UVFSFileNode psNode, const char *pcAttr, const void *pvInBuf, size_t iBufSize, UVFSXattrHow How )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_SETXATTR, (How != UVFSXattrHowRemove) ? iBufSize : 0, LFHFS_SetXAttr(psNode, pcAttr, pvInBuf, iBufSize, How) );
+}
+
+static int
+FSOPS_StatsListXAttr ( UVFSFileNode psNode, void *pvOutBuf, size_t iBufSize, size_t *iActualSize )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_LISTXATTR, (pvOutBuf != NULL) ? *iActualSize : 0, LFHFS_ListXAttr(psNode, pvOutBuf, iBufSize, iActualSize) );
+}
+
+static int
+FSOPS_StatsScanDir ( UVFSFileNode psDirNode, scandir_matching_request_t* psMatchingCriteria, scandir_matching_reply_t* psMatchingResult )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_SCANDIR, 0, LFHFS_ScanDir(psDirNode, psMatchingCriteria, psMatchingResult) );
+}
+
+static int
+FSOPS_StatsScanIDs ( UVFSFileNode psNode, uint64_t uRequestedAttributes, const uint64_t* puFileIDArray, unsigned int iFileIDCount, scanids_match_block_t fMatchCallback )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_SCANIDS, 0, LFHFS_ScanIDs(psNode, uRequestedAttributes, puFileIDArray, iFileIDCount, fMatchCallback) );
+}
+
+static int
+FSOPS_StatsStreamLookup ( UVFSFileNode psFileNode, UVFSStreamNode *ppsOutNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_STREAM_LOOKUP, 0, LFHFS_StreamLookup(psFileNode, ppsOutNode) );
+}
+
+static int
+FSOPS_StatsStreamReclaim ( UVFSStreamNode psStreamNode )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_STREAM_RECLAIM, 0, LFHFS_StreamReclaim(psStreamNode) );
+}
+
+static int
+FSOPS_StatsStreamRead ( UVFSStreamNode psStreamNode, uint64_t uOffset, size_t iLength, void *pvBuf, size_t *iActuallyRead )
+{
+    FSOPS_STATS_CALL( LFHFS_OP_STREAM_READ, *iActuallyRead, LFHFS_StreamRead(psStreamNode, uOffset, iLength, pvBuf, iActuallyRead) );
+}
+
 UVFSFSOps HFS_fsOps = {
     .fsops_version      = UVFS_FSOPS_VERSION_CURRENT,
 
-    .fsops_init         = LFHFS_Init,
-    .fsops_fini         = LFHFS_Fini,
-
-    .fsops_taste        = LFHFS_Taste,
-    .fsops_scanvols     = LFHFS_ScanVols,
-    .fsops_mount        = LFHFS_Mount,
-    .fsops_sync         = LFHFS_Sync,
-    .fsops_unmount      = LFHFS_Unmount,
-
-    .fsops_getfsattr    = LFHFS_GetFSAttr,
-    .fsops_setfsattr    = LFHFS_SetFSAttr,
-
-    .fsops_getattr      = LFHFS_GetAttr,
-    .fsops_setattr      = LFHFS_SetAttr,
-    .fsops_lookup       = LFHFS_Lookup,
-    .fsops_reclaim      = LFHFS_Reclaim,
-    .fsops_readlink     = LFHFS_ReadLink,
-    .fsops_read         = LFHFS_Read,
-    .fsops_write        = LFHFS_Write,
-    .fsops_create       = LFHFS_Create,
-    .fsops_mkdir        = LFHFS_MkDir,
-    .fsops_symlink      = LFHFS_SymLink,
-    .fsops_remove       = LFHFS_Remove,
-    .fsops_rmdir        = LFHFS_RmDir,
-    .fsops_rename       = LFHFS_Rename,
-    .fsops_readdir      = LFHFS_ReadDir,
-    .fsops_readdirattr  = LFHFS_ReadDirAttr,
-    .fsops_link         = LFHFS_Link,
-    .fsops_check        = LFHFS_Check,
-
-    .fsops_getxattr     = LFHFS_GetXAttr,
-    .fsops_setxattr     = LFHFS_SetXAttr,
-    .fsops_listxattr    = LFHFS_ListXAttr,
-
-    .fsops_scandir      = LFHFS_ScanDir,
-    .fsops_scanids      = LFHFS_ScanIDs,
+    .fsops_init         = FSOPS_StatsInit,
+    .fsops_fini         = FSOPS_StatsFini,
+
+    .fsops_taste        = FSOPS_StatsTaste,
+    .fsops_scanvols     = FSOPS_StatsScanVols,
+    .fsops_mount        = FSOPS_StatsMount,
+    .fsops_sync         = FSOPS_StatsSync,
+    .fsops_unmount      = FSOPS_StatsUnmount,
+
+    .fsops_getfsattr    = FSOPS_StatsGetFSAttr,
+    .fsops_setfsattr    = FSOPS_StatsSetFSAttr,
+
+    .fsops_getattr      = FSOPS_StatsGetAttr,
+    .fsops_setattr      = FSOPS_StatsSetAttr,
+    .fsops_lookup       = FSOPS_StatsLookup,
+    .fsops_reclaim      = FSOPS_StatsReclaim,
+    .fsops_readlink     = FSOPS_StatsReadLink,
+    .fsops_read         = FSOPS_StatsRead,
+    .fsops_write        = FSOPS_StatsWrite,
+    .fsops_create       = FSOPS_StatsCreate,
+    .fsops_mkdir        = FSOPS_StatsMkDir,
+    .fsops_symlink      = FSOPS_StatsSymLink,
+    .fsops_remove       = FSOPS_StatsRemove,
+    .fsops_rmdir        = FSOPS_StatsRmDir,
+    .fsops_rename       = FSOPS_StatsRename,
+    .fsops_readdir      = FSOPS_StatsReadDir,
+    .fsops_readdirattr  = FSOPS_StatsReadDirAttr,
+    .fsops_link         = FSOPS_StatsLink,
+    .fsops_check        = FSOPS_StatsCheck,
+
+    .fsops_getxattr     = FSOPS_StatsGetXAttr,
+    .fsops_setxattr     = FSOPS_StatsSetXAttr,
+    .fsops_listxattr    = FSOPS_StatsListXAttr,
+
+    .fsops_scandir      = FSOPS_StatsScanDir,
+    .fsops_scanids      = FSOPS_StatsScanIDs,
     
-    .fsops_stream_lookup = LFHFS_StreamLookup,
-    .fsops_stream_reclaim = LFHFS_StreamReclaim,
-    .fsops_stream_read = LFHFS_StreamRead,
+    .fsops_stream_lookup = FSOPS_StatsStreamLookup,
+    .fsops_stream_reclaim = FSOPS_StatsStreamReclaim,
+    .fsops_stream_read = FSOPS_StatsStreamRead,
 };
 
 #if HFS_CRASH_TEST
@@ -17,6 +17,9 @@
 uint64_t FSOPS_GetOffsetFromClusterNum(vnode_t vp, uint64_t uClusterNum);
 int      LFHFS_Mount   (int iFd, UVFSVolumeId puVolId, __unused UVFSMountFlags puMountFlags,
 	__unused UVFSVolumeCredential *psVolumeCreds, UVFSFileNode *ppsRootNode);
+// Mount a volume whose journal lives on another device (or image file) iJournalFd.
+// Both descriptors stay owned by the caller and must stay open until unmount.
+int      LFHFS_MountWithJournal (int iFd, int iJournalFd, UVFSMountFlags puMountFlags, UVFSFileNode *ppsRootNode);
 int      LFHFS_Unmount (UVFSFileNode psRootNode, UVFSUnmountHint hint);
 int      LFHFS_ScanVols (int iFd, UVFSScanVolsRequest *psRequest, UVFSScanVolsReply *psReply );
 int      LFHFS_Taste ( int iFd );
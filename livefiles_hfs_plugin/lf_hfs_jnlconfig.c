@@ -0,0 +1,594 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_jnlconfig.c
+ *  livefiles_hfs
+ *
+ *  Offline journal configuration: enable or disable journaling, and
+ *  resize or relocate the journal file of a mounted volume.
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+#include "lf_hfs.h"
+#include "lf_hfs_jnlconfig.h"
+#include "lf_hfs_cnode.h"
+#include "lf_hfs_vnode.h"
+#include "lf_hfs_vnops.h"
+#include "lf_hfs_vfsops.h"
+#include "lf_hfs_vfsutils.h"
+#include "lf_hfs_journal.h"
+#include "lf_hfs_logger.h"
+#include "lf_hfs_btrees_internal.h"
+#include "lf_hfs_file_mgr_internal.h"
+#include "lf_hfs_file_extent_mapping.h"
+#include "lf_hfs_raw_read_write.h"
+#include "lf_hfs_fileops_handler.h"
+#include "lf_hfs_dirops_handler.h"
+
+static const char* gpcJournalName  = ".journal";
+static const char* gpcJIBName      = ".journal_info_block";
+
+static uint64_t
+JnlConfig_DefaultSize( struct hfsmount* hfsmp )
+{
+    uint64_t uScale = ((uint64_t)hfsmp->blockSize * hfsmp->totalBlocks) / LFHFS_JNL_DEFAULT_SCALE;
+    uint64_t uSize  = LFHFS_JNL_DEFAULT_SIZE * (uScale + 1);
+
+    return MIN( uSize, LFHFS_JNL_DEFAULT_MAX_SIZE );
+}
+
+/*
+ * Read or write the allocation block holding the JournalInfoBlock.
+ * pvBuf must be hfsmp->blockSize bytes long.
+ */
+static int
+JnlConfig_ReadJIB( struct hfsmount* hfsmp, uint32_t uJIBBlock, void* pvBuf )
+{
+    uint32_t uSectorSize = hfsmp->hfs_logical_block_size;
+    uint64_t uSector     = (hfsmp->hfsPlusIOPosOffset + (uint64_t)uJIBBlock * hfsmp->blockSize) / uSectorSize;
+
+    return raw_readwrite_read_mount( hfsmp->hfs_devvp, uSector, uSectorSize, pvBuf, hfsmp->blockSize, NULL, NULL );
+}
+
+static int
+JnlConfig_WriteJIB( struct hfsmount* hfsmp, uint32_t uJIBBlock, uint32_t uFlags, uint64_t uOffset, uint64_t uSize )
+{
+    uint32_t uSectorSize = hfsmp->hfs_logical_block_size;
+    uint64_t uSector     = (hfsmp->hfsPlusIOPosOffset + (uint64_t)uJIBBlock * hfsmp->blockSize) / uSectorSize;
+
+    void* pvBuf = hfs_mallocz( hfsmp->blockSize );
+    if ( pvBuf == NULL )
+    {
+        return ENOMEM;
+    }
+
+    /* Initialize the JIB just like hfs_util and the kernel do. */
+    JournalInfoBlock* psJIB = pvBuf;
+    memset( psJIB, 'Z', sizeof(*psJIB) );
+    psJIB->flags  = SWAP_BE32( uFlags );
+    psJIB->offset = SWAP_BE64( uOffset );
+    psJIB->size   = SWAP_BE64( uSize );
+
+    int iErr = raw_readwrite_write_mount( hfsmp->hfs_devvp, uSector, uSectorSize, pvBuf, hfsmp->blockSize, NULL, NULL );
+    hfs_free( pvBuf );
+
+    if ( iErr == 0 )
+    {
+        iErr = hfs_flush( hfsmp, HFS_FLUSH_CACHE );
+    }
+
+    return iErr;
+}
+
+/*
+ * Give the fork of vp a single contiguous run of uSize bytes.
+ *
+ * As in hfs_relocate, the new run is allocated past the current blocks
+ * with an all-or-nothing contiguous allocation, and the old blocks are
+ * then head truncated away. A failed allocation leaves the fork as it was.
+ */
+static int
+JnlConfig_AllocateContig( struct vnode* vp, uint64_t uSize, uint32_t uBlockHint )
+{
+    struct cnode*       cp          = VTOC(vp);
+    struct filefork*    fp          = VTOF(vp);
+    struct hfsmount*    hfsmp       = VTOHFS(vp);
+    u_int32_t           headblks;
+    u_int32_t           nextallocsave;
+    int64_t             newbytes    = 0;
+    int                 eflags      = kEFContigMask | kEFAllMask | kEFNoClumpMask;
+    int                 lockflags;
+    int                 retval;
+
+    hfs_lock_truncate(cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT);
+    if ((retval = hfs_lock(cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT))) {
+        hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+        return (retval);
+    }
+
+    headblks = fp->ff_blocks;
+    if (uBlockHint == 0)
+        uBlockHint = hfsmp->nextAllocation;
+    if ((hfsmp->hfs_flags & HFS_METADATA_ZONE) &&
+        uBlockHint >= hfsmp->hfs_metazone_start &&
+        uBlockHint <= hfsmp->hfs_metazone_end)
+        eflags |= kEFMetadataMask;
+
+    if ((retval = hfs_start_transaction(hfsmp)) != 0)
+        goto out;
+
+    lockflags = hfs_systemfile_lock(hfsmp, SFL_BITMAP | SFL_EXTENTS, HFS_EXCLUSIVE_LOCK);
+
+    nextallocsave = hfsmp->nextAllocation;
+    retval = MacToVFSError(ExtendFileC(hfsmp, (FCB *)fp, (off_t)uSize, uBlockHint, eflags, &newbytes));
+    if (eflags & kEFMetadataMask) {
+        hfs_lock_mount(hfsmp);
+        HFS_UPDATE_NEXT_ALLOCATION(hfsmp, nextallocsave);
+        MarkVCBDirty(hfsmp);
+        hfs_unlock_mount(hfsmp);
+    }
+
+    if (retval == 0 && (newbytes < (int64_t)uSize ||
+                        fp->ff_blocks != headblks + (u_int32_t)(uSize / hfsmp->blockSize))) {
+        /* Give back whatever was allocated. */
+        (void) TruncateFileC(hfsmp, (FCB *)fp, (off_t)headblks * hfsmp->blockSize, 0,
+                             FORK_IS_RSRC(fp), cp->c_fileid, false);
+        retval = ENOSPC;
+    }
+
+    if (retval == 0 && headblks != 0) {
+        retval = MacToVFSError(HeadTruncateFile(hfsmp, (FCB *)fp, headblks));
+    }
+
+    if (retval == 0) {
+        fp->ff_size = uSize;
+        cp->c_flag |= C_MODIFIED;
+    }
+
+    hfs_systemfile_unlock(hfsmp, lockflags);
+
+    if (retval == 0) {
+        retval = hfs_update(vp, 0);
+    }
+    hfs_end_transaction(hfsmp);
+
+out:
+    hfs_unlock(cp);
+    hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+
+    return (retval);
+}
+
+/*
+ * Create one of the journal files in the root folder, hidden and with no
+ * permissions, as hfs_util does.
+ */
+static int
+JnlConfig_CreateFile( struct vnode* psRootVnode, const char* pcName, struct vnode** ppsVnode )
+{
+    UVFSFileAttributes sAttr = {0};
+    sAttr.fa_validmask  = UVFS_FA_VALID_MODE;
+    sAttr.fa_type       = UVFS_FA_TYPE_FILE;
+    sAttr.fa_mode       = 0;
+
+    int iErr = LFHFS_Create( psRootVnode, pcName, &sAttr, (UVFSFileNode*) ppsVnode );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    UVFSFileAttributes sHide = {0};
+    sHide.fa_validmask  = UVFS_FA_VALID_BSD_FLAGS;
+    sHide.fa_bsd_flags  = UF_HIDDEN;
+
+    iErr = hfs_vnop_setattr( *ppsVnode, &sHide );
+    if ( iErr )
+    {
+        LFHFS_Reclaim( *ppsVnode, 0 );
+        *ppsVnode = NULL;
+        DIROPS_RemoveInternal( psRootVnode, pcName );
+    }
+
+    return iErr;
+}
+
+/*
+ * Flush and close the journal. The volume stays marked journaled, but
+ * the header is rewritten with a non-journaled lastMountedVersion, so a
+ * mount after a crash goes through hfs_late_journal_init rather than
+ * replaying the old journal. Until the journal is created again,
+ * metadata is written in place.
+ */
+static int
+JnlConfig_Close( struct hfsmount* hfsmp )
+{
+    int iErr = hfs_flush( hfsmp, HFS_FLUSH_FULL );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    hfs_lock_global( hfsmp, HFS_EXCLUSIVE_LOCK );
+    journal_close( hfsmp->jnl );
+    hfsmp->jnl = NULL;
+    hfs_unlock_global( hfsmp );
+
+    // Must reach the disk before the .journal blocks are touched.
+    return hfs_flushvolumeheader( hfsmp, 0 );
+}
+
+/*
+ * Point the JournalInfoBlock at the journal file, create a fresh journal
+ * there and mark the volume journaled. This mirrors the kernel's
+ * HFS_ENABLE_JOURNALING sysctl.
+ */
+static int
+JnlConfig_Open( struct hfsmount* hfsmp, uint32_t uJIBBlock, uint32_t uStartBlock, uint64_t uSize, cnid_t uJIBFileID, cnid_t uJnlFileID )
+{
+    uint64_t uJIBOffset = (uint64_t)uStartBlock * hfsmp->blockSize;
+    uint64_t uJnlOffset = uJIBOffset + hfsmp->hfsPlusIOPosOffset;
+
+    int iErr = JnlConfig_WriteJIB( hfsmp, uJIBBlock, kJIJournalInFSMask, uJIBOffset, uSize );
+    if ( iErr )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "JnlConfig_Open: writing the journal info block failed (%d)\n", iErr );
+        return iErr;
+    }
+
+    LFHFS_LOG( LEVEL_DEFAULT, "hfs: Initializing the journal (joffset 0x%llx sz 0x%llx)...\n", uJnlOffset, uSize );
+
+    journal* jnl = journal_create( hfsmp->hfs_devvp,
+                                   uJnlOffset,
+                                   uSize,
+                                   hfsmp->hfs_devvp,
+                                   hfsmp->hfs_logical_block_size,
+                                   0,
+                                   0,
+                                   NULL,
+                                   hfsmp->hfs_mp,
+                                   hfsmp->hfs_mp );
+    if ( jnl == NULL )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "JnlConfig_Open: FAILED to create the journal!\n" );
+        return EIO;
+    }
+
+    hfs_lock_global( hfsmp, HFS_EXCLUSIVE_LOCK );
+
+    hfsmp->vcbJinfoBlock     = uJIBBlock;
+    hfsmp->vcbAtrb          |= kHFSVolumeJournaledMask;
+    hfsmp->jvp               = hfsmp->hfs_devvp;
+    hfsmp->jnl               = jnl;
+
+    // save this off for the hack-y check in hfs_remove()
+    hfsmp->jnl_start         = uStartBlock;
+    hfsmp->jnl_size          = uSize;
+    hfsmp->hfs_jnlinfoblkid  = uJIBFileID;
+    hfsmp->hfs_jnlfileid     = uJnlFileID;
+    hfsmp->hfs_mp->mnt_flag |= MNT_JOURNALED;
+
+    hfs_unlock_global( hfsmp );
+
+    return hfs_flushvolumeheader( hfsmp, HFS_FVH_WRITE_ALT );
+}
+
+int
+LFHFS_GetJournalInfo( UVFSFileNode psRootNode, LFHFSJournalInfo_S* psInfo )
+{
+    struct hfsmount* hfsmp = VTOHFS( (vnode_t) psRootNode );
+    struct cat_attr sAttr;
+    struct cat_fork sFork;
+    int iErr = 0;
+
+    memset( psInfo, 0, sizeof(*psInfo) );
+
+    psInfo->bJournaled = (hfsmp->vcbAtrb & kHFSVolumeJournaledMask) != 0;
+    if ( !psInfo->bJournaled )
+    {
+        return 0;
+    }
+
+    psInfo->uInfoBlock = hfsmp->vcbJinfoBlock;
+
+    void* pvBuf = hfs_malloc( hfsmp->blockSize );
+    if ( pvBuf == NULL )
+    {
+        return ENOMEM;
+    }
+
+    iErr = JnlConfig_ReadJIB( hfsmp, psInfo->uInfoBlock, pvBuf );
+    if ( iErr == 0 )
+    {
+        JournalInfoBlock* psJIB = pvBuf;
+        psInfo->uFlags  = SWAP_BE32( psJIB->flags );
+        psInfo->uOffset = SWAP_BE64( psJIB->offset );
+        psInfo->uSize   = SWAP_BE64( psJIB->size );
+    }
+    hfs_free( pvBuf );
+
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    psInfo->bExternal = (psInfo->uFlags & kJIJournalOnOtherDeviceMask) != 0;
+
+    if ( GetFileInfo( hfsmp, gpcJournalName, &sAttr, &sFork ) != 0 )
+    {
+        psInfo->uStartBlock = sFork.cf_extents[0].startBlock;
+        psInfo->bContiguous = (sFork.cf_extents[0].blockCount == sFork.cf_blocks);
+    }
+
+    return 0;
+}
+
+void
+LFHFS_JournalInfoDump( const LFHFSJournalInfo_S* psInfo, FILE* psFile )
+{
+    if ( !psInfo->bJournaled )
+    {
+        fprintf( psFile, "Not journaled\n" );
+        return;
+    }
+
+    if ( psInfo->bExternal )
+    {
+        fprintf( psFile, "Journal size %llu k on another device, info block %u\n",
+                 psInfo->uSize / 1024, psInfo->uInfoBlock );
+        return;
+    }
+
+    fprintf( psFile, "Journal size %llu k at offset 0x%llx (block %u, %s), info block %u, flags 0x%x\n",
+             psInfo->uSize / 1024, psInfo->uOffset, psInfo->uStartBlock,
+             psInfo->bContiguous ? "contiguous" : "fragmented",
+             psInfo->uInfoBlock, psInfo->uFlags );
+}
+
+/*
+ * Enable journaling: create .journal_info_block and .journal in the root
+ * folder, each a single contiguous run, and start a new journal in them.
+ * This does what hfs_util's DoMakeJournaled and the HFS_ENABLE_JOURNALING
+ * sysctl do together, without needing the volume mounted by the kernel.
+ */
+int
+LFHFS_MakeJournaled( UVFSFileNode psRootNode, uint64_t uJournalSize, uint32_t uStartBlock )
+{
+    struct vnode*    psRootVnode = (struct vnode*) psRootNode;
+    struct hfsmount* hfsmp       = VTOHFS( psRootVnode );
+    struct vnode*    psJIBVnode  = NULL;
+    struct vnode*    psJnlVnode  = NULL;
+    int iErr = 0;
+
+    if ( hfsmp->hfs_flags & HFS_READ_ONLY )
+    {
+        return EROFS;
+    }
+
+    if ( hfsmp->jnl )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_MakeJournaled: volume %s is already journaled!\n", hfsmp->vcbVN );
+        return EAGAIN;
+    }
+
+    if ( uJournalSize == 0 )
+    {
+        uJournalSize = JnlConfig_DefaultSize( hfsmp );
+    }
+    if ( (uJournalSize % hfsmp->blockSize) != 0 )
+    {
+        return EINVAL;
+    }
+
+    int lockflags = hfs_systemfile_lock( hfsmp, SFL_CATALOG | SFL_EXTENTS, HFS_EXCLUSIVE_LOCK );
+    bool bContigBTrees = BTHasContiguousNodes( VTOF(hfsmp->hfs_catalog_vp) ) &&
+                         BTHasContiguousNodes( VTOF(hfsmp->hfs_extents_vp) );
+    hfs_systemfile_unlock( hfsmp, lockflags );
+    if ( !bContigBTrees )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_MakeJournaled: volume has a btree w/non-contiguous nodes.  can not enable journaling.\n" );
+        return EINVAL;
+    }
+
+    iErr = JnlConfig_CreateFile( psRootVnode, gpcJIBName, &psJIBVnode );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    iErr = JnlConfig_CreateFile( psRootVnode, gpcJournalName, &psJnlVnode );
+    if ( iErr )
+    {
+        goto remove_jib;
+    }
+
+    iErr = JnlConfig_AllocateContig( psJIBVnode, hfsmp->blockSize, 0 );
+    if ( iErr == 0 )
+    {
+        iErr = JnlConfig_AllocateContig( psJnlVnode, uJournalSize, uStartBlock );
+    }
+    if ( iErr )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_MakeJournaled: not enough contiguous space for a %llu k journal (%d)\n", uJournalSize / 1024, iErr );
+        goto remove_jnl;
+    }
+
+    // Everything written so far went straight to disk.
+    iErr = hfs_flush( hfsmp, HFS_FLUSH_CACHE );
+    if ( iErr == 0 )
+    {
+        iErr = JnlConfig_Open( hfsmp,
+                               VTOF(psJIBVnode)->ff_extents[0].startBlock,
+                               VTOF(psJnlVnode)->ff_extents[0].startBlock,
+                               uJournalSize,
+                               VTOC(psJIBVnode)->c_fileid,
+                               VTOC(psJnlVnode)->c_fileid );
+    }
+    if ( iErr )
+    {
+        goto remove_jnl;
+    }
+
+    LFHFS_Reclaim( psJnlVnode, 0 );
+    LFHFS_Reclaim( psJIBVnode, 0 );
+    return 0;
+
+remove_jnl:
+    LFHFS_Reclaim( psJnlVnode, 0 );
+    DIROPS_RemoveInternal( psRootVnode, gpcJournalName );
+remove_jib:
+    LFHFS_Reclaim( psJIBVnode, 0 );
+    DIROPS_RemoveInternal( psRootVnode, gpcJIBName );
+    return iErr;
+}
+
+/*
+ * Resize the journal and move it into one contiguous run, starting near
+ * uStartBlock when given. The journal is flushed and closed, the .journal
+ * fork is reallocated, and a new, empty journal is created in it.
+ *
+ * Nothing is journaled while the journal is closed. JnlConfig_Close
+ * writes a non-journaled lastMountedVersion first, so if we crash in that
+ * window the next mount takes hfs_late_journal_init, which recreates the
+ * journal wherever .journal now lives instead of replaying the old one.
+ */
+int
+LFHFS_ResizeJournal( UVFSFileNode psRootNode, uint64_t uJournalSize, uint32_t uStartBlock )
+{
+    struct hfsmount* hfsmp = VTOHFS( (vnode_t) psRootNode );
+    struct vnode* vp = NULL;
+    int iErr = 0;
+
+    if ( hfsmp->hfs_flags & HFS_READ_ONLY )
+    {
+        return EROFS;
+    }
+    if ( hfsmp->jnl == NULL )
+    {
+        return EINVAL;
+    }
+    if ( hfsmp->jvp != hfsmp->hfs_devvp )
+    {
+        // The journal is on another device, there is no .journal to move.
+        return ENOTSUP;
+    }
+
+    if ( uJournalSize == 0 )
+    {
+        uJournalSize = JnlConfig_DefaultSize( hfsmp );
+    }
+    if ( (uJournalSize % hfsmp->blockSize) != 0 )
+    {
+        return EINVAL;
+    }
+
+    uint32_t uJIBBlock  = hfsmp->vcbJinfoBlock;
+    cnid_t   uJIBFileID = (cnid_t) hfsmp->hfs_jnlinfoblkid;
+    cnid_t   uJnlFileID = (cnid_t) hfsmp->hfs_jnlfileid;
+
+    iErr = hfs_vget( hfsmp, uJnlFileID, &vp, 1, 0 );
+    if ( iErr || vp == NULL )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_ResizeJournal: hfs_vget %u failed (%d)\n", uJnlFileID, iErr );
+        hfs_vnop_reclaim( vp );
+        return iErr ? iErr : ENOENT;
+    }
+
+    iErr = JnlConfig_Close( hfsmp );
+    if ( iErr && hfsmp->jnl != NULL )
+    {
+        hfs_vnop_reclaim( vp );
+        return iErr;
+    }
+
+    // If the header could not be written after the journal was closed,
+    // leave .journal where it is and only start the journal over.
+    if ( iErr )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_ResizeJournal: writing the volume header failed (%d), keeping the old journal\n", iErr );
+    }
+    else if ( (iErr = JnlConfig_AllocateContig( vp, uJournalSize, uStartBlock )) != 0 )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_ResizeJournal: can't allocate a contiguous %llu k journal (%d), keeping the old one\n", uJournalSize / 1024, iErr );
+    }
+
+    // Whether or not the fork moved, start the journal over where it is now.
+    struct filefork* fp = VTOF(vp);
+    int iOpenErr = JnlConfig_Open( hfsmp, uJIBBlock,
+                                   fp->ff_extents[0].startBlock,
+                                   (uint64_t)fp->ff_extents[0].blockCount * hfsmp->blockSize,
+                                   uJIBFileID, uJnlFileID );
+    if ( iErr == 0 )
+    {
+        iErr = iOpenErr;
+    }
+
+    hfs_vnop_reclaim( vp );
+    return iErr;
+}
+
+/*
+ * Disable journaling and remove the journal files, as hfs_util's
+ * DoUnJournal and the HFS_DISABLE_JOURNALING sysctl do.
+ */
+int
+LFHFS_UnJournal( UVFSFileNode psRootNode )
+{
+    struct vnode*    psRootVnode = (struct vnode*) psRootNode;
+    struct hfsmount* hfsmp       = VTOHFS( psRootVnode );
+    int iErr = 0;
+
+    if ( hfsmp->hfs_flags & HFS_READ_ONLY )
+    {
+        return EROFS;
+    }
+    if ( hfsmp->jnl == NULL )
+    {
+        return EINVAL;
+    }
+
+    /*
+     * Disabling journaling is disallowed on volumes with directory hard links
+     * because we have not tested the relevant code path.
+     */
+    if ( hfsmp->hfs_private_attr[DIR_HARDLINKS].ca_entries != 0 )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "hfs: cannot disable journaling on volumes with directory hardlinks\n" );
+        return EPERM;
+    }
+
+    LFHFS_LOG( LEVEL_DEFAULT, "hfs: disabling journaling for %s\n", hfsmp->vcbVN );
+
+    iErr = JnlConfig_Close( hfsmp );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    hfs_lock_global( hfsmp, HFS_EXCLUSIVE_LOCK );
+
+    hfsmp->jvp               = NULL;
+    hfsmp->jnl_start         = 0;
+    hfsmp->hfs_jnlinfoblkid  = 0;
+    hfsmp->hfs_jnlfileid     = 0;
+    hfsmp->vcbAtrb          &= ~kHFSVolumeJournaledMask;
+    hfsmp->hfs_mp->mnt_flag &= ~(u_int64_t)((unsigned int)MNT_JOURNALED);
+
+    hfs_unlock_global( hfsmp );
+
+    iErr = hfs_flushvolumeheader( hfsmp, HFS_FVH_WRITE_ALT );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    if ( DIROPS_RemoveInternal( psRootVnode, gpcJournalName ) != 0 )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_UnJournal: failed to remove the journal %s\n", gpcJournalName );
+    }
+    if ( DIROPS_RemoveInternal( psRootVnode, gpcJIBName ) != 0 )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_UnJournal: failed to remove the journal info block %s\n", gpcJIBName );
+    }
+
+    return 0;
+}
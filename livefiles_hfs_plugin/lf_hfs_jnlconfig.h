@@ -0,0 +1,45 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_jnlconfig.h
+ *  livefiles_hfs
+ *
+ *  Offline journal configuration: enable or disable journaling, and
+ *  resize or relocate the journal file of a mounted volume.
+ */
+
+#ifndef lf_hfs_jnlconfig_h
+#define lf_hfs_jnlconfig_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <UserFS/UserVFS.h>
+
+// Default journal size, as in hfs_util: 8MB for each 100GB of volume
+// size, capped at 512MB.
+#define LFHFS_JNL_DEFAULT_SIZE          (8 * 1024 * 1024)
+#define LFHFS_JNL_DEFAULT_SCALE         (100ULL * 1024 * 1024 * 1024)
+#define LFHFS_JNL_DEFAULT_MAX_SIZE      (512 * 1024 * 1024)
+
+typedef struct
+{
+    bool        bJournaled;
+    bool        bExternal;                      // Journal lives on another device
+    bool        bContiguous;                    // .journal is a single extent
+    uint32_t    uInfoBlock;                     // Allocation block of the JournalInfoBlock
+    uint32_t    uFlags;                         // JournalInfoBlock flags
+    uint64_t    uOffset;                        // In bytes, from the start of the HFS+ volume
+    uint64_t    uSize;
+    uint32_t    uStartBlock;                    // First allocation block of .journal
+} LFHFSJournalInfo_S;
+
+int     LFHFS_GetJournalInfo( UVFSFileNode psRootNode, LFHFSJournalInfo_S* psInfo );
+void    LFHFS_JournalInfoDump( const LFHFSJournalInfo_S* psInfo, FILE* psFile );
+
+// uJournalSize 0 picks the default size. uStartBlock is an allocation
+// hint for the journal file, 0 lets the allocator choose.
+int     LFHFS_MakeJournaled( UVFSFileNode psRootNode, uint64_t uJournalSize, uint32_t uStartBlock );
+int     LFHFS_ResizeJournal( UVFSFileNode psRootNode, uint64_t uJournalSize, uint32_t uStartBlock );
+int     LFHFS_UnJournal( UVFSFileNode psRootNode );
+
+#endif /* lf_hfs_jnlconfig_h */
@@ -57,6 +57,7 @@
 #include "lf_hfs_generic_buf.h"
 #include "lf_hfs_logger.h"
 #include "lf_hfs_vfsops.h"
+#include "lf_hfs_trace.h"
 
 // ************************** Function Definitions ***********************
 // number of bytes to checksum in a block_list_header
@@ -169,6 +170,9 @@ static void   unlock_condition(journal *jnl, ConditionalFlag_S *psCondFlag);
 static int    write_journal_header(journal *jnl, int updating_start, uint32_t sequence_num);
 static size_t read_journal_data(journal *jnl, off_t *offset, void *data, size_t len);
 static size_t write_journal_data(journal *jnl, off_t *offset, void *data, size_t len);
+static jnl_tr_slot *tr_hash_lookup(transaction *tr, GenericLFBuf *bp);
+static void   tr_hash_insert(transaction *tr, GenericLFBuf *bp, block_list_header *blhdr, int index);
+static void   tr_hash_free(transaction *tr);
         
 
 static __inline__ void lock_oldstart(journal *jnl) {
@@ -180,7 +184,9 @@ static __inline__ void unlock_oldstart(journal *jnl) {
 }
     
 __inline__ void journal_lock(journal *jnl) {
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_LOCK_WAIT | DBG_FUNC_START, jnl, 0, 0, 0, 0);
     lf_lck_mtx_lock(&jnl->jlock);
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_LOCK_WAIT | DBG_FUNC_END, jnl, 0, 0, 0, 0);
     if (jnl->owner) {
         panic ("jnl: owner is %p, expected NULL\n", jnl->owner);
     }
@@ -855,6 +861,8 @@ int journal_start_transaction(journal *jnl) {
         return 0;
     }
     
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_START_TR | DBG_FUNC_START, jnl, jnl->nested_count, 0, 0, 0);
+
     journal_lock(jnl);
     
     if (jnl->nested_count != 0 || jnl->active_tr != NULL) {
@@ -869,6 +877,7 @@ int journal_start_transaction(journal *jnl) {
         jnl->active_tr = jnl->cur_tr;
         jnl->cur_tr    = NULL;
         
+        LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_START_TR | DBG_FUNC_END, 0, jnl->nested_count, 0, 0, 0);
         return 0;
     }
     
@@ -879,12 +888,14 @@ int journal_start_transaction(journal *jnl) {
     
     // printf("jnl: start_tr: owner 0x%x new tr @ 0x%x\n", jnl->owner, jnl->active_tr);
     
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_START_TR | DBG_FUNC_END, 0, jnl->nested_count, 0, 0, 0);
     return 0;
     
 bad_start:
     jnl->nested_count = 0;
     journal_unlock(jnl);
     
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_START_TR | DBG_FUNC_END, ret, 0, 0, 0, 0);
     return ret;
 }
 // journal_end_transaction
@@ -944,6 +955,8 @@ int journal_end_transaction(journal *jnl) {
     // called from end_transaction().
     jnl->active_tr = NULL;
     
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_END_TR | DBG_FUNC_START, jnl, tr->total_bytes, tr->num_blhdrs, tr->flush_on_completion, 0);
+
     /* Examine the force-journal-flush state in the active txn */
     if (tr->flush_on_completion == TRUE) {
         /*
@@ -957,6 +970,7 @@ int journal_end_transaction(journal *jnl) {
         ret = end_transaction(tr, 0, NULL, NULL, TRUE);
     }
     
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_END_TR | DBG_FUNC_END, ret, 0, 0, 0, 0);
     return ret;
 }
 
@@ -1075,9 +1089,8 @@ int journal_modify_block_start(journal *jnl, GenericLFBuf *psGenBuf) {
 //    This will be done later on, at the transaction-end.
 int journal_modify_block_end(journal *jnl, GenericLFBuf *psGenBuf,
                             void (*func)(GenericLFBuf *bp, void *arg), void *arg) {
-    int                i = 1;
-    size_t             tbuffer_offset=0;
-    block_list_header *blhdr, *prev=NULL;
+    int                i;
+    block_list_header *blhdr;
     transaction       *tr = NULL;
     
     #if JOURNAL_DEBUG
@@ -1114,51 +1127,26 @@ int journal_modify_block_end(journal *jnl, GenericLFBuf *psGenBuf,
     }
     
     // first check if this block is already part of this transaction
-    for (blhdr = tr->blhdr; blhdr; prev = blhdr, blhdr = (block_list_header *)((long)blhdr->binfo[0].bnum)) {
-        tbuffer_offset = jnl->jhdr->blhdr_size;
-        
-        for (i = 1; i < blhdr->num_blocks; i++) {
-            GenericLFBuf *bp = (void*)blhdr->binfo[i].u.bp;
-            if (psGenBuf == bp) {
-                // Block found in transaction
-                #if JOURNAL_DEBUG
-                    printf("block_end, already in journal:   psGenBuf %p, psVnode %p, uBlockN %llu, uDataSize %u, uPhyCluster %llu uLockCnt %u\n",
-                       psGenBuf, psGenBuf->psVnode, psGenBuf->uBlockN, psGenBuf->uDataSize, psGenBuf->uPhyCluster, psGenBuf->uLockCnt);
-                #endif
-                break;
-            }
-            if (blhdr->binfo[i].bnum != (off_t)-1) {
-                off_t uSizeOfBuf = ((GenericLFBuf*)(blhdr->binfo[i].u.bp))->uDataSize;
-                tbuffer_offset  += uSizeOfBuf;
-            } else {
-                tbuffer_offset  += blhdr->binfo[i].u.bi.bsize;
-            }
-        }
-        
-        if (i < blhdr->num_blocks) {
-            break;
-        }
+    if (tr_hash_lookup(tr, psGenBuf) != NULL) {
+        // Block found in transaction
+        #if JOURNAL_DEBUG
+            printf("block_end, already in journal:   psGenBuf %p, psVnode %p, uBlockN %llu, uDataSize %u, uPhyCluster %llu uLockCnt %u\n",
+               psGenBuf, psGenBuf->psVnode, psGenBuf->uBlockN, psGenBuf->uDataSize, psGenBuf->uPhyCluster, psGenBuf->uLockCnt);
+        #endif
+        lf_hfs_generic_buf_release(psGenBuf);
+        return 0;
     }
-    
-    if (blhdr == NULL
-        && prev
-        && (prev->num_blocks+1) <= prev->max_blocks
-        && (prev->bytes_used+psGenBuf->uDataSize) <= (uint32_t)tr->tbuffer_size) {
-        // Block not found, add to last list
-        blhdr = prev;
-        
-    } else if (blhdr == NULL) {
+
+    // Block not found, add it to the last list if it fits
+    blhdr = tr->blhdr_tail;
+    if (   (blhdr->num_blocks+1) > blhdr->max_blocks
+        || (blhdr->bytes_used+psGenBuf->uDataSize) > (uint32_t)tr->tbuffer_size) {
         block_list_header *nblhdr;
-        if (prev == NULL) {
-            panic("jnl: modify block end: no way man, prev == NULL?!?, jnl %p, psGenBuf %p\n", jnl, psGenBuf);
-        }
         // Add another tbuffer:
         
-        // we got to the end of the list, didn't find the block and there's
-        // no room in the block_list_header pointed to by prev
-        
-        // we allocate another tbuffer and link it in at the end of the list
-        // through prev->binfo[0].bnum.  that's a skanky way to do things but
+        // there's no room in the last block_list_header, so we allocate
+        // another tbuffer and link it in at the end of the list
+        // through binfo[0].bnum.  that's a skanky way to do things but
         // avoids having yet another linked list of small data structures to manage.
         
         nblhdr = hfs_malloc(tr->tbuffer_size);
@@ -1178,31 +1166,27 @@ int journal_modify_block_end(journal *jnl, GenericLFBuf *psGenBuf,
         tr->total_bytes += jnl->jhdr->blhdr_size;
         
         // then link him in at the end
-        prev->binfo[0].bnum = (off_t)((long)nblhdr);
+        blhdr->binfo[0].bnum = (off_t)((long)nblhdr);
         
         // and finally switch to using the new guy
         blhdr          = nblhdr;
-        i              = 1;
+        tr->blhdr_tail = nblhdr;
     }
     
+    i = blhdr->num_blocks;
     if ((i+1) > blhdr->max_blocks) {
         panic("jnl: modify_block_end: i = %d, max_blocks %d\n", i, blhdr->max_blocks);
     }
     
-    // if this is true then this is a new block we haven't seen before
-    if (i >= blhdr->num_blocks) {
-        off_t    bsize;
-        bsize = psGenBuf->uDataSize;
-        
-        // Add block to list
-        blhdr->binfo[i].bnum = (off_t)(psGenBuf->uBlockN);
-        blhdr->binfo[i].u.bp = (void*)psGenBuf;
-       
-        blhdr->bytes_used += bsize;
-        tr->total_bytes   += bsize;
-        
-        blhdr->num_blocks++;
-    }
+    // Add block to list
+    blhdr->binfo[i].bnum = (off_t)(psGenBuf->uBlockN);
+    blhdr->binfo[i].u.bp = (void*)psGenBuf;
+    
+    blhdr->bytes_used += psGenBuf->uDataSize;
+    tr->total_bytes   += psGenBuf->uDataSize;
+    
+    blhdr->num_blocks++;
+    tr_hash_insert(tr, psGenBuf, blhdr, i);
 
     // We can release the block here to allow other threads to perform operations on it until the next transaction-end.
     // The buffer will not be removed from cache since it is write-locked.
@@ -1251,6 +1235,8 @@ int journal_flush(journal *jnl, journal_flush_options_t options) {
         return EINVAL;
     }
     
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_FLUSH | DBG_FUNC_START, jnl, options, 0, 0, 0);
+
     if (jnl->owner != pthread_self()) {
         journal_lock(jnl);
         drop_lock = TRUE;
@@ -1313,10 +1299,11 @@ int journal_flush(journal *jnl, journal_flush_options_t options) {
         
         // If external journal partition is enabled, flush filesystem data partition.
         if (jnl->jdev != jnl->fsdev)
-            error = ioctl(jnl->jdev->psFSRecord->iFD, DKIOCSYNCHRONIZE, (caddr_t)&sync_request);
+            error = ioctl(jnl->fsdev->psFSRecord->iFD, DKIOCSYNCHRONIZE, (caddr_t)&sync_request);
         
     }
     
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_FLUSH | DBG_FUNC_END, jnl, error, 0, 0, 0);
     return error;
 }
 
@@ -1670,6 +1657,7 @@ static int replay_journal(journal *jnl) {
     int           replay_retry_count = 0;
     
     LFHFS_LOG(LEVEL_DEFAULT, "replay_journal: start.\n");
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_REPLAY | DBG_FUNC_START, jnl, jnl->jhdr->start, jnl->jhdr->end, 0, 0);
 
     
     // wrap the start ptr if it points to the very end of the journal
@@ -2003,6 +1991,7 @@ restart_replay:
     
 success:
     LFHFS_LOG(LEVEL_DEFAULT, "replay_journal: success.\n");
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_REPLAY | DBG_FUNC_END, 0, 0, 0, 0, 0);
     return 0;
     
 bad_replay:
@@ -2011,6 +2000,7 @@ bad_replay:
     hfs_free(buff);
     
     LFHFS_LOG(LEVEL_ERROR, "replay_journal: error.\n");
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_REPLAY | DBG_FUNC_END, -1, 0, 0, 0, 0);
     return -1;
 }
 
@@ -2792,6 +2782,8 @@ static void wait_condition(journal *jnl, ConditionalFlag_S *psCondFlag, __unused
     if (!psCondFlag->uFlag)
         return;
     
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_COND_WAIT | DBG_FUNC_START, jnl, psCondFlag, 0, 0, 0);
+
     lock_flush(jnl);
     
     while (psCondFlag->uFlag) {
@@ -2799,6 +2791,8 @@ static void wait_condition(journal *jnl, ConditionalFlag_S *psCondFlag, __unused
     }
     
     unlock_flush(jnl);
+
+    LFHFS_TRACE(HFSDBG_JOURNAL_ENABLED, DBG_JOURNAL_COND_WAIT | DBG_FUNC_END, jnl, psCondFlag, 0, 0, 0);
 }
 
 static void unlock_condition(journal *jnl, ConditionalFlag_S *psCondFlag) {
@@ -2961,6 +2955,9 @@ static int end_transaction(transaction *tr, int force_it, errno_t (*callback)(vo
     
     unlock_oldstart(jnl);
     
+    // No more blocks can join this transaction.
+    tr_hash_free(tr);
+
     // go over the blocks in the transaction.
     // for each block, call the fpCallback and copy the content into the journal buffer
     for (blhdr = tr->blhdr; blhdr; blhdr = next) {
@@ -3083,8 +3080,10 @@ static void abort_transaction(journal *jnl, transaction *tr) {
     tr->trim.allocated_count = 0;
     tr->trim.extent_count = 0;
     tr->trim.extents = NULL;
+    tr_hash_free(tr);
     tr->tbuffer     = NULL;
     tr->blhdr       = NULL;
+    tr->blhdr_tail  = NULL;
     tr->total_bytes = 0xdbadc0de;
     hfs_free(tr);
 }
@@ -3278,10 +3277,102 @@ static void free_old_stuff(journal *jnl) {
             hfs_free(blhdr);
         }
         next = tr->next;
+        tr_hash_free(tr);
         hfs_free(tr);
     }
 }
 
+// Per-transaction buffer hash.
+//
+// journal_modify_block_end and journal_kill_block need to know whether a
+// buffer is already part of the active transaction.  Walking every
+// block_list_header to find out made large transactions quadratic, so each
+// transaction keeps an open-addressed (linear probing) hash from the buffer
+// to its binfo slot.  Killed buffers leave a tombstone.  The hash is only
+// needed while blocks can join the transaction; end_transaction frees it
+// once the transaction is being written out.
+#define JNL_TR_HASH_MIN_SLOTS   256
+#define JNL_TR_SLOT_DELETED     ((GenericLFBuf *)-1)
+
+static uint32_t tr_hash_index(GenericLFBuf *bp, uint32_t size) {
+    uint64_t h = (uint64_t)(uintptr_t)bp * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(h >> 32) & (size - 1);
+}
+
+static jnl_tr_slot *tr_hash_lookup(transaction *tr, GenericLFBuf *bp) {
+    uint32_t idx;
+
+    if (tr->buf_hash == NULL) {
+        return NULL;
+    }
+
+    for (idx = tr_hash_index(bp, tr->buf_hash_size); tr->buf_hash[idx].bp != NULL; idx = (idx + 1) & (tr->buf_hash_size - 1)) {
+        if (tr->buf_hash[idx].bp == bp) {
+            return &tr->buf_hash[idx];
+        }
+    }
+    return NULL;
+}
+
+// Rebuild the hash with new_size slots, dropping tombstones.
+static int tr_hash_resize(transaction *tr, uint32_t new_size) {
+    jnl_tr_slot *old_hash = tr->buf_hash;
+    uint32_t     old_size = tr->buf_hash_size;
+    jnl_tr_slot *new_hash;
+    uint32_t     i, idx;
+
+    new_hash = hfs_mallocz(new_size * sizeof(jnl_tr_slot));
+    if (new_hash == NULL) {
+        return ENOMEM;
+    }
+
+    tr->buf_hash_used = 0;
+    for (i = 0; i < old_size; i++) {
+        if (old_hash[i].bp == NULL || old_hash[i].bp == JNL_TR_SLOT_DELETED) {
+            continue;
+        }
+        for (idx = tr_hash_index(old_hash[i].bp, new_size); new_hash[idx].bp != NULL; idx = (idx + 1) & (new_size - 1))
+            ;
+        new_hash[idx] = old_hash[i];
+        tr->buf_hash_used++;
+    }
+
+    if (old_hash) {
+        hfs_free(old_hash);
+    }
+    tr->buf_hash      = new_hash;
+    tr->buf_hash_size = new_size;
+    return 0;
+}
+
+static void tr_hash_insert(transaction *tr, GenericLFBuf *bp, block_list_header *blhdr, int index) {
+    uint32_t idx;
+
+    // Keep the load (tombstones included) at or below 3/4.
+    if ((tr->buf_hash_used + 1) * 4 > tr->buf_hash_size * 3) {
+        uint32_t new_size = tr->buf_hash_size ? tr->buf_hash_size * 2 : JNL_TR_HASH_MIN_SLOTS;
+        if (tr_hash_resize(tr, new_size) != 0 && tr->buf_hash_used + 1 >= tr->buf_hash_size) {
+            panic("jnl: tr_hash_insert: no memory for %u slots (tr %p)\n", new_size, tr);
+        }
+    }
+
+    for (idx = tr_hash_index(bp, tr->buf_hash_size); tr->buf_hash[idx].bp != NULL; idx = (idx + 1) & (tr->buf_hash_size - 1))
+        ;
+    tr->buf_hash[idx].bp    = bp;
+    tr->buf_hash[idx].blhdr = blhdr;
+    tr->buf_hash[idx].index = index;
+    tr->buf_hash_used++;
+}
+
+static void tr_hash_free(transaction *tr) {
+    if (tr->buf_hash) {
+        hfs_free(tr->buf_hash);
+    }
+    tr->buf_hash      = NULL;
+    tr->buf_hash_size = 0;
+    tr->buf_hash_used = 0;
+}
+
 // Allocate a new active transaction.
 // The function does the following:
 // 1) mallocs memory for a transaction structure and a buffer
@@ -3305,6 +3396,7 @@ static errno_t journal_allocate_transaction(journal *jnl) {
     tr->blhdr->num_blocks = 1;      // accounts for this header block
     tr->blhdr->bytes_used = jnl->jhdr->blhdr_size;
     tr->blhdr->flags = BLHDR_CHECK_CHECKSUMS | BLHDR_FIRST_HEADER;
+    tr->blhdr_tail   = tr->blhdr;
     
     tr->sequence_num = ++jnl->sequence_num;
     tr->num_blhdrs  = 1;
@@ -3321,6 +3413,7 @@ int journal_kill_block(journal *jnl, GenericLFBuf *psGenBuf) {
     uint64_t           uflags;
     block_list_header *blhdr;
     transaction       *tr;
+    jnl_tr_slot       *slot;
 
     #if JOURNAL_DEBUG
         printf("journal_kill_block: psGenBuf %p, psVnode %p, uBlockN %llu, uDataSize %u, uPhyCluster %llu uLockCnt %u\n",
@@ -3353,31 +3446,32 @@ int journal_kill_block(journal *jnl, GenericLFBuf *psGenBuf) {
      * bp must be BL_BUSY and B_LOCKED
      * first check if it's already part of this transaction
      */
-    for (blhdr = tr->blhdr; blhdr; blhdr = (block_list_header *)((long)blhdr->binfo[0].bnum)) {
-        
-        for (i = 1; i < blhdr->num_blocks; i++) {
-            if (psGenBuf == (void*)blhdr->binfo[i].u.bp) {
-                
-                // if the block has the DELWRI and FILTER bits sets, then
-                // things are seriously weird.  if it was part of another
-                // transaction then journal_modify_block_start() should
-                // have force it to be written.
-                //
-                //if ((bflags & B_DELWRI) && (bflags & B_FILTER)) {
-                //    panic("jnl: kill block: this defies all logic! bp 0x%x\n", bp);
-                //} else {
-                tr->num_killed += psGenBuf->uDataSize;
-                //}
-                blhdr->binfo[i].bnum = (off_t)-1;
-                blhdr->binfo[i].u.bp = NULL;
-                blhdr->binfo[i].u.bi.bsize = psGenBuf->uDataSize;
-                
-                lf_hfs_generic_buf_clear_cache_flag(psGenBuf, GEN_BUF_WRITE_LOCK);
-                lf_hfs_generic_buf_release(psGenBuf);
-                
-                return 0;
-            }
-        }
+    slot = tr_hash_lookup(tr, psGenBuf);
+    if (slot != NULL) {
+        blhdr = slot->blhdr;
+        i     = slot->index;
+
+        // if the block has the DELWRI and FILTER bits sets, then
+        // things are seriously weird.  if it was part of another
+        // transaction then journal_modify_block_start() should
+        // have force it to be written.
+        //
+        //if ((bflags & B_DELWRI) && (bflags & B_FILTER)) {
+        //    panic("jnl: kill block: this defies all logic! bp 0x%x\n", bp);
+        //} else {
+        tr->num_killed += psGenBuf->uDataSize;
+        //}
+        blhdr->binfo[i].bnum = (off_t)-1;
+        blhdr->binfo[i].u.bp = NULL;
+        blhdr->binfo[i].u.bi.bsize = psGenBuf->uDataSize;
+
+        // The buffer may be modified again in this transaction; it then gets a new slot.
+        slot->bp = JNL_TR_SLOT_DELETED;
+
+        lf_hfs_generic_buf_clear_cache_flag(psGenBuf, GEN_BUF_WRITE_LOCK);
+        lf_hfs_generic_buf_release(psGenBuf);
+
+        return 0;
     }
     
     /*
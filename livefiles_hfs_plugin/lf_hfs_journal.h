@@ -52,6 +52,13 @@ struct jnl_trim_list {
 
 typedef void (*jnl_trim_callback_t)(void *arg, uint32_t extent_count, const dk_extent_t *extents);
 
+// One slot of the per-transaction buffer hash (see tr_hash_lookup).
+typedef struct jnl_tr_slot {
+    GenericLFBuf        *bp;            // NULL if empty, JNL_TR_SLOT_DELETED if killed
+    block_list_header   *blhdr;         // block list header holding the buffer...
+    int                  index;         // ...and its binfo[] index there
+} jnl_tr_slot;
+
 typedef struct transaction {
     int                  tbuffer_size;  // in bytes
     char                *tbuffer;       // memory copy of the transaction
@@ -68,6 +75,10 @@ typedef struct transaction {
     struct jnl_trim_list trim;
     boolean_t            delayed_header_write;
     boolean_t            flush_on_completion; //flush transaction immediately upon txn end.
+    block_list_header   *blhdr_tail;    // last block_list_header, where new blocks are added
+    jnl_tr_slot         *buf_hash;      // open-addressed hash of the buffers in this transaction
+    uint32_t             buf_hash_size; // number of slots, a power of two
+    uint32_t             buf_hash_used; // live + deleted slots
 } transaction;
 
 
@@ -418,9 +418,7 @@ out:
         hfs_end_transaction(hfsmp);
     }
 
-    dcp->c_flag &= ~C_DIR_MODIFICATION;
-    //TBD - We have wakeup here but can't see anyone who's msleeping on c_flag...
-    //wakeup((caddr_t)&dcp->c_flag);
+    hfs_clear_dir_modification(dcp);
 
     return (error);
 }
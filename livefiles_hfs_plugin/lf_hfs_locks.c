@@ -99,12 +99,24 @@ int lf_cond_wait_relative(pthread_cond_t *pCond, pthread_mutex_t *pMutex, struct
     return(iErr);
 }
 
+void lf_cond_wait(pthread_cond_t *pCond, pthread_mutex_t *pMutex) {
+    
+    int iErr = pthread_cond_wait(pCond, pMutex);
+    assert(iErr == 0);
+}
+
 void lf_cond_wakeup(pthread_cond_t *pCond) {
     
     int iErr = pthread_cond_signal(pCond);
     assert(iErr == 0);
 }
 
+void lf_cond_wakeup_all(pthread_cond_t *pCond) {
+    
+    int iErr = pthread_cond_broadcast(pCond);
+    assert(iErr == 0);
+}
+
 void lf_lck_mtx_init( pthread_mutex_t* lck )
 {
     errno_t err = pthread_mutex_init( lck, NULL );
@@ -49,7 +49,9 @@ void lf_lck_mtx_convert_spin   ( pthread_mutex_t *lck );
 void lf_cond_destroy( pthread_cond_t* cond );
 void lf_cond_init( pthread_cond_t* cond );
 int  lf_cond_wait_relative(pthread_cond_t *pCond, pthread_mutex_t *pMutex, struct timespec *pTime);
+void lf_cond_wait(pthread_cond_t *pCond, pthread_mutex_t *pMutex);
 void lf_cond_wakeup(pthread_cond_t *pCond);
+void lf_cond_wakeup_all(pthread_cond_t *pCond);
 
 // Spin locks.
 void    lf_lck_spin_init       ( pthread_mutex_t *lck );
@@ -38,18 +38,23 @@ retry:
     flags = cnp->cn_flags;
     bzero(&desc, sizeof(desc));
 
-    if (hfs_lock(VTOC(dvp), HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT) != 0) {
+    /*
+     * A lookup only reads the directory, so concurrent lookups share the
+     * lock.  The only thing we write is c_childhint, which is atomic.
+     */
+    if (hfs_lock(VTOC(dvp), HFS_SHARED_LOCK, HFS_LOCK_DEFAULT) != 0) {
         retval = ENOENT;  /* The parent no longer exists ? */
         goto exit;
     }
     dcp = VTOC(dvp);
 
     /*
-     * Need to understand if we need this check.. as we took exclusive lock..
+     * Operations that modify the directory may drop its lock while the
+     * change is in flight; wait for them to finish so we don't see a
+     * half-done create / remove / rename.
      */
     if (dcp->c_flag & C_DIR_MODIFICATION){
-        hfs_unlock(dcp);
-        usleep( 1000 );
+        hfs_wait_dir_modification(dcp);
         goto retry;
     }
 
@@ -66,14 +71,14 @@ retry:
     cndesc.cd_nameptr = (const u_int8_t *)cnp->cn_nameptr;
     cndesc.cd_namelen = cnp->cn_namelen;
     cndesc.cd_parentcnid = dcp->c_fileid;
-    cndesc.cd_hint = dcp->c_childhint;
+    cndesc.cd_hint = atomic_load_explicit(&dcp->c_childhint, memory_order_relaxed);
 
     lockflags = hfs_systemfile_lock(hfsmp, SFL_CATALOG, HFS_SHARED_LOCK);
     retval = cat_lookup(hfsmp, &cndesc, 0, &desc, &attr, &fork, NULL);
     hfs_systemfile_unlock(hfsmp, lockflags);
 
     if (retval == 0) {
-        dcp->c_childhint = desc.cd_hint;
+        atomic_store_explicit(&dcp->c_childhint, desc.cd_hint, memory_order_relaxed);
         /*
          * Note: We must drop the parent lock here before calling
          * hfs_getnewvnode (which takes the child lock).
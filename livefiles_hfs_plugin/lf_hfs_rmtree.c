@@ -0,0 +1,700 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_rmtree.c
+ *  livefiles_hfs
+ *
+ *  Recursive removal of a directory tree. The tree is first moved to the
+ *  private metadata directory, so a removal cut short by a crash is
+ *  finished on the next mount.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lf_hfs.h"
+#include "lf_hfs_rmtree.h"
+#include "lf_hfs_cnode.h"
+#include "lf_hfs_chash.h"
+#include "lf_hfs_vnode.h"
+#include "lf_hfs_vnops.h"
+#include "lf_hfs_catalog.h"
+#include "lf_hfs_logger.h"
+#include "lf_hfs_vfsutils.h"
+#include "lf_hfs_sbunicode.h"
+#include "lf_hfs_btrees_internal.h"
+#include "lf_hfs_fileops_handler.h"
+#include "lf_hfs_dirops_handler.h"
+
+typedef struct RmTreeFrame
+{
+    struct vnode*       psVnode;
+    struct RmTreeFrame* psParent;
+    char                pcName[MAX_UTF8_NAME_LENGTH];   // Name in the parent directory
+} RmTreeFrame_S;
+
+static void
+RmTree_InitCompName( struct componentname* psCN, const char* pcName )
+{
+    bzero( psCN, sizeof(*psCN) );
+    psCN->cn_nameiop    = DELETE;
+    psCN->cn_flags      = ISLASTCN;
+    psCN->cn_pnbuf      = (char *)pcName;
+    psCN->cn_pnlen      = (int)strlen(pcName);
+    psCN->cn_nameptr    = (char *)pcName;
+    psCN->cn_namelen    = (int)strlen(pcName);
+    psCN->cn_consume    = (int)strlen(pcName);
+}
+
+static int
+RmTree_CompareCnodes( const void* pvA, const void* pvB )
+{
+    uintptr_t uA = (uintptr_t) *(struct cnode* const*) pvA;
+    uintptr_t uB = (uintptr_t) *(struct cnode* const*) pvB;
+
+    return (uA < uB) ? -1 : (uA > uB);
+}
+
+/*
+ * Read the names of up to LFHFS_RMTREE_BATCH children of uDirID, in
+ * catalog key order, into pcNames (MAX_UTF8_NAME_LENGTH bytes each).
+ */
+static int
+RmTree_ReadNames( struct hfsmount* hfsmp, cnid_t uDirID, char* pcNames, uint32_t* puCount )
+{
+    FCB* fcb = VTOF( hfsmp->hfs_catalog_vp );
+    BTreeIterator* psIterator = hfs_mallocz( sizeof(BTreeIterator) );
+    CatalogRecord* psRec = hfs_malloc( sizeof(CatalogRecord) );
+    HFSPlusCatalogKey* psKey;
+    FSBufferDescriptor sBtData;
+    uint32_t uCount = 0;
+    int iLockFlags;
+    int iErr = 0;
+
+    if ( psIterator == NULL || psRec == NULL )
+    {
+        iErr = ENOMEM;
+        goto exit;
+    }
+
+    psKey = (HFSPlusCatalogKey*) &psIterator->key;
+    psKey->parentID         = uDirID;
+    psKey->nodeName.length  = 0;
+    psKey->keyLength        = kHFSPlusCatalogKeyMinimumLength;
+
+    sBtData.bufferAddress   = psRec;
+    sBtData.itemSize        = sizeof(CatalogRecord);
+    sBtData.itemCount       = 1;
+
+    iLockFlags = hfs_systemfile_lock( hfsmp, SFL_CATALOG, HFS_SHARED_LOCK );
+
+    // The directory's thread record sorts ahead of all of its children.
+    (void) BTSearchRecord( fcb, psIterator, NULL, NULL, psIterator );
+
+    while ( uCount < LFHFS_RMTREE_BATCH )
+    {
+        size_t uNameLen = 0;
+
+        iErr = BTIterateRecord( fcb, kBTreeNextRecord, psIterator, &sBtData, NULL );
+        if ( iErr )
+        {
+            iErr = (iErr == fsBTRecordNotFoundErr) ? 0 : MacToVFSError( iErr );
+            break;
+        }
+        if ( psKey->parentID != uDirID )
+        {
+            break;
+        }
+        if ( psRec->recordType != kHFSPlusFolderRecord && psRec->recordType != kHFSPlusFileRecord )
+        {
+            continue;
+        }
+
+        iErr = utf8_encodestr( psKey->nodeName.unicode, psKey->nodeName.length * 2,
+                               (u_int8_t *) &pcNames[uCount * MAX_UTF8_NAME_LENGTH], &uNameLen,
+                               MAX_UTF8_NAME_LENGTH, ':', UTF_ADD_NULL_TERM );
+        if ( iErr )
+        {
+            break;
+        }
+        uCount++;
+    }
+
+    hfs_systemfile_unlock( hfsmp, iLockFlags );
+
+exit:
+    hfs_free( psIterator );
+    hfs_free( psRec );
+    *puCount = uCount;
+    return iErr;
+}
+
+/*
+ * Remove one entry of dvp through the regular hfs_removefile /
+ * hfs_removedir path. Used for hard links, files with a resource fork
+ * vnode in hand, and emptied subdirectories.
+ */
+static int
+RmTree_RemoveOne( struct vnode* dvp, struct vnode* vp, const char* pcName )
+{
+    struct cnode* dcp = VTOC(dvp);
+    struct cnode* cp = VTOC(vp);
+    struct componentname sCN;
+    bool bIsDir = vnode_isdir(vp);
+    bool bHoldRsrc = false;
+    int iErr;
+
+    RmTree_InitCompName( &sCN, pcName );
+
+    if ( !bIsDir )
+    {
+        hfs_lock_truncate( cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT );
+    }
+
+    iErr = hfs_lockpair( dcp, cp, HFS_EXCLUSIVE_LOCK );
+    if ( iErr )
+    {
+        goto unlock_truncate;
+    }
+
+    // Keep the resource fork vnode around while its storage is released.
+    if ( !bIsDir && cp->c_rsrc_vp != NULL )
+    {
+        hfs_chash_raise_OpenLookupCounter( cp );
+        bHoldRsrc = true;
+    }
+
+    if ( bIsDir )
+    {
+        iErr = hfs_removedir( dvp, vp, &sCN, 0, 0 );
+    }
+    else
+    {
+        iErr = hfs_removefile( dvp, vp, &sCN, VNODE_REMOVE_NODELETEBUSY | VNODE_REMOVE_SKIP_NAMESPACE_EVENT, 0, 0, 0 );
+        dvp->sExtraData.sDirData.uDirVersion++;
+    }
+
+    hfs_unlockpair( dcp, cp );
+
+    if ( bHoldRsrc )
+    {
+        hfs_chash_lower_OpenLookupCounter( cp );
+    }
+
+unlock_truncate:
+    if ( !bIsDir )
+    {
+        hfs_unlock_truncate( cp, HFS_LOCK_DEFAULT );
+    }
+    return iErr;
+}
+
+/*
+ * Remove uCount plain files of dvp under a single journal transaction.
+ * Lock order is the usual one: truncate locks, then the cnode locks of
+ * the directory and all files in address order, then the transaction.
+ */
+static int
+RmTree_RemoveFiles( struct vnode* dvp, struct vnode** ppsFiles, const char** ppcNames, uint32_t uCount )
+{
+    struct hfsmount* hfsmp = VTOHFS(dvp);
+    struct cnode* ppsCnodes[LFHFS_RMTREE_BATCH + 1];
+    struct componentname sCN;
+    uint32_t uLocked = 0;
+    int iErr = 0;
+
+    for ( uint32_t uIdx = 0; uIdx < uCount; uIdx++ )
+    {
+        ppsCnodes[uIdx] = VTOC(ppsFiles[uIdx]);
+    }
+    qsort( ppsCnodes, uCount, sizeof(ppsCnodes[0]), RmTree_CompareCnodes );
+    for ( uint32_t uIdx = 0; uIdx < uCount; uIdx++ )
+    {
+        hfs_lock_truncate( ppsCnodes[uIdx], HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT );
+    }
+
+    ppsCnodes[uCount] = VTOC(dvp);
+    qsort( ppsCnodes, uCount + 1, sizeof(ppsCnodes[0]), RmTree_CompareCnodes );
+    for ( uLocked = 0; uLocked < uCount + 1; uLocked++ )
+    {
+        iErr = hfs_lock( ppsCnodes[uLocked], HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT );
+        if ( iErr )
+        {
+            goto unlock;
+        }
+    }
+
+    iErr = hfs_start_transaction( hfsmp );
+    if ( iErr )
+    {
+        goto unlock;
+    }
+
+    // hfs_removefile nests its transaction in ours, so the catalog,
+    // attribute and bitmap updates of the whole batch commit together.
+    for ( uint32_t uIdx = 0; uIdx < uCount; uIdx++ )
+    {
+        RmTree_InitCompName( &sCN, ppcNames[uIdx] );
+        int iRemoveErr = hfs_removefile( dvp, ppsFiles[uIdx], &sCN, VNODE_REMOVE_NODELETEBUSY | VNODE_REMOVE_SKIP_NAMESPACE_EVENT, 0, 0, 0 );
+        if ( iRemoveErr && !iErr )
+        {
+            iErr = iRemoveErr;
+        }
+    }
+
+    hfs_end_transaction( hfsmp );
+    dvp->sExtraData.sDirData.uDirVersion++;
+
+unlock:
+    for ( uint32_t uIdx = 0; uIdx < uLocked; uIdx++ )
+    {
+        hfs_unlock( ppsCnodes[uIdx] );
+    }
+    for ( uint32_t uIdx = 0; uIdx < uCount; uIdx++ )
+    {
+        hfs_unlock_truncate( VTOC(ppsFiles[uIdx]), HFS_LOCK_DEFAULT );
+    }
+    return iErr;
+}
+
+/*
+ * Remove every non-directory entry among the uCount names read from dvp.
+ * The first subdirectory found is returned in *ppsSubDir, with its name in
+ * pcSubDirName, for the caller to descend into; any others are picked up
+ * by a later batch.
+ */
+static int
+RmTree_RemoveBatch( struct vnode* dvp, char* pcNames, uint32_t uCount, struct vnode** ppsSubDir, char* pcSubDirName )
+{
+    struct vnode* ppsFiles[LFHFS_RMTREE_BATCH];
+    const char* ppcFileNames[LFHFS_RMTREE_BATCH];
+    uint32_t uFiles = 0;
+    int iErr = 0;
+
+    *ppsSubDir = NULL;
+
+    for ( uint32_t uIdx = 0; uIdx < uCount && iErr == 0; uIdx++ )
+    {
+        const char* pcName = &pcNames[uIdx * MAX_UTF8_NAME_LENGTH];
+        UVFSFileNode psNode = NULL;
+
+        iErr = DIROPS_LookupInternal( (UVFSFileNode) dvp, pcName, &psNode );
+        if ( iErr == ENOENT )
+        {
+            iErr = 0;
+            continue;
+        }
+        if ( iErr )
+        {
+            break;
+        }
+
+        struct vnode* vp = (struct vnode*) psNode;
+        struct cnode* cp = VTOC(vp);
+
+        if ( vnode_isdir(vp) && !(cp->c_flag & C_HARDLINK) )
+        {
+            if ( *ppsSubDir == NULL )
+            {
+                *ppsSubDir = vp;
+                strlcpy( pcSubDirName, pcName, MAX_UTF8_NAME_LENGTH );
+            }
+            else
+            {
+                LFHFS_Reclaim( psNode, 0 );
+            }
+        }
+        else if ( (cp->c_flag & C_HARDLINK) || cp->c_rsrc_vp != NULL )
+        {
+            iErr = RmTree_RemoveOne( dvp, vp, pcName );
+            LFHFS_Reclaim( psNode, 0 );
+        }
+        else
+        {
+            ppsFiles[uFiles]        = vp;
+            ppcFileNames[uFiles]    = pcName;
+            uFiles++;
+        }
+    }
+
+    if ( uFiles )
+    {
+        int iBatchErr = RmTree_RemoveFiles( dvp, ppsFiles, ppcFileNames, uFiles );
+        if ( !iErr )
+        {
+            iErr = iBatchErr;
+        }
+
+        for ( uint32_t uIdx = 0; uIdx < uFiles; uIdx++ )
+        {
+            LFHFS_Reclaim( (UVFSFileNode) ppsFiles[uIdx], 0 );
+        }
+    }
+
+    if ( iErr && *ppsSubDir != NULL )
+    {
+        LFHFS_Reclaim( (UVFSFileNode) *ppsSubDir, 0 );
+        *ppsSubDir = NULL;
+    }
+
+    return iErr;
+}
+
+/*
+ * Remove everything below psTopVp, leaving it empty. The walk keeps its
+ * own stack of open directories, so tree depth is bounded only by memory.
+ */
+static int
+RmTree_EmptyTree( struct vnode* psTopVp )
+{
+    struct hfsmount* hfsmp = VTOHFS(psTopVp);
+    RmTreeFrame_S* psFrame = hfs_mallocz( sizeof(RmTreeFrame_S) );
+    char* pcNames = hfs_malloc( LFHFS_RMTREE_BATCH * MAX_UTF8_NAME_LENGTH );
+    int iErr = 0;
+
+    if ( psFrame == NULL || pcNames == NULL )
+    {
+        iErr = ENOMEM;
+        goto exit;
+    }
+    psFrame->psVnode = psTopVp;
+
+    while ( psFrame != NULL )
+    {
+        uint32_t uCount = 0;
+
+        iErr = RmTree_ReadNames( hfsmp, VTOC(psFrame->psVnode)->c_fileid, pcNames, &uCount );
+        if ( iErr )
+        {
+            break;
+        }
+
+        if ( uCount == 0 )
+        {
+            // Empty now; remove it from its parent and go back up.
+            RmTreeFrame_S* psParent = psFrame->psParent;
+            if ( psParent != NULL )
+            {
+                iErr = RmTree_RemoveOne( psParent->psVnode, psFrame->psVnode, psFrame->pcName );
+                LFHFS_Reclaim( (UVFSFileNode) psFrame->psVnode, 0 );
+            }
+            hfs_free( psFrame );
+            psFrame = psParent;
+            if ( iErr )
+            {
+                break;
+            }
+            continue;
+        }
+
+        RmTreeFrame_S* psChild = hfs_mallocz( sizeof(RmTreeFrame_S) );
+        if ( psChild == NULL )
+        {
+            iErr = ENOMEM;
+            break;
+        }
+
+        iErr = RmTree_RemoveBatch( psFrame->psVnode, pcNames, uCount, &psChild->psVnode, psChild->pcName );
+        if ( iErr || psChild->psVnode == NULL )
+        {
+            hfs_free( psChild );
+            if ( iErr )
+            {
+                break;
+            }
+            continue;
+        }
+
+        psChild->psParent = psFrame;
+        psFrame = psChild;
+    }
+
+exit:
+    while ( psFrame != NULL )
+    {
+        RmTreeFrame_S* psParent = psFrame->psParent;
+        if ( psFrame->psVnode != psTopVp )
+        {
+            LFHFS_Reclaim( (UVFSFileNode) psFrame->psVnode, 0 );
+        }
+        hfs_free( psFrame );
+        psFrame = psParent;
+    }
+    hfs_free( pcNames );
+
+    if ( iErr )
+    {
+        LFHFS_LOG( LEVEL_ERROR, "RmTree_EmptyTree: failed to empty dir %u [%d]\n", VTOC(psTopVp)->c_fileid, iErr );
+    }
+    return iErr;
+}
+
+int
+LFHFS_RemoveTree( UVFSFileNode psDirNode, const char* pcName )
+{
+    struct vnode* dvp = (struct vnode*) psDirNode;
+    UVFSFileNode psNode = NULL;
+    struct componentname sCN;
+    int iErr;
+
+    if ( !vnode_isdir(dvp) )
+    {
+        return ENOTDIR;
+    }
+
+    iErr = DIROPS_LookupInternal( psDirNode, pcName, &psNode );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    struct vnode* vp = (struct vnode*) psNode;
+    struct cnode* cp = VTOC(vp);
+    struct cnode* dcp = VTOC(dvp);
+
+    RmTree_InitCompName( &sCN, pcName );
+
+    // Files and directory hard links only lose this name.
+    if ( !vnode_isdir(vp) )
+    {
+        iErr = hfs_vnop_remove( dvp, vp, &sCN, VNODE_REMOVE_NODELETEBUSY | VNODE_REMOVE_SKIP_NAMESPACE_EVENT );
+        goto exit;
+    }
+    if ( cp->c_flag & C_HARDLINK )
+    {
+        iErr = hfs_vnop_rmdir( dvp, vp, &sCN );
+        goto exit;
+    }
+
+    /*
+     * Move the tree into the private directory as "temp<cnid>". It is out
+     * of the namespace from here on, and if we don't get to finish, the
+     * next mount does (see hfs_remove_orphan_trees).
+     */
+    iErr = hfs_lockpair( dcp, cp, HFS_EXCLUSIVE_LOCK );
+    if ( iErr )
+    {
+        goto exit;
+    }
+    if ( dcp->c_flag & (C_DELETED | C_NOEXISTS) )
+    {
+        iErr = ENOENT;
+    }
+    else
+    {
+        iErr = hfs_removefile( dvp, vp, &sCN, 0, 0, 1, 1 );
+        dvp->sExtraData.sDirData.uDirVersion++;
+    }
+    hfs_unlockpair( dcp, cp );
+    if ( iErr )
+    {
+        goto exit;
+    }
+
+    iErr = RmTree_EmptyTree( vp );
+    if ( iErr && hfs_lock( cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT ) == 0 )
+    {
+        // Reclaim must not delete a directory that still has children;
+        // leave it in the private directory for the next mount.
+        if ( cp->c_entries != 0 )
+        {
+            cp->c_flag &= ~C_DELETED;
+        }
+        hfs_unlock( cp );
+    }
+
+exit:
+    // The last reference to a C_DELETED directory deletes its record.
+    LFHFS_Reclaim( psNode, 0 );
+    return iErr;
+}
+
+/*
+ * Collect the cnids of up to LFHFS_RMTREE_BATCH "temp<cnid>" directories
+ * in the private directory that still have children. The scan starts
+ * after "temp<uAfterID>", or at the first "temp" name if uAfterID is 0.
+ */
+static uint32_t
+RmTree_FindOrphanTrees( struct hfsmount* hfsmp, cnid_t uAfterID, cnid_t* puDirIDs )
+{
+    cnid_t uPrivDirID = hfsmp->hfs_private_desc[FILE_HARDLINKS].cd_cnid;
+    FCB* fcb = VTOF( hfsmp->hfs_catalog_vp );
+    BTreeIterator* psIterator = hfs_mallocz( sizeof(BTreeIterator) );
+    CatalogRecord* psRec = hfs_malloc( sizeof(CatalogRecord) );
+    HFSPlusCatalogKey* psKey;
+    FSBufferDescriptor sBtData;
+    char pcFileName[32];
+    char pcTempName[32];
+    size_t uNameLen;
+    uint32_t uCount = 0;
+    int iLockFlags;
+
+    if ( psIterator == NULL || psRec == NULL )
+    {
+        goto exit;
+    }
+
+    if ( uAfterID == 0 )
+    {
+        strlcpy( pcTempName, "temp", sizeof(pcTempName) );
+    }
+    else
+    {
+        MAKE_DELETED_NAME( pcTempName, sizeof(pcTempName), uAfterID );
+    }
+
+    psKey = (HFSPlusCatalogKey*) &psIterator->key;
+    psKey->parentID             = uPrivDirID;
+    psKey->nodeName.length      = strlen( pcTempName );
+    psKey->keyLength            = kHFSPlusCatalogKeyMinimumLength + psKey->nodeName.length * 2;
+    for ( uint32_t uIdx = 0; uIdx < psKey->nodeName.length; uIdx++ )
+    {
+        psKey->nodeName.unicode[uIdx] = pcTempName[uIdx];
+    }
+
+    sBtData.bufferAddress   = psRec;
+    sBtData.itemSize        = sizeof(CatalogRecord);
+    sBtData.itemCount       = 1;
+
+    iLockFlags = hfs_systemfile_lock( hfsmp, SFL_CATALOG, HFS_SHARED_LOCK );
+    (void) BTSearchRecord( fcb, psIterator, NULL, NULL, psIterator );
+
+    while ( uCount < LFHFS_RMTREE_BATCH )
+    {
+        if ( BTIterateRecord( fcb, kBTreeNextRecord, psIterator, &sBtData, NULL ) != 0 )
+        {
+            break;
+        }
+        if ( psKey->parentID != uPrivDirID )
+        {
+            break;
+        }
+        if ( psRec->recordType != kHFSPlusFolderRecord || psRec->hfsPlusFolder.valence == 0 )
+        {
+            continue;
+        }
+
+        if ( utf8_encodestr( psKey->nodeName.unicode, psKey->nodeName.length * 2,
+                             (u_int8_t *) pcFileName, &uNameLen, sizeof(pcFileName), 0, UTF_ADD_NULL_TERM ) != 0 )
+        {
+            continue;
+        }
+        MAKE_DELETED_NAME( pcTempName, sizeof(pcTempName), psRec->hfsPlusFolder.folderID );
+        if ( strcmp( pcTempName, pcFileName ) != 0 )
+        {
+            continue;
+        }
+
+        puDirIDs[uCount++] = psRec->hfsPlusFolder.folderID;
+    }
+
+    hfs_systemfile_unlock( hfsmp, iLockFlags );
+
+exit:
+    hfs_free( psIterator );
+    hfs_free( psRec );
+    return uCount;
+}
+
+static int
+RmTree_RemoveOrphanTree( struct hfsmount* hfsmp, cnid_t uDirID )
+{
+    struct cat_desc sDesc;
+    struct cat_attr sAttr;
+    struct cat_fork sFork;
+    struct vnode* vp = NULL;
+    int iNewVnodeFlags = 0;
+    int iLockFlags;
+    int iErr;
+
+    bzero( &sDesc, sizeof(sDesc) );
+    bzero( &sAttr, sizeof(sAttr) );
+    bzero( &sFork, sizeof(sFork) );
+
+    iLockFlags = hfs_systemfile_lock( hfsmp, SFL_CATALOG, HFS_SHARED_LOCK );
+    iErr = cat_idlookup( hfsmp, uDirID, 0, 0, &sDesc, &sAttr, &sFork );
+    hfs_systemfile_unlock( hfsmp, iLockFlags );
+    if ( iErr )
+    {
+        return iErr;
+    }
+
+    // hfs_vget refuses open-unlinked items, so build the vnode here.
+    char* pcBuf = hfs_malloc( MAXPATHLEN );
+    if ( pcBuf == NULL )
+    {
+        cat_releasedesc( &sDesc );
+        return ENOMEM;
+    }
+
+    struct componentname sCN = {
+        .cn_nameiop = LOOKUP,
+        .cn_flags   = ISLASTCN,
+        .cn_pnlen   = MAXPATHLEN,
+        .cn_namelen = sDesc.cd_namelen,
+        .cn_pnbuf   = pcBuf,
+        .cn_nameptr = pcBuf
+    };
+    bcopy( sDesc.cd_nameptr, sCN.cn_nameptr, sDesc.cd_namelen + 1 );
+
+    iErr = hfs_getnewvnode( hfsmp, NULL, &sCN, &sDesc, 0, &sAttr, &sFork, &vp, &iNewVnodeFlags );
+    hfs_free( pcBuf );
+    cat_releasedesc( &sDesc );
+    if ( iErr )
+    {
+        return iErr;
+    }
+    hfs_unlock( VTOC(vp) );
+
+    iErr = RmTree_EmptyTree( vp );
+    if ( iErr == 0 && hfs_lock( VTOC(vp), HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT ) == 0 )
+    {
+        // Let reclaim delete the empty directory as for any open-unlinked item.
+        VTOC(vp)->c_flag |= C_DELETED;
+        hfs_unlock( VTOC(vp) );
+    }
+
+    hfs_vnop_reclaim( vp );
+    return iErr;
+}
+
+/*
+ * Finish trees that LFHFS_RemoveTree moved to the private directory but
+ * did not get to empty. hfs_remove_orphans skips those directories since
+ * it only deletes single catalog records.
+ *
+ * Each batch resumes the scan after the last directory of the previous
+ * one, so a tree that cannot be removed is tried once and then passed.
+ */
+void
+hfs_remove_orphan_trees( struct hfsmount* hfsmp )
+{
+    cnid_t puDirIDs[LFHFS_RMTREE_BATCH];
+    cnid_t uAfterID = 0;
+    uint32_t uFound;
+    uint32_t uTotal = 0;
+
+    if ( (hfsmp->hfs_flags & HFS_READ_ONLY) || hfsmp->hfs_private_desc[FILE_HARDLINKS].cd_cnid == 0 )
+    {
+        return;
+    }
+
+    do
+    {
+        uFound = RmTree_FindOrphanTrees( hfsmp, uAfterID, puDirIDs );
+        for ( uint32_t uIdx = 0; uIdx < uFound; uIdx++ )
+        {
+            if ( RmTree_RemoveOrphanTree( hfsmp, puDirIDs[uIdx] ) == 0 )
+            {
+                uTotal++;
+            }
+        }
+        if ( uFound > 0 )
+        {
+            uAfterID = puDirIDs[uFound - 1];
+        }
+    } while ( uFound == LFHFS_RMTREE_BATCH );
+
+    if ( uTotal > 0 )
+    {
+        LFHFS_LOG( LEVEL_DEFAULT, "hfs_remove_orphan_trees: Removed %u partly deleted directory trees\n", uTotal );
+    }
+}
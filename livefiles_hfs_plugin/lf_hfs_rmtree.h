@@ -0,0 +1,25 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_rmtree.h
+ *  livefiles_hfs
+ *
+ *  Recursive removal of a directory tree. The tree is first moved to the
+ *  private metadata directory, so a removal cut short by a crash is
+ *  finished on the next mount.
+ */
+
+#ifndef lf_hfs_rmtree_h
+#define lf_hfs_rmtree_h
+
+#include <UserFS/UserVFS.h>
+#include "lf_hfs.h"
+
+// Number of catalog entries read, and files removed under one journal
+// transaction, per step of the walk.
+#define LFHFS_RMTREE_BATCH              (32)
+
+int     LFHFS_RemoveTree( UVFSFileNode psDirNode, const char* pcName );
+
+void    hfs_remove_orphan_trees( struct hfsmount* hfsmp );
+
+#endif /* lf_hfs_rmtree_h */
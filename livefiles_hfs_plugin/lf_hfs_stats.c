@@ -0,0 +1,281 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_stats.c
+ *  livefiles_hfs
+ *
+ *  Per-operation call / error / byte counters and latency histograms
+ *  for the HFS_fsOps entry points, plus the extended attribute cache
+ *  counters.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "lf_hfs_stats.h"
+#include "lf_hfs_xattr.h"
+
+typedef struct
+{
+    _Atomic uint64_t uCalls;
+    _Atomic uint64_t uErrors;
+    _Atomic uint64_t uBytes;
+    _Atomic uint64_t uTotalNs;
+    _Atomic uint64_t uMaxNs;
+    _Atomic uint64_t puHistogram[LFHFS_STATS_HIST_BUCKETS];
+} LFHFSOpCounters_S;
+
+// Each shard is cache-line aligned so that threads updating different
+// shards do not false-share.
+typedef struct
+{
+    LFHFSOpCounters_S psOps[LFHFS_OP_AMOUNT];
+} __attribute__((aligned(64))) LFHFSStatsShard_S;
+
+static LFHFSStatsShard_S    gpsStatsShards[LFHFS_STATS_SHARDS];
+static _Atomic uint32_t     guStatsNextShard = 0;
+static __thread int32_t     giStatsShard     = -1;
+
+static const char* gpcOpNames[LFHFS_OP_AMOUNT] = {
+    [ LFHFS_OP_INIT           ] = "init",
+    [ LFHFS_OP_FINI           ] = "fini",
+    [ LFHFS_OP_TASTE          ] = "taste",
+    [ LFHFS_OP_SCANVOLS       ] = "scanvols",
+    [ LFHFS_OP_MOUNT          ] = "mount",
+    [ LFHFS_OP_SYNC           ] = "sync",
+    [ LFHFS_OP_UNMOUNT        ] = "unmount",
+    [ LFHFS_OP_GETFSATTR      ] = "getfsattr",
+    [ LFHFS_OP_SETFSATTR      ] = "setfsattr",
+    [ LFHFS_OP_GETATTR        ] = "getattr",
+    [ LFHFS_OP_SETATTR        ] = "setattr",
+    [ LFHFS_OP_LOOKUP         ] = "lookup",
+    [ LFHFS_OP_RECLAIM        ] = "reclaim",
+    [ LFHFS_OP_READLINK       ] = "readlink",
+    [ LFHFS_OP_READ           ] = "read",
+    [ LFHFS_OP_WRITE          ] = "write",
+    [ LFHFS_OP_CREATE         ] = "create",
+    [ LFHFS_OP_MKDIR          ] = "mkdir",
+    [ LFHFS_OP_SYMLINK        ] = "symlink",
+    [ LFHFS_OP_REMOVE         ] = "remove",
+    [ LFHFS_OP_RMDIR          ] = "rmdir",
+    [ LFHFS_OP_RENAME         ] = "rename",
+    [ LFHFS_OP_READDIR        ] = "readdir",
+    [ LFHFS_OP_READDIRATTR    ] = "readdirattr",
+    [ LFHFS_OP_LINK           ] = "link",
+    [ LFHFS_OP_CHECK          ] = "check",
+    [ LFHFS_OP_GETXATTR       ] = "getxattr",
+    [ LFHFS_OP_SETXATTR       ] = "setxattr",
+    [ LFHFS_OP_LISTXATTR      ] = "listxattr",
+    [ LFHFS_OP_SCANDIR        ] = "scandir",
+    [ LFHFS_OP_SCANIDS        ] = "scanids",
+    [ LFHFS_OP_STREAM_LOOKUP  ] = "stream_lookup",
+    [ LFHFS_OP_STREAM_RECLAIM ] = "stream_reclaim",
+    [ LFHFS_OP_STREAM_READ    ] = "stream_read",
+};
+
+static LFHFSStatsShard_S*
+lf_hfs_stats_get_shard( void )
+{
+    if ( giStatsShard < 0 )
+    {
+        giStatsShard = (int32_t)(atomic_fetch_add_explicit(&guStatsNextShard, 1, memory_order_relaxed) % LFHFS_STATS_SHARDS);
+    }
+
+    return &gpsStatsShards[giStatsShard];
+}
+
+static uint32_t
+lf_hfs_stats_bucket( uint64_t uNs )
+{
+    if ( uNs == 0 )
+    {
+        return 0;
+    }
+
+    uint32_t uBucket = 63 - __builtin_clzll(uNs);
+    if ( uBucket >= LFHFS_STATS_HIST_BUCKETS )
+    {
+        uBucket = LFHFS_STATS_HIST_BUCKETS - 1;
+    }
+
+    return uBucket;
+}
+
+uint64_t
+LFHFS_StatsStart( void )
+{
+    return clock_gettime_nsec_np( CLOCK_UPTIME_RAW );
+}
+
+void
+LFHFS_StatsRecord( LFHFSOp_e eOp, uint64_t uStartNs, int iErr, uint64_t uBytes )
+{
+    uint64_t uNs = clock_gettime_nsec_np( CLOCK_UPTIME_RAW ) - uStartNs;
+    LFHFSOpCounters_S *psCounters = &lf_hfs_stats_get_shard()->psOps[eOp];
+
+    atomic_fetch_add_explicit( &psCounters->uCalls, 1, memory_order_relaxed );
+    if ( iErr != 0 )
+    {
+        atomic_fetch_add_explicit( &psCounters->uErrors, 1, memory_order_relaxed );
+    }
+    if ( uBytes != 0 )
+    {
+        atomic_fetch_add_explicit( &psCounters->uBytes, uBytes, memory_order_relaxed );
+    }
+    atomic_fetch_add_explicit( &psCounters->uTotalNs, uNs, memory_order_relaxed );
+    atomic_fetch_add_explicit( &psCounters->puHistogram[lf_hfs_stats_bucket(uNs)], 1, memory_order_relaxed );
+
+    uint64_t uMax = atomic_load_explicit( &psCounters->uMaxNs, memory_order_relaxed );
+    while ( uNs > uMax &&
+            !atomic_compare_exchange_weak_explicit( &psCounters->uMaxNs, &uMax, uNs, memory_order_relaxed, memory_order_relaxed ) );
+}
+
+int
+LFHFS_StatsGet( LFHFSOp_e eOp, LFHFSOpStats_S *psStats )
+{
+    if ( eOp >= LFHFS_OP_AMOUNT || psStats == NULL )
+    {
+        return EINVAL;
+    }
+
+    memset( psStats, 0, sizeof(*psStats) );
+
+    for ( uint32_t uShard = 0; uShard < LFHFS_STATS_SHARDS; uShard++ )
+    {
+        LFHFSOpCounters_S *psCounters = &gpsStatsShards[uShard].psOps[eOp];
+
+        psStats->uCalls   += atomic_load_explicit( &psCounters->uCalls,   memory_order_relaxed );
+        psStats->uErrors  += atomic_load_explicit( &psCounters->uErrors,  memory_order_relaxed );
+        psStats->uBytes   += atomic_load_explicit( &psCounters->uBytes,   memory_order_relaxed );
+        psStats->uTotalNs += atomic_load_explicit( &psCounters->uTotalNs, memory_order_relaxed );
+
+        uint64_t uMax = atomic_load_explicit( &psCounters->uMaxNs, memory_order_relaxed );
+        if ( uMax > psStats->uMaxNs )
+        {
+            psStats->uMaxNs = uMax;
+        }
+
+        for ( uint32_t uBucket = 0; uBucket < LFHFS_STATS_HIST_BUCKETS; uBucket++ )
+        {
+            psStats->puHistogram[uBucket] += atomic_load_explicit( &psCounters->puHistogram[uBucket], memory_order_relaxed );
+        }
+    }
+
+    return 0;
+}
+
+void
+LFHFS_StatsGetAll( LFHFSOpStats_S psStats[LFHFS_OP_AMOUNT] )
+{
+    for ( uint32_t uOp = 0; uOp < LFHFS_OP_AMOUNT; uOp++ )
+    {
+        LFHFS_StatsGet( (LFHFSOp_e)uOp, &psStats[uOp] );
+    }
+}
+
+// Not atomic with respect to concurrent LFHFS_StatsRecord calls; an
+// operation that completes during the reset may be partially counted.
+void
+LFHFS_StatsReset( void )
+{
+    for ( uint32_t uShard = 0; uShard < LFHFS_STATS_SHARDS; uShard++ )
+    {
+        for ( uint32_t uOp = 0; uOp < LFHFS_OP_AMOUNT; uOp++ )
+        {
+            LFHFSOpCounters_S *psCounters = &gpsStatsShards[uShard].psOps[uOp];
+
+            atomic_store_explicit( &psCounters->uCalls,   0, memory_order_relaxed );
+            atomic_store_explicit( &psCounters->uErrors,  0, memory_order_relaxed );
+            atomic_store_explicit( &psCounters->uBytes,   0, memory_order_relaxed );
+            atomic_store_explicit( &psCounters->uTotalNs, 0, memory_order_relaxed );
+            atomic_store_explicit( &psCounters->uMaxNs,   0, memory_order_relaxed );
+            for ( uint32_t uBucket = 0; uBucket < LFHFS_STATS_HIST_BUCKETS; uBucket++ )
+            {
+                atomic_store_explicit( &psCounters->puHistogram[uBucket], 0, memory_order_relaxed );
+            }
+        }
+    }
+
+    // The xattr cache byte count is a live gauge, not a counter, so it is kept.
+    atomic_store_explicit( &gXattrCacheStat.hits,      0, memory_order_relaxed );
+    atomic_store_explicit( &gXattrCacheStat.misses,    0, memory_order_relaxed );
+    atomic_store_explicit( &gXattrCacheStat.purges,    0, memory_order_relaxed );
+    atomic_store_explicit( &gXattrCacheStat.overflows, 0, memory_order_relaxed );
+}
+
+const char*
+LFHFS_StatsOpName( LFHFSOp_e eOp )
+{
+    if ( eOp >= LFHFS_OP_AMOUNT )
+    {
+        return "unknown";
+    }
+
+    return gpcOpNames[eOp];
+}
+
+// Returns the upper bound (in nanoseconds) of the histogram bucket holding
+// the requested percentile, capped by the largest latency observed.
+uint64_t
+LFHFS_StatsPercentileNs( const LFHFSOpStats_S *psStats, uint32_t uPercentile )
+{
+    if ( psStats == NULL || psStats->uCalls == 0 )
+    {
+        return 0;
+    }
+
+    if ( uPercentile > 100 )
+    {
+        uPercentile = 100;
+    }
+
+    uint64_t uTarget = (psStats->uCalls * uPercentile + 99) / 100;
+    uint64_t uSeen   = 0;
+
+    for ( uint32_t uBucket = 0; uBucket < LFHFS_STATS_HIST_BUCKETS; uBucket++ )
+    {
+        uSeen += psStats->puHistogram[uBucket];
+        if ( uSeen >= uTarget )
+        {
+            uint64_t uUpper = (2ULL << uBucket) - 1;
+            return (uUpper < psStats->uMaxNs) ? uUpper : psStats->uMaxNs;
+        }
+    }
+
+    return psStats->uMaxNs;
+}
+
+void
+LFHFS_StatsDump( FILE *psFile )
+{
+    LFHFSOpStats_S sStats;
+
+    fprintf( psFile, "%-16s %10s %8s %14s %12s %12s %12s %12s\n",
+             "op", "calls", "errors", "bytes", "avg(us)", "p50(us)", "p99(us)", "max(us)" );
+
+    for ( uint32_t uOp = 0; uOp < LFHFS_OP_AMOUNT; uOp++ )
+    {
+        LFHFS_StatsGet( (LFHFSOp_e)uOp, &sStats );
+        if ( sStats.uCalls == 0 )
+        {
+            continue;
+        }
+
+        fprintf( psFile, "%-16s %10llu %8llu %14llu %12.1f %12.1f %12.1f %12.1f\n",
+                 gpcOpNames[uOp],
+                 sStats.uCalls,
+                 sStats.uErrors,
+                 sStats.uBytes,
+                 (double)sStats.uTotalNs / sStats.uCalls / 1000.0,
+                 (double)LFHFS_StatsPercentileNs( &sStats, 50 ) / 1000.0,
+                 (double)LFHFS_StatsPercentileNs( &sStats, 99 ) / 1000.0,
+                 (double)sStats.uMaxNs / 1000.0 );
+    }
+
+    fprintf( psFile, "xattr cache: hits %llu misses %llu purges %llu overflows %llu bytes %llu\n",
+             atomic_load_explicit( &gXattrCacheStat.hits,      memory_order_relaxed ),
+             atomic_load_explicit( &gXattrCacheStat.misses,    memory_order_relaxed ),
+             atomic_load_explicit( &gXattrCacheStat.purges,    memory_order_relaxed ),
+             atomic_load_explicit( &gXattrCacheStat.overflows, memory_order_relaxed ),
+             atomic_load_explicit( &gXattrCacheStat.bytes,     memory_order_relaxed ) );
+}
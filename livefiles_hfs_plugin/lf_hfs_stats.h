@@ -0,0 +1,90 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_stats.h
+ *  livefiles_hfs
+ *
+ *  Per-operation call / error / byte counters and latency histograms
+ *  for the HFS_fsOps entry points.
+ */
+
+#ifndef lf_hfs_stats_h
+#define lf_hfs_stats_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of per-thread shards. Threads are assigned a shard round-robin on
+// their first recorded operation; threads beyond this count share shards.
+#define LFHFS_STATS_SHARDS              (32)
+
+// Latency histogram bucket i counts calls whose latency (in nanoseconds)
+// satisfies 2^i <= latency < 2^(i+1). Bucket 0 also counts sub-nanosecond
+// calls, the last bucket also counts everything above it (~68 seconds).
+#define LFHFS_STATS_HIST_BUCKETS        (36)
+
+typedef enum
+{
+    LFHFS_OP_INIT,
+    LFHFS_OP_FINI,
+    LFHFS_OP_TASTE,
+    LFHFS_OP_SCANVOLS,
+    LFHFS_OP_MOUNT,
+    LFHFS_OP_SYNC,
+    LFHFS_OP_UNMOUNT,
+    LFHFS_OP_GETFSATTR,
+    LFHFS_OP_SETFSATTR,
+    LFHFS_OP_GETATTR,
+    LFHFS_OP_SETATTR,
+    LFHFS_OP_LOOKUP,
+    LFHFS_OP_RECLAIM,
+    LFHFS_OP_READLINK,
+    LFHFS_OP_READ,
+    LFHFS_OP_WRITE,
+    LFHFS_OP_CREATE,
+    LFHFS_OP_MKDIR,
+    LFHFS_OP_SYMLINK,
+    LFHFS_OP_REMOVE,
+    LFHFS_OP_RMDIR,
+    LFHFS_OP_RENAME,
+    LFHFS_OP_READDIR,
+    LFHFS_OP_READDIRATTR,
+    LFHFS_OP_LINK,
+    LFHFS_OP_CHECK,
+    LFHFS_OP_GETXATTR,
+    LFHFS_OP_SETXATTR,
+    LFHFS_OP_LISTXATTR,
+    LFHFS_OP_SCANDIR,
+    LFHFS_OP_SCANIDS,
+    LFHFS_OP_STREAM_LOOKUP,
+    LFHFS_OP_STREAM_RECLAIM,
+    LFHFS_OP_STREAM_READ,
+    LFHFS_OP_AMOUNT,
+
+} LFHFSOp_e;
+
+typedef struct
+{
+    uint64_t uCalls;
+    uint64_t uErrors;
+    uint64_t uBytes;                                   // Bytes moved (read / write / readdir / xattr payload)
+    uint64_t uTotalNs;
+    uint64_t uMaxNs;
+    uint64_t puHistogram[LFHFS_STATS_HIST_BUCKETS];
+} LFHFSOpStats_S;
+
+// Timestamp (nanoseconds) to be passed to LFHFS_StatsRecord when the operation ends.
+uint64_t    LFHFS_StatsStart( void );
+void        LFHFS_StatsRecord( LFHFSOp_e eOp, uint64_t uStartNs, int iErr, uint64_t uBytes );
+
+// Query / reset API. psStats is the sum of all shards.
+int         LFHFS_StatsGet( LFHFSOp_e eOp, LFHFSOpStats_S *psStats );
+void        LFHFS_StatsGetAll( LFHFSOpStats_S psStats[LFHFS_OP_AMOUNT] );
+void        LFHFS_StatsReset( void );
+const char* LFHFS_StatsOpName( LFHFSOp_e eOp );
+uint64_t    LFHFS_StatsPercentileNs( const LFHFSOpStats_S *psStats, uint32_t uPercentile );
+// Dump prints every op that was called, then the xattr cache counters
+// (gXattrCacheStat). Reset also zeroes those, except the live byte count.
+void        LFHFS_StatsDump( FILE *psFile );
+
+#endif /* lf_hfs_stats_h */
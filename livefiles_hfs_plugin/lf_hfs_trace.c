@@ -0,0 +1,264 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_trace.c
+ *  livefiles_hfs
+ *
+ *  Per-thread binary trace rings for the HFSDBG tracepoints shared with the
+ *  kernel (see core/hfs_kdebug.h).
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "lf_hfs_trace.h"
+#include "lf_hfs_logger.h"
+#include "lf_hfs_vfsutils.h"
+
+/*
+ * Every ring has a single producer - the thread that owns it - so recording an
+ * event needs no lock and no atomic read-modify-write: the owner fills the slot
+ * and then publishes it by advancing uHead with a release store.
+ * LFHFS_TraceDump may race with the producer; it re-reads uHead after copying a
+ * ring and discards the slots that could have been overwritten meanwhile.
+ *
+ * Rings are never freed. They are pushed on a lock-free list when first
+ * allocated, and when their thread exits they are marked free for the next new
+ * thread to pick up, keeping the records already in them.
+ */
+typedef struct LFHFSTraceRing
+{
+    struct LFHFSTraceRing*  psNext;
+    _Atomic bool            bInUse;
+    uint64_t                uThreadID;
+    _Atomic uint64_t        uHead;      // Number of records ever written to this ring
+    _Atomic uint64_t        uTail;      // Records below this index were discarded by LFHFS_TraceReset
+    LFHFSTraceRecord_S      psRecords[LFHFS_TRACE_RING_RECORDS];
+} LFHFSTraceRing_S;
+
+_Atomic uint32_t guTraceMask = 0;
+
+static _Atomic(LFHFSTraceRing_S*)   gpsTraceRings       = NULL;
+static _Atomic uint32_t             guTraceRingsCount   = 0;
+static _Atomic uint64_t             guTraceDropped      = 0;
+static __thread LFHFSTraceRing_S*   gpsThreadRing       = NULL;
+static __thread bool                gbThreadRingFailed  = false;
+static pthread_key_t                gsTraceRingKey;
+static pthread_once_t               gsTraceRingKeyOnce  = PTHREAD_ONCE_INIT;
+
+_Static_assert((LFHFS_TRACE_RING_RECORDS & (LFHFS_TRACE_RING_RECORDS - 1)) == 0, "LFHFS_TRACE_RING_RECORDS must be a power of 2");
+
+static void
+lf_hfs_trace_ring_release( void* pvRing )
+{
+    LFHFSTraceRing_S* psRing = pvRing;
+    atomic_store_explicit( &psRing->bInUse, false, memory_order_release );
+}
+
+static void
+lf_hfs_trace_key_init( void )
+{
+    pthread_key_create( &gsTraceRingKey, lf_hfs_trace_ring_release );
+}
+
+static LFHFSTraceRing_S*
+lf_hfs_trace_attach_ring( void )
+{
+    LFHFSTraceRing_S* psRing = NULL;
+    uint64_t uThreadID = 0;
+
+    pthread_once( &gsTraceRingKeyOnce, lf_hfs_trace_key_init );
+    pthread_threadid_np( NULL, &uThreadID );
+
+    // Try to recycle the ring of a thread that already exited.
+    for ( psRing = atomic_load_explicit( &gpsTraceRings, memory_order_acquire ); psRing != NULL; psRing = psRing->psNext )
+    {
+        bool bInUse = false;
+        if ( atomic_compare_exchange_strong_explicit( &psRing->bInUse, &bInUse, true, memory_order_acquire, memory_order_relaxed ) )
+        {
+            break;
+        }
+    }
+
+    if ( psRing == NULL )
+    {
+        if ( atomic_fetch_add_explicit( &guTraceRingsCount, 1, memory_order_relaxed ) >= LFHFS_TRACE_MAX_RINGS )
+        {
+            atomic_fetch_sub_explicit( &guTraceRingsCount, 1, memory_order_relaxed );
+            return NULL;
+        }
+
+        psRing = hfs_mallocz( sizeof(LFHFSTraceRing_S) );
+        if ( psRing == NULL )
+        {
+            atomic_fetch_sub_explicit( &guTraceRingsCount, 1, memory_order_relaxed );
+            return NULL;
+        }
+        atomic_store_explicit( &psRing->bInUse, true, memory_order_relaxed );
+
+        LFHFSTraceRing_S* psHead = atomic_load_explicit( &gpsTraceRings, memory_order_relaxed );
+        do
+        {
+            psRing->psNext = psHead;
+        } while ( !atomic_compare_exchange_weak_explicit( &gpsTraceRings, &psHead, psRing, memory_order_release, memory_order_relaxed ) );
+    }
+
+    psRing->uThreadID = uThreadID;
+    pthread_setspecific( gsTraceRingKey, psRing );
+
+    return psRing;
+}
+
+void
+LFHFS_TraceRecord( uint32_t uDebugID, uint64_t uArg1, uint64_t uArg2, uint64_t uArg3, uint64_t uArg4, uint64_t uArg5 )
+{
+    LFHFSTraceRing_S* psRing = gpsThreadRing;
+
+    if ( psRing == NULL )
+    {
+        if ( !gbThreadRingFailed )
+        {
+            psRing = gpsThreadRing = lf_hfs_trace_attach_ring();
+            gbThreadRingFailed = (psRing == NULL);
+        }
+
+        if ( psRing == NULL )
+        {
+            atomic_fetch_add_explicit( &guTraceDropped, 1, memory_order_relaxed );
+            return;
+        }
+    }
+
+    uint64_t uHead = atomic_load_explicit( &psRing->uHead, memory_order_relaxed );
+    LFHFSTraceRecord_S* psRecord = &psRing->psRecords[uHead & (LFHFS_TRACE_RING_RECORDS - 1)];
+
+    psRecord->uTimestampNs = clock_gettime_nsec_np( CLOCK_UPTIME_RAW );
+    psRecord->uThreadID    = psRing->uThreadID;
+    psRecord->uDebugID     = uDebugID;
+    psRecord->uReserved    = 0;
+    psRecord->puArgs[0]    = uArg1;
+    psRecord->puArgs[1]    = uArg2;
+    psRecord->puArgs[2]    = uArg3;
+    psRecord->puArgs[3]    = uArg4;
+    psRecord->puArgs[4]    = uArg5;
+
+    atomic_store_explicit( &psRing->uHead, uHead + 1, memory_order_release );
+}
+
+void
+LFHFS_TraceInit( void )
+{
+    const char* pcMask = getenv( "LFHFS_TRACE_MASK" );
+    if ( pcMask != NULL )
+    {
+        LFHFS_TraceSetMask( (uint32_t)strtoul( pcMask, NULL, 0 ) );
+    }
+}
+
+void
+LFHFS_TraceSetMask( uint32_t uMask )
+{
+    atomic_store_explicit( &guTraceMask, uMask, memory_order_relaxed );
+}
+
+uint32_t
+LFHFS_TraceGetMask( void )
+{
+    return atomic_load_explicit( &guTraceMask, memory_order_relaxed );
+}
+
+void
+LFHFS_TraceReset( void )
+{
+    for ( LFHFSTraceRing_S* psRing = atomic_load_explicit( &gpsTraceRings, memory_order_acquire ); psRing != NULL; psRing = psRing->psNext )
+    {
+        atomic_store_explicit( &psRing->uTail, atomic_load_explicit( &psRing->uHead, memory_order_acquire ), memory_order_relaxed );
+    }
+
+    atomic_store_explicit( &guTraceDropped, 0, memory_order_relaxed );
+}
+
+int
+LFHFS_TraceDump( const char* pcPath )
+{
+    int iErr = 0;
+    LFHFSTraceFileHeader_S sHeader = {
+        .uMagic         = LFHFS_TRACE_FILE_MAGIC,
+        .uVersion       = LFHFS_TRACE_FILE_VERSION,
+        .uRecordSize    = sizeof(LFHFSTraceRecord_S),
+    };
+
+    LFHFSTraceRecord_S* psSnapshot = hfs_malloc( sizeof(LFHFSTraceRecord_S) * LFHFS_TRACE_RING_RECORDS );
+    if ( psSnapshot == NULL )
+    {
+        return ENOMEM;
+    }
+
+    FILE* psFile = fopen( pcPath, "wb" );
+    if ( psFile == NULL )
+    {
+        iErr = errno;
+        LFHFS_LOG( LEVEL_ERROR, "LFHFS_TraceDump: failed to open %s (%d)\n", pcPath, iErr );
+        goto exit;
+    }
+
+    // Reserve room for the header, written once the record count is known.
+    if ( fwrite( &sHeader, sizeof(sHeader), 1, psFile ) != 1 )
+    {
+        iErr = EIO;
+        goto exit;
+    }
+
+    for ( LFHFSTraceRing_S* psRing = atomic_load_explicit( &gpsTraceRings, memory_order_acquire ); psRing != NULL; psRing = psRing->psNext )
+    {
+        uint64_t uHead  = atomic_load_explicit( &psRing->uHead, memory_order_acquire );
+        uint64_t uFirst = atomic_load_explicit( &psRing->uTail, memory_order_relaxed );
+        if ( uHead > LFHFS_TRACE_RING_RECORDS && uFirst < uHead - LFHFS_TRACE_RING_RECORDS )
+        {
+            uFirst = uHead - LFHFS_TRACE_RING_RECORDS;
+        }
+
+        for ( uint64_t uIdx = uFirst; uIdx < uHead; uIdx++ )
+        {
+            psSnapshot[uIdx - uFirst] = psRing->psRecords[uIdx & (LFHFS_TRACE_RING_RECORDS - 1)];
+        }
+
+        // The owner may have lapped us while copying; the slot it is filling
+        // now, and everything it published since, overwrote our oldest copies.
+        uint64_t uHeadAfter = atomic_load_explicit( &psRing->uHead, memory_order_acquire );
+        uint64_t uValid     = uFirst;
+        if ( uHeadAfter + 1 > LFHFS_TRACE_RING_RECORDS && uValid < uHeadAfter + 1 - LFHFS_TRACE_RING_RECORDS )
+        {
+            uValid = uHeadAfter + 1 - LFHFS_TRACE_RING_RECORDS;
+        }
+        if ( uValid >= uHead )
+        {
+            continue;
+        }
+
+        uint64_t uCount = uHead - uValid;
+        if ( fwrite( &psSnapshot[uValid - uFirst], sizeof(LFHFSTraceRecord_S), uCount, psFile ) != uCount )
+        {
+            iErr = EIO;
+            goto exit;
+        }
+        sHeader.uRecordCount += uCount;
+    }
+
+    sHeader.uDroppedCount = atomic_load_explicit( &guTraceDropped, memory_order_relaxed );
+    if ( fseek( psFile, 0, SEEK_SET ) != 0 || fwrite( &sHeader, sizeof(sHeader), 1, psFile ) != 1 )
+    {
+        iErr = EIO;
+        goto exit;
+    }
+
+exit:
+    if ( psFile != NULL && fclose( psFile ) != 0 && iErr == 0 )
+    {
+        iErr = EIO;
+    }
+    hfs_free( psSnapshot );
+
+    return iErr;
+}
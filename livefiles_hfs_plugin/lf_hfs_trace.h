@@ -0,0 +1,108 @@
+/*  Copyright © 2026 Apple Inc. All rights reserved.
+ *
+ *  lf_hfs_trace.h
+ *  livefiles_hfs
+ *
+ *  Per-thread binary trace rings for the HFSDBG tracepoints shared with the
+ *  kernel (see core/hfs_kdebug.h). A dump can be decoded into a timeline and
+ *  per-event latency table with scripts/lf_hfs_trace_decode.py.
+ */
+
+#ifndef lf_hfs_trace_h
+#define lf_hfs_trace_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "lf_hfs_common.h"
+#include "../core/hfs_kdebug.h"
+
+enum {
+    /*
+     * HFSDBG_ALLOC_ENABLED: Log calls to BlockAllocate and
+     * BlockDeallocate, including the internal BlockAllocateXxx
+     * routines so we can see how an allocation was satisfied.
+     *
+     * HFSDBG_EXT_CACHE_ENABLED: Log routines that read or write the
+     * free extent cache.
+     *
+     * HFSDBG_UNMAP_ENABLED: Log events involving the trim list.
+     *
+     * HFSDBG_BITMAP_ENABLED: Log accesses to the volume bitmap (setting
+     * or clearing bits, scanning the bitmap).
+     *
+     * HFSDBG_JOURNAL_ENABLED: Log journal transactions, flushes, replay
+     * and the time spent waiting on the journal lock / flush conditions.
+     */
+    HFSDBG_ALLOC_ENABLED        = 1,
+    HFSDBG_EXT_CACHE_ENABLED    = 2,
+    HFSDBG_UNMAP_ENABLED        = 4,
+    HFSDBG_BITMAP_ENABLED       = 8,
+    HFSDBG_JOURNAL_ENABLED      = 16,
+
+    HFSDBG_ALL_ENABLED          = 0xFFFFFFFF
+};
+
+// Records kept per thread. Must be a power of 2; older records are overwritten.
+#define LFHFS_TRACE_RING_RECORDS        (4096)
+// Maximal number of rings (threads tracing at the same time). Rings of exited
+// threads are recycled; events of threads beyond this count are dropped.
+#define LFHFS_TRACE_MAX_RINGS           (64)
+
+#define LFHFS_TRACE_FILE_MAGIC          (0x5448464C) // "LFHT"
+#define LFHFS_TRACE_FILE_VERSION        (1)
+
+typedef struct
+{
+    uint64_t uTimestampNs;      // CLOCK_UPTIME_RAW
+    uint64_t uThreadID;
+    uint32_t uDebugID;          // HFSDBG_* / DBG_JOURNAL_* | DBG_FUNC_START / DBG_FUNC_END / DBG_FUNC_NONE
+    uint32_t uReserved;
+    uint64_t puArgs[5];
+} LFHFSTraceRecord_S;
+
+// A dump file is this header followed by uRecordCount LFHFSTraceRecord_S,
+// all in host byte order. Records are grouped by ring, not sorted by time.
+typedef struct
+{
+    uint32_t uMagic;
+    uint32_t uVersion;
+    uint32_t uRecordSize;
+    uint32_t uReserved;
+    uint64_t uRecordCount;
+    uint64_t uDroppedCount;
+} LFHFSTraceFileHeader_S;
+
+#if LF_HFS_TRACE_SUPPORT
+
+extern _Atomic uint32_t guTraceMask;
+
+/*
+ * Tracepoints take the same arguments as the kernel's KERNEL_DEBUG_CONSTANT,
+ * prefixed with the HFSDBG_*_ENABLED class gating them. With tracing disabled
+ * at runtime a tracepoint costs a single relaxed load; with LF_HFS_TRACE_SUPPORT
+ * set to 0 it compiles out completely.
+ */
+#define LFHFS_TRACE(uClass, uDebugID, a1, a2, a3, a4, a5)                                       \
+    do {                                                                                        \
+        if (__builtin_expect((atomic_load_explicit(&guTraceMask, memory_order_relaxed) & (uClass)) != 0, 0)) { \
+            LFHFS_TraceRecord((uDebugID), (uint64_t)(a1), (uint64_t)(a2), (uint64_t)(a3),       \
+                              (uint64_t)(a4), (uint64_t)(a5));                                  \
+        }                                                                                       \
+    } while (0)
+
+#else
+
+#define LFHFS_TRACE(uClass, uDebugID, a1, a2, a3, a4, a5)   do {} while (0)
+
+#endif /* LF_HFS_TRACE_SUPPORT */
+
+// Reads the LFHFS_TRACE_MASK environment variable (if set) into the trace mask.
+void        LFHFS_TraceInit( void );
+void        LFHFS_TraceSetMask( uint32_t uMask );
+uint32_t    LFHFS_TraceGetMask( void );
+void        LFHFS_TraceRecord( uint32_t uDebugID, uint64_t uArg1, uint64_t uArg2, uint64_t uArg3, uint64_t uArg4, uint64_t uArg5 );
+void        LFHFS_TraceReset( void );
+int         LFHFS_TraceDump( const char* pcPath );
+
+#endif /* lf_hfs_trace_h */
@@ -36,6 +36,7 @@
 #include "lf_hfs_fsops_handler.h"
 #include "lf_hfs_journal.h"
 #include "lf_hfs_fileops_handler.h"
+#include "lf_hfs_rmtree.h"
 
 #include <spawn.h>
 
@@ -291,6 +292,9 @@ mount_passed:
     /* Set up the maximum defrag file size */
     hfsmp->hfs_defrag_max = HFS_INITIAL_DEFRAG_SIZE;
 
+    /* Finish removing directory trees cut short by a crash */
+    hfs_remove_orphan_trees(hfsmp);
+
     if (!data)
     {
         // Root mount
@@ -466,6 +470,8 @@ static int hfs_InitialMount(struct vnode *devvp, struct mount *mp, struct hfs_mo
      */
     lf_lck_mtx_init(&(*hfsmp)->hfs_mutex);
     lf_lck_mtx_init(&(*hfsmp)->sync_mutex);
+    lf_lck_mtx_init(&(*hfsmp)->hfs_deferred_mutex);
+    TAILQ_INIT(&(*hfsmp)->hfs_deferred_cnodes);
     lf_lck_rw_init(&(*hfsmp)->hfs_global_lock);
     lf_lck_spin_init(&(*hfsmp)->vcbFreeExtLock);
 
@@ -752,6 +758,7 @@ error_exit:
         hfs_locks_destroy(*hfsmp);
         hfs_delete_chash(*hfsmp);
         hfs_idhash_destroy (*hfsmp);
+        cat_free_cnids_destroy (*hfsmp);
 
         hfs_free(*hfsmp);
         *hfsmp = NULL;
@@ -820,6 +827,7 @@ int hfs_ScanVolGetVolName(int iFd, char* pcVolumeName)
         hfs_locks_destroy(hfsmp);
         hfs_delete_chash(hfsmp);
         hfs_idhash_destroy (hfsmp);
+        cat_free_cnids_destroy (hfsmp);
         
         hfs_free(hfsmp);
         hfsmp = NULL;
@@ -894,6 +902,7 @@ error_exit:
         hfs_locks_destroy(hfsmp);
         hfs_delete_chash(hfsmp);
         hfs_idhash_destroy (hfsmp);
+        cat_free_cnids_destroy (hfsmp);
 
         hfs_free(hfsmp);
         hfsmp = NULL;
@@ -910,6 +919,7 @@ hfs_locks_destroy(struct hfsmount *hfsmp)
 
     lf_lck_mtx_destroy(&hfsmp->hfs_mutex);
     lf_lck_mtx_destroy(&hfsmp->sync_mutex);
+    lf_lck_mtx_destroy(&hfsmp->hfs_deferred_mutex);
     lf_lck_rw_destroy(&hfsmp->hfs_global_lock);
     lf_lck_spin_destroy(&hfsmp->vcbFreeExtLock);
 
@@ -1563,12 +1573,16 @@ hfs_getvoluuid(struct hfsmount *hfsmp, uuid_t result_uuid)
 }
 
 /*
- * Call into the allocator code and perform a full scan of the bitmap file.
- *
- * This allows us to TRIM unallocated ranges if needed, and also to build up
- * an in-memory summary table of the state of the allocated blocks.
+ * Bits of bitmap the background scan handles per lock hold: 1MB worth of
+ * bitmap, read in vcbVBMIOSize pieces.
  */
-void hfs_scan_blocks (struct hfsmount *hfsmp)
+#define HFS_SCAN_BITS_PER_PASS      (MAXBSIZE * 8)
+
+/*
+ * Scan the whole bitmap synchronously.  Used if the background thread
+ * cannot be started.
+ */
+static void hfs_scan_blocks_sync (struct hfsmount *hfsmp)
 {
     /*
      * Take the allocation file lock.  Journal transactions will block until
@@ -1577,25 +1591,105 @@ void hfs_scan_blocks (struct hfsmount *hfsmp)
     int flags = hfs_systemfile_lock(hfsmp, SFL_BITMAP, HFS_EXCLUSIVE_LOCK);
 
     /*
-     * We serialize here with the HFS mount lock as we're mounting.
-     *
-     * The mount can only proceed once this thread has acquired the bitmap
-     * lock, since we absolutely do not want someone else racing in and
-     * getting the bitmap lock, doing a read/write of the bitmap file,
-     * then us getting the bitmap lock.
-     *
-     * To prevent this, the mount thread takes the HFS mount mutex, starts us
-     * up, then immediately msleeps on the scan_var variable in the mount
-     * point as a condition variable.  This serialization is safe since
-     * if we race in and try to proceed while they're still holding the lock,
-     * we'll block trying to acquire the global lock.  Since the mount thread
-     * acquires the HFS mutex before starting this function in a new thread,
-     * any lock acquisition on our part must be linearizably AFTER the mount thread's.
+     * ScanUnmapBlocks assumes that the bitmap lock is held when you
+     * call the function. We don't care if there were any errors issuing unmaps.
      *
-     * Note that the HFS mount mutex is always taken last, and always for only
-     * a short time.  In this case, we just take it long enough to mark the
-     * scan-in-flight bit.
+     * It will also attempt to build up the summary table for subsequent
+     * allocator use, as configured.
      */
+    (void) ScanUnmapBlocks(hfsmp);
+
+    (void) hfs_lock_mount (hfsmp);
+    hfsmp->scan_var &= ~HFS_ALLOCATOR_SCAN_INFLIGHT;
+    hfsmp->scan_var |= HFS_ALLOCATOR_SCAN_COMPLETED;
+    hfs_unlock_mount (hfsmp);
+
+    hfs_systemfile_unlock(hfsmp, flags);
+}
+
+/*
+ * Background bitmap scan.
+ *
+ * The bitmap is scanned a pass at a time, each pass under its own hold of
+ * the bitmap lock, so allocations and frees interleave with the scan.  The
+ * allocator does not need to know how far the scan got: summary bits are
+ * zero ("may have free blocks") until scanned, so searches in chunks the
+ * scan has not reached read the bitmap, and the free extent cache is only
+ * a hint.
+ *
+ * Free blocks are unmapped as they are found.  A block freed by a
+ * transaction that is not yet in the journal on disk must not be unmapped,
+ * since replay may bring the file that owned it back.  So when unmapping,
+ * each pass holds the global lock exclusive (no transaction is open) and
+ * flushes the journal first.
+ */
+static void* hfs_scan_blocks_thread (void *arg)
+{
+    struct hfsmount *hfsmp = arg;
+    u_int32_t startbit = 0;
+    u_int32_t nextbit;
+    int error = 0;
+
+    pthread_setname_np("hfs_scan_blocks");
+
+    while (startbit < hfsmp->totalBlocks)
+    {
+        bool stop;
+        hfs_lock_mount (hfsmp);
+        stop = (hfsmp->scan_var & HFS_ALLOCATOR_SCAN_STOP) != 0;
+        hfs_unlock_mount (hfsmp);
+        if (stop)
+            break;
+
+        /*
+         * The journal can be enabled or disabled while the volume is mounted
+         * (lf_hfs_jnlconfig.c), always under the global lock, so it is only
+         * looked at once we hold that lock.
+         */
+        bool unmap = (hfsmp->hfs_flags & HFS_UNMAP) && !(hfsmp->hfs_flags & HFS_READ_ONLY);
+        if (unmap)
+        {
+            hfs_lock_global (hfsmp, HFS_EXCLUSIVE_LOCK);
+            if (hfsmp->jnl)
+                journal_flush(hfsmp->jnl, JOURNAL_WAIT_FOR_IO);
+        }
+
+        int flags = hfs_systemfile_lock(hfsmp, SFL_BITMAP, HFS_EXCLUSIVE_LOCK);
+        error = ScanUnmapBlocksRange(hfsmp, startbit, HFS_SCAN_BITS_PER_PASS, unmap, &nextbit);
+        hfs_systemfile_unlock(hfsmp, flags);
+
+        if (unmap)
+            hfs_unlock_global (hfsmp);
+
+        if (error || nextbit <= startbit)
+        {
+            LFHFS_LOG(LEVEL_ERROR, "hfs_scan_blocks_thread: scan stopped at bit %u on %s (%d)\n", startbit, hfsmp->vcbVN, error);
+            break;
+        }
+        startbit = nextbit;
+    }
+
+    (void) hfs_lock_mount (hfsmp);
+    hfsmp->scan_var &= ~HFS_ALLOCATOR_SCAN_INFLIGHT;
+    if (startbit >= hfsmp->totalBlocks)
+        hfsmp->scan_var |= HFS_ALLOCATOR_SCAN_COMPLETED;
+    hfs_unlock_mount (hfsmp);
+
+    return NULL;
+}
+
+/*
+ * Call into the allocator code and scan the bitmap file.
+ *
+ * This allows us to TRIM unallocated ranges if needed, and also to build up
+ * an in-memory summary table of the state of the allocated blocks.  The scan
+ * is linear in the volume size, so it runs on a background thread and the
+ * mount does not wait for it; hfs_scan_blocks_stop ends it at unmount.
+ */
+void hfs_scan_blocks (struct hfsmount *hfsmp)
+{
+    int flags = hfs_systemfile_lock(hfsmp, SFL_BITMAP, HFS_EXCLUSIVE_LOCK);
+
     (void) hfs_lock_mount (hfsmp);
     hfsmp->scan_var |= HFS_ALLOCATOR_SCAN_INFLIGHT;
     hfs_unlock_mount (hfsmp);
@@ -1606,21 +1700,38 @@ void hfs_scan_blocks (struct hfsmount *hfsmp)
         LFHFS_LOG(LEVEL_DEBUG, "hfs_scan_blocks: could not initialize summary table for %s\n", hfsmp->vcbVN);
     }
 
-    /*
-     * ScanUnmapBlocks assumes that the bitmap lock is held when you
-     * call the function. We don't care if there were any errors issuing unmaps.
-     *
-     * It will also attempt to build up the summary table for subsequent
-     * allocator use, as configured.
-     */
-    (void) ScanUnmapBlocks(hfsmp);
+    hfs_systemfile_unlock(hfsmp, flags);
+
+    if (pthread_create(&hfsmp->hfs_scan_thread, NULL, hfs_scan_blocks_thread, hfsmp) == 0)
+    {
+        (void) hfs_lock_mount (hfsmp);
+        hfsmp->scan_var |= HFS_ALLOCATOR_SCAN_THREAD;
+        hfs_unlock_mount (hfsmp);
+    }
+    else
+    {
+        LFHFS_LOG(LEVEL_ERROR, "hfs_scan_blocks: could not start the background scan, scanning %s now\n", hfsmp->vcbVN);
+        hfs_scan_blocks_sync(hfsmp);
+    }
+}
+
+/*
+ * Stop the background bitmap scan, if any, and wait for it to exit.
+ * Must be called before the bitmap vnode, the journal or the summary
+ * table go away, without holding the global or bitmap locks.
+ */
+void hfs_scan_blocks_stop (struct hfsmount *hfsmp)
+{
+    bool join;
 
     (void) hfs_lock_mount (hfsmp);
-    hfsmp->scan_var &= ~HFS_ALLOCATOR_SCAN_INFLIGHT;
-    hfsmp->scan_var |= HFS_ALLOCATOR_SCAN_COMPLETED;
+    join = (hfsmp->scan_var & HFS_ALLOCATOR_SCAN_THREAD) != 0;
+    hfsmp->scan_var |= HFS_ALLOCATOR_SCAN_STOP;
+    hfsmp->scan_var &= ~HFS_ALLOCATOR_SCAN_THREAD;
     hfs_unlock_mount (hfsmp);
 
-    hfs_systemfile_unlock(hfsmp, flags);
+    if (join)
+        pthread_join(hfsmp->hfs_scan_thread, NULL);
 }
 
 /*
@@ -1844,6 +1955,8 @@ int hfs_unmount(struct mount *mp)
     struct hfsmount *hfsmp = VFSTOHFS(mp);
     int retval = E_NONE;
     
+    hfs_scan_blocks_stop(hfsmp);
+
     if (hfsmp->hfs_flags & HFS_SUMMARY_TABLE)
     {
         if (hfsmp->hfs_summary_table)
@@ -1885,6 +1998,7 @@ int hfs_unmount(struct mount *mp)
     hfs_locks_destroy(hfsmp);
     hfs_delete_chash(hfsmp);
     hfs_idhash_destroy(hfsmp);
+    cat_free_cnids_destroy(hfsmp);
 
     hfs_assert(TAILQ_EMPTY(&hfsmp->hfs_reserved_ranges[HFS_TENTATIVE_BLOCKS]) && TAILQ_EMPTY(&hfsmp->hfs_reserved_ranges[HFS_LOCKED_BLOCKS]));
     hfs_assert(!hfsmp->lockedBlocks);
@@ -1935,6 +2049,16 @@ hfs_setencodingbits(struct hfsmount *hfsmp, u_int32_t encoding)
  */
 int
 hfs_volupdate(struct hfsmount *hfsmp, enum volop op, int inroot)
+{
+    return hfs_volupdate_count(hfsmp, op, inroot, 1);
+}
+
+/*
+ * Same as hfs_volupdate for count operations of the same kind, with a
+ * single volume header flush.
+ */
+int
+hfs_volupdate_count(struct hfsmount *hfsmp, enum volop op, int inroot, u_int32_t count)
 {
     struct timeval tv;
     microtime(&tv);
@@ -1943,33 +2067,35 @@ hfs_volupdate(struct hfsmount *hfsmp, enum volop op, int inroot)
     MarkVCBDirty(hfsmp);
     hfsmp->hfs_mtime = tv.tv_sec;
 
-    switch (op) {
-        case VOL_UPDATE:
-            break;
-        case VOL_MKDIR:
-            if (hfsmp->hfs_dircount != 0xFFFFFFFF)
-                ++hfsmp->hfs_dircount;
-            if (inroot && hfsmp->vcbNmRtDirs != 0xFFFF)
-                ++hfsmp->vcbNmRtDirs;
-            break;
-        case VOL_RMDIR:
-            if (hfsmp->hfs_dircount != 0)
-                --hfsmp->hfs_dircount;
-            if (inroot && hfsmp->vcbNmRtDirs != 0xFFFF)
-                --hfsmp->vcbNmRtDirs;
-            break;
-        case VOL_MKFILE:
-            if (hfsmp->hfs_filecount != 0xFFFFFFFF)
-                ++hfsmp->hfs_filecount;
-            if (inroot && hfsmp->vcbNmFls != 0xFFFF)
-                ++hfsmp->vcbNmFls;
-            break;
-        case VOL_RMFILE:
-            if (hfsmp->hfs_filecount != 0)
-                --hfsmp->hfs_filecount;
-            if (inroot && hfsmp->vcbNmFls != 0xFFFF)
-                --hfsmp->vcbNmFls;
-            break;
+    for (u_int32_t i = 0; i < count; i++) {
+        switch (op) {
+            case VOL_UPDATE:
+                break;
+            case VOL_MKDIR:
+                if (hfsmp->hfs_dircount != 0xFFFFFFFF)
+                    ++hfsmp->hfs_dircount;
+                if (inroot && hfsmp->vcbNmRtDirs != 0xFFFF)
+                    ++hfsmp->vcbNmRtDirs;
+                break;
+            case VOL_RMDIR:
+                if (hfsmp->hfs_dircount != 0)
+                    --hfsmp->hfs_dircount;
+                if (inroot && hfsmp->vcbNmRtDirs != 0xFFFF)
+                    --hfsmp->vcbNmRtDirs;
+                break;
+            case VOL_MKFILE:
+                if (hfsmp->hfs_filecount != 0xFFFFFFFF)
+                    ++hfsmp->hfs_filecount;
+                if (inroot && hfsmp->vcbNmFls != 0xFFFF)
+                    ++hfsmp->vcbNmFls;
+                break;
+            case VOL_RMFILE:
+                if (hfsmp->hfs_filecount != 0)
+                    --hfsmp->hfs_filecount;
+                if (inroot && hfsmp->vcbNmFls != 0xFFFF)
+                    --hfsmp->vcbNmFls;
+                break;
+        }
     }
 
     hfs_unlock_mount (hfsmp);
@@ -34,10 +34,12 @@ int     hfs_mount(struct mount *mp, vnode_t devvp, user_addr_t data);
 int     hfs_ScanVolGetVolName(int iFd, char* pcVolumeName);
 void    hfs_getvoluuid(struct hfsmount *hfsmp, uuid_t result_uuid);
 void    hfs_scan_blocks (struct hfsmount *hfsmp);
+void    hfs_scan_blocks_stop (struct hfsmount *hfsmp);
 int     hfs_vfs_root(struct mount *mp, struct vnode **vpp);
 int     hfs_unmount(struct mount *mp);
 void    hfs_setencodingbits(struct hfsmount *hfsmp, u_int32_t encoding);
 int     hfs_volupdate(struct hfsmount *hfsmp, enum volop op, int inroot);
+int     hfs_volupdate_count(struct hfsmount *hfsmp, enum volop op, int inroot, u_int32_t count);
 int     hfs_vget(struct hfsmount *hfsmp, cnid_t cnid, struct vnode **vpp, int skiplock, int allow_deleted);
 int     hfs_GetInfoByID(struct hfsmount *hfsmp, cnid_t cnid, UVFSFileAttributes *file_attrs, char pcName[MAX_UTF8_NAME_LENGTH]);
 int     fsck_hfs(int fd, check_flags_t how);
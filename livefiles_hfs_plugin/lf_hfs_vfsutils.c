@@ -126,10 +126,10 @@ int hfs_CollectBtreeStats(struct hfsmount *hfsmp, HFSPlusVolumeHeader *vhp, off_
     hfs_getvoluuid (hfsmp, throwaway);
 
     /*
-     * We now always initiate a full bitmap scan even if the volume is read-only because this is
-     * our only shot to do I/Os of dramaticallly different sizes than what the buffer cache ordinarily
-     * expects. TRIMs will not be delivered to the underlying media if the volume is not
-     * read-write though.
+     * We now always initiate a full bitmap scan even if the volume is read-only, to build
+     * the summary table and free extent cache. TRIMs will not be delivered to the underlying
+     * media if the volume is not read-write though. The scan runs in the background; see
+     * hfs_scan_blocks.
      */
     hfsmp->scan_var = 0;
 
@@ -1199,6 +1199,8 @@ static void ReleaseMetaFileVNode(struct vnode *vp)
 int
 hfsUnmount( register struct hfsmount *hfsmp)
 {
+    /* The background bitmap scan uses the system files released below. */
+    hfs_scan_blocks_stop(hfsmp);
 
     /* Get rid of our attribute data vnode (if any).  This is done
      * after the vflush() during mount, so we don't need to worry
@@ -1579,30 +1581,67 @@ short MacToVFSError(OSErr err)
     }
 }
 
+#define HFS_DIRHINT_BUCKET(dcp, index)  (&(dcp)->c_hinthash[((u_int32_t)(index) ^ ((u_int32_t)(index) >> HFS_INDEX_BITS)) & (HFS_DIRHINT_HASH_SIZE - 1)])
+
+static void
+hfs_dirhint_freename(directoryhint_t *hint)
+{
+    const u_int8_t * name = hint->dh_desc.cd_nameptr;
+
+    if ((hint->dh_desc.cd_flags & CD_HASBUF) && (name != NULL))
+    {
+        hint->dh_desc.cd_nameptr = NULL;
+        hint->dh_desc.cd_namelen = 0;
+        hint->dh_desc.cd_flags &= ~CD_HASBUF;
+        hfs_free((void*)name);
+    }
+}
+
+/* Unlink a hint from the list and hash.  Requires c_hint_mutex. */
+static void
+hfs_dirhint_unlink(struct cnode *dcp, directoryhint_t *hint)
+{
+    TAILQ_REMOVE(&dcp->c_hintlist, hint, dh_link);
+    LIST_REMOVE(hint, dh_hash);
+    --dcp->c_dirhintcnt;
+}
+
+/* Link a hint at the head (newest end) of the list.  Requires c_hint_mutex. */
+static void
+hfs_dirhint_link(struct cnode *dcp, directoryhint_t *hint)
+{
+    TAILQ_INSERT_HEAD(&dcp->c_hintlist, hint, dh_link);
+    LIST_INSERT_HEAD(HFS_DIRHINT_BUCKET(dcp, hint->dh_index), hint, dh_hash);
+    ++dcp->c_dirhintcnt;
+}
+
 /*
  * Find the current thread's directory hint for a given index.
  *
- * Requires an exclusive lock on directory cnode.
- *
- * Use detach if the cnode lock must be dropped while the hint is still active.
+ * The hints are protected by c_hint_mutex, so the directory cnode only
+ * needs to be locked shared.  A hint that is used with only a shared
+ * lock must be detached: nobody else can then find it, and two readers
+ * never work on the same hint.  Put it back with hfs_insertdirhint or
+ * free it with hfs_reldirhint.
  */
 directoryhint_t*
 hfs_getdirhint(struct cnode *dcp, int index, int detach)
 {
 
     directoryhint_t *hint;
-    boolean_t need_remove, need_init;
-    const u_int8_t* name;
+    boolean_t need_init;
     struct timeval tv;
     microtime(&tv);
 
+    lf_lck_mtx_lock(&dcp->c_hint_mutex);
+
     /*
      *  Look for an existing hint first.  If not found, create a new one (when
      *  the list is not full) or recycle the oldest hint.  Since new hints are
      *  always added to the head of the list, the last hint is always the
      *  oldest.
      */
-    TAILQ_FOREACH(hint, &dcp->c_hintlist, dh_link)
+    LIST_FOREACH(hint, HFS_DIRHINT_BUCKET(dcp, index), dh_hash)
     {
         if (hint->dh_index == index)
             break;
@@ -1610,7 +1649,7 @@ hfs_getdirhint(struct cnode *dcp, int index, int detach)
     if (hint != NULL)
     { /* found an existing hint */
         need_init = false;
-        need_remove = true;
+        hfs_dirhint_unlink(dcp, hint);
     }
     else
     { /* cannot find an existing hint */
@@ -1619,32 +1658,16 @@ hfs_getdirhint(struct cnode *dcp, int index, int detach)
         { /* we don't need recycling */
             /* Create a default directory hint */
             hint = hfs_malloc(sizeof(struct directoryhint));
-            ++dcp->c_dirhintcnt;
-            need_remove = false;
         }
         else
         {
             /* recycle the last (i.e., the oldest) hint */
             hint = TAILQ_LAST(&dcp->c_hintlist, hfs_hinthead);
-            if ((hint->dh_desc.cd_flags & CD_HASBUF) && (name = hint->dh_desc.cd_nameptr))
-            {
-                hint->dh_desc.cd_nameptr = NULL;
-                hint->dh_desc.cd_namelen = 0;
-                hint->dh_desc.cd_flags &= ~CD_HASBUF;
-                hfs_free((void*)name);
-            }
-            need_remove = true;
+            hfs_dirhint_unlink(dcp, hint);
+            hfs_dirhint_freename(hint);
         }
     }
 
-    if (need_remove)
-        TAILQ_REMOVE(&dcp->c_hintlist, hint, dh_link);
-
-    if (detach)
-        --dcp->c_dirhintcnt;
-    else
-        TAILQ_INSERT_HEAD(&dcp->c_hintlist, hint, dh_link);
-
     if (need_init)
     {
         hint->dh_index = index;
@@ -1657,64 +1680,98 @@ hfs_getdirhint(struct cnode *dcp, int index, int detach)
         hint->dh_desc.cd_cnid = 0;
     }
     hint->dh_time = (uint32_t) tv.tv_sec;
+
+    if (!detach)
+        hfs_dirhint_link(dcp, hint);
+
+    lf_lck_mtx_unlock(&dcp->c_hint_mutex);
     return (hint);
 }
 
 /*
  * Insert a detached directory hint back into the list of dirhints.
  *
- * Requires an exclusive lock on directory cnode.
+ * If two readers continued from the same cookie, each with its own
+ * hint, the older hint for that index is dropped.
  */
 void
 hfs_insertdirhint(struct cnode *dcp, directoryhint_t * hint)
 {
-    directoryhint_t *test;
+    directoryhint_t *test, *next;
 
-    TAILQ_FOREACH(test, &dcp->c_hintlist, dh_link)
+    lf_lck_mtx_lock(&dcp->c_hint_mutex);
+
+    LIST_FOREACH_SAFE(test, HFS_DIRHINT_BUCKET(dcp, hint->dh_index), dh_hash, next)
     {
         if (test == hint)
         {
             LFHFS_LOG(LEVEL_ERROR, "hfs_insertdirhint: hint %p already on list!", hint);
             hfs_assert(0);
         }
+        if (test->dh_index == hint->dh_index)
+        {
+            hfs_dirhint_unlink(dcp, test);
+            hfs_dirhint_freename(test);
+            hfs_free(test);
+        }
     }
 
-    TAILQ_INSERT_HEAD(&dcp->c_hintlist, hint, dh_link);
-    ++dcp->c_dirhintcnt;
+    /* Detached hints are not counted; trim back to HFS_MAXDIRHINTS. */
+    while (dcp->c_dirhintcnt >= HFS_MAXDIRHINTS)
+    {
+        test = TAILQ_LAST(&dcp->c_hintlist, hfs_hinthead);
+        hfs_dirhint_unlink(dcp, test);
+        hfs_dirhint_freename(test);
+        hfs_free(test);
+    }
+
+    hfs_dirhint_link(dcp, hint);
+
+    lf_lck_mtx_unlock(&dcp->c_hint_mutex);
 }
 
 /*
  * Release a single directory hint.
- *
- * Requires an exclusive lock on directory cnode.
  */
 void
 hfs_reldirhint(struct cnode *dcp, directoryhint_t * relhint)
 {
-    const u_int8_t * name;
     directoryhint_t *hint;
 
+    lf_lck_mtx_lock(&dcp->c_hint_mutex);
+
     /* Check if item is on list (could be detached) */
-    TAILQ_FOREACH(hint, &dcp->c_hintlist, dh_link)
+    LIST_FOREACH(hint, HFS_DIRHINT_BUCKET(dcp, relhint->dh_index), dh_hash)
     {
         if (hint == relhint)
         {
-            TAILQ_REMOVE(&dcp->c_hintlist, relhint, dh_link);
-            --dcp->c_dirhintcnt;
+            hfs_dirhint_unlink(dcp, relhint);
             break;
         }
     }
-    name = relhint->dh_desc.cd_nameptr;
-    if ((relhint->dh_desc.cd_flags & CD_HASBUF) && (name != NULL))
-    {
-        relhint->dh_desc.cd_nameptr = NULL;
-        relhint->dh_desc.cd_namelen = 0;
-        relhint->dh_desc.cd_flags &= ~CD_HASBUF;
-        hfs_free((void*)name);
-    }
+
+    lf_lck_mtx_unlock(&dcp->c_hint_mutex);
+
+    hfs_dirhint_freename(relhint);
     hfs_free(relhint);
 }
 
+/*
+ * Allocate the next non-zero readdir tag for a directory.
+ */
+unsigned int
+hfs_getdirhinttag(struct cnode *dcp)
+{
+    unsigned int tag = 0;
+
+    lf_lck_mtx_lock(&dcp->c_hint_mutex);
+    while (tag == 0)
+        tag = (++dcp->c_dirhinttag) << HFS_INDEX_BITS;
+    lf_lck_mtx_unlock(&dcp->c_hint_mutex);
+
+    return (tag);
+}
+
 /*
  * Perform a case-insensitive compare of two UTF-8 filenames.
  *
@@ -1824,34 +1881,28 @@ out:
 
 /*
  * Release directory hints for given directory
- *
- * Requires an exclusive lock on directory cnode.
  */
 void
 hfs_reldirhints(struct cnode *dcp, int stale_hints_only)
 {
     struct timeval tv;
     directoryhint_t *hint, *prev;
-    const u_int8_t * name;
     
     if (stale_hints_only)
         microuptime(&tv);
     
+    lf_lck_mtx_lock(&dcp->c_hint_mutex);
+
     /* searching from the oldest to the newest, so we can stop early when releasing stale hints only */
     TAILQ_FOREACH_REVERSE_SAFE(hint, &dcp->c_hintlist, hfs_hinthead, dh_link, prev) {
         if (stale_hints_only && (tv.tv_sec - hint->dh_time) < HFS_DIRHINT_TTL)
             break;  /* stop here if this entry is too new */
-        name = hint->dh_desc.cd_nameptr;
-        if ((hint->dh_desc.cd_flags & CD_HASBUF) && (name != NULL)) {
-            hint->dh_desc.cd_nameptr = NULL;
-            hint->dh_desc.cd_namelen = 0;
-            hint->dh_desc.cd_flags &= ~CD_HASBUF;
-            hfs_free((void *)name);
-        }
-        TAILQ_REMOVE(&dcp->c_hintlist, hint, dh_link);
+        hfs_dirhint_unlink(dcp, hint);
+        hfs_dirhint_freename(hint);
         hfs_free(hint);
-        --dcp->c_dirhintcnt;
     }
+
+    lf_lck_mtx_unlock(&dcp->c_hint_mutex);
 }
 
 /* hfs_erase_unused_nodes
@@ -2009,6 +2060,14 @@ hfs_remove_orphans(struct hfsmount * hfsmp)
         if (bcmp(tempname, filename, namelen + 1) != 0)
             continue;
 
+        /*
+         * A directory that still has children was being removed as a
+         * tree; hfs_remove_orphan_trees empties it once we are mounted.
+         */
+        if ((filerec.recordType == kHFSPlusFolderRecord) &&
+            (((HFSPlusCatalogFolder *)&filerec)->valence != 0))
+            continue;
+
         struct filefork dfork;
         struct filefork rfork;
         struct cnode cnode;
@@ -2267,13 +2326,21 @@ int hfs_early_journal_init(struct hfsmount *hfsmp, HFSPlusVolumeHeader *vhp,
 	jib_flags  = SWAP_BE32(jibp->flags);
 	jib_size   = SWAP_BE64(jibp->size);
 
-	if (!(jib_flags & kJIJournalInFSMask)) {
-        goto cleanup_dev_name;
+	if (jib_flags & kJIJournalInFSMask) {
+        hfsmp->jvp = hfsmp->hfs_devvp;
+        jib_offset = SWAP_BE64(jibp->offset) + embeddedOffset;
+    } else {
+        // The journal lives on another device.  There is no device lookup
+        // by UUID here, the caller hands it to us (LFHFS_MountWithJournal).
+        hfsmp->jvp = hfsmp->hfs_mp->psJournalVnode;
+        if (hfsmp->jvp == NULL) {
+            LFHFS_LOG(LEVEL_ERROR, "hfs: early journal init: the journal is on a different volume which was not given.\n");
+            retval = EROFS;
+            goto cleanup_dev_name;
+        }
+        jib_offset = 0;
     }
 
-    hfsmp->jvp = hfsmp->hfs_devvp;
-    jib_offset = SWAP_BE64(jibp->offset);
-
 	// save this off for the hack-y check in hfs_remove()
 	hfsmp->jnl_start = jib_offset / SWAP_BE32(vhp->blockSize);
 	hfsmp->jnl_size  = jib_size;
@@ -2283,7 +2350,7 @@ int hfs_early_journal_init(struct hfsmount *hfsmp, HFSPlusVolumeHeader *vhp,
 	    // if it is, then we can allow the mount.  otherwise we have to
 	    // return failure.
 	    retval = journal_is_clean(hfsmp->jvp,
-				      jib_offset + embeddedOffset,
+				      jib_offset,
 				      jib_size,
 				      devvp,
 				      hfsmp->hfs_logical_block_size,
@@ -2303,9 +2370,9 @@ int hfs_early_journal_init(struct hfsmount *hfsmp, HFSPlusVolumeHeader *vhp,
 
 	if (jib_flags & kJIJournalNeedInitMask) {
 		LFHFS_LOG(LEVEL_ERROR, "hfs: Initializing the journal (joffset 0x%llx sz 0x%llx)...\n",
-			   jib_offset + embeddedOffset, jib_size);
+			   jib_offset, jib_size);
 		hfsmp->jnl = journal_create(hfsmp->jvp,
-									jib_offset + embeddedOffset,
+									jib_offset,
 									jib_size,
 									devvp,
 									blksize,
@@ -2325,11 +2392,11 @@ int hfs_early_journal_init(struct hfsmount *hfsmp, HFSPlusVolumeHeader *vhp,
 		jibp     = NULL;
 	} else {
 		LFHFS_LOG(LEVEL_DEFAULT, "hfs: Opening the journal (jib_offset 0x%llx size 0x%llx vhp_blksize %d)...\n",
-			   jib_offset + embeddedOffset,
+			   jib_offset,
 			   jib_size, SWAP_BE32(vhp->blockSize));
 				
 		hfsmp->jnl = journal_open(hfsmp->jvp,
-								  jib_offset + embeddedOffset,
+								  jib_offset,
 								  jib_size,
 								  devvp,
 								  blksize,
@@ -2502,15 +2569,22 @@ static int hfs_late_journal_init(struct hfsmount *hfsmp, HFSPlusVolumeHeader *vh
         recreate_journal = 1;
     }
     
-    if (!(jib_flags & kJIJournalInFSMask)) {
-        LFHFS_LOG(LEVEL_ERROR, "hfs: No support for journal on a different volume\n");
-        hfs_free(jinfo_bp);
-        vcb->vcbAtrb &= ~kHFSVolumeJournaledMask;
-        return 0;
+    if (jib_flags & kJIJournalInFSMask) {
+        hfsmp->jvp = hfsmp->hfs_devvp;
+        jib_offset += (off_t)vcb->hfsPlusIOPosOffset;
+    } else {
+        // Someone else had the volume mounted last, so whatever is on the
+        // external journal device can not be trusted; start it over.
+        hfsmp->jvp = hfsmp->hfs_mp->psJournalVnode;
+        if (hfsmp->jvp == NULL) {
+            LFHFS_LOG(LEVEL_ERROR, "hfs: late journal init: the journal is on a different volume which was not given.\n");
+            hfs_free(jinfo_bp);
+            return EROFS;
+        }
+        jib_offset = 0;
+        recreate_journal = 1;
+        write_jibp = 1;
     }
-                  
-    hfsmp->jvp = hfsmp->hfs_devvp;
-    jib_offset += (off_t)vcb->hfsPlusIOPosOffset;
     
     // save this off for the hack-y check in hfs_remove()
     hfsmp->jnl_start = jib_offset / SWAP_BE32(vhp->blockSize);
@@ -33,6 +33,7 @@ void hfs_insertdirhint(struct cnode *dcp, directoryhint_t * hint);
 void hfs_reldirhints(struct cnode *dcp, int stale_hints_only);
 
 directoryhint_t* hfs_getdirhint(struct cnode *dcp, int index, int detach);
+unsigned int hfs_getdirhinttag(struct cnode *dcp);
 
 int  hfs_systemfile_lock(struct hfsmount *hfsmp, int flags, enum hfs_locktype locktype);
 void hfs_systemfile_unlock(struct hfsmount *hfsmp, int flags);
@@ -52,5 +53,7 @@ int hfs_early_journal_init(struct hfsmount *hfsmp, HFSPlusVolumeHeader *vhp,
 					   void *_args, off_t embeddedOffset, daddr64_t mdb_offset,
 					   HFSMasterDirectoryBlock *mdbp);
 errno_t hfs_flush(struct hfsmount *hfsmp, hfs_flush_mode_t mode);
+u_int32_t GetFileInfo(ExtendedVCB *vcb, const char *name,
+                      struct cat_attr *fattr, struct cat_fork *forkinfo);
 
 #endif /* lf_hfs_vfsutils_h */
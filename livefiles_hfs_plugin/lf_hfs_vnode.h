@@ -89,6 +89,7 @@ typedef struct mount
 {
     struct hfsmount* psHfsmount;
     int mnt_flag;
+    struct vnode* psJournalVnode;   // External journal device, NULL if the journal is in the volume
 } *mount_t;
 
 struct vnode_attr {
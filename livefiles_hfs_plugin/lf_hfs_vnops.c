@@ -202,8 +202,11 @@ hfs_vnop_readdir(vnode_t vp, int *eofflag, int *numdirent, ReadDirBuff_s* psRead
         return EINVAL;
     }
 
-    /* Note that the dirhint calls require an exclusive lock. */
-    if ((error = hfs_lock(VTOC(vp), HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT)))
+    /*
+     * The directory hints have their own lock and the hint we use is
+     * detached from the list, so concurrent readers can share the cnode.
+     */
+    if ((error = hfs_lock(VTOC(vp), HFS_SHARED_LOCK, HFS_LOCK_DEFAULT)))
     {
         LFHFS_LOG(LEVEL_ERROR, "hfs_vnop_readdir: Failed to lock vnode\n");
         return error;
@@ -262,10 +265,10 @@ hfs_vnop_readdir(vnode_t vp, int *eofflag, int *numdirent, ReadDirBuff_s* psRead
         }
     }
 
-    /* Get a directory hint (cnode must be locked exclusive) */
+    /* Get a detached directory hint */
     if (dirhint == NULL)
     {
-        dirhint = hfs_getdirhint(cp, ((index - 1) & HFS_INDEX_MASK) | tag, 0);
+        dirhint = hfs_getdirhint(cp, ((index - 1) & HFS_INDEX_MASK) | tag, TRUE);
 
         /* Hide tag from catalog layer. */
         dirhint->dh_index &= HFS_INDEX_MASK;
@@ -331,32 +334,27 @@ hfs_vnop_readdir(vnode_t vp, int *eofflag, int *numdirent, ReadDirBuff_s* psRead
     /*
      * Detect valence FS corruption.
      *
-     * We are holding the cnode lock exclusive, so there should not be
-     * anybody modifying the valence field of this cnode.  If we enter
-     * this block, that means we observed filesystem corruption, because
+     * We are holding the cnode lock, so there should not be anybody
+     * modifying the valence field of this cnode.  If we enter this
+     * block, that means we observed filesystem corruption, because
      * this directory reported a valence of 0, yet we found at least one
      * item.  In this case, we need to minimally self-heal this
      * directory to prevent userland from tripping over a directory
      * that appears empty (getattr of valence reports 0), but actually
      * has contents.
      *
-     * We'll force the cnode update at the end of the function after
-     * completing all of the normal getdirentries steps.
+     * The repair needs the lock exclusive, so it is done at the end of
+     * the function after completing all of the normal getdirentries steps.
      */
     if ((cp->c_entries == 0) && (items > 0))
     {
-        /* disk corruption */
-        cp->c_entries++;
-        /* Mark the cnode as dirty. */
-        cp->c_flag |= C_MODIFIED;
-        LFHFS_LOG(LEVEL_DEBUG, "hfs_vnop_readdir: repairing valence to non-zero! \n");
         bump_valence++;
     }
 
 
     /* Convert catalog directory index back into an offset. */
-    while (tag == 0)
-        tag = (++cp->c_dirhinttag) << HFS_INDEX_BITS;
+    if (tag == 0)
+        tag = hfs_getdirhinttag(cp);
     offset =  ((index + 2) | tag);
     dirhint->dh_index |= tag;
 
@@ -374,11 +372,18 @@ seekoffcalc:
     }
 
 out:
-    /* If we didn't do anything then go ahead and dump the hint. */
-    if ((dirhint != NULL) && (dirhint != &localhint) && (offset == startoffset))
+    /* If we didn't do anything then go ahead and dump the hint, otherwise put it back. */
+    if ((dirhint != NULL) && (dirhint != &localhint))
     {
-        hfs_reldirhint(cp, dirhint);
-        bLocalEOFflag = true;
+        if (offset == startoffset)
+        {
+            hfs_reldirhint(cp, dirhint);
+            bLocalEOFflag = true;
+        }
+        else
+        {
+            hfs_insertdirhint(cp, dirhint);
+        }
     }
 
     if (eofflag)
@@ -391,14 +396,23 @@ out:
         cat_releasedesc(&localhint.dh_desc);
     }
 
-    if (bump_valence)
+    hfs_unlock(cp);
+
+    if (bump_valence && hfs_lock(cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT) == 0)
     {
-        /* force the update before dropping the cnode lock*/
-        hfs_update(vp, 0);
+        /* Someone may have added an entry (or repaired it) while we were unlocked. */
+        if (cp->c_entries == 0)
+        {
+            /* disk corruption */
+            cp->c_entries++;
+            /* Mark the cnode as dirty. */
+            cp->c_flag |= C_MODIFIED;
+            LFHFS_LOG(LEVEL_DEBUG, "hfs_vnop_readdir: repairing valence to non-zero! \n");
+            hfs_update(vp, 0);
+        }
+        hfs_unlock(cp);
     }
 
-    hfs_unlock(cp);
-
     return (error);
 }
 
@@ -1172,9 +1186,7 @@ out:
         hfs_end_transaction(hfsmp);
     }
     
-    dcp->c_flag &= ~C_DIR_MODIFICATION;
-    //TBD - We have wakeup here but can't see anyone who's msleeping on c_flag...
-    //wakeup((caddr_t)&dcp->c_flag);
+    hfs_clear_dir_modification(dcp);
 
     return (error);
 }
@@ -1472,9 +1484,7 @@ hfs_removedir(struct vnode *dvp, struct vnode *vp, struct componentname *cnp, in
 out:
     dvp->sExtraData.sDirData.uDirVersion++;
 
-    dcp->c_flag &= ~C_DIR_MODIFICATION;
-//TBD - We have wakeup here but can't see anyone who's msleeping on c_flag...
-//    wakeup((caddr_t)&dcp->c_flag);
+    hfs_clear_dir_modification(dcp);
 
     if (started_tr)
     {
@@ -1666,6 +1676,7 @@ hfs_update(struct vnode *vp, int options)
 
     if ((hfsmp->hfs_flags & HFS_READ_ONLY) || (cp->c_mode == 0)) {
         CLR(cp->c_flag, C_MODIFIED | C_MINOR_MOD | C_NEEDS_DATEADDED);
+        hfs_cancel_deferred_update(hfsmp, cp);
         cp->c_touch_acctime = 0;
         cp->c_touch_chgtime = 0;
         cp->c_touch_modtime = 0;
@@ -1731,6 +1742,7 @@ hfs_update(struct vnode *vp, int options)
     hfs_systemfile_unlock(hfsmp, lockflags);
 
     CLR(cp->c_flag, C_MODIFIED | C_MINOR_MOD);
+    hfs_cancel_deferred_update(hfsmp, cp);
 
     hfs_end_transaction(hfsmp);
 
@@ -1893,79 +1905,44 @@ hfs_vnop_create(vnode_t a_dvp, vnode_t *a_vpp, struct componentname *a_cnp, UVFS
 }
 
 /*
- * Allocate a new node
+ * Fill in the catalog attributes of a new node from the attributes
+ * given to create / mkdir.
  */
 int
-hfs_makenode(struct vnode *dvp, struct vnode **vpp, struct componentname *cnp, UVFSFileAttributes *psGivenAttr)
+hfs_makenode_initattr(struct hfsmount *hfsmp, UVFSFileAttributes *psGivenAttr, struct cat_attr *attrp)
 {
-    struct hfsmount *hfsmp = VTOHFS(dvp);
-    struct cnode *dcp = NULL;
-    struct cnode *cp = NULL;
-    struct vnode *tvp = NULL;
     enum vtype vnodetype = UVFSTOV(psGivenAttr->fa_type);
     mode_t mode = MAKEIMODE(vnodetype);
-    struct cat_attr attr = {0};
-    int lockflags;
-    int error, started_tr = 0;
-
-    int newvnode_flags = 0;
-    u_int32_t gnv_flags = 0;
-    int nocache = 0;
-    struct cat_desc out_desc = {0};
-    out_desc.cd_flags = 0;
-    out_desc.cd_nameptr = NULL;
-
-    if ((error = hfs_lock(VTOC(dvp), HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT)))
-        return (error);
-    dcp = VTOC(dvp);
-    
-    /* Don't allow creation of new entries in open-unlinked directories */
-    if (dcp->c_flag & (C_DELETED | C_NOEXISTS))
-    {
-        error = ENOENT;
-        goto exit;
-    }
 
     if ( !(psGivenAttr->fa_validmask & UVFS_FA_VALID_MODE) && (vnodetype != VDIR) )
     {
         LFHFS_LOG(LEVEL_ERROR, "hfs_makenode: Invalid mode or type[%#llx, %d]",
 				  (unsigned long long)psGivenAttr->fa_validmask, psGivenAttr->fa_type);
-        error = EINVAL;
-        goto exit;
+        return EINVAL;
     }
 
     if ( ( psGivenAttr->fa_validmask & READ_ONLY_FA_FIELDS ) /*|| ( psGivenAttr->fa_validmask & ~VALID_IN_ATTR_MASK )*/ )
     {
         LFHFS_LOG(LEVEL_ERROR, "hfs_makenode: Setting readonly fields or invalid mask[%#llx, %#llx]", (unsigned long long)psGivenAttr->fa_validmask, (unsigned long long)READ_ONLY_FA_FIELDS);
-        error = EINVAL;
-        goto exit;
-    }
-
-    dcp->c_flag |= C_DIR_MODIFICATION;
-
-    *vpp = NULL;
-
-    /* Check if were out of usable disk space. */
-    if (hfs_freeblks(hfsmp, 1) == 0)
-    {
-        error = ENOSPC;
-        goto exit;
+        return EINVAL;
     }
 
     struct timeval tv;
     microtime(&tv);
 
+    bzero(attrp, sizeof(*attrp));
+
     /* Setup the default attributes */
     if ( psGivenAttr->fa_validmask & UVFS_FA_VALID_MODE )
     {
         mode = (mode & ~ALLPERMS) | (psGivenAttr->fa_mode & ALLPERMS);
     }
 
-    attr.ca_mode = mode;
-    attr.ca_linkcount = 1;
-    attr.ca_itime = tv.tv_sec;
-    attr.ca_atime = attr.ca_ctime = attr.ca_mtime = attr.ca_itime;
-    attr.ca_atimeondisk = attr.ca_atime;
+    attrp->ca_mode = mode;
+    attrp->ca_linkcount = 1;
+    attrp->ca_itime = tv.tv_sec;
+    attrp->ca_atime = attrp->ca_ctime = attrp->ca_mtime = attrp->ca_itime;
+    attrp->ca_atimeondisk = attrp->ca_atime;
 
     /*
      * HFS+ only: all files get ThreadExists
@@ -1974,31 +1951,31 @@ hfs_makenode(struct vnode *dvp, struct vnode **vpp, struct componentname *cnp, U
     {
         if (hfsmp->hfs_flags & HFS_FOLDERCOUNT)
         {
-            attr.ca_recflags = kHFSHasFolderCountMask;
+            attrp->ca_recflags = kHFSHasFolderCountMask;
         }
     }
     else
     {
-        attr.ca_recflags = kHFSThreadExistsMask;
+        attrp->ca_recflags = kHFSThreadExistsMask;
     }
 
     /*
      * Add the date added to the item. See above, as
      * all of the dates are set to the itime.
      */
-    hfs_write_dateadded (&attr, attr.ca_atime);
+    hfs_write_dateadded (attrp, attrp->ca_atime);
 
     /* Initialize the gen counter to 1 */
-    hfs_write_gencount(&attr, (uint32_t)1);
+    hfs_write_gencount(attrp, (uint32_t)1);
 
     if ( psGivenAttr->fa_validmask & UVFS_FA_VALID_UID )
     {
-        attr.ca_uid               = psGivenAttr->fa_uid;
+        attrp->ca_uid               = psGivenAttr->fa_uid;
     }
 
     if ( psGivenAttr->fa_validmask & UVFS_FA_VALID_GID )
     {
-        attr.ca_gid               = psGivenAttr->fa_gid;
+        attrp->ca_gid               = psGivenAttr->fa_gid;
     }
 
     /* Tag symlinks with a type and creator. */
@@ -2006,17 +1983,69 @@ hfs_makenode(struct vnode *dvp, struct vnode **vpp, struct componentname *cnp, U
     {
         struct FndrFileInfo *fip;
 
-        fip = (struct FndrFileInfo *)&attr.ca_finderinfo;
+        fip = (struct FndrFileInfo *)&attrp->ca_finderinfo;
         fip->fdType    = SWAP_BE32(kSymLinkFileType);
         fip->fdCreator = SWAP_BE32(kSymLinkCreator);
     }
 
+    return 0;
+}
+
+/*
+ * Allocate a new node
+ */
+int
+hfs_makenode(struct vnode *dvp, struct vnode **vpp, struct componentname *cnp, UVFSFileAttributes *psGivenAttr)
+{
+    struct hfsmount *hfsmp = VTOHFS(dvp);
+    struct cnode *dcp = NULL;
+    struct cnode *cp = NULL;
+    struct vnode *tvp = NULL;
+    enum vtype vnodetype = UVFSTOV(psGivenAttr->fa_type);
+    struct cat_attr attr = {0};
+    int lockflags;
+    int error, started_tr = 0;
+
+    int newvnode_flags = 0;
+    u_int32_t gnv_flags = 0;
+    int nocache = 0;
+    struct cat_desc out_desc = {0};
+    out_desc.cd_flags = 0;
+    out_desc.cd_nameptr = NULL;
+
+    if ((error = hfs_lock(VTOC(dvp), HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT)))
+        return (error);
+    dcp = VTOC(dvp);
+    
+    /* Don't allow creation of new entries in open-unlinked directories */
+    if (dcp->c_flag & (C_DELETED | C_NOEXISTS))
+    {
+        error = ENOENT;
+        goto exit;
+    }
+
+    if ((error = hfs_makenode_initattr(hfsmp, psGivenAttr, &attr)) != 0)
+    {
+        goto exit;
+    }
+
+    dcp->c_flag |= C_DIR_MODIFICATION;
+
+    *vpp = NULL;
+
+    /* Check if were out of usable disk space. */
+    if (hfs_freeblks(hfsmp, 1) == 0)
+    {
+        error = ENOSPC;
+        goto exit;
+    }
+
     /* Setup the descriptor */
     struct cat_desc in_desc ={0};
     in_desc.cd_nameptr = (const u_int8_t *)cnp->cn_nameptr;
     in_desc.cd_namelen = cnp->cn_namelen;
     in_desc.cd_parentcnid = dcp->c_fileid;
-    in_desc.cd_flags = S_ISDIR(mode) ? CD_ISDIR : 0;
+    in_desc.cd_flags = S_ISDIR(attr.ca_mode) ? CD_ISDIR : 0;
     in_desc.cd_hint = dcp->c_childhint;
     in_desc.cd_encoding = 0;
 
@@ -2135,10 +2164,7 @@ exit:
      */
     if (dcp)
     {
-        dcp->c_flag &= ~C_DIR_MODIFICATION;
-
-        //TBD - We have wakeup here but can't see anyone who's msleeping on c_flag...
-        //wakeup((caddr_t)&dcp->c_flag);
+        hfs_clear_dir_modification(dcp);
         hfs_unlock(dcp);
     }
 
@@ -2963,16 +2989,12 @@ out:
     }
 
     fdvp->sExtraData.sDirData.uDirVersion++;
-    fdcp->c_flag &= ~C_DIR_MODIFICATION;
-    //TBD - We have wakeup here but can't see anyone who's msleeping on c_flag...
-//    wakeup((caddr_t)&fdcp->c_flag);
+    hfs_clear_dir_modification(fdcp);
 
     if (fdvp != tdvp)
     {
         tdvp->sExtraData.sDirData.uDirVersion++;
-        tdcp->c_flag &= ~C_DIR_MODIFICATION;
-        //TBD - We have wakeup here but can't see anyone who's msleeping on c_flag...
-//        wakeup((caddr_t)&tdcp->c_flag);
+        hfs_clear_dir_modification(tdcp);
 
     }
 
@@ -3183,9 +3205,7 @@ out:
         hfs_end_transaction(hfsmp);
     }
 
-    tdcp->c_flag &= ~C_DIR_MODIFICATION;
-    //TBD - We have wakeup here but can't see anyone who's msleeping on c_flag...
-//    wakeup((caddr_t)&tdcp->c_flag);
+    hfs_clear_dir_modification(tdcp);
 
     if (fdcp) {
         hfs_unlockfour(tdcp, cp, fdcp, NULL);
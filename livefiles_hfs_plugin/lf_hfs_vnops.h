@@ -41,6 +41,7 @@ int hfs_vnop_readlink(struct vnode *vp, void* data, size_t dataSize, size_t *act
 int hfs_vnop_create(vnode_t a_dvp, vnode_t *a_vpp, struct componentname *a_cnp, UVFSFileAttributes* a_vap);
 int hfs_vnop_mkdir(vnode_t a_dvp, vnode_t *a_vpp, struct componentname *a_cnp, UVFSFileAttributes* a_vap);
 int hfs_makenode(struct vnode *dvp, struct vnode **vpp, struct componentname *cnp, UVFSFileAttributes *psGivenAttr);
+int hfs_makenode_initattr(struct hfsmount *hfsmp, UVFSFileAttributes *psGivenAttr, struct cat_attr *attrp);
 int hfs_vnop_symlink(struct vnode *dvp, struct vnode **vpp, struct componentname *cnp, char* symlink_content, UVFSFileAttributes *attrp);
 
 int hfs_removedir(struct vnode *dvp, struct vnode *vp, struct componentname *cnp, int skip_reserve, int only_unlink);
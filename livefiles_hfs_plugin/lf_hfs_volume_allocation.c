@@ -21,29 +21,10 @@
 #include "lf_hfs_vfsutils.h"
 #include "lf_hfs_vfsops.h"
 #include "lf_hfs_generic_buf.h"
+#include "lf_hfs_trace.h"
 
 #pragma clang diagnostic ignored "-Waddress-of-packed-member"
 
-enum {
-    /*
-     * HFSDBG_ALLOC_ENABLED: Log calls to BlockAllocate and
-     * BlockDeallocate, including the internal BlockAllocateXxx
-     * routines so we can see how an allocation was satisfied.
-     *
-     * HFSDBG_EXT_CACHE_ENABLED: Log routines that read or write the
-     * free extent cache.
-     *
-     * HFSDBG_UNMAP_ENABLED: Log events involving the trim list.
-     *
-     * HFSDBG_BITMAP_ENABLED: Log accesses to the volume bitmap (setting
-     * or clearing bits, scanning the bitmap).
-     */
-    HFSDBG_ALLOC_ENABLED        = 1,
-    HFSDBG_EXT_CACHE_ENABLED    = 2,
-    HFSDBG_UNMAP_ENABLED        = 4,
-    HFSDBG_BITMAP_ENABLED        = 8
-};
-
 enum {
     kBytesPerWord           =    4,
     kBitsPerByte            =    8,
@@ -151,6 +132,7 @@ static int hfs_track_unmap_blocks (struct hfsmount *hfsmp, u_int32_t offset,
 
 static int hfs_alloc_scan_range(struct hfsmount *hfsmp,
                                 u_int32_t startbit,
+                                u_int32_t maxiosize,
                                 u_int32_t *bitToScan,
                                 struct jnl_trim_list *list);
 
@@ -248,11 +230,15 @@ static int hfs_issue_unmap (struct hfsmount *hfsmp, struct jnl_trim_list *list)
     dk_unmap_t unmap;
     int error = 0;
 
+    LFHFS_TRACE(HFSDBG_UNMAP_ENABLED, HFSDBG_UNMAP_SCAN_TRIM | DBG_FUNC_START, hfsmp->hfs_raw_dev, 0, 0, 0, 0);
+
     if (list->extent_count > 0 && list->extents != NULL) {
         bzero(&unmap, sizeof(unmap));
         unmap.extents = list->extents;
         unmap.extentsCount = list->extent_count;
-        
+
+        LFHFS_TRACE(HFSDBG_UNMAP_ENABLED, HFSDBG_UNMAP_SCAN_TRIM | DBG_FUNC_NONE, hfsmp->hfs_raw_dev, unmap.extentsCount, 0, 0, 0);
+
         /* Issue a TRIM and flush them out */
         error = ioctl(hfsmp->hfs_devvp->psFSRecord->iFD, DKIOCUNMAP, &unmap);
         
@@ -260,7 +246,9 @@ static int hfs_issue_unmap (struct hfsmount *hfsmp, struct jnl_trim_list *list)
         bzero (&unmap, sizeof(unmap));
         list->extent_count = 0;
     }
-    
+
+    LFHFS_TRACE(HFSDBG_UNMAP_ENABLED, HFSDBG_UNMAP_SCAN_TRIM | DBG_FUNC_END, error, hfsmp->hfs_raw_dev, 0, 0, 0);
+
     return error;
 }
 
@@ -353,12 +341,16 @@ hfs_trim_callback(void *arg, uint32_t extent_count, const dk_extent_t *extents)
     uint32_t startBlock, numBlocks;
     struct hfsmount *hfsmp = arg;
 
+    LFHFS_TRACE(HFSDBG_UNMAP_ENABLED, HFSDBG_UNMAP_CALLBACK | DBG_FUNC_START, 0, extent_count, 0, 0, 0);
+
     for (i=0; i<extent_count; ++i) {
         /* Convert the byte range in *extents back to a range of allocation blocks. */
         startBlock = (uint32_t)((extents[i].offset - hfsmp->hfsPlusIOPosOffset) / hfsmp->blockSize);
         numBlocks = (uint32_t)(extents[i].length / hfsmp->blockSize);
         (void) add_free_extent_cache(hfsmp, startBlock, numBlocks);
     }
+
+    LFHFS_TRACE(HFSDBG_UNMAP_ENABLED, HFSDBG_UNMAP_CALLBACK | DBG_FUNC_END, 0, 0, 0, 0, 0);
 }
 
 
@@ -401,6 +393,8 @@ u_int32_t ScanUnmapBlocks (struct hfsmount *hfsmp)
      */
     bzero (&trimlist, sizeof(trimlist));
 
+    LFHFS_TRACE(HFSDBG_UNMAP_ENABLED, HFSDBG_UNMAP_SCAN | DBG_FUNC_START, hfsmp->hfs_raw_dev, 0, 0, 0, 0);
+
     /*
      * Any trim related work should be tied to whether the underlying
      * storage media supports UNMAP, as any solid state device would
@@ -426,7 +420,7 @@ u_int32_t ScanUnmapBlocks (struct hfsmount *hfsmp)
 
     while ((blocks_scanned < hfsmp->totalBlocks) && (error == 0)){
 
-        error = hfs_alloc_scan_range (hfsmp, blocks_scanned, &blocks_scanned, &trimlist);
+        error = hfs_alloc_scan_range (hfsmp, blocks_scanned, 0, &blocks_scanned, &trimlist);
 
         if (error) {
             LFHFS_LOG(LEVEL_DEBUG, "ScanUnmapBlocks: bitmap scan range error: %d on vol=%s\n", error, hfsmp->vcbVN);
@@ -456,6 +450,80 @@ u_int32_t ScanUnmapBlocks (struct hfsmount *hfsmp)
     }
 #endif
 
+    LFHFS_TRACE(HFSDBG_UNMAP_ENABLED, HFSDBG_UNMAP_SCAN | DBG_FUNC_END, error, hfsmp->hfs_raw_dev, 0, 0, 0);
+
+    return error;
+}
+
+/*
+ ;________________________________________________________________________________
+ ;
+ ; Routine:        ScanUnmapBlocksRange
+ ;
+ ; Function:    Incremental form of ScanUnmapBlocks used by the background scan
+ ;                that runs after mount.  Scans at most maxbits bits of the
+ ;                bitmap starting at startbit (which must be vcbVBMIOSize aligned),
+ ;                builds the summary table and free extent cache for them and
+ ;                unmaps their free blocks.
+ ;
+ ;                Unlike ScanUnmapBlocks this reads the bitmap in vcbVBMIOSize
+ ;                blocks, so it shares the runtime allocator's buffers and sees
+ ;                any changes that have not been written to the bitmap file yet.
+ ;
+ ;                The caller must hold the bitmap lock exclusive.  If the free
+ ;                blocks are to be unmapped, the caller must also make sure that
+ ;                no transaction which freed them can still be rolled back (e.g.
+ ;                by holding the global lock exclusive and flushing the journal).
+ ;
+ ; Input Arguments:
+ ;    hfsmp            - The volume containing the allocation blocks.
+ ;    startbit        - First bit to scan.
+ ;    maxbits            - Upper bound on the number of bits to scan.
+ ;    unmap            - Unmap the free blocks found.  Decided by the caller,
+ ;                       which is the one that made unmapping safe.
+ ;
+ ; Output:
+ ;    nextbit            - First bit that was not scanned.
+ ;________________________________________________________________________________
+ */
+int ScanUnmapBlocksRange (struct hfsmount *hfsmp, u_int32_t startbit, u_int32_t maxbits, bool unmap, u_int32_t *nextbit)
+{
+    u_int32_t blocks_scanned = startbit;
+    u_int32_t stopbit;
+    int error = 0;
+    struct jnl_trim_list trimlist;
+
+    bzero (&trimlist, sizeof(trimlist));
+
+    stopbit = (maxbits > hfsmp->totalBlocks - startbit) ? hfsmp->totalBlocks : startbit + maxbits;
+
+    if (unmap) {
+        int alloc_count = ((u_int32_t)PAGE_SIZE) / sizeof(dk_extent_t);
+        void *extents = hfs_malloc(alloc_count * sizeof(dk_extent_t));
+        trimlist.extents = (dk_extent_t*)extents;
+        trimlist.allocated_count = (extents != NULL) ? alloc_count : 0;
+        trimlist.extent_count = 0;
+    }
+
+    while ((blocks_scanned < stopbit) && (error == 0)) {
+
+        error = hfs_alloc_scan_range (hfsmp, blocks_scanned, hfsmp->vcbVBMIOSize, &blocks_scanned, &trimlist);
+
+        if (error) {
+            LFHFS_LOG(LEVEL_DEBUG, "ScanUnmapBlocksRange: bitmap scan range error: %d on vol=%s\n", error, hfsmp->vcbVN);
+            break;
+        }
+    }
+
+    if (trimlist.extents) {
+        if (error == 0) {
+            hfs_issue_unmap(hfsmp, &trimlist);
+        }
+        hfs_free(trimlist.extents);
+    }
+
+    *nextbit = blocks_scanned;
+
     return error;
 }
 
@@ -646,6 +714,8 @@ OSErr hfs_block_alloc_int(hfsmount_t *hfsmp,
     uint32_t minBlocks = extent->blockCount;
     uint32_t maxBlocks = (ap && ap->max_blocks) ? ap->max_blocks : minBlocks;
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_BLOCK_ALLOCATE | DBG_FUNC_START, startingBlock, minBlocks, maxBlocks, flags, 0);
+
     if (ISSET(flags, HFS_ALLOC_COMMIT)) {
         if (ap == NULL || ap->reservation_in == NULL) {
             err = paramErr;
@@ -1061,6 +1131,8 @@ exit:
     // KBZ : For now, make sure clusters fills with zeros.
     raw_readwrite_zero_fill_fill( hfsmp, extent->startBlock, extent->blockCount );
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_BLOCK_ALLOCATE | DBG_FUNC_END, err, extent->startBlock, extent->blockCount, 0, 0);
+
     return err;
 }
 
@@ -1100,6 +1172,8 @@ OSErr BlockDeallocate (
     struct hfsmount *hfsmp;
     hfsmp = VCBTOHFS(vcb);
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_BLOCK_DEALLOCATE | DBG_FUNC_START, firstBlock, numBlocks, flags, 0, 0);
+
     //
     //    If no blocks to deallocate, then exit early
     //
@@ -1178,6 +1252,8 @@ OSErr BlockDeallocate (
 
 Exit:
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_BLOCK_DEALLOCATE | DBG_FUNC_END, err, 0, 0, 0, 0);
+
     return err;
 }
 
@@ -1402,6 +1478,9 @@ static OSErr ReadBitmapBlock(ExtendedVCB        *vcb,
 
     blockSize = (u_int32_t)vcb->vcbVBMIOSize;
     if (blockSize == 0) return EINVAL; //Devision protection
+
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_READ_BITMAP_BLOCK | DBG_FUNC_START, bit, 0, 0, 0, 0);
+
     block = (daddr64_t)(bit / (blockSize * kBitsPerByte));
 
     /* HFS+ / HFSX */
@@ -1428,6 +1507,8 @@ static OSErr ReadBitmapBlock(ExtendedVCB        *vcb,
         *buffer = bp->pvData;
     }
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_READ_BITMAP_BLOCK | DBG_FUNC_END, err, 0, 0, 0, 0);
+
     return err;
 }
 
@@ -1464,6 +1545,8 @@ static OSErr ReadBitmapRange(struct hfsmount *hfsmp, uint32_t offset, uint32_t i
      */
     REQUIRE_FILE_LOCK(hfsmp->hfs_allocation_vp, false);
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_READ_BITMAP_RANGE | DBG_FUNC_START, offset, iosize, 0, 0, 0);
+
     vp = hfsmp->hfs_allocation_vp;    /* use allocation file vnode */
 
     /*
@@ -1498,6 +1581,8 @@ static OSErr ReadBitmapRange(struct hfsmount *hfsmp, uint32_t offset, uint32_t i
         *buffer = bp->pvData;
     }
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_READ_BITMAP_RANGE | DBG_FUNC_END, err, 0, 0, 0, 0);
+
     return err;
 }
 
@@ -1520,12 +1605,15 @@ static OSErr ReleaseBitmapBlock( ExtendedVCB *vcb, GenericLFBufPtr blockRef, Boo
 
     GenericLFBufPtr bp = blockRef;
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_RELEASE_BITMAP_BLOCK | DBG_FUNC_START, dirty, 0, 0, 0, 0);
+
     if (blockRef == 0) {
         if (dirty)
         {
             LFHFS_LOG(LEVEL_ERROR, "ReleaseBitmapBlock: missing bp");
             hfs_assert(0);
         }
+        LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_RELEASE_BITMAP_BLOCK | DBG_FUNC_END, 0, 0, 0, 0, 0);
         return (0);
     }
 
@@ -1556,6 +1644,8 @@ static OSErr ReleaseBitmapBlock( ExtendedVCB *vcb, GenericLFBufPtr blockRef, Boo
         }
     }
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_RELEASE_BITMAP_BLOCK | DBG_FUNC_END, 0, 0, 0, 0, 0);
+
     return (0);
 }
 
@@ -1575,11 +1665,15 @@ static OSErr ReleaseBitmapBlock( ExtendedVCB *vcb, GenericLFBufPtr blockRef, Boo
 
 static OSErr ReleaseScanBitmapRange( GenericLFBufPtr bp )
 {
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_RELEASE_SCAN_BITMAP | DBG_FUNC_START, 0, 0, 0, 0, 0);
+
     if (bp)
     {
         lf_hfs_generic_buf_release(bp);
     }
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_RELEASE_SCAN_BITMAP | DBG_FUNC_END, 0, 0, 0, 0, 0);
+
     return (0);
 }
 
@@ -1678,6 +1772,8 @@ static OSErr BlockFindContig(
 
     struct hfsmount *hfsmp = VCBTOHFS(vcb);
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_FIND_CONTIG_BITMAP | DBG_FUNC_START, startingBlock, minBlocks, maxBlocks, useMetaZone, 0);
+
     while ((retval == noErr) && (foundStart == 0) && (foundCount == 0)) {
 
         /* Try and find something that works. */
@@ -1751,6 +1847,8 @@ bailout:
         *actualNumBlocks = foundCount;
     }
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_FIND_CONTIG_BITMAP | DBG_FUNC_END, retval, foundStart, foundCount, 0, 0);
+
     return retval;
 
 }
@@ -1868,6 +1966,8 @@ static OSErr BlockFindAnyBitmap(
     struct hfsmount *hfsmp = VCBTOHFS(vcb);
     Boolean useMetaZone = (flags & HFS_ALLOC_METAZONE);
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_ALLOC_ANY_BITMAP | DBG_FUNC_START, startingBlock, endingBlock, maxBlocks, useMetaZone, 0);
+
     /*
      * When we're skipping the metadata zone and the start/end
      * range overlaps with the metadata zone then adjust the
@@ -2101,6 +2201,8 @@ Exit:
         *actualNumBlocks = 0;
     }
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_ALLOC_ANY_BITMAP | DBG_FUNC_END, err, *actualStartBlock, *actualNumBlocks, 0, 0);
+
     return err;
 }
 
@@ -2137,12 +2239,15 @@ static OSErr BlockFindKnown(
     u_int32_t        foundBlocks;
     struct hfsmount *hfsmp = VCBTOHFS(vcb);
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_ALLOC_FIND_KNOWN | DBG_FUNC_START, 0, 0, maxBlocks, 0, 0);
+
     hfs_lock_mount (hfsmp);
     lf_lck_spin_lock(&vcb->vcbFreeExtLock);
     if ( vcb->vcbFreeExtCnt == 0 ||
         vcb->vcbFreeExt[0].blockCount == 0) {
         lf_lck_spin_unlock(&vcb->vcbFreeExtLock);
         hfs_unlock_mount(hfsmp);
+        LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_ALLOC_FIND_KNOWN | DBG_FUNC_END, dskFulErr, 0, 0, 0, 0);
         return dskFulErr;
     }
     lf_lck_spin_unlock(&vcb->vcbFreeExtLock);
@@ -2168,6 +2273,8 @@ static OSErr BlockFindKnown(
     } else
         err = 0;
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_ALLOC_FIND_KNOWN | DBG_FUNC_END, err, *actualStartBlock, *actualNumBlocks, 0, 0);
+
     return err;
 }
 
@@ -2228,6 +2335,8 @@ OSErr BlockMarkAllocatedInternal (
     // XXXdbg
     struct hfsmount *hfsmp = VCBTOHFS(vcb);
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_MARK_ALLOC_BITMAP | DBG_FUNC_START, startingBlock, numBlocks, flags, 0, 0);
+
 #if DEBUG
 
     if (!ISSET(flags, HFS_ALLOC_COMMIT)
@@ -2408,6 +2517,8 @@ Exit:
     if (buffer)
         (void)ReleaseBitmapBlock(vcb, blockRef, true);
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_MARK_ALLOC_BITMAP | DBG_FUNC_END, err, 0, 0, 0, 0);
+
     return err;
 }
 
@@ -2562,6 +2673,8 @@ OSErr BlockMarkFreeInternal(
     // XXXdbg
     struct hfsmount *hfsmp = VCBTOHFS(vcb);
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_MARK_FREE_BITMAP | DBG_FUNC_START, startingBlock_in, numBlocks_in, do_validate, 0, 0);
+
     /*
      * NOTE: We use vcb->totalBlocks instead of vcb->allocLimit because we
      * need to be able to free blocks being relocated during hfs_truncatefs.
@@ -2765,6 +2878,7 @@ Exit:
 
     if (buffer)
         (void)ReleaseBitmapBlock(vcb, blockRef, true);
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_MARK_FREE_BITMAP | DBG_FUNC_END, err, 0, 0, 0, 0);
     return err;
 
 Corruption:
@@ -2840,6 +2954,8 @@ static OSErr BlockFindContiguous(
     struct hfsmount *hfsmp = (struct hfsmount*) vcb;
     HFSPlusExtentDescriptor best = { 0, 0 };
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_BLOCK_FIND_CONTIG | DBG_FUNC_START, startingBlock, endingBlock, minBlocks, maxBlocks, 0);
+
     /*
      * When we're skipping the metadata zone and the start/end
      * range overlaps with the metadata zone then adjust the
@@ -3223,6 +3339,8 @@ LoopExit:
     if (buffer)
         (void) ReleaseBitmapBlock(vcb, blockRef, false);
 
+    LFHFS_TRACE(HFSDBG_ALLOC_ENABLED, HFSDBG_BLOCK_FIND_CONTIG | DBG_FUNC_END, err, *actualStartBlock, *actualNumBlocks, 0, 0);
+
     return err;
 }
 
@@ -3278,6 +3396,8 @@ hfs_isallocated_internal(struct hfsmount *hfsmp, u_int32_t startingBlock,
     u_int32_t  blockCount = 0;
     int  error;
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_IS_ALLOCATED | DBG_FUNC_START, startingBlock, numBlocks, stop_on_first, 0, 0);
+
     /*
      * Pre-read the bitmap block containing the first word of allocation
      */
@@ -3392,6 +3512,8 @@ Exit:
 
 JustReturn:
 
+    LFHFS_TRACE(HFSDBG_BITMAP_ENABLED, HFSDBG_IS_ALLOCATED | DBG_FUNC_END, error, 0, blockCount, 0, 0);
+
     return (error);
 }
 
@@ -3451,6 +3573,89 @@ hfs_isallocated(struct hfsmount *hfsmp, u_int32_t startingBlock, u_int32_t numBl
     }
 }
 
+/*
+ * Walk the whole volume bitmap and report every run of free allocation
+ * blocks to the callback, in ascending block order.  Used by offline
+ * tools to measure free-space fragmentation.
+ *
+ * Whole words are tested at a time; only words that are neither all
+ * free nor all allocated are examined bit by bit.
+ *
+ * The allocation file lock must be held.
+ *
+ * Returns:
+ *     0 on success, non-zero on failure.
+ */
+int
+hfs_find_free_extents(struct hfsmount *hfsmp,
+                      void (*callback)(void *data, u_int32_t startBlock, u_int32_t blockCount),
+                      void *callback_arg)
+{
+    u_int32_t  *buffer = NULL;
+    GenericLFBufPtr  blockRef = NULL;
+    u_int32_t  wordsPerBlock;
+    u_int32_t  totalBlocks = hfsmp->totalBlocks;
+    u_int32_t  block = 0;          // First allocation block of the current word
+    u_int32_t  runStart = 0;
+    u_int32_t  runLength = 0;
+    u_int32_t  wordIndex;
+    u_int32_t  word;
+    u_int32_t  bit;
+    int  error = 0;
+
+    if (hfsmp->vcbVBMIOSize == 0)
+        return EINVAL;
+
+    wordsPerBlock = hfsmp->vcbVBMIOSize / kBytesPerWord;
+
+    while (block < totalBlocks) {
+        error = ReadBitmapBlock(hfsmp, block, &buffer, &blockRef,
+                                HFS_ALLOC_IGNORE_TENTATIVE);
+        if (error)
+            break;
+
+        for (wordIndex = 0; wordIndex < wordsPerBlock && block < totalBlocks; ++wordIndex, block += kBitsPerWord) {
+            word = SWAP_BE32(buffer[wordIndex]);
+
+            if (word == 0 && totalBlocks - block >= kBitsPerWord) {
+                if (runLength == 0)
+                    runStart = block;
+                runLength += kBitsPerWord;
+                continue;
+            }
+            if (word == kAllBitsSetInWord) {
+                if (runLength != 0) {
+                    callback(callback_arg, runStart, runLength);
+                    runLength = 0;
+                }
+                continue;
+            }
+
+            for (bit = 0; bit < kBitsPerWord && block + bit < totalBlocks; ++bit) {
+                if (word & (kHighBitInWordMask >> bit)) {
+                    if (runLength != 0) {
+                        callback(callback_arg, runStart, runLength);
+                        runLength = 0;
+                    }
+                } else {
+                    if (runLength == 0)
+                        runStart = block + bit;
+                    ++runLength;
+                }
+            }
+        }
+
+        (void)ReleaseBitmapBlock(hfsmp, blockRef, false);
+        buffer = NULL;
+        blockRef = NULL;
+    }
+
+    if (error == 0 && runLength != 0)
+        callback(callback_arg, runStart, runLength);
+
+    return (error);
+}
+
 /*
  * CONFIG_HFS_RBTREE
  * Check to see if the red-black tree is live.  Allocation file lock must be held
@@ -4046,7 +4251,7 @@ void hfs_validate_summary (struct hfsmount *hfsmp) {
  *                    of this call as 'startbit'.
  */
 
-static int hfs_alloc_scan_range(struct hfsmount *hfsmp, u_int32_t startbit,
+static int hfs_alloc_scan_range(struct hfsmount *hfsmp, u_int32_t startbit, u_int32_t maxiosize,
                                 u_int32_t *bitToScan, struct jnl_trim_list *list) {
 
     int error;
@@ -4087,6 +4292,10 @@ static int hfs_alloc_scan_range(struct hfsmount *hfsmp, u_int32_t startbit,
         return error;
     }
 
+    if (maxiosize && iosize > maxiosize) {
+        iosize = maxiosize;
+    }
+
     if (iosize < hfsmp->vcbVBMIOSize) {
         if (ALLOC_DEBUG) {
             LFHFS_LOG(LEVEL_ERROR, "hfs_alloc_scan_range: iosize too small! (iosize %d)\n", iosize);
@@ -4535,6 +4744,8 @@ static void remove_free_extent_cache(struct hfsmount *hfsmp, u_int32_t startBloc
     u_int32_t currentStart, currentEnd, endBlock;
     int extentsRemoved = 0;
 
+    LFHFS_TRACE(HFSDBG_EXT_CACHE_ENABLED, HFSDBG_REMOVE_EXTENT_CACHE | DBG_FUNC_START, startBlock, blockCount, 0, 0, 0);
+
     endBlock = startBlock + blockCount;
 
     lf_lck_spin_lock(&hfsmp->vcbFreeExtLock);
@@ -4617,6 +4828,8 @@ static void remove_free_extent_cache(struct hfsmount *hfsmp, u_int32_t startBloc
     lf_lck_spin_unlock(&hfsmp->vcbFreeExtLock);
     sanity_check_free_ext(hfsmp, 0);
 
+    LFHFS_TRACE(HFSDBG_EXT_CACHE_ENABLED, HFSDBG_REMOVE_EXTENT_CACHE | DBG_FUNC_END, 0, 0, 0, extentsRemoved, 0);
+
     return;
 }
 
@@ -4649,6 +4862,8 @@ static Boolean add_free_extent_cache(struct hfsmount *hfsmp, u_int32_t startBloc
     uint32_t currentEnd;
     uint32_t i;
 
+    LFHFS_TRACE(HFSDBG_EXT_CACHE_ENABLED, HFSDBG_ADD_EXTENT_CACHE | DBG_FUNC_START, startBlock, blockCount, 0, 0, 0);
+
 #if DEBUG
     for (i = 0; i < 2; ++i) {
         struct rl_entry *range;
@@ -4707,6 +4922,8 @@ static Boolean add_free_extent_cache(struct hfsmount *hfsmp, u_int32_t startBloc
 out_not_locked:
     sanity_check_free_ext(hfsmp, 0);
 
+    LFHFS_TRACE(HFSDBG_EXT_CACHE_ENABLED, HFSDBG_ADD_EXTENT_CACHE | DBG_FUNC_END, 0, 0, 0, retval, 0);
+
     return retval;
 }
 
@@ -13,6 +13,10 @@
 
 int hfs_init_summary (struct hfsmount *hfsmp);
 u_int32_t ScanUnmapBlocks (struct hfsmount *hfsmp);
+int ScanUnmapBlocksRange (struct hfsmount *hfsmp, u_int32_t startbit, u_int32_t maxbits, bool unmap, u_int32_t *nextbit);
 int hfs_isallocated(struct hfsmount *hfsmp, u_int32_t startingBlock, u_int32_t numBlocks);
+int hfs_find_free_extents(struct hfsmount *hfsmp,
+                          void (*callback)(void *data, u_int32_t startBlock, u_int32_t blockCount),
+                          void *callback_arg);
 
 #endif /* lf_hfs_volume_allocation_h */
@@ -20,6 +20,9 @@
 #include "lf_hfs_endian.h"
 #include "lf_hfs_logger.h"
 #include "lf_hfs_utils.h"
+#include "lf_hfs_chash.h"
+#include "lf_hfs_readwrite_ops.h"
+#include "lf_hfs_fileops_handler.h"
 
 #define  ATTRIBUTE_FILE_NODE_SIZE   8192
 
@@ -32,6 +35,7 @@ struct listattr_callback_state {
     void        *buf;
     size_t      bufsize;
     size_t      size;
+    struct hfs_xattr_cache *cache;  /* names collected for the cnode's cache, NULL if not collecting */
 };
 
 static u_int32_t emptyfinfo[8] = {0};
@@ -44,6 +48,10 @@ const char hfs_attrdatafilename[] = "Attribute Data";
 static int  listattr_callback(const HFSPlusAttrKey *key, const HFSPlusAttrData *data,
                               struct listattr_callback_state *state);
 
+struct getallattr_callback_state;
+static int  getallattr_callback(const HFSPlusAttrKey *key, const HFSPlusAttrRecord *recp,
+                                struct getallattr_callback_state *state);
+
 static int remove_attribute_records(struct hfsmount *hfsmp, BTreeIterator * iterator);
 
 static int  getnodecount(struct hfsmount *hfsmp, size_t nodesize);
@@ -88,6 +96,354 @@ static int hfs_zero_hidden_fields (struct cnode *cp, u_int8_t *finderinfo)
     return 0;
 }
 
+/*
+ * Extended attribute cache, see lf_hfs_xattr.h.
+ *
+ * The cache hangs off the cnode and is protected by c_xattr_mutex, since
+ * getxattr and listxattr fill it with only a shared cnode lock held.
+ * Anything that changes the attributes of a file holds the cnode lock
+ * exclusive and purges the cache, so a reader holding the lock shared
+ * never races a change.
+ */
+
+XattrCacheStats_S gXattrCacheStat = {0};
+
+/* xe_state, in increasing order of what is known */
+enum {
+    XE_NAME     = 0,    /* attribute exists */
+    XE_SIZE     = 1,    /* ... and xe_size is its size */
+    XE_VALUE    = 2,    /* ... and the value follows xe_name */
+    XE_ABSENT   = 3,    /* attribute does not exist */
+};
+
+struct hfs_xattr_entry {
+    TAILQ_ENTRY(hfs_xattr_entry) xe_link;
+    size_t      xe_allocsize;
+    u_int32_t   xe_size;        /* attribute size in bytes */
+    u_int16_t   xe_namelen;     /* including the terminating NUL */
+    u_int8_t    xe_state;
+    char        xe_name[];      /* followed by the value for XE_VALUE */
+};
+
+struct hfs_xattr_cache {
+    TAILQ_HEAD(, hfs_xattr_entry) xc_entries;   /* in attributes B-tree order when complete */
+    u_int32_t   xc_count;
+    bool        xc_complete;    /* xc_entries names every attribute of the file, no XE_ABSENT */
+};
+
+static struct hfs_xattr_entry *
+hfs_xattr_entry_alloc(const char *name, size_t namelen, u_int8_t state, u_int32_t size, const void *value)
+{
+    struct hfs_xattr_entry *xe;
+    size_t allocsize = sizeof(*xe) + namelen + (state == XE_VALUE ? size : 0);
+
+    if (atomic_load_explicit(&gXattrCacheStat.bytes, memory_order_relaxed) + allocsize > HFS_XATTR_CACHE_MAX_BYTES) {
+        atomic_fetch_add_explicit(&gXattrCacheStat.overflows, 1, memory_order_relaxed);
+        return NULL;
+    }
+    xe = hfs_malloc(allocsize);
+    if (xe == NULL) {
+        return NULL;
+    }
+    atomic_fetch_add_explicit(&gXattrCacheStat.bytes, allocsize, memory_order_relaxed);
+
+    xe->xe_allocsize = allocsize;
+    xe->xe_size = size;
+    xe->xe_namelen = (u_int16_t)namelen;
+    xe->xe_state = state;
+    memcpy(xe->xe_name, name, namelen);
+    if (state == XE_VALUE && size != 0) {
+        memcpy(xe->xe_name + namelen, value, size);
+    }
+    return xe;
+}
+
+static void
+hfs_xattr_entry_free(struct hfs_xattr_entry *xe)
+{
+    atomic_fetch_sub_explicit(&gXattrCacheStat.bytes, xe->xe_allocsize, memory_order_relaxed);
+    hfs_free(xe);
+}
+
+static struct hfs_xattr_cache *
+hfs_xattr_cache_alloc(void)
+{
+    struct hfs_xattr_cache *xc = hfs_mallocz(sizeof(*xc));
+
+    if (xc != NULL) {
+        TAILQ_INIT(&xc->xc_entries);
+        atomic_fetch_add_explicit(&gXattrCacheStat.bytes, sizeof(*xc), memory_order_relaxed);
+    }
+    return xc;
+}
+
+static void
+hfs_xattr_cache_free(struct hfs_xattr_cache *xc)
+{
+    struct hfs_xattr_entry *xe;
+
+    while ((xe = TAILQ_FIRST(&xc->xc_entries)) != NULL) {
+        TAILQ_REMOVE(&xc->xc_entries, xe, xe_link);
+        hfs_xattr_entry_free(xe);
+    }
+    atomic_fetch_sub_explicit(&gXattrCacheStat.bytes, sizeof(*xc), memory_order_relaxed);
+    hfs_free(xc);
+}
+
+static struct hfs_xattr_entry *
+hfs_xattr_cache_find(struct hfs_xattr_cache *xc, const char *name)
+{
+    struct hfs_xattr_entry *xe;
+
+    TAILQ_FOREACH(xe, &xc->xc_entries, xe_link) {
+        if (strcmp(xe->xe_name, name) == 0) {
+            return xe;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Answer a getxattr from the cache.  Returns true, with *result and
+ * *actual_size set as hfs_vnop_getxattr would, if it could.
+ */
+static bool
+hfs_xattr_cache_get(struct cnode *cp, const char *name, void *buf, size_t bufsize, size_t *actual_size, int *result)
+{
+    struct hfs_xattr_cache *xc;
+    struct hfs_xattr_entry *xe;
+    bool hit = false;
+
+    lf_lck_mtx_lock(&cp->c_xattr_mutex);
+    xc = cp->c_xattrcache;
+    if (xc != NULL) {
+        xe = hfs_xattr_cache_find(xc, name);
+        if (xe == NULL || xe->xe_state == XE_ABSENT) {
+            if (xe != NULL || xc->xc_complete) {
+                *result = ENOATTR;
+                hit = true;
+            }
+        } else if (xe->xe_state == XE_VALUE) {
+            *actual_size = xe->xe_size;
+            *result = 0;
+            if (buf && xe->xe_size != 0) {
+                if (xe->xe_size > bufsize) {
+                    *result = ERANGE;
+                } else {
+                    memcpy(buf, xe->xe_name + xe->xe_namelen, xe->xe_size);
+                }
+            }
+            hit = true;
+        } else if (xe->xe_state == XE_SIZE && (buf == NULL || xe->xe_size > bufsize)) {
+            /* Size queries and too small buffers don't need the value. */
+            *actual_size = xe->xe_size;
+            *result = (buf == NULL) ? 0 : ERANGE;
+            hit = true;
+        }
+    }
+    lf_lck_mtx_unlock(&cp->c_xattr_mutex);
+
+    atomic_fetch_add_explicit(hit ? &gXattrCacheStat.hits : &gXattrCacheStat.misses, 1, memory_order_relaxed);
+    return hit;
+}
+
+/*
+ * Record what a B-tree search learnt about one attribute.  value is only
+ * used for XE_VALUE.
+ */
+static void
+hfs_xattr_cache_enter(struct cnode *cp, const char *name, u_int8_t state, u_int32_t size, const void *value)
+{
+    struct hfs_xattr_cache *xc;
+    struct hfs_xattr_entry *xe, *old;
+
+    if (state == XE_VALUE && size > HFS_XATTR_CACHE_MAX_VALUE) {
+        state = XE_SIZE;
+    }
+
+    lf_lck_mtx_lock(&cp->c_xattr_mutex);
+    xc = cp->c_xattrcache;
+    if (xc == NULL) {
+        xc = hfs_xattr_cache_alloc();
+        if (xc == NULL) {
+            goto out;
+        }
+        cp->c_xattrcache = xc;
+    }
+
+    old = hfs_xattr_cache_find(xc, name);
+    if (old == NULL) {
+        /* A complete cache already knows every name there is. */
+        if (xc->xc_complete) {
+            goto out;
+        }
+        if (xc->xc_count >= HFS_XATTR_CACHE_MAX_ENTRIES) {
+            atomic_fetch_add_explicit(&gXattrCacheStat.overflows, 1, memory_order_relaxed);
+            goto out;
+        }
+    } else if (old->xe_state >= state) {
+        goto out;
+    }
+
+    xe = hfs_xattr_entry_alloc(name, strlen(name) + 1, state, size, value);
+    if (xe == NULL) {
+        goto out;
+    }
+    if (old != NULL) {
+        /* Replace in place to keep the B-tree order of a complete cache. */
+        TAILQ_INSERT_BEFORE(old, xe, xe_link);
+        TAILQ_REMOVE(&xc->xc_entries, old, xe_link);
+        hfs_xattr_entry_free(old);
+    } else {
+        TAILQ_INSERT_TAIL(&xc->xc_entries, xe, xe_link);
+        xc->xc_count++;
+    }
+out:
+    lf_lck_mtx_unlock(&cp->c_xattr_mutex);
+}
+
+/*
+ * Answer a listxattr from the cache, if it holds every name.  *size is
+ * the number of bytes of names, as listattr_callback counts them.
+ */
+static bool
+hfs_xattr_cache_list(struct cnode *cp, void *buf, size_t bufsize, size_t *size, int *result)
+{
+    struct hfs_xattr_cache *xc;
+    struct hfs_xattr_entry *xe;
+    bool hit = false;
+
+    lf_lck_mtx_lock(&cp->c_xattr_mutex);
+    xc = cp->c_xattrcache;
+    if (xc != NULL && xc->xc_complete) {
+        *size = 0;
+        *result = 0;
+        TAILQ_FOREACH(xe, &xc->xc_entries, xe_link) {
+            *size += xe->xe_namelen;
+            if (buf != NULL) {
+                if (xe->xe_namelen > bufsize) {
+                    *result = ERANGE;
+                    break;
+                }
+                memcpy(buf, xe->xe_name, xe->xe_namelen);
+                buf = (u_int8_t*)buf + xe->xe_namelen;
+                bufsize -= xe->xe_namelen;
+            }
+        }
+        hit = true;
+    }
+    lf_lck_mtx_unlock(&cp->c_xattr_mutex);
+
+    atomic_fetch_add_explicit(hit ? &gXattrCacheStat.hits : &gXattrCacheStat.misses, 1, memory_order_relaxed);
+    return hit;
+}
+
+/* Called by listattr_callback for each name while state->cache is set. */
+static void
+hfs_xattr_cache_collect(struct listattr_callback_state *state, const char *name, size_t namelen)
+{
+    struct hfs_xattr_cache *xc = state->cache;
+    struct hfs_xattr_entry *xe = NULL;
+
+    if (xc->xc_count < HFS_XATTR_CACHE_MAX_ENTRIES) {
+        xe = hfs_xattr_entry_alloc(name, namelen, XE_NAME, 0, NULL);
+    } else {
+        atomic_fetch_add_explicit(&gXattrCacheStat.overflows, 1, memory_order_relaxed);
+    }
+    if (xe == NULL) {
+        /* Give up, a partial list can't answer listxattr. */
+        hfs_xattr_cache_free(xc);
+        state->cache = NULL;
+        return;
+    }
+    TAILQ_INSERT_TAIL(&xc->xc_entries, xe, xe_link);
+    xc->xc_count++;
+}
+
+/*
+ * Install the complete list of names built by listxattr as the cnode's cache,
+ * keeping the sizes and values the old cache had for those names.
+ */
+static void
+hfs_xattr_cache_install(struct cnode *cp, struct hfs_xattr_cache *xc)
+{
+    struct hfs_xattr_cache *old;
+    struct hfs_xattr_entry *xe, *oxe, *next;
+
+    xc->xc_complete = true;
+
+    lf_lck_mtx_lock(&cp->c_xattr_mutex);
+    old = cp->c_xattrcache;
+    if (old != NULL) {
+        for (xe = TAILQ_FIRST(&xc->xc_entries); xe != NULL; xe = next) {
+            next = TAILQ_NEXT(xe, xe_link);
+            oxe = hfs_xattr_cache_find(old, xe->xe_name);
+            if (oxe != NULL && oxe->xe_state > XE_NAME && oxe->xe_state != XE_ABSENT) {
+                TAILQ_REMOVE(&old->xc_entries, oxe, xe_link);
+                TAILQ_INSERT_BEFORE(xe, oxe, xe_link);
+                TAILQ_REMOVE(&xc->xc_entries, xe, xe_link);
+                hfs_xattr_entry_free(xe);
+            }
+        }
+    }
+    cp->c_xattrcache = xc;
+    lf_lck_mtx_unlock(&cp->c_xattr_mutex);
+
+    if (old != NULL) {
+        hfs_xattr_cache_free(old);
+    }
+}
+
+/*
+ * Drop the extended attribute cache of a cnode.  Called with the cnode
+ * lock held exclusive by anything that changes the attributes, and when
+ * the cnode is reclaimed.
+ */
+void
+hfs_xattr_cache_purge(struct cnode *cp)
+{
+    struct hfs_xattr_cache *xc;
+
+    lf_lck_mtx_lock(&cp->c_xattr_mutex);
+    xc = cp->c_xattrcache;
+    cp->c_xattrcache = NULL;
+    lf_lck_mtx_unlock(&cp->c_xattr_mutex);
+
+    if (xc != NULL) {
+        hfs_xattr_cache_free(xc);
+        atomic_fetch_add_explicit(&gXattrCacheStat.purges, 1, memory_order_relaxed);
+    }
+}
+
+/*
+ * Truncate the resource fork rvp of vp to length and push the new fork
+ * sizes to the catalog.
+ */
+static int
+hfs_truncate_rsrc(vnode_t vp, vnode_t rvp, off_t length)
+{
+    struct cnode *cp = VTOC(vp);
+    int result;
+
+    /* hfs_truncate deals with the cnode lock */
+    hfs_lock_truncate(cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT);
+    result = hfs_truncate(rvp, length, 0, 0);
+    hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+    if (result) {
+        return (result);
+    }
+
+    if ((result = hfs_lock(cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT))) {
+        return (result);
+    }
+    cp->c_touch_chgtime = TRUE;
+    cp->c_flag |= C_MODIFIED;
+    result = hfs_update(vp, 0);
+    hfs_unlock(cp);
+
+    return (result);
+}
+
 /*
  * Retrieve the data of an extended attribute.
  */
@@ -154,7 +510,40 @@ hfs_vnop_getxattr(vnode_t vp, const char *attr_name, void *buf, size_t bufsize,
 
     /* Read the Resource Fork. */
     if (strcmp(attr_name, XATTR_RESOURCEFORK_NAME) == 0) {
-        return (ENOATTR);
+        struct vnode *rvp = NULL;
+        size_t rsrcsize;
+        bool has_rsrc;
+
+        if (!vnode_isreg(vp)) {
+            return (EPERM);
+        }
+        if ((result = hfs_lock(cp, HFS_SHARED_LOCK, HFS_LOCK_DEFAULT))) {
+            return (result);
+        }
+        has_rsrc = hfs_has_rsrc(cp);
+        hfs_unlock(cp);
+        if (!has_rsrc) {
+            return (ENOATTR);
+        }
+
+        /* hfs_vgetrsrc takes the cnode lock and returns with it held. */
+        if ((result = hfs_vgetrsrc(vp, &rvp))) {
+            return (result);
+        }
+        rsrcsize = (size_t)VTOF(rvp)->ff_size;
+        hfs_unlock(cp);
+
+        *actual_size = rsrcsize;
+        if (buf != NULL) {
+            if (bufsize < rsrcsize) {
+                result = ERANGE;
+            } else {
+                /* Reads whole contiguous runs of the rsrc fork extents at a time. */
+                result = LFHFS_Read((UVFSFileNode)rvp, 0, rsrcsize, buf, actual_size);
+            }
+        }
+        hfs_chash_lower_OpenLookupCounter(cp);
+        return (result);
     }
 
     hfsmp = VTOHFS(vp);
@@ -186,18 +575,24 @@ hfs_vnop_getxattr(vnode_t vp, const char *attr_name, void *buf, size_t bufsize,
         goto exit;
     }
 
+    if (hfs_xattr_cache_get(cp, attr_name, buf, bufsize, actual_size, &result)) {
+        goto exit;
+    }
+
     /* Initialize the B-Tree iterator for searching for the proper EA */
     btfile = VTOF(hfsmp->hfs_attribute_vp);
 
     iterator = hfs_mallocz(sizeof(*iterator));
 
     /* Allocate memory for reading in the attribute record.  This buffer is
-     * big enough to read in all types of attribute records.  It is not big
-     * enough to read inline attribute data which is read in later.
+     * big enough to read in all types of attribute records, and inline
+     * attribute data up to HFS_XATTR_CACHE_MAX_VALUE.  Larger inline data
+     * is read in later.
      */
-    recp = hfs_malloc(sizeof(HFSPlusAttrRecord));
+    attrsize = MAX(sizeof(HFSPlusAttrRecord), sizeof(HFSPlusAttrData) - 2 + HFS_XATTR_CACHE_MAX_VALUE);
+    recp = hfs_malloc(attrsize);
     btdata.bufferAddress = recp;
-    btdata.itemSize = sizeof(HFSPlusAttrRecord);
+    btdata.itemSize = attrsize;
     btdata.itemCount = 1;
 
     result = hfs_buildattrkey(target_id, attr_name, (HFSPlusAttrKey *)&iterator->key);
@@ -212,6 +607,7 @@ hfs_vnop_getxattr(vnode_t vp, const char *attr_name, void *buf, size_t bufsize,
 
     if (result) {
         if (result == btNotFound) {
+            hfs_xattr_cache_enter(cp, attr_name, XE_ABSENT, 0, NULL);
             result = ENOATTR;
         }
         goto exit;
@@ -238,6 +634,22 @@ hfs_vnop_getxattr(vnode_t vp, const char *attr_name, void *buf, size_t bufsize,
                 break;
             }
             *actual_size = recp->attrData.attrSize;
+
+            /* Small attributes were read in along with the record. */
+            if (recp->attrData.attrSize <= HFS_XATTR_CACHE_MAX_VALUE &&
+                datasize >= sizeof(HFSPlusAttrData) - 2 + recp->attrData.attrSize) {
+                hfs_xattr_cache_enter(cp, attr_name, XE_VALUE, recp->attrData.attrSize, recp->attrData.attrData);
+                if (buf && recp->attrData.attrSize != 0) {
+                    if (*actual_size > bufsize) {
+                        result = ERANGE;
+                    } else {
+                        memcpy(buf, (caddr_t) &recp->attrData.attrData, recp->attrData.attrSize);
+                    }
+                }
+                break;
+            }
+            hfs_xattr_cache_enter(cp, attr_name, XE_SIZE, recp->attrData.attrSize, NULL);
+
             if (buf && recp->attrData.attrSize != 0) {
                 if (*actual_size > bufsize) {
                     /* User provided buffer is not large enough for the xattr data */
@@ -289,6 +701,7 @@ hfs_vnop_getxattr(vnode_t vp, const char *attr_name, void *buf, size_t bufsize,
                 break;
             }
             *actual_size = recp->forkData.theFork.logicalSize;
+            hfs_xattr_cache_enter(cp, attr_name, XE_SIZE, (u_int32_t)recp->forkData.theFork.logicalSize, NULL);
             if (buf == NULL) {
                 break;
             }
@@ -536,7 +949,51 @@ hfs_vnop_setxattr(vnode_t vp, const char *attr_name, const void *buf, size_t buf
 
     /* Write the Resource Fork. */
     if (strcmp(attr_name, XATTR_RESOURCEFORK_NAME) == 0) {
-        return (ENOTSUP);
+        struct vnode *rvp = NULL;
+        size_t written = 0;
+        off_t rsrcsize;
+        bool has_rsrc;
+
+        if (!vnode_isreg(vp)) {
+            return (EPERM);
+        }
+        cp = VTOC(vp);
+        if ((result = hfs_lock(cp, HFS_SHARED_LOCK, HFS_LOCK_DEFAULT))) {
+            return (result);
+        }
+        has_rsrc = hfs_has_rsrc(cp);
+        hfs_unlock(cp);
+
+        if (has_rsrc && (option == UVFSXattrHowCreate)) {
+            return (EEXIST);
+        }
+        if (!has_rsrc && (option == UVFSXattrHowReplace)) {
+            return (ENOATTR);
+        }
+
+        /* hfs_vgetrsrc takes the cnode lock and returns with it held. */
+        if ((result = hfs_vgetrsrc(vp, &rvp))) {
+            return (result);
+        }
+        rsrcsize = VTOF(rvp)->ff_size;
+        hfs_unlock(cp);
+
+        /*
+         * There is no position to write at, so the value replaces the whole
+         * fork: cut off what lies past the new end, then write the value
+         * with a single call (which allocates the rsrc fork extents).
+         */
+        if (rsrcsize > (off_t)bufsize || bufsize == 0) {
+            result = hfs_truncate_rsrc(vp, rvp, bufsize);
+        }
+        if (result == 0 && bufsize != 0) {
+            result = LFHFS_Write((UVFSFileNode)rvp, 0, bufsize, buf, &written);
+            if (result == 0 && written != bufsize) {
+                result = ENOSPC;
+            }
+        }
+        hfs_chash_lower_OpenLookupCounter(cp);
+        return (result);
     }
 
     attrsize = bufsize;
@@ -546,6 +1003,7 @@ hfs_vnop_setxattr(vnode_t vp, const char *attr_name, const void *buf, size_t buf
         goto exit;
     }
     cp = VTOC(vp);
+    hfs_xattr_cache_purge(cp);
 
     /*
      * If we're trying to set a non-finderinfo, non-resourcefork EA, then
@@ -807,9 +1265,32 @@ hfs_vnop_removexattr(vnode_t vp, const char *attr_name)
         return (EPERM);
     }
 
-    /* Write the Resource Fork. */
+    /* If Resource Fork is non-empty then truncate it. */
     if (strcmp(attr_name, XATTR_RESOURCEFORK_NAME) == 0) {
-        return (ENOTSUP);
+        struct vnode *rvp = NULL;
+        bool has_rsrc;
+
+        if (!vnode_isreg(vp)) {
+            return (EPERM);
+        }
+        if ((result = hfs_lock(cp, HFS_SHARED_LOCK, HFS_LOCK_DEFAULT))) {
+            return (result);
+        }
+        has_rsrc = hfs_has_rsrc(cp);
+        hfs_unlock(cp);
+        if (!has_rsrc) {
+            return (ENOATTR);
+        }
+
+        if ((result = hfs_vgetrsrc(vp, &rvp))) {
+            return (result);
+        }
+        hfs_unlock(cp);
+
+        result = hfs_truncate_rsrc(vp, rvp, 0);
+
+        hfs_chash_lower_OpenLookupCounter(cp);
+        return (result);
     }
 
     /* Clear out the Finder Info. */
@@ -905,6 +1386,7 @@ hfs_vnop_removexattr(vnode_t vp, const char *attr_name)
     if ((result = hfs_lock(cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT))) {
         goto exit_nolock;
     }
+    hfs_xattr_cache_purge(cp);
 
     result = hfs_buildattrkey(cp->c_fileid, attr_name, (HFSPlusAttrKey *)&iterator->key);
     if (result) {
@@ -1516,6 +1998,19 @@ hfs_vnop_listxattr(vnode_t vp, void *buf, size_t bufsize, size_t *actual_size)
         }
     }
 
+    /* If Resource Fork is non-empty then export it's name. */
+    if (vnode_isreg(vp) && hfs_has_rsrc(cp)) {
+        if (buf == NULL) {
+            *actual_size += sizeof(XATTR_RESOURCEFORK_NAME);
+        } else if (bufsize - *actual_size < sizeof(XATTR_RESOURCEFORK_NAME)) {
+            result = ERANGE;
+            goto exit;
+        } else {
+            strcpy((char*)buf + *actual_size, XATTR_RESOURCEFORK_NAME);
+            *actual_size += sizeof(XATTR_RESOURCEFORK_NAME);
+        }
+    }
+
     /* Bail if we don't have any extended attributes. */
     if ((hfsmp->hfs_attribute_vp == NULL) ||
         (cp->c_attr.ca_recflags & kHFSHasAttributesMask) == 0) {
@@ -1524,6 +2019,12 @@ hfs_vnop_listxattr(vnode_t vp, void *buf, size_t bufsize, size_t *actual_size)
     }
     btfile = VTOF(hfsmp->hfs_attribute_vp);
 
+    if (hfs_xattr_cache_list(cp, (buf == NULL ? NULL : ((u_int8_t*)buf + *actual_size)),
+                             bufsize - *actual_size, &state.size, &result)) {
+        *actual_size += state.size;
+        goto exit;
+    }
+
     iterator = hfs_mallocz(sizeof(*iterator));
 
     result = hfs_buildattrkey(cp->c_fileid, NULL, (HFSPlusAttrKey *)&iterator->key);
@@ -1544,6 +2045,7 @@ hfs_vnop_listxattr(vnode_t vp, void *buf, size_t bufsize, size_t *actual_size)
     state.buf = (buf == NULL ? NULL : ((u_int8_t*)buf + *actual_size));
     state.bufsize = bufsize - *actual_size;
     state.size = 0;
+    state.cache = hfs_xattr_cache_alloc();
 
     /*
      * Process entries starting just after iterator->key.
@@ -1558,6 +2060,14 @@ hfs_vnop_listxattr(vnode_t vp, void *buf, size_t bufsize, size_t *actual_size)
         result = state.result;
     }
 
+    if (state.cache != NULL) {
+        if (result == 0 && state.result == 0) {
+            hfs_xattr_cache_install(cp, state.cache);
+        } else {
+            hfs_xattr_cache_free(state.cache);
+        }
+    }
+
 exit:
     hfs_free(iterator);
     hfs_unlock(cp);
@@ -1596,6 +2106,10 @@ listattr_callback(const HFSPlusAttrKey *key, __unused const HFSPlusAttrData *dat
     }
     bytecount++; /* account for null termination char */
 
+    if (state->cache != NULL) {
+        hfs_xattr_cache_collect(state, attrname, bytecount);
+    }
+
     state->size += bytecount;
 
     if (state->buf != NULL) {
@@ -1612,6 +2126,311 @@ listattr_callback(const HFSPlusAttrKey *key, __unused const HFSPlusAttrData *dat
     return (1); /* continue */
 }
 
+/*
+ * An extent based attribute whose data is read once the attributes B-tree
+ * has been walked.
+ */
+struct getallattr_fork {
+    TAILQ_ENTRY(getallattr_fork) gf_link;
+    void        *gf_value;          /* where the data goes in the caller's buffer */
+    u_int64_t   gf_size;
+    u_int32_t   gf_totalblocks;
+    u_int32_t   gf_blkcnt;          /* blocks covered by gf_extents so far */
+    u_int32_t   gf_nextents;        /* used entries of gf_extents */
+    u_int32_t   gf_maxextents;
+    HFSPlusExtentDescriptor gf_extents[];   /* zero terminated */
+};
+
+/* State information for the getallattr_callback callback function. */
+struct getallattr_callback_state {
+    struct hfsmount *hfsmp;
+    u_int32_t   fileID;
+    size_t      maxinline;          /* largest valid inline attribute */
+    int         result;
+    u_int8_t    *buf;               /* NULL once the buffer is full, we then only count */
+    size_t      bufsize;
+    size_t      size;
+    struct getallattr_fork *fork;   /* last primary record, if extent based and copied */
+    TAILQ_HEAD(, getallattr_fork) forks;
+};
+
+/*
+ * Account for one entry, and copy its header and name if it fits.  Returns
+ * the entry, or NULL if it is only being counted.
+ */
+static LFHFSXAttrEntry_S *
+getallattr_addentry(u_int8_t **bufp, size_t *bufsizep, size_t *sizep, int *resultp,
+                    const char *name, size_t namelen, u_int64_t valuesize)
+{
+    size_t reclen = LFHFS_XATTR_ENTRY_SIZE(namelen, valuesize);
+    LFHFSXAttrEntry_S *entry;
+
+    *sizep += reclen;
+    if (*bufp == NULL) {
+        return NULL;
+    }
+    if (reclen > *bufsizep) {
+        /* Keep counting so the caller learns the size it needs. */
+        *resultp = ERANGE;
+        *bufp = NULL;
+        return NULL;
+    }
+
+    entry = (LFHFSXAttrEntry_S *)*bufp;
+    bzero(entry, reclen);
+    entry->uRecLen = (uint32_t)reclen;
+    entry->uNameLen = (uint32_t)namelen;
+    entry->uValueSize = valuesize;
+    memcpy(entry->pcName, name, namelen);
+
+    *bufp += reclen;
+    *bufsizep -= reclen;
+    return entry;
+}
+
+/*
+ * Retrieve the names and values of all the extended attributes of a file
+ * in a single walk of the attributes B-tree.
+ *
+ * Inline data is copied from the records as they are iterated.  Extent
+ * based data is read after the walk, once the B-tree lock is dropped, like
+ * hfs_vnop_getxattr does.  If the buffer is too small, the walk goes on
+ * counting and ERANGE is returned with *actual_size set to the size needed.
+ */
+int
+hfs_vnop_getallxattr(vnode_t vp, void *buf, size_t bufsize, size_t *actual_size)
+{
+    struct cnode *cp = VTOC(vp);
+    struct hfsmount *hfsmp;
+    BTreeIterator * iterator = NULL;
+    struct filefork *btfile;
+    struct getallattr_callback_state state;
+    struct getallattr_fork *gf;
+    LFHFSXAttrEntry_S *entry;
+    size_t maxinline = 0;
+    int lockflags;
+    int result;
+    u_int8_t finderinfo[32];
+
+    if (actual_size == NULL) {
+        return (EINVAL);
+    }
+    if (VNODE_IS_RSRC(vp)) {
+        return (EPERM);
+    }
+
+    hfsmp = VTOHFS(vp);
+    *actual_size = 0;
+
+    bzero(&state, sizeof(state));
+    TAILQ_INIT(&state.forks);
+    state.buf = buf;
+    state.bufsize = (buf == NULL) ? 0 : bufsize;
+
+    if (hfsmp->hfs_attribute_vp != NULL) {
+        maxinline = getmaxinlineattrsize(hfsmp->hfs_attribute_vp);
+    }
+
+    /* Same locking as hfs_vnop_listxattr. */
+    hfs_lock_truncate(cp, HFS_SHARED_LOCK, HFS_LOCK_DEFAULT);
+    if ((result = hfs_lock(cp, HFS_SHARED_LOCK, HFS_LOCK_DEFAULT))) {
+        hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+        return (result);
+    }
+
+    /* The Finder Info, as hfs_vnop_getxattr returns it. */
+    bcopy(cp->c_finderinfo, finderinfo, sizeof(finderinfo));
+    hfs_zero_hidden_fields (cp, finderinfo);
+    if (vnode_islnk(vp)) {
+        struct FndrFileInfo *fip;
+
+        fip = (struct FndrFileInfo *)&finderinfo;
+        fip->fdType = 0;
+        fip->fdCreator = 0;
+    }
+    if (bcmp(finderinfo, emptyfinfo, sizeof(emptyfinfo)) != 0) {
+        entry = getallattr_addentry(&state.buf, &state.bufsize, &state.size, &state.result,
+                                    XATTR_FINDERINFO_NAME, sizeof(XATTR_FINDERINFO_NAME), sizeof(finderinfo));
+        if (entry != NULL) {
+            memcpy(LFHFS_XATTR_ENTRY_VALUE(entry), finderinfo, sizeof(finderinfo));
+        }
+    }
+
+    /* Bail if we don't have any extended attributes. */
+    if ((hfsmp->hfs_attribute_vp == NULL) ||
+        (cp->c_attr.ca_recflags & kHFSHasAttributesMask) == 0) {
+        result = 0;
+        goto exit;
+    }
+    btfile = VTOF(hfsmp->hfs_attribute_vp);
+
+    iterator = hfs_mallocz(sizeof(*iterator));
+
+    result = hfs_buildattrkey(cp->c_fileid, NULL, (HFSPlusAttrKey *)&iterator->key);
+    if (result) {
+        goto exit;
+    }
+
+    lockflags = hfs_systemfile_lock(hfsmp, SFL_ATTRIBUTE, HFS_SHARED_LOCK);
+
+    result = BTSearchRecord(btfile, iterator, NULL, NULL, NULL);
+    if (result && result != btNotFound) {
+        hfs_systemfile_unlock(hfsmp, lockflags);
+        goto exit;
+    }
+
+    state.hfsmp = hfsmp;
+    state.fileID = cp->c_fileid;
+    state.maxinline = maxinline;
+
+    /*
+     * Process entries starting just after iterator->key.
+     */
+    result = BTIterateRecords(btfile, kBTreeNextRecord, iterator,
+                              (IterateCallBackProcPtr)getallattr_callback, &state);
+    hfs_systemfile_unlock(hfsmp, lockflags);
+
+    if (result == btNotFound) {
+        result = 0;
+    }
+    if (result) {
+        goto exit;
+    }
+
+    /* Now read in the extent based attributes. */
+    if (state.result == 0) {
+        TAILQ_FOREACH(gf, &state.forks, gf_link) {
+            if (gf->gf_blkcnt < gf->gf_totalblocks) {
+                LFHFS_LOG(LEVEL_DEBUG, "hfs_getallxattr: missing extents, only %d blks of %d found\n",
+                          gf->gf_blkcnt, gf->gf_totalblocks);
+                result = ENOATTR;
+                break;
+            }
+            result = read_attr_data(hfsmp, gf->gf_value, gf->gf_size, gf->gf_extents);
+            if (result) {
+                break;
+            }
+        }
+    }
+
+exit:
+    while ((gf = TAILQ_FIRST(&state.forks)) != NULL) {
+        TAILQ_REMOVE(&state.forks, gf, gf_link);
+        hfs_free(gf);
+    }
+    hfs_free(iterator);
+    hfs_unlock(cp);
+    hfs_unlock_truncate(cp, HFS_LOCK_DEFAULT);
+
+    *actual_size = state.size;
+    if (result == 0) {
+        result = state.result;
+    }
+
+    return MacToVFSError(result);
+}
+
+/*
+ * Callback - called for each attribute record by hfs_vnop_getallxattr.
+ * Overflow extent records of an attribute follow its fork data record.
+ */
+static int
+getallattr_callback(const HFSPlusAttrKey *key, const HFSPlusAttrRecord *recp, struct getallattr_callback_state *state)
+{
+    char attrname[XATTR_MAXNAMELEN + 1];
+    size_t bytecount;
+    struct getallattr_fork *gf;
+    LFHFSXAttrEntry_S *entry;
+    u_int64_t valuesize;
+    int result;
+
+    if (state->fileID != key->fileID) {
+        return (0);    /* stop */
+    }
+
+    if (key->startBlock != 0) {
+        gf = state->fork;
+        if (gf == NULL || recp->recordType != kHFSPlusAttrExtents) {
+            return (1);    /* continue */
+        }
+        if (key->startBlock != gf->gf_blkcnt ||
+            gf->gf_nextents + kHFSPlusExtentDensity > gf->gf_maxextents) {
+            /* Leave gf_blkcnt short, the attribute fails with ENOATTR. */
+            state->fork = NULL;
+            return (1);    /* continue */
+        }
+        bcopy(&recp->overflowExtents.extents[0], &gf->gf_extents[gf->gf_nextents], sizeof(HFSPlusExtentRecord));
+        gf->gf_nextents += kHFSPlusExtentDensity;
+        gf->gf_blkcnt += count_extent_blocks(gf->gf_totalblocks, (HFSPlusExtentDescriptor *)recp->overflowExtents.extents);
+        return (1);    /* continue */
+    }
+    state->fork = NULL;
+
+    switch (recp->recordType) {
+        case kHFSPlusAttrInlineData:
+            if (recp->attrData.attrSize > state->maxinline) {
+                LFHFS_LOG(LEVEL_DEBUG, "hfs_getallxattr: vol=%s %d: invalid inline size %d\n",
+                          state->hfsmp->vcbVN, key->fileID, recp->attrData.attrSize);
+                return (1);    /* continue */
+            }
+            valuesize = recp->attrData.attrSize;
+            break;
+        case kHFSPlusAttrForkData:
+            /* Ignore bogus block counts. */
+            if (recp->forkData.theFork.totalBlocks > howmany(HFS_XATTR_MAXSIZE, state->hfsmp->blockSize)) {
+                return (1);    /* continue */
+            }
+            valuesize = recp->forkData.theFork.logicalSize;
+            break;
+        default:
+            /* We only support inline and extent based EAs, like hfs_vnop_getxattr. */
+            return (1);    /* continue */
+    }
+
+    /* Convert the attribute name into UTF-8. */
+    result = utf8_encodestr(key->attrName, key->attrNameLen * sizeof(UniChar),
+                            (u_int8_t *)attrname, &bytecount, sizeof(attrname), '/', UTF_ADD_NULL_TERM);
+    if (result) {
+        state->result = result;
+        return (0);    /* stop */
+    }
+    bytecount++; /* account for null termination char */
+
+    entry = getallattr_addentry(&state->buf, &state->bufsize, &state->size, &state->result,
+                                attrname, bytecount, valuesize);
+    if (entry == NULL) {
+        return (1);    /* continue, counting */
+    }
+
+    if (recp->recordType == kHFSPlusAttrInlineData) {
+        memcpy(LFHFS_XATTR_ENTRY_VALUE(entry), recp->attrData.attrData, recp->attrData.attrSize);
+        return (1);    /* continue */
+    }
+
+    if (valuesize == 0) {
+        return (1);    /* continue */
+    }
+
+    /* Room for the worst case amount of extents, plus a terminating record. */
+    u_int32_t maxextents = (u_int32_t)roundup(recp->forkData.theFork.totalBlocks, kHFSPlusExtentDensity);
+    gf = hfs_mallocz(sizeof(*gf) + (maxextents + kHFSPlusExtentDensity) * sizeof(HFSPlusExtentDescriptor));
+    if (gf == NULL) {
+        state->result = ENOMEM;
+        return (0);    /* stop */
+    }
+    gf->gf_value = LFHFS_XATTR_ENTRY_VALUE(entry);
+    gf->gf_size = valuesize;
+    gf->gf_totalblocks = recp->forkData.theFork.totalBlocks;
+    gf->gf_maxextents = maxextents;
+    bcopy(&recp->forkData.theFork.extents[0], &gf->gf_extents[0], sizeof(HFSPlusExtentRecord));
+    gf->gf_nextents = kHFSPlusExtentDensity;
+    gf->gf_blkcnt = count_extent_blocks(gf->gf_totalblocks, (HFSPlusExtentDescriptor *)recp->forkData.theFork.extents);
+    TAILQ_INSERT_TAIL(&state->forks, gf, gf_link);
+    state->fork = gf;
+
+    return (1); /* continue */
+}
+
 /*
  * Remove all the attributes from a cnode.
  *
@@ -11,6 +11,52 @@
 #include "lf_hfs_vnode.h"
 #include "lf_hfs_format.h"
 #include <UserFS/UserVFS.h>
+#include <stdatomic.h>
+
+/*
+ * Per-cnode extended attribute cache.
+ *
+ * Names seen by listxattr/getxattr are kept on the cnode, together with
+ * the size and, for inline attributes no larger than
+ * HFS_XATTR_CACHE_MAX_VALUE, the value.  Once listxattr has walked every
+ * record of a file the cache is complete and also answers ENOATTR.  The
+ * cache is dropped by setxattr, removexattr and before hfs_removeallattr.
+ */
+#define HFS_XATTR_CACHE_MAX_VALUE     (256)                 /* largest value kept, in bytes */
+#define HFS_XATTR_CACHE_MAX_ENTRIES   (32)                  /* per cnode */
+#define HFS_XATTR_CACHE_MAX_BYTES     (4 * 1024 * 1024)     /* all cnodes together */
+
+typedef struct {
+    _Atomic uint64_t hits;          /* getxattr / listxattr answered from the cache */
+    _Atomic uint64_t misses;        /* ... that had to go to the attributes B-tree */
+    _Atomic uint64_t purges;        /* caches dropped by a change or by reclaim */
+    _Atomic uint64_t overflows;     /* entries not cached because of the caps above */
+    _Atomic uint64_t bytes;         /* memory currently held by all caches */
+} XattrCacheStats_S;
+
+extern XattrCacheStats_S gXattrCacheStat;
+
+struct cnode;
+void hfs_xattr_cache_purge(struct cnode *cp);
+
+/*
+ * Entry of the buffer filled by hfs_vnop_getallxattr.  Entries follow each
+ * other in the order listxattr returns the names (Finder Info first, then
+ * attributes B-tree order); uRecLen is the offset of the next entry.  The
+ * value starts at pcName + uNameLen.  The resource fork is left out, read
+ * it through getxattr or the stream interface.
+ */
+typedef struct {
+    uint32_t    uRecLen;                /* multiple of 8 */
+    uint32_t    uNameLen;               /* including the terminating NUL */
+    uint64_t    uValueSize;
+    char        pcName[];
+} LFHFSXAttrEntry_S;
+
+#define LFHFS_XATTR_ENTRY_SIZE(namelen, valuesize)  \
+    (((sizeof(LFHFSXAttrEntry_S) + (namelen) + (valuesize)) + 7) & ~(size_t)7)
+#define LFHFS_XATTR_ENTRY_VALUE(entry)              ((void*)((entry)->pcName + (entry)->uNameLen))
+#define LFHFS_XATTR_ENTRY_NEXT(entry)               ((LFHFSXAttrEntry_S*)((uint8_t*)(entry) + (entry)->uRecLen))
 
 int hfs_attrkeycompare(HFSPlusAttrKey *searchKey, HFSPlusAttrKey *trialKey);
 int init_attrdata_vnode(struct hfsmount *hfsmp);
@@ -21,5 +67,6 @@ int hfs_vnop_getxattr(vnode_t vp, const char *attr_name, void *buf, size_t bufsi
 int hfs_vnop_setxattr(vnode_t vp, const char *attr_name, const void *buf, size_t bufsize, UVFSXattrHow How);
 int hfs_vnop_removexattr(vnode_t vp, const char *attr_name);
 int hfs_vnop_listxattr(vnode_t vp, void *buf, size_t bufsize, size_t *actual_size);
+int hfs_vnop_getallxattr(vnode_t vp, void *buf, size_t bufsize, size_t *actual_size);
 
 #endif /* lf_hfs_xattr_h */
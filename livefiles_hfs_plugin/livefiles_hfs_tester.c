@@ -8,17 +8,30 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <mach/mach_time.h>
 #include "livefiles_hfs_tester.h"
 #include "lf_hfs_fsops_handler.h"
 #include "lf_hfs_dirops_handler.h"
 #include <UserFS/UserVFS.h>
 #include <assert.h>
+#include <sys/xattr.h>
 #include <sys/queue.h>
 #include "lf_hfs_journal.h"
 #include "lf_hfs_generic_buf.h"
 #include "lf_hfs_vfsutils.h"
 #include "lf_hfs_raw_read_write.h"
+#include "lf_hfs_stats.h"
+#include "lf_hfs_trace.h"
+#include "lf_hfs_fsinfo.h"
+#include "lf_hfs_defrag.h"
+#include "lf_hfs_jnlconfig.h"
+#include "lf_hfs_copy.h"
+#include "lf_hfs_rmtree.h"
+#include "lf_hfs_createbatch.h"
+#include "lf_hfs_fileops_handler.h"
+#include "lf_hfs_xattr.h"
+#include "lf_hfs_vnops.h"
 
 #define DEFAULT_SYNCER_PERIOD     100 // mS
 #define MAX_UTF8_NAME_LENGTH (NAME_MAX*3+1)
@@ -95,6 +108,11 @@ CrashReport_S gsCrashReport;
 #endif
 
 int giFD = 0;
+TestData_S* gpsTestData = NULL;
+
+static int HFSTest_Unmount(UVFSFileNode* ppsRootNode);
+static int HFSTest_Mount(UVFSFileNode* ppsRootNode);
+static int HFSTest_Remount(UVFSFileNode* ppsRootNode);
 
 // Multi-thread read-write test
 #if 1 // Quick Regression
@@ -123,6 +141,24 @@ typedef struct {
     int32_t      iRetVal;
 } RWThreadData_S;
 
+typedef struct {
+    UVFSFileNode psFile;
+    uint64_t     uOffset;
+    uint64_t     uLength;
+    uint32_t     uChunk;
+    uint32_t     uPasses;
+    uint8_t      uFirstByte;        // pass p writes uFirstByte + p
+    int32_t      iRetVal;
+} OverwriteThreadData_S;
+
+typedef struct {
+    UVFSFileNode psDir;
+    uint32_t     uThreadNum;
+    cnid_t*      puIDs;             // fileids of the DIRCONC_STABLE_FILES stable files
+    uint32_t     uRestarts;
+    int32_t      iRetVal;
+} DirThreadData_S;
+
 
 static int   SetAttrChangeSize(UVFSFileNode FileNode,uint64_t uNewSize);
 static int   SetAttrChangeMode(UVFSFileNode FileNode,uint32_t uNewMode);
@@ -131,6 +167,10 @@ static int   SetAttrChangeAtimeMtime(UVFSFileNode FileNode);
 static int   GetAttrAndCompare(UVFSFileNode FileNode,UVFSFileAttributes* sInAttrs);
 static int   HFSTest_RunTest(TestData_S *psTestData);
 static void *ReadWriteThread(void *pvArgs);
+static void *OverwriteThread(void *pvArgs);
+static void *DirMutatorThread(void *pvArgs);
+static void *DirLookupThread(void *pvArgs);
+static void *DirReadDirThread(void *pvArgs);
 
 
 struct unistr255 {
@@ -219,6 +259,25 @@ void HFSTest_PrintCacheStats(void) {
            gCacheStat.gen_buf_uncached);
 }
 
+void HFSTest_PrintOpStats(void) {
+    printf("Operation Statistics:\n");
+    LFHFS_StatsDump(stdout);
+}
+
+// Set LFHFS_TRACE_MASK (see lf_hfs_trace.h) and LFHFS_TRACE_FILE to collect a
+// trace of every test into <LFHFS_TRACE_FILE>.<test name>.
+void HFSTest_DumpTrace(const char *pcTestName) {
+    const char *pcTraceFile = getenv("LFHFS_TRACE_FILE");
+    if (pcTraceFile == NULL || LFHFS_TraceGetMask() == 0) {
+        return;
+    }
+
+    char pcPath[PATH_MAX] = {0};
+    snprintf(pcPath, sizeof(pcPath), "%s.%s", pcTraceFile, pcTestName);
+    int iErr = LFHFS_TraceDump(pcPath);
+    printf("Trace dumped to %s, err [%d]\n", pcPath, iErr);
+}
+
 __unused static long long int timestamp()
 {
     /* Example of timestamp in second. */
@@ -873,6 +932,12 @@ SetAttrChangeAtimeMtime(UVFSFileNode FileNode)
 
 #define HFS_TEST_PREFIX        "RUN_HFS_TESTS"
 #define HFS_RUN_FSCK           "RUN_FSCK"
+#define HFS_RUN_BENCH          "RUN_HFS_BENCH"
+#define HFS_RUN_FSINFO         "RUN_HFS_FSINFO"
+#define FSINFO_DEFAULT_TOP     (20)
+#define HFS_RUN_DEFRAG         "RUN_HFS_DEFRAG"
+#define DEFRAG_DEFAULT_FILES   (100)
+#define HFS_RUN_JNL            "RUN_HFS_JNL"
 #define HFS_DMGS_FOLDER        "/Volumes/SSD_Shared/FS_DMGs/"
 #define TEMP_DMG               "/tmp/hfstester.dmg"
 #define TEMP_DMG_SPARSE        "/tmp/hfstester.dmg.sparseimage"
@@ -2157,6 +2222,150 @@ exit:
     return iErr;
 }
 
+static void *OverwriteThread(void *pvArgs) {
+    int iErr = 0;
+
+    OverwriteThreadData_S *psThrdData = pvArgs;
+    uint8_t *puBuf = malloc(psThrdData->uChunk);
+    assert(puBuf);
+
+    for(uint32_t uPass=0; uPass<psThrdData->uPasses; uPass++) {
+        memset(puBuf, psThrdData->uFirstByte + uPass, psThrdData->uChunk);
+        for(uint64_t uOff=0; uOff<psThrdData->uLength; uOff+=psThrdData->uChunk) {
+            size_t iLen = MIN(psThrdData->uChunk, psThrdData->uLength - uOff);
+            size_t iActuallyWrite = 0;
+            iErr = HFS_fsOps.fsops_write(psThrdData->psFile, psThrdData->uOffset + uOff, iLen, puBuf, &iActuallyWrite);
+            if (iErr || iActuallyWrite != iLen) {
+                printf("Failed writing %zu bytes at %llu, iErr %d, wrote %zu\n", iLen, psThrdData->uOffset + uOff, iErr, iActuallyWrite);
+                if (!iErr) iErr = EIO;
+                goto exit;
+            }
+        }
+    }
+exit:
+    free(puBuf);
+    psThrdData->iRetVal = iErr;
+    return psThrdData;
+}
+
+/*
+ * Several threads overwrite one preallocated file at the same time while
+ * another one keeps extending it.  Disjoint regions are not sector aligned,
+ * so neighbours share sectors; the two overlapping writers use the same
+ * unaligned chunks, so each chunk must end up wholly one writer's last pass.
+ */
+static int HFSTest_ConcurrentOverwrite(UVFSFileNode psRootNode) {
+    #define OVERWRITE_DISJOINT_THREADS  (8)
+    #define OVERWRITE_OVERLAP_THREADS   (2)
+    #define OVERWRITE_THREADS           (OVERWRITE_DISJOINT_THREADS + OVERWRITE_OVERLAP_THREADS + 1)
+    #define OVERWRITE_REGION_SIZE       (3*4096 + 123)
+    #define OVERWRITE_CHUNK_SIZE        (1500)
+    #define OVERWRITE_PASSES            (20)
+    #define OVERWRITE_BASE_SIZE         ((OVERWRITE_DISJOINT_THREADS + 1) * OVERWRITE_REGION_SIZE)
+    #define OVERWRITE_EXTEND_SIZE       (64 * OVERWRITE_CHUNK_SIZE)
+    #define OVERWRITE_TOTAL_SIZE        (OVERWRITE_BASE_SIZE + OVERWRITE_EXTEND_SIZE)
+
+    int iErr = 0;
+    UVFSFileNode psFile = NULL;
+    size_t iActually = 0;
+
+    // Write the whole file once, so the overwrites below are of allocated, valid space
+    uint8_t *puBuf = malloc(OVERWRITE_TOTAL_SIZE);
+    assert(puBuf);
+    assert(CreateNewFile(psRootNode, &psFile, "ConcurrentOverwrite", OVERWRITE_BASE_SIZE) == 0);
+    memset(puBuf, 0x5A, OVERWRITE_BASE_SIZE);
+    assert(HFS_fsOps.fsops_write(psFile, 0, OVERWRITE_BASE_SIZE, puBuf, &iActually) == 0);
+    assert(iActually == OVERWRITE_BASE_SIZE);
+
+    pthread_attr_t sAttr;
+    pthread_attr_setdetachstate(&sAttr, PTHREAD_CREATE_JOINABLE);
+    pthread_attr_init(&sAttr);
+    pthread_t psExecThread[OVERWRITE_THREADS];
+    OverwriteThreadData_S pcThreadData[OVERWRITE_THREADS] = {{0}};
+    for(uint32_t u = 0; u < OVERWRITE_THREADS; u++) {
+        pcThreadData[u].psFile  = psFile;
+        pcThreadData[u].uChunk  = OVERWRITE_CHUNK_SIZE;
+        pcThreadData[u].uPasses = OVERWRITE_PASSES;
+        if (u < OVERWRITE_DISJOINT_THREADS) {
+            pcThreadData[u].uOffset    = u * OVERWRITE_REGION_SIZE;
+            pcThreadData[u].uLength    = OVERWRITE_REGION_SIZE;
+            pcThreadData[u].uFirstByte = (uint8_t)(u * OVERWRITE_PASSES);
+        } else if (u < OVERWRITE_DISJOINT_THREADS + OVERWRITE_OVERLAP_THREADS) {
+            pcThreadData[u].uOffset    = OVERWRITE_DISJOINT_THREADS * OVERWRITE_REGION_SIZE;
+            pcThreadData[u].uLength    = OVERWRITE_REGION_SIZE;
+            pcThreadData[u].uFirstByte = (uint8_t)(u * OVERWRITE_PASSES);
+        } else {
+            // The extending writer appends each chunk past the current EOF
+            pcThreadData[u].uOffset    = OVERWRITE_BASE_SIZE;
+            pcThreadData[u].uLength    = OVERWRITE_EXTEND_SIZE;
+            pcThreadData[u].uPasses    = 1;
+            pcThreadData[u].uFirstByte = 0xEE;
+        }
+
+        iErr = pthread_create(&psExecThread[u], &sAttr, OverwriteThread, &pcThreadData[u]);
+        if (iErr) {
+            printf("can't pthread_create\n");
+            goto exit;
+        }
+    }
+    pthread_attr_destroy(&sAttr);
+
+    for(uint32_t u = 0; u < OVERWRITE_THREADS; u++) {
+        iErr = pthread_join(psExecThread[u], NULL);
+        if (iErr) {
+            printf("can't pthread_join\n");
+            goto exit;
+        }
+        if (pcThreadData[u].iRetVal) {
+            printf("Thread %u return error %d\n", u, pcThreadData[u].iRetVal);
+            iErr = pcThreadData[u].iRetVal;
+        }
+    }
+    if (iErr) {
+        goto exit;
+    }
+
+    UVFSFileAttributes sOutAttrs;
+    assert(HFS_fsOps.fsops_getattr(psFile, &sOutAttrs) == 0);
+    assert(sOutAttrs.fa_size == OVERWRITE_TOTAL_SIZE);
+
+    memset(puBuf, 0, OVERWRITE_TOTAL_SIZE);
+    assert(HFS_fsOps.fsops_read(psFile, 0, OVERWRITE_TOTAL_SIZE, puBuf, &iActually) == 0);
+    assert(iActually == OVERWRITE_TOTAL_SIZE);
+
+    // Every disjoint region holds its writer's last pass
+    for(uint32_t u = 0; u < OVERWRITE_DISJOINT_THREADS; u++) {
+        uint8_t uExpected = pcThreadData[u].uFirstByte + OVERWRITE_PASSES - 1;
+        for(uint64_t uOff = 0; uOff < OVERWRITE_REGION_SIZE; uOff++) {
+            assert(puBuf[u * OVERWRITE_REGION_SIZE + uOff] == uExpected);
+        }
+    }
+
+    // Every overlapped chunk is wholly the last pass of one of its writers
+    uint8_t uLastA = pcThreadData[OVERWRITE_DISJOINT_THREADS].uFirstByte + OVERWRITE_PASSES - 1;
+    uint8_t uLastB = pcThreadData[OVERWRITE_DISJOINT_THREADS + 1].uFirstByte + OVERWRITE_PASSES - 1;
+    for(uint64_t uOff = 0; uOff < OVERWRITE_REGION_SIZE; uOff += OVERWRITE_CHUNK_SIZE) {
+        uint8_t *puChunk = &puBuf[OVERWRITE_DISJOINT_THREADS * OVERWRITE_REGION_SIZE + uOff];
+        size_t iLen = MIN(OVERWRITE_CHUNK_SIZE, OVERWRITE_REGION_SIZE - uOff);
+        assert(puChunk[0] == uLastA || puChunk[0] == uLastB);
+        for(size_t i = 1; i < iLen; i++) {
+            assert(puChunk[i] == puChunk[0]);
+        }
+    }
+
+    for(uint64_t uOff = OVERWRITE_BASE_SIZE; uOff < OVERWRITE_TOTAL_SIZE; uOff++) {
+        assert(puBuf[uOff] == 0xEE);
+    }
+
+exit:
+    free(puBuf);
+    HFS_fsOps.fsops_reclaim(psFile, 0);
+    if (!iErr) {
+        iErr = RemoveFile(psRootNode, "ConcurrentOverwrite");
+    }
+    return iErr;
+}
+
 static int
 HFSTest_Create1000Files( UVFSFileNode RootNode )
 {
@@ -3592,1076 +3801,3397 @@ exit:
 }
 
 static int
-HFSTest_RandomIO( UVFSFileNode RootNode )
+HFSTest_CopyFile( UVFSFileNode RootNode )
 {
-#define MAX_IO_SIZE (1024*1024)
-#define MAX_IO_OFFSET (80*MAX_IO_SIZE)
-#define TEST_RUN_TIME_SEC (30)
-
-    int iErr = 0;
-    UVFSFileNode psFile;
-    static mach_timebase_info_data_t sTimebaseInfo;
-    mach_timebase_info(&sTimebaseInfo);
+#define COPY_FILE_SIZE  (3*1024*1024 + 1234)
 
-    void* pvWriteBuf    = malloc(MAX_IO_SIZE);
-    void* pvReadBuf     = malloc(MAX_IO_SIZE);
+    const char* pcAttr      = "com.apple.test.copy";
+    char pcData[]           = "This is attribute data";
+    char pcAttrBuf[64]      = {0};
+    UVFSFileNode psFile     = NULL;
+    UVFSFileNode psCopy     = NULL;
+    UVFSFileAttributes sSrcAttrs;
+    UVFSFileAttributes sDstAttrs;
+    size_t iActuallyWrite   = 0;
+    size_t iActuallyRead    = 0;
+    size_t iAttrSize        = 0;
+    uint8_t* puOutBuf       = malloc(COPY_FILE_SIZE);
+    uint8_t* puInBuf        = malloc(COPY_FILE_SIZE);
+    assert( puOutBuf != NULL && puInBuf != NULL );
 
-    int* puBuf = pvWriteBuf;
-    for ( uint64_t uIdx=0; uIdx<(MAX_IO_SIZE/sizeof(int)); uIdx++ )
+    for ( uint64_t uIdx=0; uIdx<COPY_FILE_SIZE; uIdx++ )
     {
-        puBuf[uIdx] = rand();
+        puOutBuf[uIdx] = (uint8_t)(uIdx * 7 + uIdx / 4096);
     }
 
-    iErr = CreateNewFile( RootNode, &psFile, "SimpleFile", 0 );
-    assert(iErr == 0);
+    assert( CreateNewFile( RootNode, &psFile, "CopySource", 0 ) == 0 );
+    assert( HFS_fsOps.fsops_write( psFile, 0, COPY_FILE_SIZE, puOutBuf, &iActuallyWrite ) == 0 );
+    assert( iActuallyWrite == COPY_FILE_SIZE );
+    assert( HFS_fsOps.fsops_setxattr( psFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowCreate ) == 0 );
 
-    uint64_t start = mach_absolute_time();
-    uint64_t elapsedSec = 0;
-    // while( elapsedSec < TEST_RUN_TIME_SEC )
-    for(uint32_t uWriteReadCnt=1000; uWriteReadCnt; uWriteReadCnt--)
-    {
-        uint64_t uNextIOSize   = rand() % MAX_IO_SIZE;
-        uint64_t uNextIOOffset = rand() % MAX_IO_OFFSET;
+    // A directory is not a valid source
+    assert( LFHFS_CopyFile( RootNode, RootNode, "CopyOfRoot", 0, &psCopy ) == EISDIR );
 
-        printf("uNextIOSize = %llu, uNextIOOffset = %llu\n", uNextIOSize, uNextIOOffset);
+    assert( LFHFS_CopyFile( psFile, RootNode, "CopyDest", 0, &psCopy ) == 0 );
 
-        size_t iActuallyWrite;
-        size_t iActuallyRead;
-        
-        iErr = HFS_fsOps.fsops_write( psFile, uNextIOOffset, uNextIOSize, pvWriteBuf, &iActuallyWrite );
-        assert(iErr==0);
-        iErr = HFS_fsOps.fsops_read( psFile, uNextIOOffset, uNextIOSize, pvReadBuf, &iActuallyRead );
-        assert(iErr==0);
+    assert( HFS_fsOps.fsops_read( psCopy, 0, COPY_FILE_SIZE, puInBuf, &iActuallyRead ) == 0 );
+    assert( iActuallyRead == COPY_FILE_SIZE );
+    assert( memcmp( puInBuf, puOutBuf, COPY_FILE_SIZE ) == 0 );
 
-        uint8_t* puRead = pvReadBuf;
-        uint8_t* puWrite = pvWriteBuf;
-        for ( uint64_t uIdx=0; uIdx<uNextIOSize; uIdx++ )
-        {
-            assert( puRead[uIdx] == puWrite[uIdx] );
-        }
+    assert( HFS_fsOps.fsops_getxattr( psCopy, pcAttr, pcAttrBuf, sizeof(pcAttrBuf), &iAttrSize ) == 0 );
+    assert( iAttrSize == strlen(pcData)+1 && strcmp( pcAttrBuf, pcData ) == 0 );
 
-        uint64_t end = mach_absolute_time();
-        uint64_t elapsed = end - start;
-        uint64_t elapsedNano = elapsed * sTimebaseInfo.numer / sTimebaseInfo.denom;
-        elapsedSec = elapsedNano / 1000 / 1000 / 1000;
-    }
+    assert( HFS_fsOps.fsops_getattr( psFile, &sSrcAttrs ) == 0 );
+    assert( HFS_fsOps.fsops_getattr( psCopy, &sDstAttrs ) == 0 );
+    assert( sDstAttrs.fa_size == sSrcAttrs.fa_size );
+    assert( sDstAttrs.fa_mode == sSrcAttrs.fa_mode );
+    assert( sDstAttrs.fa_mtime.tv_sec == sSrcAttrs.fa_mtime.tv_sec );
+    assert( sDstAttrs.fa_fileid != sSrcAttrs.fa_fileid );
 
-    free(pvReadBuf);
-    free(pvWriteBuf);
+    // The destination name is taken now
+    UVFSFileNode psCopy2 = NULL;
+    assert( LFHFS_CopyFile( psFile, RootNode, "CopyDest", 0, &psCopy2 ) == EEXIST );
 
-    HFS_fsOps.fsops_reclaim(psFile, 0);
+    HFS_fsOps.fsops_reclaim( psCopy, 0 );
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+    assert( HFS_fsOps.fsops_remove( RootNode, "CopyDest", NULL ) == 0 );
+    assert( HFS_fsOps.fsops_remove( RootNode, "CopySource", NULL ) == 0 );
 
+    free(puOutBuf);
+    free(puInBuf);
     return 0;
 }
 
 static int
-HFSTest_HardLink( UVFSFileNode RootNode )
+HFSTest_RemoveTree( UVFSFileNode RootNode )
 {
-    int iErr                = 0;
+#define RMTREE_DEPTH            (50)
+#define RMTREE_FILES_PER_LEVEL  (40)
+
+    const char* pcAttr      = "com.apple.test.rmtree";
+    char pcData[]           = "This is attribute data";
+    char pcName[64];
+    UVFSFileNode psTop      = NULL;
+    UVFSFileNode psDir      = NULL;
+    UVFSFileNode psFile     = NULL;
+    UVFSFileNode psLinked   = NULL;
+    UVFSFileNode psLookup   = NULL;
 
-    // Validate files exist on media
-    UVFSFileNode psOriginalFile = NULL;
-    iErr = HFS_fsOps.fsops_lookup( RootNode, "original_file.txt", &psOriginalFile );
-    printf("Lookup for original file err [%d]\n", iErr);
-    if ( iErr )
-        return iErr;
+    assert( CreateNewFolder( RootNode, &psTop, "RmTreeTop" ) == 0 );
 
-    UVFSFileNode psFirstLink = NULL;
-    iErr = HFS_fsOps.fsops_lookup( RootNode, "first_link.txt", &psFirstLink );
-    printf("Lookup for original file err [%d]\n", iErr);
-    if ( iErr )
-        return iErr;
+    // A file linked from both inside and outside the tree must survive
+    assert( CreateNewFile( RootNode, &psLinked, "RmTreeLinked", 4096 ) == 0 );
+    assert( CreateHardLink( psLinked, psTop, "LinkToOutside" ) == 0 );
 
-    UVFSFileNode psDirectory = NULL;
-    iErr = HFS_fsOps.fsops_lookup( RootNode, "dir", &psDirectory );
-    printf("Lookup for original file err [%d]\n", iErr);
-    if ( iErr )
-        return iErr;
+    // Deep chain of directories, each holding a few dozen files
+    psDir = psTop;
+    for ( uint32_t uLevel = 0; uLevel < RMTREE_DEPTH; uLevel++ )
+    {
+        UVFSFileNode psSubDir = NULL;
 
-    UVFSFileNode psSecondLink = NULL;
-    iErr = HFS_fsOps.fsops_lookup( psDirectory, "second_link.txt", &psSecondLink );
-    printf("Lookup for original file err [%d]\n", iErr);
-    if ( iErr )
-        return iErr;
+        for ( uint32_t uFile = 0; uFile < RMTREE_FILES_PER_LEVEL; uFile++ )
+        {
+            sprintf( pcName, "File_%u", uFile );
+            assert( CreateNewFile( psDir, &psFile, pcName, (uFile % 4) * 8192 ) == 0 );
+            if ( uFile == 0 )
+            {
+                assert( HFS_fsOps.fsops_setxattr( psFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowCreate ) == 0 );
+            }
+            HFS_fsOps.fsops_reclaim( psFile, 0 );
+        }
 
+        sprintf( pcName, "Level_%u", uLevel );
+        assert( CreateNewFolder( psDir, &psSubDir, pcName ) == 0 );
+        if ( psDir != psTop )
+        {
+            HFS_fsOps.fsops_reclaim( psDir, 0 );
+        }
+        psDir = psSubDir;
+    }
+    HFS_fsOps.fsops_reclaim( psDir, 0 );
+    HFS_fsOps.fsops_reclaim( psTop, 0 );
 
-    UVFSFileAttributes sOutAttrs;
-    iErr = HFS_fsOps.fsops_getattr(psOriginalFile, &sOutAttrs);
-    printf("GetAttr for original file err [%d]\n", iErr);
-    if (iErr)
-        return iErr;
+    assert( LFHFS_RemoveTree( RootNode, "RmTreeTop" ) == 0 );
+    assert( HFS_fsOps.fsops_lookup( RootNode, "RmTreeTop", &psLookup ) == ENOENT );
+    assert( LFHFS_RemoveTree( RootNode, "RmTreeTop" ) == ENOENT );
 
-    if (sOutAttrs.fa_nlink != 3)
-    {
-        printf("nlink of original file should be 3, got [%d]\n", sOutAttrs.fa_nlink);
-        return 1;
-    }
+    // Removing a file through the tree interface just unlinks it
+    assert( HFS_fsOps.fsops_lookup( RootNode, "RmTreeLinked", &psLookup ) == 0 );
+    HFS_fsOps.fsops_reclaim( psLookup, 0 );
+    HFS_fsOps.fsops_reclaim( psLinked, 0 );
+    assert( LFHFS_RemoveTree( RootNode, "RmTreeLinked" ) == 0 );
+    assert( HFS_fsOps.fsops_lookup( RootNode, "RmTreeLinked", &psLookup ) == ENOENT );
 
-    void* pvOriginalFileBuf          = malloc(sOutAttrs.fa_size);
-    void* pvFirstLinkeBuf            = malloc(sOutAttrs.fa_size);
-    void* pvSecondLinkeBuf           = malloc(sOutAttrs.fa_size);
-    uint64_t* puOriginalFileBuf  = pvOriginalFileBuf;
-    uint64_t* puFirstLinkeBuf    = pvFirstLinkeBuf;
-    uint64_t* puSecondLinkeBuf   = pvSecondLinkeBuf;
+    return 0;
+}
 
-    size_t iActuallyRead   = 0;
-    assert( HFS_fsOps.fsops_read( psOriginalFile, 0, sOutAttrs.fa_size, pvOriginalFileBuf, &iActuallyRead ) == 0 );
-    assert( HFS_fsOps.fsops_read( psFirstLink,    0, sOutAttrs.fa_size, pvFirstLinkeBuf, &iActuallyRead ) == 0 );
-    assert( HFS_fsOps.fsops_read( psSecondLink,   0, sOutAttrs.fa_size, pvSecondLinkeBuf, &iActuallyRead ) == 0 );
+/*
+ * Returns ENOENT once cnid has no catalog record.
+ */
+static int
+HFSTest_IDLookup( UVFSFileNode RootNode, cnid_t uCnid )
+{
+    struct hfsmount* hfsmp = VTOHFS( (struct vnode*) RootNode );
+    struct cat_desc sDesc;
+    struct cat_attr sAttr;
 
-    // Lets test if all links has the same content it...
-    for ( uint64_t uIdx=0; uIdx<(sOutAttrs.fa_size/sizeof(uint64_t)); uIdx++ )
+    int iLockFlags = hfs_systemfile_lock( hfsmp, SFL_CATALOG, HFS_SHARED_LOCK );
+    int iErr = cat_idlookup( hfsmp, uCnid, 0, 0, &sDesc, &sAttr, NULL );
+    hfs_systemfile_unlock( hfsmp, iLockFlags );
+    if ( iErr == 0 )
     {
-        assert( puOriginalFileBuf[uIdx] == puFirstLinkeBuf[uIdx] );
-        assert( puOriginalFileBuf[uIdx] == puSecondLinkeBuf[uIdx] );
+        cat_releasedesc( &sDesc );
     }
 
-    // Save content of the original file and fill up 0x1000 0xAAs
-    void* pvNewContentBuf  = malloc(sOutAttrs.fa_size + 1000);
-    uint64_t* puNewContentBuf   = pvNewContentBuf;
+    return iErr;
+}
 
-    memcpy(pvNewContentBuf, pvOriginalFileBuf ,sOutAttrs.fa_size);
-    memset(pvNewContentBuf + sOutAttrs.fa_size, 0xAA,1000);
-    
-    assert( HFS_fsOps.fsops_write( psOriginalFile, 0, sOutAttrs.fa_size + 1000, pvNewContentBuf, &iActuallyRead ) == 0 );
-    free(pvOriginalFileBuf);
-    free(pvFirstLinkeBuf);
-    free(pvSecondLinkeBuf);
+/*
+ * Leave populated trees in the private directory, as LFHFS_RemoveTree
+ * does when it is cut short after the move, and let the next mount
+ * finish them. More trees than one scan batch are left behind.
+ */
+static int
+HFSTest_RemoveTreeRestart( UVFSFileNode RootNode )
+{
+#define RMTREE_RESTART_TREES    (LFHFS_RMTREE_BATCH + 5)
+#define RMTREE_RESTART_FILES    (6)
 
-    pvOriginalFileBuf  = malloc(sOutAttrs.fa_size + 1000);
-    pvFirstLinkeBuf    = malloc(sOutAttrs.fa_size + 1000);
-    pvSecondLinkeBuf   = malloc(sOutAttrs.fa_size + 1000);
-    puOriginalFileBuf  = pvOriginalFileBuf;
-    puFirstLinkeBuf    = pvFirstLinkeBuf;
-    puSecondLinkeBuf   = pvSecondLinkeBuf;
+    cnid_t puIDs[RMTREE_RESTART_TREES][RMTREE_RESTART_FILES + 2];
+    UVFSFileAttributes sOutAttrs;
+    UVFSFileNode psTree     = NULL;
+    UVFSFileNode psSub      = NULL;
+    UVFSFileNode psFile     = NULL;
+    char pcName[64];
 
-    // Make sure the file and its hardlinks have the new content
-    assert( HFS_fsOps.fsops_read( psOriginalFile, 0, sOutAttrs.fa_size + 1000, pvOriginalFileBuf, &iActuallyRead ) == 0 );
-    assert( HFS_fsOps.fsops_read( psFirstLink,    0, sOutAttrs.fa_size + 1000, pvFirstLinkeBuf, &iActuallyRead ) == 0 );
-    assert( HFS_fsOps.fsops_read( psSecondLink,   0, sOutAttrs.fa_size + 1000, pvSecondLinkeBuf, &iActuallyRead ) == 0 );
-    for ( uint64_t uIdx=0; uIdx<((sOutAttrs.fa_size + 1000)/sizeof(uint64_t)); uIdx++ )
-    {
-        assert( puOriginalFileBuf[uIdx] == puNewContentBuf[uIdx] );
-        assert( puOriginalFileBuf[uIdx] == puFirstLinkeBuf[uIdx] );
-        assert( puOriginalFileBuf[uIdx] == puSecondLinkeBuf[uIdx] );
-    }
+    struct hfsmount* hfsmp  = VTOHFS( (struct vnode*) RootNode );
+    uint32_t uPrivEntries   = hfsmp->hfs_private_attr[FILE_HARDLINKS].ca_entries;
 
-    iErr = HFS_fsOps.fsops_remove( RootNode, "original_file.txt", NULL);
-    printf( "Remove original file err [%d]\n", iErr );
-    if ( iErr != 0 )
-        return iErr;
+    for ( uint32_t uTree = 0; uTree < RMTREE_RESTART_TREES; uTree++ )
+    {
+        sprintf( pcName, "Orphan_%u", uTree );
+        assert( CreateNewFolder( RootNode, &psTree, pcName ) == 0 );
+        assert( HFS_fsOps.fsops_getattr( psTree, &sOutAttrs ) == 0 );
+        puIDs[uTree][0] = (cnid_t) sOutAttrs.fa_fileid;
 
-    iErr = HFS_fsOps.fsops_getattr(psFirstLink, &sOutAttrs);
-    printf("GetAttr for first link err [%d]\n", iErr);
-    if (iErr)
-        return iErr;
+        assert( CreateNewFolder( psTree, &psSub, "Sub" ) == 0 );
+        assert( HFS_fsOps.fsops_getattr( psSub, &sOutAttrs ) == 0 );
+        puIDs[uTree][1] = (cnid_t) sOutAttrs.fa_fileid;
 
-    if (sOutAttrs.fa_nlink != 2)
+        for ( uint32_t uFile = 0; uFile < RMTREE_RESTART_FILES; uFile++ )
+        {
+            sprintf( pcName, "File_%u", uFile );
+            assert( CreateNewFile( (uFile % 2) ? psSub : psTree, &psFile, pcName, uFile * 4096 ) == 0 );
+            assert( HFS_fsOps.fsops_getattr( psFile, &sOutAttrs ) == 0 );
+            puIDs[uTree][uFile + 2] = (cnid_t) sOutAttrs.fa_fileid;
+            HFS_fsOps.fsops_reclaim( psFile, 0 );
+        }
+        HFS_fsOps.fsops_reclaim( psSub, 0 );
+
+        // The first step of LFHFS_RemoveTree: move the tree, still full, to "temp<cnid>"
+        struct vnode* dvp = (struct vnode*) RootNode;
+        struct vnode* vp  = (struct vnode*) psTree;
+        struct componentname sCN = {0};
+        sprintf( pcName, "Orphan_%u", uTree );
+        sCN.cn_nameiop  = DELETE;
+        sCN.cn_flags    = ISLASTCN;
+        sCN.cn_pnbuf    = pcName;
+        sCN.cn_pnlen    = (int) strlen( pcName );
+        sCN.cn_nameptr  = pcName;
+        sCN.cn_namelen  = (int) strlen( pcName );
+
+        assert( hfs_lockpair( VTOC(dvp), VTOC(vp), HFS_EXCLUSIVE_LOCK ) == 0 );
+        assert( hfs_removefile( dvp, vp, &sCN, 0, 0, 1, 1 ) == 0 );
+        dvp->sExtraData.sDirData.uDirVersion++;
+        // Keep reclaim from deleting it, as if we had crashed here
+        VTOC(vp)->c_flag &= ~C_DELETED;
+        hfs_unlockpair( VTOC(dvp), VTOC(vp) );
+        HFS_fsOps.fsops_reclaim( psTree, 0 );
+
+        sprintf( pcName, "Orphan_%u", uTree );
+        assert( HFS_fsOps.fsops_lookup( RootNode, pcName, &psTree ) == ENOENT );
+    }
+
+    assert( hfsmp->hfs_private_attr[FILE_HARDLINKS].ca_entries == uPrivEntries + RMTREE_RESTART_TREES );
+    for ( uint32_t uTree = 0; uTree < RMTREE_RESTART_TREES; uTree++ )
     {
-        printf("nlink of first link should be 2, got [%d]\n", sOutAttrs.fa_nlink);
-        return 1;
+        assert( HFSTest_IDLookup( RootNode, puIDs[uTree][0] ) == 0 );
     }
 
-    RenameFile(psDirectory, psSecondLink,"second_link.txt", RootNode, psFirstLink,"first_link.txt" );
-
-    iErr = HFS_fsOps.fsops_getattr(psSecondLink, &sOutAttrs);
-    printf("GetAttr for second link err [%d]\n", iErr);
-    if (iErr)
-        return iErr;
-    
+    assert( HFSTest_Remount( &RootNode ) == 0 );
+    hfsmp = VTOHFS( (struct vnode*) RootNode );
 
-    if (sOutAttrs.fa_nlink != 2)
+    // The mount removed every tree and left the private directory as it was
+    for ( uint32_t uTree = 0; uTree < RMTREE_RESTART_TREES; uTree++ )
     {
-        printf("nlink of first link should be 2, got [%d]\n", sOutAttrs.fa_nlink);
-        return 1;
+        for ( uint32_t uID = 0; uID < RMTREE_RESTART_FILES + 2; uID++ )
+        {
+            assert( HFSTest_IDLookup( RootNode, puIDs[uTree][uID] ) == ENOENT );
+        }
     }
+    assert( hfsmp->hfs_private_attr[FILE_HARDLINKS].ca_entries == uPrivEntries );
 
-    iErr = HFS_fsOps.fsops_remove( RootNode, "first_link.txt", NULL);
-    printf( "Remove first link err [%d]\n", iErr );
-    if ( iErr != 0 )
-        return iErr;
-
-    free(pvOriginalFileBuf);
-    free(pvFirstLinkeBuf);
-    free(pvSecondLinkeBuf);
-    free(pvNewContentBuf);
-    HFS_fsOps.fsops_reclaim(psOriginalFile, 0);
-    HFS_fsOps.fsops_reclaim(psFirstLink, 0);
-    HFS_fsOps.fsops_reclaim(psSecondLink, 0);
-    HFS_fsOps.fsops_reclaim(psDirectory, 0);
-
-    return iErr;
-}
+    return 0;
+}
 
+/*
+ * Count the files and directories in psDirNode with readdir,
+ * not counting "." and "..".
+ */
 static int
-HFSTest_CreateHardLink( UVFSFileNode RootNode )
+HFSTest_CountDirEntries( UVFSFileNode psDirNode, uint32_t* puFiles, uint32_t* puDirs )
 {
-    uint32_t uOriginalFileSize = 500000;
+    uint8_t puBuf[4096];
+    uint64_t uCookie = 0;
+    uint64_t uVerifier = UVFS_DIRCOOKIE_VERIFIER_INITIAL;
+    bool bDone = false;
 
-    int iErr                = 0;
-    UVFSFileNode psFile     = NULL;
-    size_t iActuallyWrite   = 0;
-    size_t iActuallyRead   = 0;
-    void* pvOutBuf          = malloc(uOriginalFileSize);
-    void* pvInBuf           = malloc(uOriginalFileSize);
-    assert( pvOutBuf != NULL && pvInBuf != NULL );
-    uint64_t* puOutBuf  = pvOutBuf;
-    uint64_t* puInBuf   = pvInBuf;
+    *puFiles = 0;
+    *puDirs = 0;
+    while ( !bDone )
+    {
+        size_t uOutLen = 0;
+        int iErr = HFS_fsOps.fsops_readdir( psDirNode, puBuf, sizeof(puBuf), uCookie, &uOutLen, &uVerifier );
+        if ( iErr == UVFS_READDIR_EOF_REACHED || (iErr == 0 && uOutLen == 0) )
+        {
+            break;
+        }
+        if ( iErr )
+        {
+            return iErr;
+        }
 
-    // Create the original file with size 500,000 Bytes
-    iErr = CreateNewFile( RootNode, &psFile, "original_file.txt", uOriginalFileSize);
-    assert( iErr == 0 );
+        for ( size_t uOffset = 0; uOffset < uOutLen; )
+        {
+            UVFSDirEntry* psEntry = (UVFSDirEntry*) &puBuf[uOffset];
+            bool bDot = (strcmp( psEntry->de_name, "." ) == 0) || (strcmp( psEntry->de_name, ".." ) == 0);
 
-    // lets write 10,000 Bytes with 0xCD
-    memset(pvOutBuf, 0, uOriginalFileSize);
-    memset(pvInBuf, 0, uOriginalFileSize);
+            if ( !bDot && psEntry->de_filetype == UVFS_FA_TYPE_DIR )
+            {
+                (*puDirs)++;
+            }
+            else if ( !bDot )
+            {
+                (*puFiles)++;
+            }
 
-    memset(pvOutBuf, 0xCD, uOriginalFileSize);
+            uCookie = psEntry->de_nextcookie;
+            if ( uCookie == UVFS_DIRCOOKIE_EOF || psEntry->de_reclen == 0 )
+            {
+                bDone = true;
+                break;
+            }
+            uOffset += psEntry->de_reclen;
+        }
+    }
 
-    assert( HFS_fsOps.fsops_write( psFile, 0, uOriginalFileSize, pvOutBuf, &iActuallyWrite ) == 0 );
-    assert( HFS_fsOps.fsops_read( psFile, 0, uOriginalFileSize, pvInBuf, &iActuallyRead ) == 0 );
+    return 0;
+}
 
-    // Lets test it...
-    for ( uint64_t uIdx=0; uIdx<(uOriginalFileSize/sizeof(uint64_t)); uIdx++ )
+static int
+HFSTest_CreateBatch( UVFSFileNode RootNode )
+{
+#define CREATE_BATCH_ENTRIES    (200)
+#define CREATE_BATCH_DIR_EVERY  (20)
+
+    static char pcNames[CREATE_BATCH_ENTRIES][32];
+    LFHFSCreateEntry_S psEntries[CREATE_BATCH_ENTRIES];
+    UVFSFileAttributes sFileAttrs = {0};
+    UVFSFileAttributes sDirAttrs = {0};
+    UVFSFileAttributes sSizedAttrs = {0};
+    UVFSFileAttributes sOutAttrs;
+    UVFSFileNode psDir = NULL;
+    UVFSFileNode psNode = NULL;
+
+    sFileAttrs.fa_validmask = UVFS_FA_VALID_MODE;
+    sFileAttrs.fa_type      = UVFS_FA_TYPE_FILE;
+    sFileAttrs.fa_mode      = UVFS_FA_MODE_OTH(UVFS_FA_MODE_RWX)|UVFS_FA_MODE_GRP(UVFS_FA_MODE_RWX)|UVFS_FA_MODE_USR(UVFS_FA_MODE_RWX);
+    sDirAttrs               = sFileAttrs;
+    sDirAttrs.fa_type       = UVFS_FA_TYPE_DIR;
+    sSizedAttrs             = sFileAttrs;
+    sSizedAttrs.fa_validmask |= UVFS_FA_VALID_SIZE;
+    sSizedAttrs.fa_size     = 4096;
+
+    assert( CreateNewFolder( RootNode, &psDir, "BatchDir" ) == 0 );
+    assert( CreateNewFile( psDir, &psNode, "Existing", 0 ) == 0 );
+    HFS_fsOps.fsops_reclaim( psNode, 0 );
+
+    // Names go in reverse order, the batch sorts them
+    for ( uint32_t uIdx = 0; uIdx < CREATE_BATCH_ENTRIES; uIdx++ )
     {
-        assert( puInBuf[uIdx] == puOutBuf[uIdx] );
+        sprintf( pcNames[uIdx], "Entry_%03u", CREATE_BATCH_ENTRIES - uIdx );
+        psEntries[uIdx].pcName = pcNames[uIdx];
+        psEntries[uIdx].psAttr = (uIdx % CREATE_BATCH_DIR_EVERY) ? &sFileAttrs : &sDirAttrs;
     }
+    psEntries[7].pcName     = "Existing";
+    psEntries[8].pcName     = ".";
+    psEntries[9].psAttr     = &sSizedAttrs;
+    psEntries[10].pcName    = pcNames[11];      // Same name twice in one batch
 
-    UVFSFileNode psDirectory = NULL;
-    assert (CreateNewFolder(RootNode,&psDirectory,"dir") == 0);
-    assert (CreateHardLink(psFile,RootNode,"first_link.txt") == 0);
-    assert (CreateHardLink(psFile,psDirectory,"second_link.txt") == 0);
-
-    HFS_fsOps.fsops_reclaim( psFile, 0 );
-    HFS_fsOps.fsops_reclaim( psDirectory, 0 );
-
-    assert (HFSTest_HardLink( RootNode ) == 0);
-
-    goto exit;
+    assert( LFHFS_CreateBatch( psDir, psEntries, CREATE_BATCH_ENTRIES ) != 0 );
 
-exit:
-    return iErr;
-}
+    for ( uint32_t uIdx = 0; uIdx < CREATE_BATCH_ENTRIES; uIdx++ )
+    {
+        if ( uIdx == 7 || uIdx == 10 || uIdx == 11 )
+        {
+            // One of the two entries named pcNames[11] loses
+            assert( psEntries[uIdx].iErr == 0 || psEntries[uIdx].iErr == EEXIST );
+            continue;
+        }
+        if ( uIdx == 8 || uIdx == 9 )
+        {
+            assert( psEntries[uIdx].iErr == EINVAL );
+            continue;
+        }
 
-static int
-HFSTest_RenameToHardlink( UVFSFileNode RootNode )
-{
-    UVFSFileNode psFile0            = NULL;
-    UVFSFileNode psFile1            = NULL;
-    UVFSFileNode psLink             = NULL;
-    UVFSFileAttributes sOutAttrs    = {0};
+        assert( psEntries[uIdx].iErr == 0 );
+        assert( HFS_fsOps.fsops_lookup( psDir, pcNames[uIdx], &psNode ) == 0 );
+        assert( HFS_fsOps.fsops_getattr( psNode, &sOutAttrs ) == 0 );
+        assert( sOutAttrs.fa_fileid == psEntries[uIdx].uFileID );
+        assert( sOutAttrs.fa_type == psEntries[uIdx].psAttr->fa_type );
+        HFS_fsOps.fsops_reclaim( psNode, 0 );
+    }
+    assert( psEntries[7].iErr == EEXIST );
+    assert( (psEntries[10].iErr == 0) != (psEntries[11].iErr == 0) );
+
+    // "Existing" plus everything but entries 7, 8, 9 and one of 10/11
+    uint32_t uExpectedDirs  = CREATE_BATCH_ENTRIES / CREATE_BATCH_DIR_EVERY;
+    uint32_t uExpectedFiles = 1 + CREATE_BATCH_ENTRIES - 4 - uExpectedDirs;
+    uint32_t uFiles = 0;
+    uint32_t uDirs = 0;
+
+    assert( HFS_fsOps.fsops_getattr( psDir, &sOutAttrs ) == 0 );
+    assert( sOutAttrs.fa_nlink == 2 + uExpectedFiles + uExpectedDirs );
+    assert( HFSTest_CountDirEntries( psDir, &uFiles, &uDirs ) == 0 );
+    assert( uFiles == uExpectedFiles );
+    assert( uDirs == uExpectedDirs );
+
+    // Entries that failed on their name did not use up CNIDs
+    uint64_t uMinID = UINT64_MAX;
+    uint64_t uMaxID = 0;
+    for ( uint32_t uIdx = 0; uIdx < CREATE_BATCH_ENTRIES; uIdx++ )
+    {
+        if ( psEntries[uIdx].iErr == 0 && psEntries[uIdx].uFileID < uMinID )
+        {
+            uMinID = psEntries[uIdx].uFileID;
+        }
+        if ( psEntries[uIdx].iErr == 0 && psEntries[uIdx].uFileID > uMaxID )
+        {
+            uMaxID = psEntries[uIdx].uFileID;
+        }
+    }
+    assert( uMaxID - uMinID + 1 == CREATE_BATCH_ENTRIES - 4 );
 
-    assert ( CreateNewFile( RootNode, &psFile0, "simple_file.txt", 0 ) == 0 );
-    assert ( CreateNewFile( RootNode, &psFile1, "original_file.txt", 0 ) == 0 );
-    assert ( CreateHardLink( psFile1, RootNode, "first_link.txt" ) == 0 );
-    assert ( CreateHardLink( psFile1, RootNode, "second_link.txt" ) == 0 );
-    assert ( HFS_fsOps.fsops_lookup( RootNode, "first_link.txt", &psLink ) == 0 );
-    assert( RenameFile(RootNode, psFile0, "simple_file.txt", RootNode, psLink, "first_link.txt") == 0 );
+    struct cnode* psDirCnode = VTOC( (struct vnode*) psDir );
+    if ( (VTOHFS( (struct vnode*) psDir )->hfs_flags & HFS_FOLDERCOUNT) &&
+         (psDirCnode->c_attr.ca_recflags & kHFSHasFolderCountMask) )
+    {
+        assert( psDirCnode->c_attr.ca_dircount == uExpectedDirs );
+    }
 
-    assert( HFS_fsOps.fsops_getattr(psFile1, &sOutAttrs) == 0 );
+    // The directories made by the batch are usable
+    UVFSFileNode psSubDir = NULL;
+    assert( HFS_fsOps.fsops_lookup( psDir, pcNames[0], &psSubDir ) == 0 );
+    assert( CreateNewFile( psSubDir, &psNode, "Inner", 0 ) == 0 );
+    HFS_fsOps.fsops_reclaim( psNode, 0 );
+    HFS_fsOps.fsops_reclaim( psSubDir, 0 );
+    HFS_fsOps.fsops_reclaim( psDir, 0 );
 
-    assert( HFS_fsOps.fsops_reclaim(psFile0, 0) == 0 );
-    for ( uint32_t uIdx=0; uIdx<sOutAttrs.fa_nlink; uIdx++ )
-        assert( HFS_fsOps.fsops_reclaim(psFile1, 0) == 0 );
+    assert( LFHFS_RemoveTree( RootNode, "BatchDir" ) == 0 );
 
     return 0;
 }
 
 static int
-HFSTest_JustMount( __unused UVFSFileNode RootNode )
+HFSTest_CNIDReuse( UVFSFileNode RootNode )
 {
-    return 0;
-}
+#define CNID_REUSE_FILES    (32)
 
-static int HFSTest_OpenJournal( __unused UVFSFileNode RootNode ) {
-    
-    printf("HFSTest_OpenJournal:\n");
-    
-    return 0;
-}
+    struct hfsmount* hfsmp = VTOHFS( (struct vnode*) RootNode );
+    UVFSFileNode psFiles[CNID_REUSE_FILES] = {0};
+    uint64_t puOldIDs[CNID_REUSE_FILES];
+    uint64_t puNewIDs[CNID_REUSE_FILES / 2];
+    UVFSFileAttributes sOutAttrs;
+    UVFSFileNode psDir  = NULL;
+    UVFSFileNode psNode = NULL;
+    char pcName[32];
 
-static int HFSTest_WriteToJournal(UVFSFileNode RootNode ) {
-    int iErr = 0;
-    
-    printf("HFSTest_WriteToJournal:\n");
-    
-    printf("Create a new folder:\n");
-    UVFSFileNode TestFolder = NULL;
-    iErr = CreateNewFolder( RootNode, &TestFolder, "TestFolder");
-    printf("CreateNewFolder err [%d]\n", iErr);
-    if (iErr) {
-        return iErr;
-    }
+    assert( CreateNewFolder( RootNode, &psDir, "CNIDReuse" ) == 0 );
 
-    printf("Create new file with size 0:\n");
-    UVFSFileNode TestFile1 = NULL;
-    CreateNewFile(TestFolder, &TestFile1, "TestFile.txt",0);
-    printf("Create TestFile in TestFolder err [%d]\n", iErr);
-    if (iErr) {
-        return iErr;
+    for ( uint32_t uIdx = 0; uIdx < CNID_REUSE_FILES; uIdx++ )
+    {
+        sprintf( pcName, "Old_%u", uIdx );
+        assert( CreateNewFile( psDir, &psFiles[uIdx], pcName, 0 ) == 0 );
+        assert( HFS_fsOps.fsops_getattr( psFiles[uIdx], &sOutAttrs ) == 0 );
+        puOldIDs[uIdx] = sOutAttrs.fa_fileid;
+        if ( uIdx != 0 )
+        {
+            HFS_fsOps.fsops_reclaim( psFiles[uIdx], 0 );
+        }
     }
-    
-    printf("Create new file with size 512:\n");
-    UVFSFileNode TestFile2 = NULL;
-    CreateNewFile(TestFolder, &TestFile2, "TestFile2.txt",512);
-    printf("Create TestFile2 in TestFolder err [%d]\n", iErr);
-    if (iErr) {
-        return iErr;
+
+    // Free every other ID. Old_0 stays open, so its cnode lingers after the remove
+    for ( uint32_t uIdx = 0; uIdx < CNID_REUSE_FILES; uIdx += 2 )
+    {
+        sprintf( pcName, "Old_%u", uIdx );
+        assert( RemoveFile( psDir, pcName ) == 0 );
     }
 
-    uint32_t uEntrySize = sizeof(UVFSDirEntryAttr) + MAX_UTF8_NAME_LENGTH;
-    UVFSDirEntryAttr *psReadDirTestsData = malloc(2*uEntrySize);
-    if (psReadDirTestsData == NULL)
-        return ENOMEM;
+    // Pretend the IDs have wrapped and come back around to the first test file
+    hfs_lock_mount( hfsmp );
+    hfsmp->vcbAtrb |= kHFSCatalogNodeIDsReusedMask;
+    hfsmp->vcbNxtCNID = (u_int32_t) puOldIDs[0];
+    hfs_unlock_mount( hfsmp );
 
-    UVFSDirEntryAttr *psCurrentReadDirTestsData = psReadDirTestsData;
-    SetExpectedAttr("TestFile.txt", UVFS_FA_TYPE_FILE, psCurrentReadDirTestsData);
-    iErr = HFS_fsOps.fsops_getattr( TestFile1, &psCurrentReadDirTestsData->dea_attrs );
-    psCurrentReadDirTestsData = (UVFSDirEntryAttr *) ((void*) psCurrentReadDirTestsData + uEntrySize);
-    SetExpectedAttr("TestFile2.txt", UVFS_FA_TYPE_FILE, psCurrentReadDirTestsData);
-    iErr = HFS_fsOps.fsops_getattr( TestFile2, &psCurrentReadDirTestsData->dea_attrs );
+    // The freed IDs come back in order, skipping the lingering one. A create
+    // that fails on an existing name must not use one up.
+    for ( uint32_t uIdx = 0; uIdx < CNID_REUSE_FILES / 2; uIdx++ )
+    {
+        sprintf( pcName, "New_%u", uIdx );
+        assert( CreateNewFile( psDir, &psNode, pcName, 0 ) == 0 );
+        assert( HFS_fsOps.fsops_getattr( psNode, &sOutAttrs ) == 0 );
+        HFS_fsOps.fsops_reclaim( psNode, 0 );
+        puNewIDs[uIdx] = sOutAttrs.fa_fileid;
 
-    printf("Read DIR attr:\n");
-    iErr = ReadDirAttr(TestFolder, psReadDirTestsData, 2);
-    free(psReadDirTestsData);
-    printf("ReadDirAttr err [%d]\n", iErr);
-    if (iErr) {
-        goto exit;
-    }
-    
-    printf("Remove File1:\n");
-    iErr =  RemoveFile(TestFolder,"TestFile.txt");
-    printf("Remove File TestFile from TestFolder err [%d]\n", iErr);
-    if (iErr) {
-        goto exit;
-    }
-    
-    printf("Remove File2:\n");
-    iErr =  RemoveFile(TestFolder,"TestFile2.txt");
-    printf("Remove File TestFile2 from TestFolder err [%d]\n", iErr);
-    if (iErr) {
-        goto exit;
+        if ( uIdx < CNID_REUSE_FILES / 2 - 1 )
+        {
+            assert( puNewIDs[uIdx] == puOldIDs[2 * uIdx + 2] );
+        }
+        for ( uint32_t uOld = 1; uOld < CNID_REUSE_FILES; uOld += 2 )
+        {
+            assert( puNewIDs[uIdx] != puOldIDs[uOld] );
+        }
+        for ( uint32_t uPrev = 0; uPrev < uIdx; uPrev++ )
+        {
+            assert( puNewIDs[uIdx] != puNewIDs[uPrev] );
+        }
+        assert( puNewIDs[uIdx] != puOldIDs[0] );
+
+        if ( uIdx == 3 )
+        {
+            assert( CreateNewFile( psDir, &psNode, "Old_1", 0 ) == EEXIST );
+        }
     }
-    
-    printf("Remove TestFolder:\n");
-    iErr =  RemoveFolder(RootNode,"TestFolder");
-    printf("Remove Folder TestFolder from Root err [%d]\n", iErr);
-    if (iErr) {
-        goto exit;
+
+    // The lingering ID was skipped, not lost
+    HFS_fsOps.fsops_reclaim( psFiles[0], 0 );
+    bool bFound = false;
+    for ( uint32_t uRange = 0; uRange < hfsmp->hfs_free_cnids_count; uRange++ )
+    {
+        cat_cnid_range_t* psRange = &hfsmp->hfs_free_cnids[uRange];
+        if ( puOldIDs[0] >= psRange->start && puOldIDs[0] - psRange->start < psRange->count )
+        {
+            bFound = true;
+        }
     }
-    
-exit:
-    HFS_fsOps.fsops_reclaim(TestFolder, 0);
-    HFS_fsOps.fsops_reclaim(TestFile1, 0);
-    HFS_fsOps.fsops_reclaim(TestFile2, 0);
-    return iErr;
+    assert( bFound );
+
+    // Deleting the newest file and creating again hands out the same ID
+    sprintf( pcName, "New_%u", CNID_REUSE_FILES / 2 - 1 );
+    assert( RemoveFile( psDir, pcName ) == 0 );
+    assert( CreateNewFile( psDir, &psNode, "Again", 0 ) == 0 );
+    assert( HFS_fsOps.fsops_getattr( psNode, &sOutAttrs ) == 0 );
+    assert( sOutAttrs.fa_fileid == puNewIDs[CNID_REUSE_FILES / 2 - 1] );
+    HFS_fsOps.fsops_reclaim( psNode, 0 );
+
+    HFS_fsOps.fsops_reclaim( psDir, 0 );
+    assert( LFHFS_RemoveTree( RootNode, "CNIDReuse" ) == 0 );
+
+    return 0;
 }
 
-static int __used
-HFSTest_SetXattr( UVFSFileNode RootNode )
+#define DIRCONC_STABLE_FILES    (500)
+#define DIRCONC_CHURN_FILES     (300)
+#define DIRCONC_THREADS         (8)
+#define DIRCONC_LOOKUP_PASSES   (4)
+#define DIRCONC_READDIR_PASSES  (4)
+
+static _Atomic bool gbDirConcMutatorDone = false;
+
+// Churn names alternate between sorting before and after the stable ones
+static void
+DirConc_ChurnName( char* pcName, uint32_t uIdx )
 {
-    const char * pcAttr = "com.apple.test.set";
-    const char * pcAttr2 = "com.apple.test.set2";
-    char pcData[] = "This is attribute data";
-    char pcData2[] = "This is attribute data 2";
+    sprintf( pcName, (uIdx % 2) ? "Tail_%u" : "Before_%u", uIdx );
+}
+
+/*
+ * Create a file for every churn index, removing the one from two steps
+ * back, so the directory keeps gaining and losing entries on both sides
+ * of the stable files while the other threads run.
+ */
+static void *DirMutatorThread(void *pvArgs) {
     int iErr = 0;
 
-    UVFSFileNode TestFile = NULL;
-    iErr = HFS_fsOps.fsops_lookup( RootNode, "kl_set.test", &TestFile );
-    if ( iErr )
+    DirThreadData_S *psThrdData = pvArgs;
+    char pcName[64];
+    UVFSFileNode psNode = NULL;
+
+    for ( uint32_t uIdx = 0; uIdx < DIRCONC_CHURN_FILES; uIdx++ )
     {
-        printf("Lookup err [%d]\n", iErr);
-        return iErr;
+        DirConc_ChurnName( pcName, uIdx );
+        iErr = CreateNewFile( psThrdData->psDir, &psNode, pcName, 0 );
+        if ( iErr )
+        {
+            printf( "Failed creating %s with iErr %d.\n", pcName, iErr );
+            goto exit;
+        }
+        HFS_fsOps.fsops_reclaim( psNode, 0 );
+
+        if ( uIdx >= 2 )
+        {
+            DirConc_ChurnName( pcName, uIdx - 2 );
+            iErr = RemoveFile( psThrdData->psDir, pcName );
+            if ( iErr )
+            {
+                printf( "Failed removing %s with iErr %d.\n", pcName, iErr );
+                goto exit;
+            }
+        }
+        usleep( 500 );
     }
 
-    // Add Attribute - create
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowCreate);
-    if ( iErr )
+    for ( uint32_t uIdx = DIRCONC_CHURN_FILES - 2; uIdx < DIRCONC_CHURN_FILES; uIdx++ )
     {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out;
+        DirConc_ChurnName( pcName, uIdx );
+        iErr = RemoveFile( psThrdData->psDir, pcName );
+        if ( iErr )
+        {
+            printf( "Failed removing %s with iErr %d.\n", pcName, iErr );
+            goto exit;
+        }
     }
 
-    // Add Attribute - create with failure
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData2, strlen(pcData2)+1, UVFSXattrHowCreate);
-    if ( iErr != EEXIST)
+exit:
+    gbDirConcMutatorDone = true;
+    psThrdData->iRetVal = iErr;
+    return psThrdData;
+}
+
+/*
+ * Create psDir's DIRCONC_STABLE_FILES files, recording their fileids.
+ */
+static void
+DirConc_CreateStable( UVFSFileNode psDir, cnid_t* puIDs )
+{
+    UVFSFileAttributes sOutAttrs;
+    UVFSFileNode psNode = NULL;
+    char pcName[64];
+
+    for ( uint32_t uIdx = 0; uIdx < DIRCONC_STABLE_FILES; uIdx++ )
     {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out;
+        sprintf( pcName, "Stable_%04u", uIdx );
+        assert( CreateNewFile( psDir, &psNode, pcName, 0 ) == 0 );
+        assert( HFS_fsOps.fsops_getattr( psNode, &sOutAttrs ) == 0 );
+        puIDs[uIdx] = (cnid_t) sOutAttrs.fa_fileid;
+        HFS_fsOps.fsops_reclaim( psNode, 0 );
     }
+}
 
-    // Add Attribute - set
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData2, strlen(pcData2)+1, UVFSXattrHowSet);
-    if ( iErr )
-    {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out;
-    }
-
-    // Add Attribute - replace
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowReplace);
-    if ( iErr )
-    {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out;
-    }
-
-    // Add Attribute - replace with failure
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr2, pcData, strlen(pcData)+1, UVFSXattrHowReplace);
-    if ( iErr != ENOATTR )
-    {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out;
-    }
+/*
+ * Run DIRCONC_THREADS copies of pvWorker next to one DirMutatorThread
+ * on psDir.  Returns the first error any of them reported.
+ */
+static int
+DirConc_Run( UVFSFileNode psDir, cnid_t* puIDs, void *(*pvWorker)(void *), uint32_t* puRestarts )
+{
+    int iErr = 0;
 
-    // Add Attribute - remove
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowRemove);
-    if ( iErr )
+    pthread_attr_t sAttr;
+    pthread_attr_setdetachstate(&sAttr, PTHREAD_CREATE_JOINABLE);
+    pthread_attr_init(&sAttr);
+    pthread_t psExecThread[DIRCONC_THREADS + 1];
+    DirThreadData_S pcThreadData[DIRCONC_THREADS + 1] = {{0}};
+    gbDirConcMutatorDone = false;
+    for ( uint32_t u = 0; u < DIRCONC_THREADS + 1; u++ )
     {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out;
-    }
+        pcThreadData[u].psDir      = psDir;
+        pcThreadData[u].uThreadNum = u;
+        pcThreadData[u].puIDs      = puIDs;
 
-    // Add Attribute - remove with failure
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowRemove);
-    if ( iErr != ENOATTR )
-    {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out;
+        iErr = pthread_create( &psExecThread[u], &sAttr, (u == DIRCONC_THREADS) ? DirMutatorThread : pvWorker, &pcThreadData[u] );
+        if ( iErr )
+        {
+            printf("can't pthread_create\n");
+            return iErr;
+        }
     }
+    pthread_attr_destroy(&sAttr);
 
-    // Get Attribute - check nothing left
-    size_t actual_size = INT32_MAX;
-    iErr = HFS_fsOps.fsops_listxattr(TestFile, NULL, 0, &actual_size);
-    if ( iErr || (actual_size != 0))
+    *puRestarts = 0;
+    for ( uint32_t u = 0; u < DIRCONC_THREADS + 1; u++ )
     {
-        printf("ListAttr err [%d]\n", iErr);
-        goto out;
+        int iJoinErr = pthread_join( psExecThread[u], NULL );
+        if ( iJoinErr )
+        {
+            printf("can't pthread_join\n");
+            return iJoinErr;
+        }
+        if ( pcThreadData[u].iRetVal )
+        {
+            printf( "Thread %u return error %d\n", u, pcThreadData[u].iRetVal );
+            if ( !iErr )
+            {
+                iErr = pcThreadData[u].iRetVal;
+            }
+        }
+        *puRestarts += pcThreadData[u].uRestarts;
     }
 
-    // Add Attribute - create extended attribute and check content
-    const char * pcAttr3 = "com.apple.test.set3";
-    uint8_t *pBuffer = NULL;
-    uint8_t *pBufferRet = NULL;
+    return iErr;
+}
 
-    // Test more than one sector and ending outside boundary.
-#define ATTR_EXT_SIZE   (5000)
+/*
+ * Look up every stable file, from a different starting point in each
+ * thread, plus the churn names, which may or may not exist at the time.
+ */
+static void *DirLookupThread(void *pvArgs) {
+    int iErr = 0;
 
-    pBuffer = malloc(ATTR_EXT_SIZE);
-    pBufferRet = malloc(ATTR_EXT_SIZE);
+    DirThreadData_S *psThrdData = pvArgs;
+    UVFSFileAttributes sOutAttrs;
+    UVFSFileNode psNode = NULL;
+    char pcName[64];
 
-    if ( pBuffer == NULL || pBufferRet == NULL)
+    for ( uint32_t uPass = 0; uPass < DIRCONC_LOOKUP_PASSES; uPass++ )
     {
-        iErr = ENOMEM;
-        goto out;
-    }
+        for ( uint32_t uCnt = 0; uCnt < DIRCONC_STABLE_FILES; uCnt++ )
+        {
+            uint32_t uIdx = (uCnt + psThrdData->uThreadNum * (DIRCONC_STABLE_FILES / DIRCONC_THREADS)) % DIRCONC_STABLE_FILES;
 
-    for (int i = 0; i < ATTR_EXT_SIZE; ++i)
-    {
-        pBuffer[i] = i % 256;
-        pBufferRet[i] = 0xff;
-    }
+            sprintf( pcName, "Stable_%04u", uIdx );
+            iErr = HFS_fsOps.fsops_lookup( psThrdData->psDir, pcName, &psNode );
+            if ( iErr )
+            {
+                printf( "Lookup %s failed with iErr %d.\n", pcName, iErr );
+                goto exit;
+            }
+            iErr = HFS_fsOps.fsops_getattr( psNode, &sOutAttrs );
+            HFS_fsOps.fsops_reclaim( psNode, 0 );
+            if ( iErr || sOutAttrs.fa_fileid != psThrdData->puIDs[uIdx] )
+            {
+                printf( "Lookup %s found fileid %llu instead of %u, iErr %d.\n", pcName, sOutAttrs.fa_fileid, psThrdData->puIDs[uIdx], iErr );
+                if ( !iErr )
+                {
+                    iErr = EINVAL;
+                }
+                goto exit;
+            }
 
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr3, pBuffer, ATTR_EXT_SIZE, UVFSXattrHowCreate);
-    if ( iErr )
-    {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out_mem;
-    }
+            DirConc_ChurnName( pcName, uCnt % DIRCONC_CHURN_FILES );
+            iErr = HFS_fsOps.fsops_lookup( psThrdData->psDir, pcName, &psNode );
+            if ( iErr == 0 )
+            {
+                HFS_fsOps.fsops_reclaim( psNode, 0 );
+            }
+            else if ( iErr != ENOENT )
+            {
+                printf( "Lookup %s failed with iErr %d.\n", pcName, iErr );
+                goto exit;
+            }
 
-    iErr = HFS_fsOps.fsops_getxattr(TestFile, pcAttr3, pBufferRet, ATTR_EXT_SIZE, &actual_size);
-    if ( iErr )
-    {
-        printf("GetAttr err [%d]\n", iErr);
-        goto out_mem;
+            iErr = HFS_fsOps.fsops_lookup( psThrdData->psDir, "Stable_Missing", &psNode );
+            if ( iErr != ENOENT )
+            {
+                printf( "Lookup of a missing name returned %d.\n", iErr );
+                if ( iErr == 0 )
+                {
+                    HFS_fsOps.fsops_reclaim( psNode, 0 );
+                    iErr = EEXIST;
+                }
+                goto exit;
+            }
+            iErr = 0;
+        }
     }
 
-    // check data
-    assert(actual_size == ATTR_EXT_SIZE);
+exit:
+    psThrdData->iRetVal = iErr;
+    return psThrdData;
+}
 
-    for (int i = 0; i < ATTR_EXT_SIZE; ++i)
-    {
-        assert(pBuffer[i] == pBufferRet[i]);
-    }
+static int
+HFSTest_ConcurrentLookup( UVFSFileNode RootNode )
+{
+    cnid_t puIDs[DIRCONC_STABLE_FILES];
+    UVFSFileNode psDir = NULL;
+    uint32_t uFiles, uDirs, uRestarts;
 
-    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr3, pBuffer, ATTR_EXT_SIZE, UVFSXattrHowRemove);
-    if ( iErr )
-    {
-        printf("SetAttr err [%d]\n", iErr);
-        goto out_mem;
-    }
+    assert( CreateNewFolder( RootNode, &psDir, "ConcurrentLookup" ) == 0 );
+    DirConc_CreateStable( psDir, puIDs );
 
-out_mem:
-    free(pBuffer);
-    free(pBufferRet);
+    assert( DirConc_Run( psDir, puIDs, DirLookupThread, &uRestarts ) == 0 );
 
-out:
-    // Reclaim test file
-    HFS_fsOps.fsops_reclaim(TestFile, 0);
+    // Only the stable files are left
+    assert( HFSTest_CountDirEntries( psDir, &uFiles, &uDirs ) == 0 );
+    assert( uFiles == DIRCONC_STABLE_FILES && uDirs == 0 );
+    assert( VTOC( (struct vnode*) psDir )->c_entries == DIRCONC_STABLE_FILES );
 
-    return iErr;
+    HFS_fsOps.fsops_reclaim( psDir, 0 );
+    return 0;
 }
 
-
-static int __used
-HFSTest_ListXattr( UVFSFileNode RootNode )
+/*
+ * Enumerate psDir once, marking every name seen.  Returns
+ * UVFS_READDIR_VERIFIER_MISMATCHED if the directory changed under us
+ * and the enumeration has to start over.
+ */
+static int
+DirConc_ReadDirOnce( UVFSFileNode psDir, uint8_t* puStableSeen, uint8_t* puChurnSeen )
 {
-    int iErr = 0;
+    uint8_t puBuf[2048];
+    uint64_t uCookie = 0;
+    uint64_t uVerifier = UVFS_DIRCOOKIE_VERIFIER_INITIAL;
 
-    UVFSFileNode TestFile = NULL;
-    iErr = HFS_fsOps.fsops_lookup( RootNode, "kl.test", &TestFile );
-    if ( iErr )
+    memset( puStableSeen, 0, DIRCONC_STABLE_FILES );
+    memset( puChurnSeen, 0, DIRCONC_CHURN_FILES );
+    while ( true )
     {
-        printf("Lookup err [%d]\n", iErr);
-        return iErr;
-    }
+        size_t uOutLen = 0;
+        int iErr = HFS_fsOps.fsops_readdir( psDir, puBuf, sizeof(puBuf), uCookie, &uOutLen, &uVerifier );
+        if ( iErr == UVFS_READDIR_EOF_REACHED || (iErr == 0 && uOutLen == 0) )
+        {
+            return 0;
+        }
+        if ( iErr )
+        {
+            return iErr;
+        }
 
-    // Get required size
-    size_t actual_size = 0;
-    iErr = HFS_fsOps.fsops_listxattr(TestFile, NULL, 0, &actual_size);
-    if ( iErr )
-    {
-        printf("ListAttr err [%d]\n", iErr);
-        goto out;
-    }
+        for ( size_t uOffset = 0; uOffset < uOutLen; )
+        {
+            UVFSDirEntry* psEntry = (UVFSDirEntry*) &puBuf[uOffset];
+            unsigned uIdx = 0;
 
-    // Get Attributes
-    size_t size = actual_size;
-    char *pcBuffer = malloc(size);
-    if ( pcBuffer == NULL )
-    {
-        iErr = ENOMEM;
-        goto out;
-    }
+            if ( sscanf( psEntry->de_name, "Stable_%u", &uIdx ) == 1 && uIdx < DIRCONC_STABLE_FILES )
+            {
+                puStableSeen[uIdx]++;
+            }
+            else if ( (sscanf( psEntry->de_name, "Before_%u", &uIdx ) == 1 ||
+                       sscanf( psEntry->de_name, "Tail_%u", &uIdx ) == 1) && uIdx < DIRCONC_CHURN_FILES )
+            {
+                puChurnSeen[uIdx]++;
+            }
+            else if ( strcmp( psEntry->de_name, "." ) != 0 && strcmp( psEntry->de_name, ".." ) != 0 )
+            {
+                printf( "Readdir returned unexpected name %s\n", psEntry->de_name );
+                return EINVAL;
+            }
 
-    actual_size = 0;
-    iErr = HFS_fsOps.fsops_listxattr(TestFile, pcBuffer, size, &actual_size);
-    if ( iErr )
-    {
-        printf("ListAttr err [%d]\n", iErr);
-        goto mem_err;
+            uCookie = psEntry->de_nextcookie;
+            if ( uCookie == UVFS_DIRCOOKIE_EOF || psEntry->de_reclen == 0 )
+            {
+                return 0;
+            }
+            uOffset += psEntry->de_reclen;
+        }
     }
+}
 
-    // Just check it
-    assert(actual_size == size);
+/*
+ * Enumerate the directory until the mutator is done and at least
+ * DIRCONC_READDIR_PASSES enumerations completed.  Every completed
+ * enumeration must see each stable file exactly once and each churn
+ * file at most once.
+ */
+static void *DirReadDirThread(void *pvArgs) {
+    int iErr = 0;
 
-    // Print Attributes Names
-    size_t attr_size = 0;
-    char *pcAttribues = pcBuffer;
+    DirThreadData_S *psThrdData = pvArgs;
+    uint8_t puStableSeen[DIRCONC_STABLE_FILES];
+    uint8_t puChurnSeen[DIRCONC_CHURN_FILES];
+    uint32_t uCompleted = 0;
 
-    while (attr_size < size)
+    while ( !gbDirConcMutatorDone || uCompleted < DIRCONC_READDIR_PASSES )
     {
-        // Get required size
-        actual_size = 0;
-        iErr = HFS_fsOps.fsops_getxattr(TestFile, pcAttribues, NULL, 0, &actual_size);
+        iErr = DirConc_ReadDirOnce( psThrdData->psDir, puStableSeen, puChurnSeen );
+        if ( iErr == UVFS_READDIR_VERIFIER_MISMATCHED )
+        {
+            psThrdData->uRestarts++;
+            continue;
+        }
         if ( iErr )
         {
-            printf("GetAttr size err [%d]\n", iErr);
-            goto mem_err;
+            printf( "Readdir failed with iErr %d.\n", iErr );
+            goto exit;
         }
 
-        // Get Attributes
-        size_t bufsize = actual_size+1;
-        char *pcAttrBuffer = malloc(bufsize);
-        if ( pcAttrBuffer == NULL )
+        for ( uint32_t uIdx = 0; uIdx < DIRCONC_STABLE_FILES; uIdx++ )
         {
-            iErr = ENOMEM;
-            goto mem_err;
+            if ( puStableSeen[uIdx] != 1 )
+            {
+                printf( "Stable_%04u seen %u times.\n", uIdx, puStableSeen[uIdx] );
+                iErr = EINVAL;
+                goto exit;
+            }
         }
-        bzero(pcAttrBuffer, bufsize);
-
-        HFS_fsOps.fsops_getxattr(TestFile, pcAttribues, pcAttrBuffer, bufsize, &actual_size);
-        if ( iErr )
+        for ( uint32_t uIdx = 0; uIdx < DIRCONC_CHURN_FILES; uIdx++ )
         {
-            printf("GetAttr err [%d]\n", iErr);
-            free(pcAttrBuffer);
-            goto mem_err;
+            if ( puChurnSeen[uIdx] > 1 )
+            {
+                printf( "Churn file %u seen %u times.\n", uIdx, puChurnSeen[uIdx] );
+                iErr = EINVAL;
+                goto exit;
+            }
         }
+        uCompleted++;
+    }
 
-        printf("Found attribute '%s' : %s\n", pcAttribues, pcAttrBuffer);
-
-        free(pcAttrBuffer);
+exit:
+    psThrdData->iRetVal = iErr;
+    return psThrdData;
+}
 
-        size_t curr_attr_size = strlen(pcAttribues) + 1;
+static int
+HFSTest_ConcurrentReadDir( UVFSFileNode RootNode )
+{
+    cnid_t puIDs[DIRCONC_STABLE_FILES];
+    UVFSFileNode psDir = NULL;
+    uint32_t uFiles, uDirs, uRestarts;
 
-        attr_size += curr_attr_size;
-        pcAttribues += curr_attr_size;
-    }
+    assert( CreateNewFolder( RootNode, &psDir, "ConcurrentReadDir" ) == 0 );
+    DirConc_CreateStable( psDir, puIDs );
 
-mem_err:
-    free(pcBuffer);
+    assert( DirConc_Run( psDir, puIDs, DirReadDirThread, &uRestarts ) == 0 );
+    printf( "Readdir restarted %u times\n", uRestarts );
 
-out:
-    // Reclaim test file
-    HFS_fsOps.fsops_reclaim(TestFile, 0);
+    assert( HFSTest_CountDirEntries( psDir, &uFiles, &uDirs ) == 0 );
+    assert( uFiles == DIRCONC_STABLE_FILES && uDirs == 0 );
 
-    return iErr;
+    HFS_fsOps.fsops_reclaim( psDir, 0 );
+    return 0;
 }
 
-/*
- *  Tests List Struct.
- */
+static int
+HFSTest_DeferredUpdate( UVFSFileNode RootNode )
+{
+#define DEFERRED_APPENDS        (64)
+#define DEFERRED_APPEND_SIZE    (100)
+#define DEFERRED_OLD_MTIME      (1000000000)
+
+    uint8_t puOutBuf[DEFERRED_APPENDS * DEFERRED_APPEND_SIZE];
+    uint8_t puInBuf[DEFERRED_APPENDS * DEFERRED_APPEND_SIZE];
+    UVFSFileAttributes sInAttrs = {0};
+    UVFSFileAttributes sOutAttrs;
+    UVFSFileNode psFile = NULL;
+    size_t iActuallyWrite = 0;
+    size_t iActuallyRead  = 0;
+
+    for ( uint32_t uIdx = 0; uIdx < sizeof(puOutBuf); uIdx++ )
+    {
+        puOutBuf[uIdx] = (uint8_t)(uIdx * 13 + uIdx / DEFERRED_APPEND_SIZE);
+    }
+
+    assert( CreateNewFile( RootNode, &psFile, "DeferredAppend", 0 ) == 0 );
+
+    // Start from an old mtime so that the appends visibly move it
+    sInAttrs.fa_validmask     = UVFS_FA_VALID_MTIME;
+    sInAttrs.fa_mtime.tv_sec  = DEFERRED_OLD_MTIME;
+    assert( HFS_fsOps.fsops_setattr( psFile, &sInAttrs, &sOutAttrs ) == 0 );
+
+    // Small appends only queue the catalog record
+    for ( uint32_t uIdx = 0; uIdx < DEFERRED_APPENDS; uIdx++ )
+    {
+        uint64_t uOffset = uIdx * DEFERRED_APPEND_SIZE;
+        assert( HFS_fsOps.fsops_write( psFile, uOffset, DEFERRED_APPEND_SIZE, puOutBuf + uOffset, &iActuallyWrite ) == 0 );
+        assert( iActuallyWrite == DEFERRED_APPEND_SIZE );
+    }
+
+    assert( HFS_fsOps.fsops_getattr( psFile, &sOutAttrs ) == 0 );
+    assert( sOutAttrs.fa_size == sizeof(puOutBuf) );
+    assert( sOutAttrs.fa_mtime.tv_sec != DEFERRED_OLD_MTIME );
+    time_t uMTime = sOutAttrs.fa_mtime.tv_sec;
+
+    assert( HFS_fsOps.fsops_sync( RootNode ) == 0 );
+    assert( HFS_fsOps.fsops_getattr( psFile, &sOutAttrs ) == 0 );
+    assert( sOutAttrs.fa_size == sizeof(puOutBuf) );
+    assert( sOutAttrs.fa_mtime.tv_sec == uMTime );
+
+    // One more write, its record is pushed when the node is reclaimed
+    assert( HFS_fsOps.fsops_write( psFile, 0, DEFERRED_APPEND_SIZE, puOutBuf, &iActuallyWrite ) == 0 );
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+
+    // Everything has to come back from the catalog now
+    assert( HFSTest_Remount( &RootNode ) == 0 );
+
+    assert( HFS_fsOps.fsops_lookup( RootNode, "DeferredAppend", &psFile ) == 0 );
+    assert( HFS_fsOps.fsops_getattr( psFile, &sOutAttrs ) == 0 );
+    assert( sOutAttrs.fa_size == sizeof(puOutBuf) );
+    assert( sOutAttrs.fa_mtime.tv_sec >= uMTime );
+    assert( HFS_fsOps.fsops_read( psFile, 0, sizeof(puInBuf), puInBuf, &iActuallyRead ) == 0 );
+    assert( iActuallyRead == sizeof(puInBuf) );
+    assert( memcmp( puInBuf, puOutBuf, sizeof(puOutBuf) ) == 0 );
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+
+    assert( HFS_fsOps.fsops_remove( RootNode, "DeferredAppend", NULL ) == 0 );
+
+    return 0;
+}
+
+/*
+ * Create a blank sparse image and attach it without mounting.
+ * pcDisk (32 bytes) gets the device name, e.g. "disk5".
+ */
+static int
+HFSTest_AttachBlankImage( const char* pcImage, uint32_t uSizeMB, char* pcDisk )
+{
+    char pcCmd[MAX_CMN_LEN];
+
+    snprintf( pcCmd, sizeof(pcCmd), "hdiutil create -ov -size %um -type SPARSE -layout NONE %s", uSizeMB, pcImage );
+    printf("Execute %s:\n", pcCmd);
+    if ( system( pcCmd ) != 0 )
+    {
+        return EIO;
+    }
+
+    snprintf( pcCmd, sizeof(pcCmd), "hdiutil attach -nomount %s.sparseimage", pcImage );
+    printf("Execute %s:\n", pcCmd);
+    FILE* psOut = popen( pcCmd, "r" );
+    if ( psOut == NULL )
+    {
+        return EIO;
+    }
+    int iMatched = fscanf( psOut, "/dev/%31s", pcDisk );
+    pclose( psOut );
+
+    return (iMatched == 1) ? 0 : EIO;
+}
+
+static int
+HFSTest_MountExternalJournal( int iFD, int iJournalFD, UVFSFileNode* ppsRootNode )
+{
+    UVFSScanVolsRequest sScanVolsReq = {0};
+    UVFSScanVolsReply sScanVolsReply = {0};
+
+    int iErr = HFS_fsOps.fsops_taste( iFD );
+    if ( !iErr )
+    {
+        iErr = HFS_fsOps.fsops_scanvols( iFD, &sScanVolsReq, &sScanVolsReply );
+    }
+    if ( !iErr )
+    {
+        if ( iJournalFD < 0 )
+        {
+            iErr = HFS_fsOps.fsops_mount( iFD, sScanVolsReply.sr_volid, 0, NULL, ppsRootNode );
+        }
+        else
+        {
+            iErr = LFHFS_MountWithJournal( iFD, iJournalFD, 0, ppsRootNode );
+        }
+    }
+    printf("Mount (journal fd %d) err [%d]\n", iJournalFD, iErr);
+
+    return iErr;
+}
+
+static void
+HFSTest_ExternalJournalVerify( UVFSFileNode psRootNode, char* pcName, const uint8_t* puOutBuf, uint8_t* puInBuf, uint64_t uSize )
+{
+    UVFSFileNode psFile = NULL;
+    size_t iActuallyRead = 0;
+
+    assert( HFS_fsOps.fsops_lookup( psRootNode, pcName, &psFile ) == 0 );
+    memset( puInBuf, 0, uSize );
+    assert( HFS_fsOps.fsops_read( psFile, 0, uSize, puInBuf, &iActuallyRead ) == 0 );
+    assert( iActuallyRead == uSize );
+    assert( memcmp( puInBuf, puOutBuf, uSize ) == 0 );
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+}
+
+/*
+ * Build a volume whose journal is on a second device and mount it through
+ * late journal init (the journal is created over) and early journal init
+ * (the journal is opened as is), checking the data each time.
+ */
+static int
+HFSTest_ExternalJournal( __unused UVFSFileNode RootNode )
+{
+#define XJNL_VOLUME_IMAGE       "/tmp/hfstester_xjnl_vol"
+#define XJNL_JOURNAL_IMAGE      "/tmp/hfstester_xjnl_jnl"
+#define XJNL_FILE_SIZE          (1024*1024 + 123)
+
+    char pcVolDisk[32]      = {0};
+    char pcJnlDisk[32]      = {0};
+    char pcCmd[MAX_CMN_LEN];
+    uint8_t pcVolumeHeader[512];
+    UVFSFileNode psRootNode = NULL;
+    UVFSFileNode psFile     = NULL;
+    size_t iActuallyWrite   = 0;
+    uint8_t* puOutBuf       = malloc(XJNL_FILE_SIZE);
+    uint8_t* puInBuf        = malloc(XJNL_FILE_SIZE);
+    assert( puOutBuf != NULL && puInBuf != NULL );
+
+    for ( uint32_t uIdx = 0; uIdx < XJNL_FILE_SIZE; uIdx++ )
+    {
+        puOutBuf[uIdx] = (uint8_t)(uIdx * 5 + uIdx / 512);
+    }
+
+    assert( HFSTest_AttachBlankImage( XJNL_VOLUME_IMAGE, 256, pcVolDisk ) == 0 );
+    assert( HFSTest_AttachBlankImage( XJNL_JOURNAL_IMAGE, 16, pcJnlDisk ) == 0 );
+
+    snprintf( pcCmd, sizeof(pcCmd), "newfs_hfs -v ExternalJournal -J -D /dev/%s /dev/%s", pcJnlDisk, pcVolDisk );
+    printf("Execute %s:\n", pcCmd);
+    assert( system( pcCmd ) == 0 );
+
+    snprintf( pcCmd, sizeof(pcCmd), "/dev/r%s", pcVolDisk );
+    int iFD = open( pcCmd, O_RDWR );
+    snprintf( pcCmd, sizeof(pcCmd), "/dev/r%s", pcJnlDisk );
+    int iJournalFD = open( pcCmd, O_RDWR );
+    assert( iFD >= 0 && iJournalFD >= 0 );
+
+    // Without the journal device the mount is refused
+    assert( HFSTest_MountExternalJournal( iFD, -1, &psRootNode ) != 0 );
+
+    // newfs records a non-journaled last mount, so this is late journal init
+    assert( HFSTest_MountExternalJournal( iFD, iJournalFD, &psRootNode ) == 0 );
+    assert( CreateNewFile( psRootNode, &psFile, "First", 0 ) == 0 );
+    assert( HFS_fsOps.fsops_write( psFile, 0, XJNL_FILE_SIZE, puOutBuf, &iActuallyWrite ) == 0 );
+    assert( iActuallyWrite == XJNL_FILE_SIZE );
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+    HFSTest_ExternalJournalVerify( psRootNode, "First", puOutBuf, puInBuf, XJNL_FILE_SIZE );
+    assert( HFS_fsOps.fsops_unmount( psRootNode, UVFSUnmountHintNone ) == 0 );
+
+    // Early journal init opens the journal we left
+    assert( HFSTest_MountExternalJournal( iFD, iJournalFD, &psRootNode ) == 0 );
+    HFSTest_ExternalJournalVerify( psRootNode, "First", puOutBuf, puInBuf, XJNL_FILE_SIZE );
+    assert( HFS_fsOps.fsops_unmount( psRootNode, UVFSUnmountHintNone ) == 0 );
+
+    // Make it look like the volume was last mounted without its journal,
+    // so the next mount starts the journal that is in use over
+    assert( pread( iFD, pcVolumeHeader, sizeof(pcVolumeHeader), 1024 ) == sizeof(pcVolumeHeader) );
+    *(uint32_t*)(pcVolumeHeader + offsetof(HFSPlusVolumeHeader, lastMountedVersion)) = OSSwapHostToBigInt32(kHFSPlusMountVersion);
+    assert( pwrite( iFD, pcVolumeHeader, sizeof(pcVolumeHeader), 1024 ) == sizeof(pcVolumeHeader) );
+
+    assert( HFSTest_MountExternalJournal( iFD, iJournalFD, &psRootNode ) == 0 );
+    HFSTest_ExternalJournalVerify( psRootNode, "First", puOutBuf, puInBuf, XJNL_FILE_SIZE );
+    assert( CreateNewFile( psRootNode, &psFile, "Second", 0 ) == 0 );
+    assert( HFS_fsOps.fsops_write( psFile, 0, XJNL_FILE_SIZE, puOutBuf, &iActuallyWrite ) == 0 );
+    assert( iActuallyWrite == XJNL_FILE_SIZE );
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+    assert( HFS_fsOps.fsops_unmount( psRootNode, UVFSUnmountHintNone ) == 0 );
+
+    // And the recreated journal opens again
+    assert( HFSTest_MountExternalJournal( iFD, iJournalFD, &psRootNode ) == 0 );
+    HFSTest_ExternalJournalVerify( psRootNode, "First", puOutBuf, puInBuf, XJNL_FILE_SIZE );
+    HFSTest_ExternalJournalVerify( psRootNode, "Second", puOutBuf, puInBuf, XJNL_FILE_SIZE );
+    assert( HFS_fsOps.fsops_remove( psRootNode, "First", NULL ) == 0 );
+    assert( HFS_fsOps.fsops_remove( psRootNode, "Second", NULL ) == 0 );
+    assert( HFS_fsOps.fsops_unmount( psRootNode, UVFSUnmountHintNone ) == 0 );
+
+    close( iFD );
+    close( iJournalFD );
+
+    snprintf( pcCmd, sizeof(pcCmd), "hdiutil detach /dev/%s && hdiutil detach /dev/%s && rm -f %s.sparseimage %s.sparseimage",
+              pcVolDisk, pcJnlDisk, XJNL_VOLUME_IMAGE, XJNL_JOURNAL_IMAGE );
+    printf("Execute %s:\n", pcCmd);
+    system( pcCmd );
+
+    free(puOutBuf);
+    free(puInBuf);
+    return 0;
+}
+
+/*
+ * Read the attributes and lastMountedVersion of the volume header on
+ * disk. Only meaningful while the volume is unmounted.
+ */
+static void
+HFSTest_ReadHeaderStamp( uint32_t* puAttributes, uint32_t* puMountVersion )
+{
+    uint8_t pcVolumeHeader[512];
+
+    assert( pread( giFD, pcVolumeHeader, sizeof(pcVolumeHeader), 1024 ) == sizeof(pcVolumeHeader) );
+    *puAttributes   = OSSwapBigToHostInt32( *(uint32_t*)(pcVolumeHeader + offsetof(HFSPlusVolumeHeader, attributes)) );
+    *puMountVersion = OSSwapBigToHostInt32( *(uint32_t*)(pcVolumeHeader + offsetof(HFSPlusVolumeHeader, lastMountedVersion)) );
+}
+
+/*
+ * Unmount, check the header stamp, mount again and check that the
+ * journal and the data file came back as they were.
+ */
+static void
+HFSTest_JournalLifecycleCheck( UVFSFileNode* ppsRootNode, bool bJournaled, const uint8_t* puOutBuf, uint8_t* puInBuf, uint64_t uSize )
+{
+    LFHFSJournalInfo_S sBefore;
+    LFHFSJournalInfo_S sAfter;
+    uint32_t uAttributes    = 0;
+    uint32_t uMountVersion  = 0;
+
+    assert( LFHFS_GetJournalInfo( *ppsRootNode, &sBefore ) == 0 );
+    assert( sBefore.bJournaled == bJournaled );
+
+    assert( HFSTest_Unmount( ppsRootNode ) == 0 );
+    HFSTest_ReadHeaderStamp( &uAttributes, &uMountVersion );
+    assert( ((uAttributes & kHFSVolumeJournaledMask) != 0) == bJournaled );
+    assert( uMountVersion == (bJournaled ? kHFSJMountVersion : kHFSPlusMountVersion) );
+
+    assert( HFSTest_Mount( ppsRootNode ) == 0 );
+    assert( (VTOHFS( (struct vnode*) *ppsRootNode )->jnl != NULL) == bJournaled );
+    assert( LFHFS_GetJournalInfo( *ppsRootNode, &sAfter ) == 0 );
+    assert( sAfter.bJournaled == bJournaled );
+    if ( bJournaled )
+    {
+        assert( !sAfter.bExternal );
+        assert( sAfter.bContiguous );
+        assert( sAfter.uInfoBlock == sBefore.uInfoBlock );
+        assert( sAfter.uOffset == sBefore.uOffset );
+        assert( sAfter.uSize == sBefore.uSize );
+        assert( sAfter.uStartBlock == sBefore.uStartBlock );
+    }
+
+    HFSTest_ExternalJournalVerify( *ppsRootNode, "JournalLifecycle", puOutBuf, puInBuf, uSize );
+}
+
+static int
+HFSTest_JournalLifecycle( UVFSFileNode RootNode )
+{
+#define JNL_LIFE_FILE_SIZE      (3*1024*1024 + 77)
+#define JNL_LIFE_SIZE           (1024*1024)
+#define JNL_LIFE_NEW_SIZE       (4*1024*1024)
+
+    LFHFSJournalInfo_S sInfo;
+    UVFSFileNode psFile     = NULL;
+    size_t iActuallyWrite   = 0;
+    uint8_t* puOutBuf       = malloc(JNL_LIFE_FILE_SIZE);
+    uint8_t* puInBuf        = malloc(JNL_LIFE_FILE_SIZE);
+    assert( puOutBuf != NULL && puInBuf != NULL );
+
+    for ( uint32_t uIdx = 0; uIdx < JNL_LIFE_FILE_SIZE; uIdx++ )
+    {
+        puOutBuf[uIdx] = (uint8_t)(uIdx * 11 + uIdx / 4096);
+    }
+
+    assert( LFHFS_GetJournalInfo( RootNode, &sInfo ) == 0 );
+    assert( !sInfo.bJournaled );
+
+    // Enable, then write the data through the new journal
+    assert( LFHFS_MakeJournaled( RootNode, JNL_LIFE_SIZE, 0 ) == 0 );
+    assert( LFHFS_GetJournalInfo( RootNode, &sInfo ) == 0 );
+    assert( sInfo.bJournaled && !sInfo.bExternal && sInfo.bContiguous );
+    assert( sInfo.uFlags & kJIJournalInFSMask );
+    assert( sInfo.uSize == JNL_LIFE_SIZE );
+    assert( sInfo.uOffset == (uint64_t)sInfo.uStartBlock * VTOHFS( (struct vnode*) RootNode )->blockSize );
+
+    assert( CreateNewFile( RootNode, &psFile, "JournalLifecycle", 0 ) == 0 );
+    assert( HFS_fsOps.fsops_write( psFile, 0, JNL_LIFE_FILE_SIZE, puOutBuf, &iActuallyWrite ) == 0 );
+    assert( iActuallyWrite == JNL_LIFE_FILE_SIZE );
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+
+    HFSTest_JournalLifecycleCheck( &RootNode, true, puOutBuf, puInBuf, JNL_LIFE_FILE_SIZE );
+
+    // Grow the journal and move it to the middle of the volume
+    uint32_t uOldStart  = sInfo.uStartBlock;
+    uint32_t uOldJIB    = sInfo.uInfoBlock;
+    uint32_t uHint      = VTOHFS( (struct vnode*) RootNode )->totalBlocks / 2;
+    assert( LFHFS_ResizeJournal( RootNode, JNL_LIFE_NEW_SIZE, uHint ) == 0 );
+    assert( LFHFS_GetJournalInfo( RootNode, &sInfo ) == 0 );
+    assert( sInfo.bJournaled && sInfo.bContiguous );
+    assert( sInfo.uSize == JNL_LIFE_NEW_SIZE );
+    assert( sInfo.uInfoBlock == uOldJIB );
+    assert( sInfo.uStartBlock != uOldStart && sInfo.uStartBlock >= uHint );
+    assert( sInfo.uOffset == (uint64_t)sInfo.uStartBlock * VTOHFS( (struct vnode*) RootNode )->blockSize );
+
+    HFSTest_JournalLifecycleCheck( &RootNode, true, puOutBuf, puInBuf, JNL_LIFE_FILE_SIZE );
+
+    // Disable; the journal files go away
+    UVFSFileNode psLookup = NULL;
+    assert( LFHFS_UnJournal( RootNode ) == 0 );
+    assert( LFHFS_GetJournalInfo( RootNode, &sInfo ) == 0 );
+    assert( !sInfo.bJournaled );
+    assert( HFS_fsOps.fsops_lookup( RootNode, ".journal", &psLookup ) == ENOENT );
+    assert( HFS_fsOps.fsops_lookup( RootNode, ".journal_info_block", &psLookup ) == ENOENT );
+
+    HFSTest_JournalLifecycleCheck( &RootNode, false, puOutBuf, puInBuf, JNL_LIFE_FILE_SIZE );
+
+    assert( HFS_fsOps.fsops_remove( RootNode, "JournalLifecycle", NULL ) == 0 );
+
+    free(puOutBuf);
+    free(puInBuf);
+    return 0;
+}
+
+/*
+ * Allocate while the bitmap scan started by the mount is running, then
+ * unmount before it gets far. The harness runs fsck at the end.
+ */
+static int
+HFSTest_BackgroundScan( UVFSFileNode RootNode )
+{
+#define BGSCAN_ROUNDS       (4)
+#define BGSCAN_FILE_SIZE    (4*1024*1024)
+
+    char pcName[32];
+    UVFSFileNode psFile     = NULL;
+    size_t iActuallyWrite   = 0;
+    size_t iActuallyRead    = 0;
+    uint8_t* puOutBuf       = malloc(BGSCAN_FILE_SIZE);
+    uint8_t* puInBuf        = malloc(BGSCAN_FILE_SIZE);
+    assert( puOutBuf != NULL && puInBuf != NULL );
+
+    for ( uint32_t uIdx = 0; uIdx < BGSCAN_FILE_SIZE; uIdx++ )
+    {
+        puOutBuf[uIdx] = (uint8_t)(uIdx * 3 + uIdx / 4096);
+    }
+
+    for ( uint32_t uRound = 0; uRound < BGSCAN_ROUNDS; uRound++ )
+    {
+        struct hfsmount* hfsmp = VTOHFS( (struct vnode*) RootNode );
+        printf("Round %u: bitmap scan %s\n", uRound, (hfsmp->scan_var & HFS_ALLOCATOR_SCAN_COMPLETED) ? "completed" : "in flight");
+
+        sprintf( pcName, "ScanFile_%u", uRound );
+        puOutBuf[0] = (uint8_t) uRound;
+        assert( CreateNewFile( RootNode, &psFile, pcName, 0 ) == 0 );
+        assert( HFS_fsOps.fsops_write( psFile, 0, BGSCAN_FILE_SIZE, puOutBuf, &iActuallyWrite ) == 0 );
+        assert( iActuallyWrite == BGSCAN_FILE_SIZE );
+        HFS_fsOps.fsops_reclaim( psFile, 0 );
+
+        // Unmount right behind the allocations, most likely mid-scan
+        assert( HFSTest_Remount( &RootNode ) == 0 );
+    }
+
+    for ( uint32_t uRound = 0; uRound < BGSCAN_ROUNDS; uRound++ )
+    {
+        sprintf( pcName, "ScanFile_%u", uRound );
+        puOutBuf[0] = (uint8_t) uRound;
+        assert( HFS_fsOps.fsops_lookup( RootNode, pcName, &psFile ) == 0 );
+        assert( HFS_fsOps.fsops_read( psFile, 0, BGSCAN_FILE_SIZE, puInBuf, &iActuallyRead ) == 0 );
+        assert( iActuallyRead == BGSCAN_FILE_SIZE );
+        assert( memcmp( puInBuf, puOutBuf, BGSCAN_FILE_SIZE ) == 0 );
+        HFS_fsOps.fsops_reclaim( psFile, 0 );
+
+        // Leave some freed space behind for fsck to check
+        if ( uRound % 2 )
+        {
+            assert( HFS_fsOps.fsops_remove( RootNode, pcName, NULL ) == 0 );
+        }
+    }
+
+    free(puOutBuf);
+    free(puInBuf);
+    return 0;
+}
+
+static int
+HFSTest_RandomIO( UVFSFileNode RootNode )
+{
+#define MAX_IO_SIZE (1024*1024)
+#define MAX_IO_OFFSET (80*MAX_IO_SIZE)
+#define TEST_RUN_TIME_SEC (30)
+
+    int iErr = 0;
+    UVFSFileNode psFile;
+    static mach_timebase_info_data_t sTimebaseInfo;
+    mach_timebase_info(&sTimebaseInfo);
+
+    void* pvWriteBuf    = malloc(MAX_IO_SIZE);
+    void* pvReadBuf     = malloc(MAX_IO_SIZE);
+
+    int* puBuf = pvWriteBuf;
+    for ( uint64_t uIdx=0; uIdx<(MAX_IO_SIZE/sizeof(int)); uIdx++ )
+    {
+        puBuf[uIdx] = rand();
+    }
+
+    iErr = CreateNewFile( RootNode, &psFile, "SimpleFile", 0 );
+    assert(iErr == 0);
+
+    uint64_t start = mach_absolute_time();
+    uint64_t elapsedSec = 0;
+    // while( elapsedSec < TEST_RUN_TIME_SEC )
+    for(uint32_t uWriteReadCnt=1000; uWriteReadCnt; uWriteReadCnt--)
+    {
+        uint64_t uNextIOSize   = rand() % MAX_IO_SIZE;
+        uint64_t uNextIOOffset = rand() % MAX_IO_OFFSET;
+
+        printf("uNextIOSize = %llu, uNextIOOffset = %llu\n", uNextIOSize, uNextIOOffset);
+
+        size_t iActuallyWrite;
+        size_t iActuallyRead;
+        
+        iErr = HFS_fsOps.fsops_write( psFile, uNextIOOffset, uNextIOSize, pvWriteBuf, &iActuallyWrite );
+        assert(iErr==0);
+        iErr = HFS_fsOps.fsops_read( psFile, uNextIOOffset, uNextIOSize, pvReadBuf, &iActuallyRead );
+        assert(iErr==0);
+
+        uint8_t* puRead = pvReadBuf;
+        uint8_t* puWrite = pvWriteBuf;
+        for ( uint64_t uIdx=0; uIdx<uNextIOSize; uIdx++ )
+        {
+            assert( puRead[uIdx] == puWrite[uIdx] );
+        }
+
+        uint64_t end = mach_absolute_time();
+        uint64_t elapsed = end - start;
+        uint64_t elapsedNano = elapsed * sTimebaseInfo.numer / sTimebaseInfo.denom;
+        elapsedSec = elapsedNano / 1000 / 1000 / 1000;
+    }
+
+    free(pvReadBuf);
+    free(pvWriteBuf);
+
+    HFS_fsOps.fsops_reclaim(psFile, 0);
+
+    return 0;
+}
+
+static int
+HFSTest_HardLink( UVFSFileNode RootNode )
+{
+    int iErr                = 0;
+
+    // Validate files exist on media
+    UVFSFileNode psOriginalFile = NULL;
+    iErr = HFS_fsOps.fsops_lookup( RootNode, "original_file.txt", &psOriginalFile );
+    printf("Lookup for original file err [%d]\n", iErr);
+    if ( iErr )
+        return iErr;
+
+    UVFSFileNode psFirstLink = NULL;
+    iErr = HFS_fsOps.fsops_lookup( RootNode, "first_link.txt", &psFirstLink );
+    printf("Lookup for original file err [%d]\n", iErr);
+    if ( iErr )
+        return iErr;
+
+    UVFSFileNode psDirectory = NULL;
+    iErr = HFS_fsOps.fsops_lookup( RootNode, "dir", &psDirectory );
+    printf("Lookup for original file err [%d]\n", iErr);
+    if ( iErr )
+        return iErr;
+
+    UVFSFileNode psSecondLink = NULL;
+    iErr = HFS_fsOps.fsops_lookup( psDirectory, "second_link.txt", &psSecondLink );
+    printf("Lookup for original file err [%d]\n", iErr);
+    if ( iErr )
+        return iErr;
+
+
+    UVFSFileAttributes sOutAttrs;
+    iErr = HFS_fsOps.fsops_getattr(psOriginalFile, &sOutAttrs);
+    printf("GetAttr for original file err [%d]\n", iErr);
+    if (iErr)
+        return iErr;
+
+    if (sOutAttrs.fa_nlink != 3)
+    {
+        printf("nlink of original file should be 3, got [%d]\n", sOutAttrs.fa_nlink);
+        return 1;
+    }
+
+    void* pvOriginalFileBuf          = malloc(sOutAttrs.fa_size);
+    void* pvFirstLinkeBuf            = malloc(sOutAttrs.fa_size);
+    void* pvSecondLinkeBuf           = malloc(sOutAttrs.fa_size);
+    uint64_t* puOriginalFileBuf  = pvOriginalFileBuf;
+    uint64_t* puFirstLinkeBuf    = pvFirstLinkeBuf;
+    uint64_t* puSecondLinkeBuf   = pvSecondLinkeBuf;
+
+    size_t iActuallyRead   = 0;
+    assert( HFS_fsOps.fsops_read( psOriginalFile, 0, sOutAttrs.fa_size, pvOriginalFileBuf, &iActuallyRead ) == 0 );
+    assert( HFS_fsOps.fsops_read( psFirstLink,    0, sOutAttrs.fa_size, pvFirstLinkeBuf, &iActuallyRead ) == 0 );
+    assert( HFS_fsOps.fsops_read( psSecondLink,   0, sOutAttrs.fa_size, pvSecondLinkeBuf, &iActuallyRead ) == 0 );
+
+    // Lets test if all links has the same content it...
+    for ( uint64_t uIdx=0; uIdx<(sOutAttrs.fa_size/sizeof(uint64_t)); uIdx++ )
+    {
+        assert( puOriginalFileBuf[uIdx] == puFirstLinkeBuf[uIdx] );
+        assert( puOriginalFileBuf[uIdx] == puSecondLinkeBuf[uIdx] );
+    }
+
+    // Save content of the original file and fill up 0x1000 0xAAs
+    void* pvNewContentBuf  = malloc(sOutAttrs.fa_size + 1000);
+    uint64_t* puNewContentBuf   = pvNewContentBuf;
+
+    memcpy(pvNewContentBuf, pvOriginalFileBuf ,sOutAttrs.fa_size);
+    memset(pvNewContentBuf + sOutAttrs.fa_size, 0xAA,1000);
+    
+    assert( HFS_fsOps.fsops_write( psOriginalFile, 0, sOutAttrs.fa_size + 1000, pvNewContentBuf, &iActuallyRead ) == 0 );
+    free(pvOriginalFileBuf);
+    free(pvFirstLinkeBuf);
+    free(pvSecondLinkeBuf);
+
+    pvOriginalFileBuf  = malloc(sOutAttrs.fa_size + 1000);
+    pvFirstLinkeBuf    = malloc(sOutAttrs.fa_size + 1000);
+    pvSecondLinkeBuf   = malloc(sOutAttrs.fa_size + 1000);
+    puOriginalFileBuf  = pvOriginalFileBuf;
+    puFirstLinkeBuf    = pvFirstLinkeBuf;
+    puSecondLinkeBuf   = pvSecondLinkeBuf;
+
+    // Make sure the file and its hardlinks have the new content
+    assert( HFS_fsOps.fsops_read( psOriginalFile, 0, sOutAttrs.fa_size + 1000, pvOriginalFileBuf, &iActuallyRead ) == 0 );
+    assert( HFS_fsOps.fsops_read( psFirstLink,    0, sOutAttrs.fa_size + 1000, pvFirstLinkeBuf, &iActuallyRead ) == 0 );
+    assert( HFS_fsOps.fsops_read( psSecondLink,   0, sOutAttrs.fa_size + 1000, pvSecondLinkeBuf, &iActuallyRead ) == 0 );
+    for ( uint64_t uIdx=0; uIdx<((sOutAttrs.fa_size + 1000)/sizeof(uint64_t)); uIdx++ )
+    {
+        assert( puOriginalFileBuf[uIdx] == puNewContentBuf[uIdx] );
+        assert( puOriginalFileBuf[uIdx] == puFirstLinkeBuf[uIdx] );
+        assert( puOriginalFileBuf[uIdx] == puSecondLinkeBuf[uIdx] );
+    }
+
+    iErr = HFS_fsOps.fsops_remove( RootNode, "original_file.txt", NULL);
+    printf( "Remove original file err [%d]\n", iErr );
+    if ( iErr != 0 )
+        return iErr;
+
+    iErr = HFS_fsOps.fsops_getattr(psFirstLink, &sOutAttrs);
+    printf("GetAttr for first link err [%d]\n", iErr);
+    if (iErr)
+        return iErr;
+
+    if (sOutAttrs.fa_nlink != 2)
+    {
+        printf("nlink of first link should be 2, got [%d]\n", sOutAttrs.fa_nlink);
+        return 1;
+    }
+
+    RenameFile(psDirectory, psSecondLink,"second_link.txt", RootNode, psFirstLink,"first_link.txt" );
+
+    iErr = HFS_fsOps.fsops_getattr(psSecondLink, &sOutAttrs);
+    printf("GetAttr for second link err [%d]\n", iErr);
+    if (iErr)
+        return iErr;
+    
+
+    if (sOutAttrs.fa_nlink != 2)
+    {
+        printf("nlink of first link should be 2, got [%d]\n", sOutAttrs.fa_nlink);
+        return 1;
+    }
+
+    iErr = HFS_fsOps.fsops_remove( RootNode, "first_link.txt", NULL);
+    printf( "Remove first link err [%d]\n", iErr );
+    if ( iErr != 0 )
+        return iErr;
+
+    free(pvOriginalFileBuf);
+    free(pvFirstLinkeBuf);
+    free(pvSecondLinkeBuf);
+    free(pvNewContentBuf);
+    HFS_fsOps.fsops_reclaim(psOriginalFile, 0);
+    HFS_fsOps.fsops_reclaim(psFirstLink, 0);
+    HFS_fsOps.fsops_reclaim(psSecondLink, 0);
+    HFS_fsOps.fsops_reclaim(psDirectory, 0);
+
+    return iErr;
+}
+
+static int
+HFSTest_CreateHardLink( UVFSFileNode RootNode )
+{
+    uint32_t uOriginalFileSize = 500000;
+
+    int iErr                = 0;
+    UVFSFileNode psFile     = NULL;
+    size_t iActuallyWrite   = 0;
+    size_t iActuallyRead   = 0;
+    void* pvOutBuf          = malloc(uOriginalFileSize);
+    void* pvInBuf           = malloc(uOriginalFileSize);
+    assert( pvOutBuf != NULL && pvInBuf != NULL );
+    uint64_t* puOutBuf  = pvOutBuf;
+    uint64_t* puInBuf   = pvInBuf;
+
+    // Create the original file with size 500,000 Bytes
+    iErr = CreateNewFile( RootNode, &psFile, "original_file.txt", uOriginalFileSize);
+    assert( iErr == 0 );
+
+    // lets write 10,000 Bytes with 0xCD
+    memset(pvOutBuf, 0, uOriginalFileSize);
+    memset(pvInBuf, 0, uOriginalFileSize);
+
+    memset(pvOutBuf, 0xCD, uOriginalFileSize);
+
+    assert( HFS_fsOps.fsops_write( psFile, 0, uOriginalFileSize, pvOutBuf, &iActuallyWrite ) == 0 );
+    assert( HFS_fsOps.fsops_read( psFile, 0, uOriginalFileSize, pvInBuf, &iActuallyRead ) == 0 );
+
+    // Lets test it...
+    for ( uint64_t uIdx=0; uIdx<(uOriginalFileSize/sizeof(uint64_t)); uIdx++ )
+    {
+        assert( puInBuf[uIdx] == puOutBuf[uIdx] );
+    }
+
+    UVFSFileNode psDirectory = NULL;
+    assert (CreateNewFolder(RootNode,&psDirectory,"dir") == 0);
+    assert (CreateHardLink(psFile,RootNode,"first_link.txt") == 0);
+    assert (CreateHardLink(psFile,psDirectory,"second_link.txt") == 0);
+
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+    HFS_fsOps.fsops_reclaim( psDirectory, 0 );
+
+    assert (HFSTest_HardLink( RootNode ) == 0);
+
+    goto exit;
+
+exit:
+    return iErr;
+}
+
+static int
+HFSTest_RenameToHardlink( UVFSFileNode RootNode )
+{
+    UVFSFileNode psFile0            = NULL;
+    UVFSFileNode psFile1            = NULL;
+    UVFSFileNode psLink             = NULL;
+    UVFSFileAttributes sOutAttrs    = {0};
+
+    assert ( CreateNewFile( RootNode, &psFile0, "simple_file.txt", 0 ) == 0 );
+    assert ( CreateNewFile( RootNode, &psFile1, "original_file.txt", 0 ) == 0 );
+    assert ( CreateHardLink( psFile1, RootNode, "first_link.txt" ) == 0 );
+    assert ( CreateHardLink( psFile1, RootNode, "second_link.txt" ) == 0 );
+    assert ( HFS_fsOps.fsops_lookup( RootNode, "first_link.txt", &psLink ) == 0 );
+    assert( RenameFile(RootNode, psFile0, "simple_file.txt", RootNode, psLink, "first_link.txt") == 0 );
+
+    assert( HFS_fsOps.fsops_getattr(psFile1, &sOutAttrs) == 0 );
+
+    assert( HFS_fsOps.fsops_reclaim(psFile0, 0) == 0 );
+    for ( uint32_t uIdx=0; uIdx<sOutAttrs.fa_nlink; uIdx++ )
+        assert( HFS_fsOps.fsops_reclaim(psFile1, 0) == 0 );
+
+    return 0;
+}
+
+static int
+HFSTest_JustMount( __unused UVFSFileNode RootNode )
+{
+    return 0;
+}
+
+static int HFSTest_OpenJournal( __unused UVFSFileNode RootNode ) {
+    
+    printf("HFSTest_OpenJournal:\n");
+    
+    return 0;
+}
+
+static int HFSTest_WriteToJournal(UVFSFileNode RootNode ) {
+    int iErr = 0;
+    
+    printf("HFSTest_WriteToJournal:\n");
+    
+    printf("Create a new folder:\n");
+    UVFSFileNode TestFolder = NULL;
+    iErr = CreateNewFolder( RootNode, &TestFolder, "TestFolder");
+    printf("CreateNewFolder err [%d]\n", iErr);
+    if (iErr) {
+        return iErr;
+    }
+
+    printf("Create new file with size 0:\n");
+    UVFSFileNode TestFile1 = NULL;
+    CreateNewFile(TestFolder, &TestFile1, "TestFile.txt",0);
+    printf("Create TestFile in TestFolder err [%d]\n", iErr);
+    if (iErr) {
+        return iErr;
+    }
+    
+    printf("Create new file with size 512:\n");
+    UVFSFileNode TestFile2 = NULL;
+    CreateNewFile(TestFolder, &TestFile2, "TestFile2.txt",512);
+    printf("Create TestFile2 in TestFolder err [%d]\n", iErr);
+    if (iErr) {
+        return iErr;
+    }
+
+    uint32_t uEntrySize = sizeof(UVFSDirEntryAttr) + MAX_UTF8_NAME_LENGTH;
+    UVFSDirEntryAttr *psReadDirTestsData = malloc(2*uEntrySize);
+    if (psReadDirTestsData == NULL)
+        return ENOMEM;
+
+    UVFSDirEntryAttr *psCurrentReadDirTestsData = psReadDirTestsData;
+    SetExpectedAttr("TestFile.txt", UVFS_FA_TYPE_FILE, psCurrentReadDirTestsData);
+    iErr = HFS_fsOps.fsops_getattr( TestFile1, &psCurrentReadDirTestsData->dea_attrs );
+    psCurrentReadDirTestsData = (UVFSDirEntryAttr *) ((void*) psCurrentReadDirTestsData + uEntrySize);
+    SetExpectedAttr("TestFile2.txt", UVFS_FA_TYPE_FILE, psCurrentReadDirTestsData);
+    iErr = HFS_fsOps.fsops_getattr( TestFile2, &psCurrentReadDirTestsData->dea_attrs );
+
+    printf("Read DIR attr:\n");
+    iErr = ReadDirAttr(TestFolder, psReadDirTestsData, 2);
+    free(psReadDirTestsData);
+    printf("ReadDirAttr err [%d]\n", iErr);
+    if (iErr) {
+        goto exit;
+    }
+    
+    printf("Remove File1:\n");
+    iErr =  RemoveFile(TestFolder,"TestFile.txt");
+    printf("Remove File TestFile from TestFolder err [%d]\n", iErr);
+    if (iErr) {
+        goto exit;
+    }
+    
+    printf("Remove File2:\n");
+    iErr =  RemoveFile(TestFolder,"TestFile2.txt");
+    printf("Remove File TestFile2 from TestFolder err [%d]\n", iErr);
+    if (iErr) {
+        goto exit;
+    }
+    
+    printf("Remove TestFolder:\n");
+    iErr =  RemoveFolder(RootNode,"TestFolder");
+    printf("Remove Folder TestFolder from Root err [%d]\n", iErr);
+    if (iErr) {
+        goto exit;
+    }
+    
+exit:
+    HFS_fsOps.fsops_reclaim(TestFolder, 0);
+    HFS_fsOps.fsops_reclaim(TestFile1, 0);
+    HFS_fsOps.fsops_reclaim(TestFile2, 0);
+    return iErr;
+}
+
+static int __used
+HFSTest_SetXattr( UVFSFileNode RootNode )
+{
+    const char * pcAttr = "com.apple.test.set";
+    const char * pcAttr2 = "com.apple.test.set2";
+    char pcData[] = "This is attribute data";
+    char pcData2[] = "This is attribute data 2";
+    int iErr = 0;
+
+    UVFSFileNode TestFile = NULL;
+    iErr = HFS_fsOps.fsops_lookup( RootNode, "kl_set.test", &TestFile );
+    if ( iErr )
+    {
+        printf("Lookup err [%d]\n", iErr);
+        return iErr;
+    }
+
+    // Add Attribute - create
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowCreate);
+    if ( iErr )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Add Attribute - create with failure
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData2, strlen(pcData2)+1, UVFSXattrHowCreate);
+    if ( iErr != EEXIST)
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Add Attribute - set
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData2, strlen(pcData2)+1, UVFSXattrHowSet);
+    if ( iErr )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Add Attribute - replace
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowReplace);
+    if ( iErr )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Add Attribute - replace with failure
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr2, pcData, strlen(pcData)+1, UVFSXattrHowReplace);
+    if ( iErr != ENOATTR )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Add Attribute - remove
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowRemove);
+    if ( iErr )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Add Attribute - remove with failure
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowRemove);
+    if ( iErr != ENOATTR )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Get Attribute - check nothing left
+    size_t actual_size = INT32_MAX;
+    iErr = HFS_fsOps.fsops_listxattr(TestFile, NULL, 0, &actual_size);
+    if ( iErr || (actual_size != 0))
+    {
+        printf("ListAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Add Attribute - create extended attribute and check content
+    const char * pcAttr3 = "com.apple.test.set3";
+    uint8_t *pBuffer = NULL;
+    uint8_t *pBufferRet = NULL;
+
+    // Test more than one sector and ending outside boundary.
+#define ATTR_EXT_SIZE   (5000)
+
+    pBuffer = malloc(ATTR_EXT_SIZE);
+    pBufferRet = malloc(ATTR_EXT_SIZE);
+
+    if ( pBuffer == NULL || pBufferRet == NULL)
+    {
+        iErr = ENOMEM;
+        goto out;
+    }
+
+    for (int i = 0; i < ATTR_EXT_SIZE; ++i)
+    {
+        pBuffer[i] = i % 256;
+        pBufferRet[i] = 0xff;
+    }
+
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr3, pBuffer, ATTR_EXT_SIZE, UVFSXattrHowCreate);
+    if ( iErr )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out_mem;
+    }
+
+    iErr = HFS_fsOps.fsops_getxattr(TestFile, pcAttr3, pBufferRet, ATTR_EXT_SIZE, &actual_size);
+    if ( iErr )
+    {
+        printf("GetAttr err [%d]\n", iErr);
+        goto out_mem;
+    }
+
+    // check data
+    assert(actual_size == ATTR_EXT_SIZE);
+
+    for (int i = 0; i < ATTR_EXT_SIZE; ++i)
+    {
+        assert(pBuffer[i] == pBufferRet[i]);
+    }
+
+    // Get all attributes at once - both the inline and the extent based one
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowCreate);
+    if ( iErr )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out_mem;
+    }
+
+    actual_size = 0;
+    iErr = LFHFS_GetAllXAttrs(TestFile, NULL, 0, &actual_size);
+    if ( iErr )
+    {
+        printf("GetAllAttrs size err [%d]\n", iErr);
+        goto out_mem;
+    }
+
+    size_t uAllSize = actual_size;
+    uint8_t *pAllBuffer = malloc(uAllSize);
+    if ( pAllBuffer == NULL )
+    {
+        iErr = ENOMEM;
+        goto out_mem;
+    }
+
+    iErr = LFHFS_GetAllXAttrs(TestFile, pAllBuffer, uAllSize - 1, &actual_size);
+    assert(iErr == ERANGE && actual_size == uAllSize);
+
+    iErr = LFHFS_GetAllXAttrs(TestFile, pAllBuffer, uAllSize, &actual_size);
+    if ( iErr )
+    {
+        printf("GetAllAttrs err [%d]\n", iErr);
+        free(pAllBuffer);
+        goto out_mem;
+    }
+
+    // Finder Info (if any) first, then attributes B-tree order: "com.apple.test.set" < "com.apple.test.set3"
+    LFHFSXAttrEntry_S *psEntry = (LFHFSXAttrEntry_S *)pAllBuffer;
+    if ( strcmp(psEntry->pcName, XATTR_FINDERINFO_NAME) == 0 )
+    {
+        psEntry = LFHFS_XATTR_ENTRY_NEXT(psEntry);
+    }
+    assert(strcmp(psEntry->pcName, pcAttr) == 0);
+    assert(psEntry->uValueSize == strlen(pcData)+1);
+    assert(memcmp(LFHFS_XATTR_ENTRY_VALUE(psEntry), pcData, strlen(pcData)+1) == 0);
+
+    psEntry = LFHFS_XATTR_ENTRY_NEXT(psEntry);
+    assert(strcmp(psEntry->pcName, pcAttr3) == 0);
+    assert(psEntry->uValueSize == ATTR_EXT_SIZE);
+    assert(memcmp(LFHFS_XATTR_ENTRY_VALUE(psEntry), pBuffer, ATTR_EXT_SIZE) == 0);
+    assert((uint8_t*)LFHFS_XATTR_ENTRY_NEXT(psEntry) == pAllBuffer + uAllSize);
+    free(pAllBuffer);
+
+    // Resource fork - through the xattr interface
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, XATTR_RESOURCEFORK_NAME, pBuffer, ATTR_EXT_SIZE, UVFSXattrHowCreate);
+    if ( iErr )
+    {
+        printf("SetAttr rsrc err [%d]\n", iErr);
+        goto out_mem;
+    }
+
+    memset(pBufferRet, 0xff, ATTR_EXT_SIZE);
+    iErr = HFS_fsOps.fsops_getxattr(TestFile, XATTR_RESOURCEFORK_NAME, pBufferRet, ATTR_EXT_SIZE, &actual_size);
+    if ( iErr )
+    {
+        printf("GetAttr rsrc err [%d]\n", iErr);
+        goto out_mem;
+    }
+    assert(actual_size == ATTR_EXT_SIZE);
+    assert(memcmp(pBuffer, pBufferRet, ATTR_EXT_SIZE) == 0);
+
+    // A shorter value replaces the whole fork
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, XATTR_RESOURCEFORK_NAME, pcData, strlen(pcData)+1, UVFSXattrHowReplace);
+    if ( iErr )
+    {
+        printf("SetAttr rsrc err [%d]\n", iErr);
+        goto out_mem;
+    }
+    iErr = HFS_fsOps.fsops_getxattr(TestFile, XATTR_RESOURCEFORK_NAME, NULL, 0, &actual_size);
+    assert(iErr == 0 && actual_size == strlen(pcData)+1);
+
+    // Resource fork - through the stream node
+    UVFSStreamNode RsrcNode = NULL;
+    size_t iRsrcIO = 0;
+    iErr = HFS_fsOps.fsops_stream_lookup(TestFile, &RsrcNode);
+    if ( iErr )
+    {
+        printf("StreamLookup err [%d]\n", iErr);
+        goto out_mem;
+    }
+    iErr = LFHFS_StreamWrite(RsrcNode, strlen(pcData)+1, ATTR_EXT_SIZE, pBuffer, &iRsrcIO);
+    assert(iErr == 0 && iRsrcIO == ATTR_EXT_SIZE);
+    memset(pBufferRet, 0xff, ATTR_EXT_SIZE);
+    iErr = HFS_fsOps.fsops_stream_read(RsrcNode, strlen(pcData)+1, ATTR_EXT_SIZE, pBufferRet, &iRsrcIO);
+    assert(iErr == 0 && iRsrcIO == ATTR_EXT_SIZE);
+    assert(memcmp(pBuffer, pBufferRet, ATTR_EXT_SIZE) == 0);
+    HFS_fsOps.fsops_stream_reclaim(RsrcNode);
+
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, XATTR_RESOURCEFORK_NAME, NULL, 0, UVFSXattrHowRemove);
+    if ( iErr )
+    {
+        printf("SetAttr rsrc remove err [%d]\n", iErr);
+        goto out_mem;
+    }
+    iErr = HFS_fsOps.fsops_getxattr(TestFile, XATTR_RESOURCEFORK_NAME, NULL, 0, &actual_size);
+    assert(iErr == ENOATTR);
+
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr, pcData, strlen(pcData)+1, UVFSXattrHowRemove);
+    if ( iErr )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out_mem;
+    }
+
+    iErr = HFS_fsOps.fsops_setxattr(TestFile, pcAttr3, pBuffer, ATTR_EXT_SIZE, UVFSXattrHowRemove);
+    if ( iErr )
+    {
+        printf("SetAttr err [%d]\n", iErr);
+        goto out_mem;
+    }
+
+out_mem:
+    free(pBuffer);
+    free(pBufferRet);
+
+out:
+    // Reclaim test file
+    HFS_fsOps.fsops_reclaim(TestFile, 0);
+
+    return iErr;
+}
+
+/*
+ * Return true if pcName is one of the names listxattr returns for psNode.
+ */
+static bool
+HFSTest_XattrListHas( UVFSFileNode psNode, const char* pcName )
+{
+    char pcList[1024];
+    size_t uSize = 0;
+
+    assert( HFS_fsOps.fsops_listxattr( psNode, pcList, sizeof(pcList), &uSize ) == 0 );
+    for ( size_t uOff = 0; uOff < uSize; uOff += strlen( &pcList[uOff] ) + 1 )
+    {
+        if ( strcmp( &pcList[uOff], pcName ) == 0 )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int __used
+HFSTest_XattrCacheInvalidate( UVFSFileNode RootNode )
+{
+    const char* pcAttrA = "com.apple.test.cacheA";
+    const char* pcAttrB = "com.apple.test.cacheB";
+    char pcFirst[]      = "first value";
+    char pcSecond[]     = "second, longer value";
+    char pcBuf[64];
+    size_t uSize;
+    uint64_t uHits, uMisses, uPurges;
+    UVFSFileNode psFile = NULL;
+
+    assert( CreateNewFile( RootNode, &psFile, "XattrCache", 0 ) == 0 );
+    assert( HFS_fsOps.fsops_setxattr( psFile, pcAttrA, pcFirst, sizeof(pcFirst), UVFSXattrHowCreate ) == 0 );
+
+    // The first get fills the cache, the second is answered from it
+    assert( HFS_fsOps.fsops_getxattr( psFile, pcAttrA, pcBuf, sizeof(pcBuf), &uSize ) == 0 );
+    assert( uSize == sizeof(pcFirst) && memcmp( pcBuf, pcFirst, uSize ) == 0 );
+    uHits = atomic_load( &gXattrCacheStat.hits );
+    assert( HFS_fsOps.fsops_getxattr( psFile, pcAttrA, pcBuf, sizeof(pcBuf), &uSize ) == 0 );
+    assert( uSize == sizeof(pcFirst) && memcmp( pcBuf, pcFirst, uSize ) == 0 );
+    assert( atomic_load( &gXattrCacheStat.hits ) == uHits + 1 );
+
+    // get -> set -> get returns the new value
+    uPurges = atomic_load( &gXattrCacheStat.purges );
+    assert( HFS_fsOps.fsops_setxattr( psFile, pcAttrA, pcSecond, sizeof(pcSecond), UVFSXattrHowReplace ) == 0 );
+    assert( atomic_load( &gXattrCacheStat.purges ) == uPurges + 1 );
+    assert( HFS_fsOps.fsops_getxattr( psFile, pcAttrA, pcBuf, sizeof(pcBuf), &uSize ) == 0 );
+    assert( uSize == sizeof(pcSecond) && memcmp( pcBuf, pcSecond, uSize ) == 0 );
+
+    // A complete list is cached; set and remove must still show up in it
+    assert( HFSTest_XattrListHas( psFile, pcAttrA ) );
+    assert( !HFSTest_XattrListHas( psFile, pcAttrB ) );
+    assert( HFS_fsOps.fsops_setxattr( psFile, pcAttrB, pcFirst, sizeof(pcFirst), UVFSXattrHowCreate ) == 0 );
+    assert( HFSTest_XattrListHas( psFile, pcAttrA ) );
+    assert( HFSTest_XattrListHas( psFile, pcAttrB ) );
+    assert( HFS_fsOps.fsops_setxattr( psFile, pcAttrA, NULL, 0, UVFSXattrHowRemove ) == 0 );
+    assert( !HFSTest_XattrListHas( psFile, pcAttrA ) );
+    assert( HFSTest_XattrListHas( psFile, pcAttrB ) );
+    assert( HFS_fsOps.fsops_getxattr( psFile, pcAttrA, pcBuf, sizeof(pcBuf), &uSize ) == ENOATTR );
+
+    // Cache B's value, then drop every attribute the way cnode teardown does
+    assert( HFS_fsOps.fsops_getxattr( psFile, pcAttrB, pcBuf, sizeof(pcBuf), &uSize ) == 0 );
+    uHits = atomic_load( &gXattrCacheStat.hits );
+    assert( HFS_fsOps.fsops_getxattr( psFile, pcAttrB, pcBuf, sizeof(pcBuf), &uSize ) == 0 );
+    assert( atomic_load( &gXattrCacheStat.hits ) == uHits + 1 );
+
+    struct vnode* vp        = (struct vnode*) psFile;
+    struct cnode* cp        = VTOC(vp);
+    struct hfsmount* hfsmp  = VTOHFS(vp);
+    bool bStartedTr         = false;
+
+    uPurges = atomic_load( &gXattrCacheStat.purges );
+    assert( hfs_lock( cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT ) == 0 );
+    hfs_xattr_cache_purge( cp );
+    assert( hfs_removeallattr( hfsmp, cp->c_fileid, &bStartedTr ) == 0 );
+    if ( bStartedTr )
+    {
+        hfs_end_transaction( hfsmp );
+    }
+    hfs_unlock( cp );
+    assert( atomic_load( &gXattrCacheStat.purges ) == uPurges + 1 );
+
+    // kHFSHasAttributesMask is still set, so the get reaches the cache and
+    // must miss it rather than return B's old value
+    uHits   = atomic_load( &gXattrCacheStat.hits );
+    uMisses = atomic_load( &gXattrCacheStat.misses );
+    assert( HFS_fsOps.fsops_getxattr( psFile, pcAttrB, pcBuf, sizeof(pcBuf), &uSize ) == ENOATTR );
+    assert( atomic_load( &gXattrCacheStat.hits ) == uHits );
+    assert( atomic_load( &gXattrCacheStat.misses ) == uMisses + 1 );
+
+    // Finish what teardown does so fsck sees a consistent record
+    assert( hfs_lock( cp, HFS_EXCLUSIVE_LOCK, HFS_LOCK_DEFAULT ) == 0 );
+    assert( hfs_start_transaction( hfsmp ) == 0 );
+    cp->c_attr.ca_recflags &= ~kHFSHasAttributesMask;
+    cp->c_flag |= C_MODIFIED;
+    assert( hfs_update( vp, 0 ) == 0 );
+    hfs_end_transaction( hfsmp );
+    hfs_unlock( cp );
+
+    HFS_fsOps.fsops_reclaim( psFile, 0 );
+    assert( RemoveFile( RootNode, "XattrCache" ) == 0 );
+
+    return 0;
+}
+
+static int __used
+HFSTest_ListXattr( UVFSFileNode RootNode )
+{
+    int iErr = 0;
+
+    UVFSFileNode TestFile = NULL;
+    iErr = HFS_fsOps.fsops_lookup( RootNode, "kl.test", &TestFile );
+    if ( iErr )
+    {
+        printf("Lookup err [%d]\n", iErr);
+        return iErr;
+    }
+
+    // Get required size
+    size_t actual_size = 0;
+    iErr = HFS_fsOps.fsops_listxattr(TestFile, NULL, 0, &actual_size);
+    if ( iErr )
+    {
+        printf("ListAttr err [%d]\n", iErr);
+        goto out;
+    }
+
+    // Get Attributes
+    size_t size = actual_size;
+    char *pcBuffer = malloc(size);
+    if ( pcBuffer == NULL )
+    {
+        iErr = ENOMEM;
+        goto out;
+    }
+
+    actual_size = 0;
+    iErr = HFS_fsOps.fsops_listxattr(TestFile, pcBuffer, size, &actual_size);
+    if ( iErr )
+    {
+        printf("ListAttr err [%d]\n", iErr);
+        goto mem_err;
+    }
+
+    // Just check it
+    assert(actual_size == size);
+
+    // Print Attributes Names
+    size_t attr_size = 0;
+    char *pcAttribues = pcBuffer;
+
+    while (attr_size < size)
+    {
+        // Get required size
+        actual_size = 0;
+        iErr = HFS_fsOps.fsops_getxattr(TestFile, pcAttribues, NULL, 0, &actual_size);
+        if ( iErr )
+        {
+            printf("GetAttr size err [%d]\n", iErr);
+            goto mem_err;
+        }
+
+        // Get Attributes
+        size_t bufsize = actual_size+1;
+        char *pcAttrBuffer = malloc(bufsize);
+        if ( pcAttrBuffer == NULL )
+        {
+            iErr = ENOMEM;
+            goto mem_err;
+        }
+        bzero(pcAttrBuffer, bufsize);
+
+        HFS_fsOps.fsops_getxattr(TestFile, pcAttribues, pcAttrBuffer, bufsize, &actual_size);
+        if ( iErr )
+        {
+            printf("GetAttr err [%d]\n", iErr);
+            free(pcAttrBuffer);
+            goto mem_err;
+        }
+
+        printf("Found attribute '%s' : %s\n", pcAttribues, pcAttrBuffer);
+
+        free(pcAttrBuffer);
+
+        size_t curr_attr_size = strlen(pcAttribues) + 1;
+
+        attr_size += curr_attr_size;
+        pcAttribues += curr_attr_size;
+    }
+
+mem_err:
+    free(pcBuffer);
+
+out:
+    // Reclaim test file
+    HFS_fsOps.fsops_reclaim(TestFile, 0);
+
+    return iErr;
+}
+
+/*
+ *  Tests List Struct.
+ */
+
+#if HFS_CRASH_TEST
+    #define ADD_TEST_WITH_CRASH_ABORT(testName, dmgPath, testHandler, CrashAbortType, CrashAbortCallback, CrashAbortCount)    \
+    { .pcTestName = testName, .pcDMGPath = dmgPath, .pfTestHandler = testHandler,                                             \
+      .eCrashID = CrashAbortType, .pAbortFunc = CrashAbortCallback,                                                           \
+      .uCrashAbortCnt = CrashAbortCount                                                                                       \
+    }
+#endif
+
+#define ADD_TEST(testName, dmgPath, testHandler)                              \
+{ .pcTestName = testName, .pcDMGPath = dmgPath, .pfTestHandler = testHandler, \
+}
+
+#define ADD_TEST_NO_SYNC(testName, dmgPath, testHandler)                      \
+{ .pcTestName = testName, .pcDMGPath = dmgPath, .pfTestHandler = testHandler, \
+}
+
+TestData_S  gsTestsData[] = {
+#if 1 // Enable non-journal tests
+    ADD_TEST( "HFSTest_JustMount",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_JustMount ),
+    ADD_TEST( "HFSTest_ReadDefragmentFile",      "/Volumes/SSD_Shared/FS_DMGs/HFSDeFragment.dmg",    &HFSTest_ReadDefragmentFile ),
+    ADD_TEST( "HFSTest_RemoveDir",               "/Volumes/SSD_Shared/FS_DMGs/HFSRemoveDir.dmg",     &HFSTest_RemoveDir ),
+    ADD_TEST( "HFSTest_Remove",                  "/Volumes/SSD_Shared/FS_DMGs/HFSRemove.dmg",        &HFSTest_Remove ),
+    ADD_TEST( "HFSTest_ReadDir",                 "/Volumes/SSD_Shared/FS_DMGs/HFSReadDir.dmg",       &HFSTest_ReadDir ),
+    ADD_TEST( "HFSTest_ReadDirAttr",             "/Volumes/SSD_Shared/FS_DMGs/HFSReadDir.dmg",       &HFSTest_ReadDirAttr ),
+    ADD_TEST( "HFSTest_MakeDir",                 "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_MakeDir ),
+    ADD_TEST( "HFSTest_SetAttr",                 "/Volumes/SSD_Shared/FS_DMGs/HFSSetAttr.dmg",       &HFSTest_SetAttr ),
+    ADD_TEST( "HFSTest_ReadSymLink",             "/Volumes/SSD_Shared/FS_DMGs/HFSReadSymLink.dmg",   &HFSTest_ReadSymlink ),
+    ADD_TEST( "HFSTest_GetFSAttr",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_GetFSAttr ),
+    ADD_TEST( "HFSTest_Create",                  "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_Create ),
+    ADD_TEST( "HFSTest_Symlink",                 "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_Symlink ),
+    ADD_TEST( "HFSTest_SymlinkOnFile",           "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_SymlinkOnFile ),
+    ADD_TEST( "HFSTest_Rename",                  "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_Rename ),
+    ADD_TEST( "HFSTest_WriteRead",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_WriteRead ),
+    ADD_TEST( "HFSTest_CopyFile",                "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_CopyFile ),
+    ADD_TEST( "HFSTest_RemoveTree",              "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_RemoveTree ),
+    ADD_TEST( "HFSTest_RemoveTreeRestart",       "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_RemoveTreeRestart ),
+    ADD_TEST( "HFSTest_CreateBatch",             "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_CreateBatch ),
+    ADD_TEST( "HFSTest_CNIDReuse",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_CNIDReuse ),
+    ADD_TEST( "HFSTest_ConcurrentLookup",        "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ConcurrentLookup ),
+    ADD_TEST( "HFSTest_ConcurrentReadDir",       "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ConcurrentReadDir ),
+    ADD_TEST( "HFSTest_DeferredUpdate",          "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_DeferredUpdate ),
+    ADD_TEST( "HFSTest_RandomIO",                "/Volumes/SSD_Shared/FS_DMGs/HFS100MB.dmg",         &HFSTest_RandomIO ),
+    ADD_TEST( "HFSTest_Create1000Files",         "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_Create1000Files ),
+    ADD_TEST( "HFSTest_HardLink",                "/Volumes/SSD_Shared/FS_DMGs/HFSHardLink.dmg",      &HFSTest_HardLink ),
+    ADD_TEST( "HFSTest_CreateHardLink",          "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_CreateHardLink ),
+    ADD_TEST( "HFSTest_RenameToHardlink",        "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_RenameToHardlink ),
+    ADD_TEST( "HFSTest_SetXattr",                "/Volumes/SSD_Shared/FS_DMGs/HFSXattr.dmg",         &HFSTest_SetXattr ),
+    ADD_TEST( "HFSTest_ListXattr",               "/Volumes/SSD_Shared/FS_DMGs/HFSXattr.dmg",         &HFSTest_ListXattr ),
+    ADD_TEST( "HFSTest_XattrCacheInvalidate",    "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_XattrCacheInvalidate ),
+    ADD_TEST( "HFSTest_RootFillUp",              "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_RootFillUp ),
+    ADD_TEST( "HFSTest_ScanDir",                 "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ScanDir ),
+    ADD_TEST( "HFSTest_MultiThreadedRW",         CREATE_HFS_DMG,                                     &HFSTest_MultiThreadedRW_wJournal ),
+    ADD_TEST( "HFSTest_ConcurrentOverwrite",     "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ConcurrentOverwrite ),
+    ADD_TEST( "HFSTest_JournalLifecycle",        CREATE_HFS_DMG,                                     &HFSTest_JournalLifecycle ),
+    ADD_TEST_NO_SYNC( "HFSTest_ValidateUnmount", "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ValidateUnmount ),
+    ADD_TEST( "HFSTest_ScanID",                  "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ScanID ),
+#endif
+#if 1 // Enbale journal-tests
+    ADD_TEST( "HFSTest_OpenJournal",                 "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_OpenJournal ),
+    ADD_TEST( "HFSTest_WriteToJournal",              "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_WriteToJournal ),
+    ADD_TEST( "HFSTest_JustMount_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_JustMount ),
+    ADD_TEST( "HFSTest_ReadDefragmentFile_wJournal", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-DeFragment.dmg",      &HFSTest_ReadDefragmentFile ),
+    ADD_TEST( "HFSTest_RemoveDir_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-RemoveDir.dmg",       &HFSTest_RemoveDir ),
+    ADD_TEST( "HFSTest_Remove_wJournal",             "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Remove.dmg",          &HFSTest_Remove ),
+    ADD_TEST( "HFSTest_ReadDir_wJournal",            "/Volumes/SSD_Shared/FS_DMGs/HFSJ-ReadDir.dmg",         &HFSTest_ReadDir ),
+    ADD_TEST( "HFSTest_ReadDirAttr_wJournal",        "/Volumes/SSD_Shared/FS_DMGs/HFSJ-ReadDir.dmg",         &HFSTest_ReadDirAttr ),
+    ADD_TEST( "HFSTest_MakeDir_wJournal",            "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_MakeDir ),
+    ADD_TEST( "HFSTest_SetAttr_wJournal",            "/Volumes/SSD_Shared/FS_DMGs/HFSJ-SetAttr.dmg",         &HFSTest_SetAttr ),
+    ADD_TEST( "HFSTest_ReadSymLink_wJournal",        "/Volumes/SSD_Shared/FS_DMGs/HFSJ-ReadSymLink.dmg",     &HFSTest_ReadSymlink ),
+    ADD_TEST( "HFSTest_GetFSAttr_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_GetFSAttr ),
+    ADD_TEST( "HFSTest_Create_wJournal",             "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_Create ),
+    ADD_TEST( "HFSTest_Symlink_wJournal",            "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_Symlink ),
+    ADD_TEST( "HFSTest_SymlinkOnFile",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",             &HFSTest_SymlinkOnFile ),
+    ADD_TEST( "HFSTest_Rename_wJournal",             "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_Rename ),
+    ADD_TEST( "HFSTest_WriteRead_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_WriteRead ),
+    ADD_TEST( "HFSTest_CopyFile_wJournal",           "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_CopyFile ),
+    ADD_TEST( "HFSTest_RemoveTree_wJournal",         "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_RemoveTree ),
+    ADD_TEST( "HFSTest_RemoveTreeRestart_wJournal",  "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_RemoveTreeRestart ),
+    ADD_TEST( "HFSTest_CreateBatch_wJournal",        "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_CreateBatch ),
+    ADD_TEST( "HFSTest_CNIDReuse_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_CNIDReuse ),
+    ADD_TEST( "HFSTest_ConcurrentLookup_wJournal",   "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_ConcurrentLookup ),
+    ADD_TEST( "HFSTest_ConcurrentReadDir_wJournal",  "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_ConcurrentReadDir ),
+    ADD_TEST( "HFSTest_DeferredUpdate_wJournal",     "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_DeferredUpdate ),
+    ADD_TEST( "HFSTest_ExternalJournal",             "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_ExternalJournal ),
+    ADD_TEST( "HFSTest_RandomIO_wJournal",           "/Volumes/SSD_Shared/FS_DMGs/HFSJ-144MB.dmg",           &HFSTest_RandomIO ),
+    ADD_TEST( "HFSTest_Create1000Files_wJournal",    "/Volumes/SSD_Shared/FS_DMGs/HFSJ-EmptyLarge.dmg",      &HFSTest_Create1000Files ),
+    ADD_TEST( "HFSTest_HardLink_wJournal",           "/Volumes/SSD_Shared/FS_DMGs/HFSJ-HardLink.dmg",        &HFSTest_HardLink ),
+    ADD_TEST( "HFSTest_CreateHardLink_wJournal",     "/Volumes/SSD_Shared/FS_DMGs/HFSJ-EmptyLarge.dmg",      &HFSTest_CreateHardLink ),
+    ADD_TEST( "HFSTest_RootFillUp_wJournal",         "/Volumes/SSD_Shared/FS_DMGs/HFSJ-EmptyLarge.dmg",      &HFSTest_RootFillUp ),
+    ADD_TEST( "HFSTest_XattrCacheInvalidate_wJournal", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",         &HFSTest_XattrCacheInvalidate ),
+    ADD_TEST( "HFSTest_MultiThreadedRW_wJournal",                "",                                         &HFSTest_MultiThreadedRW_wJournal ),
+    ADD_TEST( "HFSTest_ConcurrentOverwrite_wJournal",    "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",       &HFSTest_ConcurrentOverwrite ),
+    ADD_TEST( "HFSTest_DeleteAHugeDefragmentedFile_wJournal",    "",                                         &HFSTest_DeleteAHugeDefragmentedFile_wJournal ),
+    ADD_TEST( "HFSTest_CreateJournal_Sparse",                CREATE_SPARSE_VOLUME,                           &HFSTest_OpenJournal ),
+    ADD_TEST( "HFSTest_MakeDirAndKeep_Sparse",               CREATE_SPARSE_VOLUME,                           &HFSTest_MakeDirAndKeep ),
+    ADD_TEST( "HFSTest_CreateAndWriteToJournal_Sparse",      CREATE_SPARSE_VOLUME,                           &HFSTest_WriteToJournal ),
+    ADD_TEST( "HFSTest_MultiThreadedRW_wJournal_Sparse",     CREATE_SPARSE_VOLUME,                           &HFSTest_MultiThreadedRW_wJournal ),
+    ADD_TEST( "HFSTest_BackgroundScan_Sparse",               CREATE_SPARSE_VOLUME,                           &HFSTest_BackgroundScan ),
+    ADD_TEST( "HFSTest_ScanDir",                          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",      &HFSTest_ScanDir ),
+    ADD_TEST_NO_SYNC( "HFSTest_ValidateUnmount_wJournal", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",      &HFSTest_ValidateUnmount_wJournal ),
+    ADD_TEST( "HFSTest_Corrupted2ndDiskImage",            "/Volumes/SSD_Shared/FS_DMGs/corrupted_80M.dmg.sparseimage",
+                                                                                                             &HFSTest_Corrupted2ndDiskImage ),
+    ADD_TEST( "HFSTest_ScanID",                       "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",          &HFSTest_ScanID ),
+
+#endif
+#if HFS_CRASH_TEST
+    // The following 2 tests checks mount after unmount, no-journal
+    ADD_TEST_WITH_CRASH_ABORT( "HFSTest_OneSync", "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",
+                              &HFSTest_OneSync, CRASH_ABORT_RANDOM, HFSTest_SaveDMG, 0 ),
+    ADD_TEST( "HFSTest_ConfirmTestFolderExists", TEMP_DMG_BKUP, &HFSTest_ConfirmTestFolderExists ),
+
+    // The following 2 tests checks mount after unmount with journal
+    ADD_TEST_WITH_CRASH_ABORT( "HFSTest_OneSync_wJournal", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
+                              &HFSTest_OneSync, CRASH_ABORT_RANDOM, HFSTest_SaveDMG, 0 ),
+    ADD_TEST( "HFSTest_ConfirmTestFolderExists", TEMP_DMG_BKUP, &HFSTest_ConfirmTestFolderExists ),
+
+    ADD_TEST_WITH_CRASH_ABORT("HFSTest_OpenJournal_wCrashOnMakeDir", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
+                              &HFSTest_OpenJournal, CRASH_ABORT_MAKE_DIR, HFSTest_FailTestOnCrashAbort, 0),
+
+    ADD_TEST_WITH_CRASH_ABORT("HFSTest_OpenJournal_wCrashAfterBlockData", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
+                              &HFSTest_OpenJournal, CRASH_ABORT_JOURNAL_AFTER_BLOCK_DATA, HFSTest_CrashAbort, 0),
+
+    ADD_TEST_WITH_CRASH_ABORT("HFSTest_OpenJournal_wCrashAfterJournalData", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
+                              &HFSTest_OpenJournal, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_DATA, HFSTest_CrashAbort, 0),
+
+    ADD_TEST_WITH_CRASH_ABORT("HFSTest_OpenJournal_wCrashAfterJournalHeader", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
+                              &HFSTest_OpenJournal, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_HEADER, HFSTest_CrashAbort, 0),
+
+    ADD_TEST_WITH_CRASH_ABORT("MultiThreadedRW_wJournal_RandomCrash", CREATE_SPARSE_VOLUME,
+                              &MultiThreadedRW_wJournal_RandomCrash, CRASH_ABORT_RANDOM, HFSTest_CrashAbortAtRandom, 0),
+
+    // The following 2 tests check journal replay, make sure the drive is mountable, and the created fonder DOES exist
+    ADD_TEST_WITH_CRASH_ABORT("HFSTest_MakeDirAndKeep_wCrashAfterJournalHeader", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
+                              &HFSTest_MakeDirAndKeep, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_HEADER, HFSTest_CrashAbortOnMkDir, 0),
+    ADD_TEST( "HFSTest_ConfirmTestFolderExists", TEMP_DMG_BKUP, &HFSTest_ConfirmTestFolderExists ),
+
+    // The following 2 tests check journal replay, make sure the drive is mountable, and the created fonder does NOT exist
+    ADD_TEST_WITH_CRASH_ABORT("HFSTest_MakeDirAndKeep_wCrashAfterJournalData", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
+                              &HFSTest_MakeDirAndKeep, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_DATA, HFSTest_CrashAbortOnMkDir, 0),
+    ADD_TEST( "HFSTest_ConfirmTestFolderDoesntExists", TEMP_DMG_BKUP, &HFSTest_ConfirmTestFolderDoesntExists ),
+
+    // The following 2 tests check journal replay, make sure the drive is mountable, and the created fonder DOES exist
+    ADD_TEST_WITH_CRASH_ABORT("HFSTest_MakeDirAndKeep_wCrashAfterJournalHeader_Sparse", CREATE_SPARSE_VOLUME,
+                              &HFSTest_MakeDirAndKeep, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_HEADER, HFSTest_CrashAbortOnMkDir, 1),
+    ADD_TEST( "HFSTest_ConfirmTestFolderExists", TEMP_DMG_BKUP_SPARSE, &HFSTest_ConfirmTestFolderExists ),
+#endif
+
+};
+
+void *SyncerThread(void *pvArgs) {
+    
+    int iErr = 0;
+    TestData_S *psTestData = pvArgs;
+    
+    printf("Syncer Thread runs every %u mS\n", guSyncerPeriod);
+    
+    while(psTestData->bSyncerOn) {
+        usleep(guSyncerPeriod * 1000);
+        iErr = HFS_fsOps.fsops_sync(psTestData->psRootNode);
+        psTestData->uSyncerCount++;
+        if (iErr) {
+            printf("fsops_sync returned %d\n", iErr);
+            break;
+        }
+    }
+    
+    TesterThreadReturnStatus_S *psReturnStatus = malloc(sizeof(TesterThreadReturnStatus_S));
+    assert(psReturnStatus);
+    memset(psReturnStatus, 0, sizeof(*psReturnStatus));
+    
+    printf("Syncer returns %d\n", iErr);
+    
+    psReturnStatus->iErr = iErr;
+    
+    return((void*)psReturnStatus);
+}
+
+static int KickOffSyncerThread(TestData_S *psTestData) {
+
+    int iErr = 0;
+    
+    if (guSyncerPeriod == 0) {
+        goto exit;
+    }
+    psTestData->bSyncerOn = true;
+    
+    pthread_attr_t sAttr;
+    pthread_attr_init(&sAttr);
+    pthread_attr_setdetachstate(&sAttr, PTHREAD_CREATE_JOINABLE);
+    
+    iErr = pthread_create(&psTestData->sSyncerThread, &sAttr, SyncerThread, psTestData);
+    
+    pthread_attr_destroy(&sAttr);
+
+exit:
+    return(iErr);
+}
+
+static int ShutdownSyncerThread(TestData_S *psTestData) {
+    
+    int iErr = 0;
+    TesterThreadReturnStatus_S *psReturnStatus = NULL;
+
+    if (guSyncerPeriod == 0) {
+        goto exit;
+    }
+    
+    psTestData->bSyncerOn = false;
+    iErr = pthread_join(psTestData->sSyncerThread, (void*)&psReturnStatus);
+    if (iErr) {
+        printf("Error waiting for Syncer thread! %d\n", iErr);
+        goto exit;
+    }
+    
+    printf("Syncer Thead ran %u times (iErr %d)\n", psTestData->uSyncerCount, iErr);
+
+    assert(psReturnStatus);
+
+    iErr = psReturnStatus->iErr;
+    if (iErr) {
+        printf("Syncer thread returned iErr = %d\n", iErr);
+        goto exit;
+    }
+
+exit:
+    if (psReturnStatus) {
+        free(psReturnStatus);
+    }
+        
+    return(iErr);
+}
+
+/*
+ * Unmount the volume of the running test and mount it again from the same
+ * device, so that whatever the test checks next is read back from disk.
+ */
+static int HFSTest_Unmount(UVFSFileNode* ppsRootNode) {
+    int iErr = ShutdownSyncerThread(gpsTestData);
+    if (iErr) {
+        return(iErr);
+    }
+
+    iErr = HFS_fsOps.fsops_unmount(*ppsRootNode, UVFSUnmountHintNone);
+    printf("Remount: UnMount err [%d]\n", iErr);
+    *ppsRootNode = gpsTestData->psRootNode = NULL;
+    return(iErr);
+}
+
+static int HFSTest_Mount(UVFSFileNode* ppsRootNode) {
+    UVFSScanVolsRequest sScanVolsReq = {0};
+    UVFSScanVolsReply sScanVolsReply = {0};
+
+    int iErr = HFS_fsOps.fsops_taste(giFD);
+    if (!iErr) {
+        iErr = HFS_fsOps.fsops_scanvols(giFD, &sScanVolsReq, &sScanVolsReply);
+    }
+    if (!iErr) {
+        iErr = HFS_fsOps.fsops_mount(giFD, sScanVolsReply.sr_volid, 0, NULL, ppsRootNode);
+    }
+    printf("Remount: Mount err [%d]\n", iErr);
+    if (iErr) {
+        return(iErr);
+    }
+
+    gpsTestData->psRootNode = *ppsRootNode;
+    return(KickOffSyncerThread(gpsTestData));
+}
+
+static int HFSTest_Remount(UVFSFileNode* ppsRootNode) {
+    int iErr = HFSTest_Unmount(ppsRootNode);
+    if (!iErr) {
+        iErr = HFSTest_Mount(ppsRootNode);
+    }
+    return(iErr);
+}
+
+static int HFSTest_RunTest(TestData_S *psTestData) {
+    UVFSScanVolsRequest sScanVolsReq = {0};
+    UVFSScanVolsReply sScanVolsReply = {0};
+    int iErr = 0;
+    int iFD = HFSTest_PrepareEnv( psTestData );
+    giFD = iFD;
+    gpsTestData = psTestData;
+
+    LFHFS_StatsReset();
+    LFHFS_TraceReset();
+
+    iErr = HFS_fsOps.fsops_taste( iFD );
+    printf("Taste err [%d]\n",iErr);
+    if ( iErr ) {
+        close(iFD);
+        HFSTest_DestroyEnv( iFD );
+        return(iErr);
+    }
+
+    iErr = HFS_fsOps.fsops_scanvols( iFD, &sScanVolsReq, &sScanVolsReply );
+    printf("ScanVols err [%d]\n", iErr);
+    if ( iErr )
+    {
+        close(iFD);
+        HFSTest_DestroyEnv( iFD );
+        return(iErr);
+    }
+
+    UVFSFileNode RootNode = NULL;
+    iErr = HFS_fsOps.fsops_mount( iFD, sScanVolsReply.sr_volid, 0, NULL, &RootNode );
+    printf("Mount err [%d]\n", iErr);
+    if ( iErr )
+    {
+        close(iFD);
+        HFSTest_DestroyEnv( iFD );
+        return(iErr);
+    }
+    
+    psTestData->psRootNode = RootNode;
+    iErr = KickOffSyncerThread(psTestData);
+    if ( iErr ) {
+        close(iFD);
+        HFSTest_DestroyEnv( iFD );
+        return(iErr);
+    }
+
+    // Execute the test
+    iErr = psTestData->pfTestHandler( RootNode );
+    printf("Test [%s] finish with error code [%d]\n", psTestData->pcTestName, iErr);
+    #if HFS_CRASH_TEST
+    if (psTestData->eCrashID == CRASH_ABORT_NONE)
+    #endif
+        if ( iErr ) {
+            close(iFD);
+            HFSTest_DestroyEnv( iFD );
+            return(iErr);
+        }
+
+    iErr = ShutdownSyncerThread(psTestData);
+    if ( iErr ) {
+        close(iFD);
+        HFSTest_DestroyEnv( iFD );
+        return(iErr);
+    }
+    
+    // The test may have remounted the volume (HFSTest_Remount)
+    RootNode = psTestData->psRootNode;
+    iErr = HFS_fsOps.fsops_unmount(RootNode, UVFSUnmountHintNone);
+    printf("UnMount err [%d]\n", iErr);
+    if ( iErr ) {
+        close(iFD);
+        HFSTest_DestroyEnv( iFD );
+        return(iErr);
+    }
+    
+    HFSTest_PrintCacheStats();
+    HFSTest_PrintOpStats();
+    HFSTest_DumpTrace(psTestData->pcTestName);
+    
+    #if HFS_CRASH_TEST
+        if (psTestData->eCrashID != CRASH_ABORT_NONE) {
+            
+            // Execute post crash analysis
+            iErr = psTestData->pAbortFunc(psTestData,
+                                          gsCrashReport.eCrashID,
+                                          iFD,
+                                          gsCrashReport.psNode,
+                                          gsCrashReport.pSyncerThread);
+            
+            printf("Analysis [%s] finished with error code [%d]\n", psTestData->pcTestName, iErr);
+            
+            if (iErr) {
+                HFSTest_DestroyEnv( iFD );
+                return(iErr);
+            }
+        } else
+    #endif
+        {
+            // close file
+            close(iFD);
+            
+            //assert(gCacheStat.buf_cache_size == 0);
+            
+            // Run fsck
+            char pcFsckCmd[512] = {0};
+            strcat( pcFsckCmd, PATH_TO_FSCK);
+            strcat( pcFsckCmd, " -fd /dev/disk");
+
+            strcat( pcFsckCmd, pcLastDevPathName );
+            if (pcDevNum[0] != '\0') {
+                strcat( pcFsckCmd, "s" );
+                strcat( pcFsckCmd, pcDevNum );
+            }
+            printf("Execute %s\n", pcFsckCmd);
+            iErr = system( pcFsckCmd );
+            if ( iErr )
+            {
+                printf( "*** Fsck CMD failed! (%d)\n", iErr);
+                HFSTest_DestroyEnv( iFD );
+                return(iErr);
+            } else {
+                printf( "*** Fsck CMD succeeded!\n");
+            }
+
+            HFSTest_DestroyEnv( iFD );
+        }
+    return(iErr);
+}
+
+#if HFS_CRASH_TEST
+int HFSTest_CrashAbort_Hanlder(CrashAbort_E eAbort, int iFD, UVFSFileNode psNode, pthread_t pSyncerThread) {
+    printf("HFSTest_CrashAbort_Hanlder (%u):\n", guCrashAbortCnt);
+    if (guCrashAbortCnt) {
+        guCrashAbortCnt--;
+        return(0);
+    }
+
+    close(iFD); // prevent additional writes to media
+    if (pSyncerThread == pthread_self()) {
+        printf("Crash Abort on Syncer Thread!\n");
+    }
+    
+    gsCrashReport.uCrashCount++;
+    gsCrashReport.eCrashID      = eAbort;
+    gsCrashReport.iFD           = iFD;
+    gsCrashReport.psNode        = psNode;
+    gsCrashReport.pSyncerThread = pSyncerThread;
+    
+    return(0);
+}
+#endif
+
+
+int hfs_tester_run_fsck(void)
+{
+    // Journaled
+    int iErr = HFS_fsOps.fsops_init();
+    printf("Init err [%d]\n",iErr);
+    if (iErr)
+        exit(-1);
+    
+    TestData_S sTestData = {
+        .pcTestName = "hfs_tester_run_fsck",
+        .pcDMGPath  = "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
+    };
 
-#if HFS_CRASH_TEST
-    #define ADD_TEST_WITH_CRASH_ABORT(testName, dmgPath, testHandler, CrashAbortType, CrashAbortCallback, CrashAbortCount)    \
-    { .pcTestName = testName, .pcDMGPath = dmgPath, .pfTestHandler = testHandler,                                             \
-      .eCrashID = CrashAbortType, .pAbortFunc = CrashAbortCallback,                                                           \
-      .uCrashAbortCnt = CrashAbortCount                                                                                       \
+    int iFD = HFSTest_PrepareEnv(&sTestData);
+    
+    iErr = HFS_fsOps.fsops_taste( iFD );
+    printf("Taste err [%d]\n",iErr);
+    if ( iErr ) {
+        close(iFD);
+        HFSTest_DestroyEnv( iFD );
+        return(iErr);
     }
-#endif
+    
+    iErr = HFS_fsOps.fsops_check(iFD, 0, NULL, QUICK_CHECK);
+    printf("Check err [%d]\n",iErr);
+    if (iErr)
+        exit(-1);
+    
+    close(iFD);
+    HFSTest_DestroyEnv( iFD );
 
-#define ADD_TEST(testName, dmgPath, testHandler)                              \
-{ .pcTestName = testName, .pcDMGPath = dmgPath, .pfTestHandler = testHandler, \
+    // Non-Journaled
+    iErr = HFS_fsOps.fsops_init();
+    printf("Init err [%d]\n",iErr);
+    if (iErr)
+        exit(-1);
+    
+    sTestData.pcDMGPath  = "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg";
+    
+    iFD = HFSTest_PrepareEnv(&sTestData);
+    
+    iErr = HFS_fsOps.fsops_taste( iFD );
+    printf("Taste err [%d]\n",iErr);
+    if ( iErr ) {
+        close(iFD);
+        HFSTest_DestroyEnv( iFD );
+        return(iErr);
+    }
+    
+    iErr = HFS_fsOps.fsops_check(iFD, 0, NULL, QUICK_CHECK);
+    printf("Check err [%d]\n",iErr);
+    if (iErr)
+        exit(-1);
+    
+    close(iFD);
+    HFSTest_DestroyEnv( iFD );
+    return iErr;
 }
 
-#define ADD_TEST_NO_SYNC(testName, dmgPath, testHandler)                      \
-{ .pcTestName = testName, .pcDMGPath = dmgPath, .pfTestHandler = testHandler, \
+int hfs_tester_run(uint32_t uFirstTest, uint32_t uLastTest)
+{
+    uint32_t uTestRan = 0;
+    int iErr = HFS_fsOps.fsops_init();
+    printf("Init err [%d]\n",iErr);
+    if (iErr)
+        exit(-1);
+    
+    uint32_t uAvailTests = sizeof(gsTestsData)/sizeof(gsTestsData[0]);
+    if ((!uLastTest) ||
+        (uLastTest > uAvailTests)) {
+        
+        uLastTest = uAvailTests;
+    }
+    
+    for ( unsigned uTestNum=uFirstTest; uTestNum < uLastTest ; uTestNum++ )
+    {
+        printf("******************************************************************************************\n");
+        printf("**** about to run test [%s] [%u] \n", gsTestsData[uTestNum].pcTestName, uTestNum);
+        printf("******************************************************************************************\n");
+        
+        #if HFS_CRASH_TEST
+            HFSTest_ClearCrashAbortFunctionArray();
+        
+            if (gsTestsData[uTestNum].eCrashID) {
+                // Inject Crach condition
+                CrashAbort_E eCrashID = gsTestsData[uTestNum].eCrashID;
+                printf( "Adding Crash-Abort Function at (%u), %s.\n", eCrashID, ppcCrashAbortDesc[eCrashID] );
+                guCrashAbortCnt = gsTestsData[uTestNum].uCrashAbortCnt;
+                gpsCrashAbortFunctionArray[eCrashID] = HFSTest_CrashAbort_Hanlder;
+                memset(&gsCrashReport, 0, sizeof(gsCrashReport));
+            }
+        #endif
+                
+        iErr = HFSTest_RunTest(&gsTestsData[uTestNum]);
+
+        if (iErr) {
+            exit(-1);
+        }
+        uTestRan++;
+    }
+
+    HFS_fsOps.fsops_fini();
+    
+    printf("*** Run %u out of %u tests successfully\n", uTestRan, uAvailTests);
+
+    return 0;
 }
 
-TestData_S  gsTestsData[] = {
-#if 1 // Enable non-journal tests
-    ADD_TEST( "HFSTest_JustMount",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_JustMount ),
-    ADD_TEST( "HFSTest_ReadDefragmentFile",      "/Volumes/SSD_Shared/FS_DMGs/HFSDeFragment.dmg",    &HFSTest_ReadDefragmentFile ),
-    ADD_TEST( "HFSTest_RemoveDir",               "/Volumes/SSD_Shared/FS_DMGs/HFSRemoveDir.dmg",     &HFSTest_RemoveDir ),
-    ADD_TEST( "HFSTest_Remove",                  "/Volumes/SSD_Shared/FS_DMGs/HFSRemove.dmg",        &HFSTest_Remove ),
-    ADD_TEST( "HFSTest_ReadDir",                 "/Volumes/SSD_Shared/FS_DMGs/HFSReadDir.dmg",       &HFSTest_ReadDir ),
-    ADD_TEST( "HFSTest_ReadDirAttr",             "/Volumes/SSD_Shared/FS_DMGs/HFSReadDir.dmg",       &HFSTest_ReadDirAttr ),
-    ADD_TEST( "HFSTest_MakeDir",                 "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_MakeDir ),
-    ADD_TEST( "HFSTest_SetAttr",                 "/Volumes/SSD_Shared/FS_DMGs/HFSSetAttr.dmg",       &HFSTest_SetAttr ),
-    ADD_TEST( "HFSTest_ReadSymLink",             "/Volumes/SSD_Shared/FS_DMGs/HFSReadSymLink.dmg",   &HFSTest_ReadSymlink ),
-    ADD_TEST( "HFSTest_GetFSAttr",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_GetFSAttr ),
-    ADD_TEST( "HFSTest_Create",                  "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_Create ),
-    ADD_TEST( "HFSTest_Symlink",                 "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_Symlink ),
-    ADD_TEST( "HFSTest_SymlinkOnFile",           "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_SymlinkOnFile ),
-    ADD_TEST( "HFSTest_Rename",                  "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_Rename ),
-    ADD_TEST( "HFSTest_WriteRead",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_WriteRead ),
-    ADD_TEST( "HFSTest_RandomIO",                "/Volumes/SSD_Shared/FS_DMGs/HFS100MB.dmg",         &HFSTest_RandomIO ),
-    ADD_TEST( "HFSTest_Create1000Files",         "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_Create1000Files ),
-    ADD_TEST( "HFSTest_HardLink",                "/Volumes/SSD_Shared/FS_DMGs/HFSHardLink.dmg",      &HFSTest_HardLink ),
-    ADD_TEST( "HFSTest_CreateHardLink",          "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_CreateHardLink ),
-    ADD_TEST( "HFSTest_RenameToHardlink",        "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_RenameToHardlink ),
-    ADD_TEST( "HFSTest_SetXattr",                "/Volumes/SSD_Shared/FS_DMGs/HFSXattr.dmg",         &HFSTest_SetXattr ),
-    ADD_TEST( "HFSTest_ListXattr",               "/Volumes/SSD_Shared/FS_DMGs/HFSXattr.dmg",         &HFSTest_ListXattr ),
-    ADD_TEST( "HFSTest_RootFillUp",              "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_RootFillUp ),
-    ADD_TEST( "HFSTest_ScanDir",                 "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ScanDir ),
-    ADD_TEST( "HFSTest_MultiThreadedRW",         CREATE_HFS_DMG,                                     &HFSTest_MultiThreadedRW_wJournal ),
-    ADD_TEST_NO_SYNC( "HFSTest_ValidateUnmount", "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ValidateUnmount ),
-    ADD_TEST( "HFSTest_ScanID",                  "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",         &HFSTest_ScanID ),
-#endif
-#if 1 // Enbale journal-tests
-    ADD_TEST( "HFSTest_OpenJournal",                 "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_OpenJournal ),
-    ADD_TEST( "HFSTest_WriteToJournal",              "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_WriteToJournal ),
-    ADD_TEST( "HFSTest_JustMount_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_JustMount ),
-    ADD_TEST( "HFSTest_ReadDefragmentFile_wJournal", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-DeFragment.dmg",      &HFSTest_ReadDefragmentFile ),
-    ADD_TEST( "HFSTest_RemoveDir_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-RemoveDir.dmg",       &HFSTest_RemoveDir ),
-    ADD_TEST( "HFSTest_Remove_wJournal",             "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Remove.dmg",          &HFSTest_Remove ),
-    ADD_TEST( "HFSTest_ReadDir_wJournal",            "/Volumes/SSD_Shared/FS_DMGs/HFSJ-ReadDir.dmg",         &HFSTest_ReadDir ),
-    ADD_TEST( "HFSTest_ReadDirAttr_wJournal",        "/Volumes/SSD_Shared/FS_DMGs/HFSJ-ReadDir.dmg",         &HFSTest_ReadDirAttr ),
-    ADD_TEST( "HFSTest_MakeDir_wJournal",            "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_MakeDir ),
-    ADD_TEST( "HFSTest_SetAttr_wJournal",            "/Volumes/SSD_Shared/FS_DMGs/HFSJ-SetAttr.dmg",         &HFSTest_SetAttr ),
-    ADD_TEST( "HFSTest_ReadSymLink_wJournal",        "/Volumes/SSD_Shared/FS_DMGs/HFSJ-ReadSymLink.dmg",     &HFSTest_ReadSymlink ),
-    ADD_TEST( "HFSTest_GetFSAttr_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_GetFSAttr ),
-    ADD_TEST( "HFSTest_Create_wJournal",             "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_Create ),
-    ADD_TEST( "HFSTest_Symlink_wJournal",            "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_Symlink ),
-    ADD_TEST( "HFSTest_SymlinkOnFile",               "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",             &HFSTest_SymlinkOnFile ),
-    ADD_TEST( "HFSTest_Rename_wJournal",             "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_Rename ),
-    ADD_TEST( "HFSTest_WriteRead_wJournal",          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",           &HFSTest_WriteRead ),
-    ADD_TEST( "HFSTest_RandomIO_wJournal",           "/Volumes/SSD_Shared/FS_DMGs/HFSJ-144MB.dmg",           &HFSTest_RandomIO ),
-    ADD_TEST( "HFSTest_Create1000Files_wJournal",    "/Volumes/SSD_Shared/FS_DMGs/HFSJ-EmptyLarge.dmg",      &HFSTest_Create1000Files ),
-    ADD_TEST( "HFSTest_HardLink_wJournal",           "/Volumes/SSD_Shared/FS_DMGs/HFSJ-HardLink.dmg",        &HFSTest_HardLink ),
-    ADD_TEST( "HFSTest_CreateHardLink_wJournal",     "/Volumes/SSD_Shared/FS_DMGs/HFSJ-EmptyLarge.dmg",      &HFSTest_CreateHardLink ),
-    ADD_TEST( "HFSTest_RootFillUp_wJournal",         "/Volumes/SSD_Shared/FS_DMGs/HFSJ-EmptyLarge.dmg",      &HFSTest_RootFillUp ),
-    ADD_TEST( "HFSTest_MultiThreadedRW_wJournal",                "",                                         &HFSTest_MultiThreadedRW_wJournal ),
-    ADD_TEST( "HFSTest_DeleteAHugeDefragmentedFile_wJournal",    "",                                         &HFSTest_DeleteAHugeDefragmentedFile_wJournal ),
-    ADD_TEST( "HFSTest_CreateJournal_Sparse",                CREATE_SPARSE_VOLUME,                           &HFSTest_OpenJournal ),
-    ADD_TEST( "HFSTest_MakeDirAndKeep_Sparse",               CREATE_SPARSE_VOLUME,                           &HFSTest_MakeDirAndKeep ),
-    ADD_TEST( "HFSTest_CreateAndWriteToJournal_Sparse",      CREATE_SPARSE_VOLUME,                           &HFSTest_WriteToJournal ),
-    ADD_TEST( "HFSTest_MultiThreadedRW_wJournal_Sparse",     CREATE_SPARSE_VOLUME,                           &HFSTest_MultiThreadedRW_wJournal ),
-    ADD_TEST( "HFSTest_ScanDir",                          "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",      &HFSTest_ScanDir ),
-    ADD_TEST_NO_SYNC( "HFSTest_ValidateUnmount_wJournal", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",      &HFSTest_ValidateUnmount_wJournal ),
-    ADD_TEST( "HFSTest_Corrupted2ndDiskImage",            "/Volumes/SSD_Shared/FS_DMGs/corrupted_80M.dmg.sparseimage",
-                                                                                                             &HFSTest_Corrupted2ndDiskImage ),
-    ADD_TEST( "HFSTest_ScanID",                       "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",          &HFSTest_ScanID ),
+/*******************************************/
+/*******************************************/
+/*******************************************/
+// Benchmarks START.
+/*******************************************/
+/*******************************************/
+/*******************************************/
 
-#endif
-#if HFS_CRASH_TEST
-    // The following 2 tests checks mount after unmount, no-journal
-    ADD_TEST_WITH_CRASH_ABORT( "HFSTest_OneSync", "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg",
-                              &HFSTest_OneSync, CRASH_ABORT_RANDOM, HFSTest_SaveDMG, 0 ),
-    ADD_TEST( "HFSTest_ConfirmTestFolderExists", TEMP_DMG_BKUP, &HFSTest_ConfirmTestFolderExists ),
+/*
+ * RUN_HFS_BENCH runs a fixed, seeded set of metadata and data workloads on a
+ * freshly created sparse volume and writes the results as JSON. All parameters
+ * are compile-time constants so that two runs (or two builds) are comparable.
+ */
+#define BENCH_VERSION           (1)
+#define BENCH_DEFAULT_OUTPUT    "/tmp/hfstester_bench.json"
+#define BENCH_SEED              (0x48465342) // "HFSB"
+#define BENCH_MAX_THREADS       (8)
+#define BENCH_DATA_FILE_SIZE    (64*1024*1024ULL)
+#define BENCH_SEQ_IO_SIZE       (1024*1024)
+#define BENCH_RAND_IO_SIZE      (4*1024)
+#define BENCH_RAND_IO_OPS       (4096)
+#define BENCH_REPLAY_FILES      (2000)
+#define BENCH_READDIR_BUF_SIZE  (32*1024)
+
+static const uint32_t gpuBenchThreads[]  = { 1, 2, 4, 8 };
+static const uint32_t gpuBenchDirSizes[] = { 100, 1000, 10000 };
 
-    // The following 2 tests checks mount after unmount with journal
-    ADD_TEST_WITH_CRASH_ABORT( "HFSTest_OneSync_wJournal", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
-                              &HFSTest_OneSync, CRASH_ABORT_RANDOM, HFSTest_SaveDMG, 0 ),
-    ADD_TEST( "HFSTest_ConfirmTestFolderExists", TEMP_DMG_BKUP, &HFSTest_ConfirmTestFolderExists ),
+typedef struct {
+    UVFSFileNode    psDirNode;
+    UVFSFileNode    psFileNode;
+    uint32_t        uThreadNum;
+    uint32_t        uFirstEntry;
+    uint32_t        uNumOfEntries;
+    uint64_t        uOps;           // Entries or bytes processed by the last phase
+    unsigned short  pusRandState[3];
+    void*           pvBuf;
+    int             iErr;
+} BenchThreadData_S;
+
+typedef void* (*BenchPhase_FP)(void* pvArgs);
+
+static uint64_t HFSBench_NowNs(void) {
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
 
-    ADD_TEST_WITH_CRASH_ABORT("HFSTest_OpenJournal_wCrashOnMakeDir", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
-                              &HFSTest_OpenJournal, CRASH_ABORT_MAKE_DIR, HFSTest_FailTestOnCrashAbort, 0),
+static double HFSBench_PerSec(uint64_t uOps, uint64_t uNs) {
+    return uNs ? ((double)uOps * 1e9 / (double)uNs) : 0.0;
+}
 
-    ADD_TEST_WITH_CRASH_ABORT("HFSTest_OpenJournal_wCrashAfterBlockData", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
-                              &HFSTest_OpenJournal, CRASH_ABORT_JOURNAL_AFTER_BLOCK_DATA, HFSTest_CrashAbort, 0),
+static double HFSBench_MBPerSec(uint64_t uBytes, uint64_t uNs) {
+    return HFSBench_PerSec(uBytes, uNs) / (1024.0 * 1024.0);
+}
 
-    ADD_TEST_WITH_CRASH_ABORT("HFSTest_OpenJournal_wCrashAfterJournalData", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
-                              &HFSTest_OpenJournal, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_DATA, HFSTest_CrashAbort, 0),
+static double HFSBench_Ms(uint64_t uNs) {
+    return (double)uNs / 1e6;
+}
 
-    ADD_TEST_WITH_CRASH_ABORT("HFSTest_OpenJournal_wCrashAfterJournalHeader", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
-                              &HFSTest_OpenJournal, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_HEADER, HFSTest_CrashAbort, 0),
+static void HFSBench_SeedThread(BenchThreadData_S *psThrdData) {
+    psThrdData->pusRandState[0] = (unsigned short)(BENCH_SEED & 0xFFFF);
+    psThrdData->pusRandState[1] = (unsigned short)(BENCH_SEED >> 16);
+    psThrdData->pusRandState[2] = (unsigned short)psThrdData->uThreadNum;
+}
 
-    ADD_TEST_WITH_CRASH_ABORT("MultiThreadedRW_wJournal_RandomCrash", CREATE_SPARSE_VOLUME,
-                              &MultiThreadedRW_wJournal_RandomCrash, CRASH_ABORT_RANDOM, HFSTest_CrashAbortAtRandom, 0),
+static void HFSBench_EntryName(char *pcName, size_t uSize, char cPrefix, BenchThreadData_S *psThrdData, uint32_t uEntry) {
+    snprintf(pcName, uSize, "%c_%u_%u", cPrefix, psThrdData->uThreadNum, psThrdData->uFirstEntry + uEntry);
+}
+
+static void* HFSBench_CreateThread(void *pvArgs) {
+    BenchThreadData_S *psThrdData = pvArgs;
+    char pcName[64];
+
+    for (uint32_t u = 0; u < psThrdData->uNumOfEntries; u++) {
+        UVFSFileNode psNode = NULL;
+        HFSBench_EntryName(pcName, sizeof(pcName), 'f', psThrdData, u);
+        psThrdData->iErr = CreateNewFile(psThrdData->psDirNode, &psNode, pcName, 0);
+        if (psThrdData->iErr) {
+            printf("Bench: failed to create %s (%d)\n", pcName, psThrdData->iErr);
+            break;
+        }
+        HFS_fsOps.fsops_reclaim(psNode, 0);
+        psThrdData->uOps++;
+    }
+
+    return psThrdData;
+}
+
+static void* HFSBench_LookupThread(void *pvArgs) {
+    BenchThreadData_S *psThrdData = pvArgs;
+    char pcName[64];
+
+    for (uint32_t u = 0; u < psThrdData->uNumOfEntries; u++) {
+        UVFSFileNode psNode = NULL;
+        HFSBench_EntryName(pcName, sizeof(pcName), 'f', psThrdData, u);
+        psThrdData->iErr = HFS_fsOps.fsops_lookup(psThrdData->psDirNode, pcName, &psNode);
+        if (psThrdData->iErr) {
+            printf("Bench: failed to lookup %s (%d)\n", pcName, psThrdData->iErr);
+            break;
+        }
+        HFS_fsOps.fsops_reclaim(psNode, 0);
+        psThrdData->uOps++;
+    }
+
+    return psThrdData;
+}
+
+// Every thread reads the whole directory; uOps counts the entries returned.
+static void* HFSBench_ReadDirThread(void *pvArgs) {
+    BenchThreadData_S *psThrdData = pvArgs;
+    uint8_t *puBuf = psThrdData->pvBuf;
+    uint64_t uCookie = 0;
+    uint64_t uVerifier = UVFS_DIRCOOKIE_VERIFIER_INITIAL;
+    bool bDone = false;
+
+    while (!bDone) {
+        size_t uOutLen = 0;
+        int iErr = HFS_fsOps.fsops_readdir(psThrdData->psDirNode, puBuf, BENCH_READDIR_BUF_SIZE, uCookie, &uOutLen, &uVerifier);
+        if (iErr == UVFS_READDIR_EOF_REACHED || (iErr == 0 && uOutLen == 0)) {
+            break;
+        }
+        if (iErr) {
+            printf("Bench: readdir failed (%d)\n", iErr);
+            psThrdData->iErr = iErr;
+            break;
+        }
+
+        for (size_t uOffset = 0; uOffset < uOutLen; ) {
+            UVFSDirEntry *psEntry = (UVFSDirEntry *)&puBuf[uOffset];
+            psThrdData->uOps++;
+            uCookie = psEntry->de_nextcookie;
+            if (uCookie == UVFS_DIRCOOKIE_EOF) {
+                bDone = true;
+            }
+            if (bDone || psEntry->de_reclen == 0) {
+                break;
+            }
+            uOffset += psEntry->de_reclen;
+        }
+    }
+
+    return psThrdData;
+}
+
+static void* HFSBench_RenameThread(void *pvArgs) {
+    BenchThreadData_S *psThrdData = pvArgs;
+    char pcFromName[64];
+    char pcToName[64];
+
+    for (uint32_t u = 0; u < psThrdData->uNumOfEntries; u++) {
+        HFSBench_EntryName(pcFromName, sizeof(pcFromName), 'f', psThrdData, u);
+        HFSBench_EntryName(pcToName, sizeof(pcToName), 'r', psThrdData, u);
+        psThrdData->iErr = RenameFile(psThrdData->psDirNode, NULL, pcFromName, psThrdData->psDirNode, NULL, pcToName);
+        if (psThrdData->iErr) {
+            printf("Bench: failed to rename %s to %s (%d)\n", pcFromName, pcToName, psThrdData->iErr);
+            break;
+        }
+        psThrdData->uOps++;
+    }
+
+    return psThrdData;
+}
+
+static void* HFSBench_UnlinkThread(void *pvArgs) {
+    BenchThreadData_S *psThrdData = pvArgs;
+    char pcName[64];
+
+    for (uint32_t u = 0; u < psThrdData->uNumOfEntries; u++) {
+        HFSBench_EntryName(pcName, sizeof(pcName), 'r', psThrdData, u);
+        psThrdData->iErr = RemoveFile(psThrdData->psDirNode, pcName);
+        if (psThrdData->iErr) {
+            printf("Bench: failed to remove %s (%d)\n", pcName, psThrdData->iErr);
+            break;
+        }
+        psThrdData->uOps++;
+    }
+
+    return psThrdData;
+}
+
+static void HFSBench_DataIO(BenchThreadData_S *psThrdData, bool bWrite, bool bRandom) {
+    uint32_t uIOSize = bRandom ? BENCH_RAND_IO_SIZE : BENCH_SEQ_IO_SIZE;
+    uint64_t uNumOfIOs = bRandom ? BENCH_RAND_IO_OPS : (BENCH_DATA_FILE_SIZE / BENCH_SEQ_IO_SIZE);
+
+    HFSBench_SeedThread(psThrdData);
 
-    // The following 2 tests check journal replay, make sure the drive is mountable, and the created fonder DOES exist
-    ADD_TEST_WITH_CRASH_ABORT("HFSTest_MakeDirAndKeep_wCrashAfterJournalHeader", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
-                              &HFSTest_MakeDirAndKeep, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_HEADER, HFSTest_CrashAbortOnMkDir, 0),
-    ADD_TEST( "HFSTest_ConfirmTestFolderExists", TEMP_DMG_BKUP, &HFSTest_ConfirmTestFolderExists ),
+    for (uint64_t u = 0; u < uNumOfIOs; u++) {
+        uint64_t uOffset = u * uIOSize;
+        size_t uActual = 0;
 
-    // The following 2 tests check journal replay, make sure the drive is mountable, and the created fonder does NOT exist
-    ADD_TEST_WITH_CRASH_ABORT("HFSTest_MakeDirAndKeep_wCrashAfterJournalData", "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
-                              &HFSTest_MakeDirAndKeep, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_DATA, HFSTest_CrashAbortOnMkDir, 0),
-    ADD_TEST( "HFSTest_ConfirmTestFolderDoesntExists", TEMP_DMG_BKUP, &HFSTest_ConfirmTestFolderDoesntExists ),
+        if (bRandom) {
+            uOffset = ((uint64_t)nrand48(psThrdData->pusRandState) % (BENCH_DATA_FILE_SIZE / uIOSize)) * uIOSize;
+        }
 
-    // The following 2 tests check journal replay, make sure the drive is mountable, and the created fonder DOES exist
-    ADD_TEST_WITH_CRASH_ABORT("HFSTest_MakeDirAndKeep_wCrashAfterJournalHeader_Sparse", CREATE_SPARSE_VOLUME,
-                              &HFSTest_MakeDirAndKeep, CRASH_ABORT_JOURNAL_AFTER_JOURNAL_HEADER, HFSTest_CrashAbortOnMkDir, 1),
-    ADD_TEST( "HFSTest_ConfirmTestFolderExists", TEMP_DMG_BKUP_SPARSE, &HFSTest_ConfirmTestFolderExists ),
-#endif
+        if (bWrite) {
+            psThrdData->iErr = HFS_fsOps.fsops_write(psThrdData->psFileNode, uOffset, uIOSize, psThrdData->pvBuf, &uActual);
+        } else {
+            psThrdData->iErr = HFS_fsOps.fsops_read(psThrdData->psFileNode, uOffset, uIOSize, psThrdData->pvBuf, &uActual);
+        }
+        if (psThrdData->iErr) {
+            printf("Bench: %s at offset %llu failed (%d)\n", bWrite ? "write" : "read", uOffset, psThrdData->iErr);
+            break;
+        }
+        psThrdData->uOps += uActual;
+    }
+}
 
-};
+static void* HFSBench_SeqWriteThread(void *pvArgs)  { HFSBench_DataIO(pvArgs, true,  false); return pvArgs; }
+static void* HFSBench_SeqReadThread(void *pvArgs)   { HFSBench_DataIO(pvArgs, false, false); return pvArgs; }
+static void* HFSBench_RandWriteThread(void *pvArgs) { HFSBench_DataIO(pvArgs, true,  true);  return pvArgs; }
+static void* HFSBench_RandReadThread(void *pvArgs)  { HFSBench_DataIO(pvArgs, false, true);  return pvArgs; }
 
-void *SyncerThread(void *pvArgs) {
-    
+// Runs pfPhase on uThreads threads; returns the wall time of the whole phase
+// and the sum of the per-thread uOps.
+static int HFSBench_RunPhase(BenchPhase_FP pfPhase, BenchThreadData_S *psThrdData, uint32_t uThreads, uint64_t *puNs, uint64_t *puOps) {
+    pthread_t psExecThread[BENCH_MAX_THREADS];
+    uint32_t uStarted = 0;
     int iErr = 0;
-    TestData_S *psTestData = pvArgs;
-    
-    printf("Syncer Thread runs every %u mS\n", guSyncerPeriod);
-    
-    while(psTestData->bSyncerOn) {
-        usleep(guSyncerPeriod * 1000);
-        iErr = HFS_fsOps.fsops_sync(psTestData->psRootNode);
-        psTestData->uSyncerCount++;
+
+    *puOps = 0;
+    for (uint32_t u = 0; u < uThreads; u++) {
+        psThrdData[u].uOps = 0;
+        psThrdData[u].iErr = 0;
+    }
+
+    uint64_t uStartNs = HFSBench_NowNs();
+    for (; uStarted < uThreads; uStarted++) {
+        iErr = pthread_create(&psExecThread[uStarted], NULL, pfPhase, &psThrdData[uStarted]);
         if (iErr) {
-            printf("fsops_sync returned %d\n", iErr);
+            printf("can't pthread_create\n");
             break;
         }
     }
-    
-    TesterThreadReturnStatus_S *psReturnStatus = malloc(sizeof(TesterThreadReturnStatus_S));
-    assert(psReturnStatus);
-    memset(psReturnStatus, 0, sizeof(*psReturnStatus));
-    
-    printf("Syncer returns %d\n", iErr);
-    
-    psReturnStatus->iErr = iErr;
-    
-    return((void*)psReturnStatus);
+    for (uint32_t u = 0; u < uStarted; u++) {
+        pthread_join(psExecThread[u], NULL);
+        if (!iErr && psThrdData[u].iErr) {
+            iErr = psThrdData[u].iErr;
+        }
+        *puOps += psThrdData[u].uOps;
+    }
+    *puNs = HFSBench_NowNs() - uStartNs;
+
+    return iErr;
 }
 
-static int KickOffSyncerThread(TestData_S *psTestData) {
+static int HFSBench_Mount(int iFD, UVFSFileNode *ppsRootNode, uint64_t *puNs) {
+    UVFSScanVolsRequest sScanVolsReq = {0};
+    UVFSScanVolsReply sScanVolsReply = {0};
 
-    int iErr = 0;
-    
-    if (guSyncerPeriod == 0) {
-        goto exit;
+    int iErr = HFS_fsOps.fsops_taste(iFD);
+    if (iErr) {
+        printf("Taste err [%d]\n", iErr);
+        return iErr;
     }
-    psTestData->bSyncerOn = true;
-    
-    pthread_attr_t sAttr;
-    pthread_attr_init(&sAttr);
-    pthread_attr_setdetachstate(&sAttr, PTHREAD_CREATE_JOINABLE);
-    
-    iErr = pthread_create(&psTestData->sSyncerThread, &sAttr, SyncerThread, psTestData);
-    
-    pthread_attr_destroy(&sAttr);
 
-exit:
-    return(iErr);
+    iErr = HFS_fsOps.fsops_scanvols(iFD, &sScanVolsReq, &sScanVolsReply);
+    if (iErr) {
+        printf("ScanVols err [%d]\n", iErr);
+        return iErr;
+    }
+
+    uint64_t uStartNs = HFSBench_NowNs();
+    iErr = HFS_fsOps.fsops_mount(iFD, sScanVolsReply.sr_volid, 0, NULL, ppsRootNode);
+    *puNs = HFSBench_NowNs() - uStartNs;
+    printf("Mount err [%d]\n", iErr);
+
+    return iErr;
 }
 
-static int ShutdownSyncerThread(TestData_S *psTestData) {
-    
+static int HFSBench_Metadata(UVFSFileNode psRootNode, FILE *psOut) {
+    BenchThreadData_S psThrdData[BENCH_MAX_THREADS] = {{0}};
+    BenchPhase_FP ppfPhases[] = { HFSBench_CreateThread, HFSBench_LookupThread, HFSBench_ReadDirThread, HFSBench_RenameThread, HFSBench_UnlinkThread };
+    const char *ppcPhases[]   = { "create_per_sec", "lookup_per_sec", "readdir_entries_per_sec", "rename_per_sec", "unlink_per_sec" };
+    bool bFirst = true;
     int iErr = 0;
-    TesterThreadReturnStatus_S *psReturnStatus = NULL;
 
-    if (guSyncerPeriod == 0) {
-        goto exit;
-    }
-    
-    psTestData->bSyncerOn = false;
-    iErr = pthread_join(psTestData->sSyncerThread, (void*)&psReturnStatus);
-    if (iErr) {
-        printf("Error waiting for Syncer thread! %d\n", iErr);
-        goto exit;
+    for (uint32_t uThread = 0; uThread < BENCH_MAX_THREADS; uThread++) {
+        psThrdData[uThread].pvBuf = malloc(BENCH_READDIR_BUF_SIZE);
+        assert(psThrdData[uThread].pvBuf);
     }
-    
-    printf("Syncer Thead ran %u times (iErr %d)\n", psTestData->uSyncerCount, iErr);
 
-    assert(psReturnStatus);
+    fprintf(psOut, "  \"metadata\": [\n");
+    for (uint32_t uSize = 0; uSize < sizeof(gpuBenchDirSizes)/sizeof(gpuBenchDirSizes[0]); uSize++) {
+        for (uint32_t uT = 0; uT < sizeof(gpuBenchThreads)/sizeof(gpuBenchThreads[0]); uT++) {
+            uint32_t uDirSize = gpuBenchDirSizes[uSize];
+            uint32_t uThreads = gpuBenchThreads[uT];
+            char pcDirName[64];
+            UVFSFileNode psDirNode = NULL;
 
-    iErr = psReturnStatus->iErr;
-    if (iErr) {
-        printf("Syncer thread returned iErr = %d\n", iErr);
-        goto exit;
+            printf("Bench: metadata, %u entries, %u threads\n", uDirSize, uThreads);
+            snprintf(pcDirName, sizeof(pcDirName), "bench_dir_%u_%u", uDirSize, uThreads);
+            iErr = CreateNewFolder(psRootNode, &psDirNode, pcDirName);
+            if (iErr) {
+                printf("Bench: failed to create %s (%d)\n", pcDirName, iErr);
+                goto exit;
+            }
+
+            // All threads share the directory; each owns a contiguous slice of the names.
+            for (uint32_t u = 0; u < uThreads; u++) {
+                psThrdData[u].psDirNode     = psDirNode;
+                psThrdData[u].uThreadNum    = u;
+                psThrdData[u].uFirstEntry   = u * (uDirSize / uThreads);
+                psThrdData[u].uNumOfEntries = (u == uThreads - 1) ? (uDirSize - psThrdData[u].uFirstEntry) : (uDirSize / uThreads);
+            }
+
+            fprintf(psOut, "%s    { \"dir_size\": %u, \"threads\": %u", bFirst ? "" : ",\n", uDirSize, uThreads);
+            bFirst = false;
+            for (uint32_t uPhase = 0; uPhase < sizeof(ppfPhases)/sizeof(ppfPhases[0]); uPhase++) {
+                uint64_t uNs = 0, uOps = 0;
+                iErr = HFSBench_RunPhase(ppfPhases[uPhase], psThrdData, uThreads, &uNs, &uOps);
+                if (iErr) {
+                    HFS_fsOps.fsops_reclaim(psDirNode, 0);
+                    goto exit;
+                }
+                fprintf(psOut, ", \"%s\": %.1f", ppcPhases[uPhase], HFSBench_PerSec(uOps, uNs));
+            }
+            fprintf(psOut, " }");
+
+            HFS_fsOps.fsops_reclaim(psDirNode, 0);
+            iErr = RemoveFolder(psRootNode, pcDirName);
+            if (iErr) {
+                printf("Bench: failed to remove %s (%d)\n", pcDirName, iErr);
+                goto exit;
+            }
+            HFS_fsOps.fsops_sync(psRootNode);
+        }
     }
+    fprintf(psOut, "\n  ],\n");
 
 exit:
-    if (psReturnStatus) {
-        free(psReturnStatus);
+    for (uint32_t uThread = 0; uThread < BENCH_MAX_THREADS; uThread++) {
+        free(psThrdData[uThread].pvBuf);
     }
-        
-    return(iErr);
+    return iErr;
 }
 
-static int HFSTest_RunTest(TestData_S *psTestData) {
-    UVFSScanVolsRequest sScanVolsReq = {0};
-    UVFSScanVolsReply sScanVolsReply = {0};
+static int HFSBench_Data(UVFSFileNode psRootNode, FILE *psOut) {
+    BenchThreadData_S psThrdData[BENCH_MAX_THREADS] = {{0}};
+    BenchPhase_FP ppfPhases[] = { HFSBench_SeqWriteThread, HFSBench_SeqReadThread, HFSBench_RandWriteThread, HFSBench_RandReadThread };
+    const char *ppcPhases[]   = { "seq_write_mb_per_sec", "seq_read_mb_per_sec", "rand_write_mb_per_sec", "rand_read_mb_per_sec" };
     int iErr = 0;
-    int iFD = HFSTest_PrepareEnv( psTestData );
-    giFD = iFD;
 
-    iErr = HFS_fsOps.fsops_taste( iFD );
-    printf("Taste err [%d]\n",iErr);
-    if ( iErr ) {
-        close(iFD);
-        HFSTest_DestroyEnv( iFD );
-        return(iErr);
+    for (uint32_t uThread = 0; uThread < BENCH_MAX_THREADS; uThread++) {
+        psThrdData[uThread].uThreadNum = uThread;
+        psThrdData[uThread].pvBuf = malloc(BENCH_SEQ_IO_SIZE);
+        assert(psThrdData[uThread].pvBuf);
+        memset(psThrdData[uThread].pvBuf, (int)(0xA5 + uThread), BENCH_SEQ_IO_SIZE);
     }
 
-    iErr = HFS_fsOps.fsops_scanvols( iFD, &sScanVolsReq, &sScanVolsReply );
-    printf("ScanVols err [%d]\n", iErr);
-    if ( iErr )
-    {
+    fprintf(psOut, "  \"data\": [\n");
+    for (uint32_t uT = 0; uT < sizeof(gpuBenchThreads)/sizeof(gpuBenchThreads[0]); uT++) {
+        uint32_t uThreads = gpuBenchThreads[uT];
+        char pcName[64];
+
+        printf("Bench: data, %u threads\n", uThreads);
+        for (uint32_t u = 0; u < uThreads; u++) {
+            snprintf(pcName, sizeof(pcName), "bench_data_%u_%u", uThreads, u);
+            iErr = CreateNewFile(psRootNode, &psThrdData[u].psFileNode, pcName, 0);
+            if (iErr) {
+                printf("Bench: failed to create %s (%d)\n", pcName, iErr);
+                for (uint32_t uCreated = 0; uCreated < u; uCreated++) {
+                    HFS_fsOps.fsops_reclaim(psThrdData[uCreated].psFileNode, 0);
+                }
+                goto exit;
+            }
+        }
+
+        fprintf(psOut, "%s    { \"threads\": %u", uT ? ",\n" : "", uThreads);
+        for (uint32_t uPhase = 0; uPhase < sizeof(ppfPhases)/sizeof(ppfPhases[0]) && !iErr; uPhase++) {
+            uint64_t uNs = 0, uBytes = 0;
+            iErr = HFSBench_RunPhase(ppfPhases[uPhase], psThrdData, uThreads, &uNs, &uBytes);
+            fprintf(psOut, ", \"%s\": %.1f", ppcPhases[uPhase], HFSBench_MBPerSec(uBytes, uNs));
+        }
+        fprintf(psOut, " }");
+
+        for (uint32_t u = 0; u < uThreads; u++) {
+            HFS_fsOps.fsops_reclaim(psThrdData[u].psFileNode, 0);
+            snprintf(pcName, sizeof(pcName), "bench_data_%u_%u", uThreads, u);
+            int iRemoveErr = RemoveFile(psRootNode, pcName);
+            if (!iErr) {
+                iErr = iRemoveErr;
+            }
+        }
+        if (iErr) {
+            goto exit;
+        }
+        HFS_fsOps.fsops_sync(psRootNode);
+    }
+    fprintf(psOut, "\n  ],\n");
+
+exit:
+    for (uint32_t uThread = 0; uThread < BENCH_MAX_THREADS; uThread++) {
+        free(psThrdData[uThread].pvBuf);
+    }
+    return iErr;
+}
+
+// Leaves BENCH_REPLAY_FILES creates in the journal, drops the device under the
+// mounted volume (like the crash tests do) and times the mount that replays it.
+static int HFSBench_Replay(int iFD, UVFSFileNode psRootNode, uint64_t *puReplayNs) {
+    UVFSFileNode psDirNode = NULL;
+    char pcName[64];
+
+    int iErr = CreateNewFolder(psRootNode, &psDirNode, "bench_replay");
+    for (uint32_t u = 0; u < BENCH_REPLAY_FILES && !iErr; u++) {
+        UVFSFileNode psNode = NULL;
+        snprintf(pcName, sizeof(pcName), "replay_%u", u);
+        iErr = CreateNewFile(psDirNode, &psNode, pcName, 0);
+        if (!iErr) {
+            HFS_fsOps.fsops_reclaim(psNode, 0);
+        }
+    }
+    if (psDirNode) {
+        HFS_fsOps.fsops_reclaim(psDirNode, 0);
+    }
+    if (iErr) {
+        printf("Bench: failed to populate replay directory (%d)\n", iErr);
+        HFS_fsOps.fsops_unmount(psRootNode, UVFSUnmountHintNone);
         close(iFD);
-        HFSTest_DestroyEnv( iFD );
-        return(iErr);
+        return iErr;
+    }
+
+    close(iFD);
+    HFS_fsOps.fsops_unmount(psRootNode, UVFSUnmountHintNone);
+
+    iFD = open(pcDevPath, O_RDWR);
+    if (iFD < 0) {
+        printf("Failed to open %s\n", pcDevPath);
+        return errno;
+    }
+
+    iErr = HFSBench_Mount(iFD, &psRootNode, puReplayNs);
+    if (!iErr) {
+        iErr = HFS_fsOps.fsops_unmount(psRootNode, UVFSUnmountHintNone);
     }
+    close(iFD);
+
+    return iErr;
+}
 
+int hfs_tester_run_bench(const char *pcOutPath)
+{
+    TestData_S sTestData = {
+        .pcTestName = "hfs_tester_run_bench",
+        .pcDMGPath  = CREATE_SPARSE_VOLUME,
+    };
     UVFSFileNode RootNode = NULL;
-    iErr = HFS_fsOps.fsops_mount( iFD, sScanVolsReply.sr_volid, 0, NULL, &RootNode );
-    printf("Mount err [%d]\n", iErr);
-    if ( iErr )
-    {
-        close(iFD);
-        HFSTest_DestroyEnv( iFD );
-        return(iErr);
+    uint64_t uMountNs = 0, uUnmountNs = 0, uRemountNs = 0, uReplayNs = 0;
+
+    FILE *psOut = fopen(pcOutPath, "w");
+    if (psOut == NULL) {
+        int iOpenErr = errno;
+        printf("Failed to open %s (%d)\n", pcOutPath, iOpenErr);
+        return iOpenErr;
     }
-    
-    psTestData->psRootNode = RootNode;
-    iErr = KickOffSyncerThread(psTestData);
-    if ( iErr ) {
-        close(iFD);
-        HFSTest_DestroyEnv( iFD );
-        return(iErr);
+
+    int iErr = HFS_fsOps.fsops_init();
+    printf("Init err [%d]\n",iErr);
+    if (iErr)
+        exit(-1);
+
+    int iFD = HFSTest_PrepareEnv(&sTestData);
+    LFHFS_StatsReset();
+
+    fprintf(psOut, "{\n");
+    fprintf(psOut, "  \"benchmark\": \"livefiles_hfs\",\n");
+    fprintf(psOut, "  \"version\": %u,\n", BENCH_VERSION);
+    fprintf(psOut, "  \"timestamp\": %ld,\n", (long)time(NULL));
+    fprintf(psOut, "  \"config\": { \"seed\": %u, \"thread_counts\": [", BENCH_SEED);
+    for (uint32_t u = 0; u < sizeof(gpuBenchThreads)/sizeof(gpuBenchThreads[0]); u++) {
+        fprintf(psOut, "%s%u", u ? ", " : "", gpuBenchThreads[u]);
     }
+    fprintf(psOut, "], \"dir_sizes\": [");
+    for (uint32_t u = 0; u < sizeof(gpuBenchDirSizes)/sizeof(gpuBenchDirSizes[0]); u++) {
+        fprintf(psOut, "%s%u", u ? ", " : "", gpuBenchDirSizes[u]);
+    }
+    fprintf(psOut, "], \"data_file_size\": %llu, \"seq_io_size\": %u, \"rand_io_size\": %u, \"rand_io_ops\": %u, \"replay_files\": %u },\n",
+            BENCH_DATA_FILE_SIZE, BENCH_SEQ_IO_SIZE, BENCH_RAND_IO_SIZE, BENCH_RAND_IO_OPS, BENCH_REPLAY_FILES);
 
-    // Execute the test
-    iErr = psTestData->pfTestHandler( RootNode );
-    printf("Test [%s] finish with error code [%d]\n", psTestData->pcTestName, iErr);
-    #if HFS_CRASH_TEST
-    if (psTestData->eCrashID == CRASH_ABORT_NONE)
-    #endif
-        if ( iErr ) {
-            close(iFD);
-            HFSTest_DestroyEnv( iFD );
-            return(iErr);
-        }
+    iErr = HFSBench_Mount(iFD, &RootNode, &uMountNs);
+    if (iErr) {
+        close(iFD);
+        goto exit;
+    }
 
-    iErr = ShutdownSyncerThread(psTestData);
-    if ( iErr ) {
+    iErr = HFSBench_Metadata(RootNode, psOut);
+    if (!iErr) {
+        iErr = HFSBench_Data(RootNode, psOut);
+    }
+    if (iErr) {
+        HFS_fsOps.fsops_unmount(RootNode, UVFSUnmountHintNone);
         close(iFD);
-        HFSTest_DestroyEnv( iFD );
-        return(iErr);
+        goto exit;
     }
-    
+
+    uint64_t uStartNs = HFSBench_NowNs();
     iErr = HFS_fsOps.fsops_unmount(RootNode, UVFSUnmountHintNone);
+    uUnmountNs = HFSBench_NowNs() - uStartNs;
     printf("UnMount err [%d]\n", iErr);
-    if ( iErr ) {
+    if (iErr) {
         close(iFD);
-        HFSTest_DestroyEnv( iFD );
-        return(iErr);
-    }
-    
-    HFSTest_PrintCacheStats();
-    
-    #if HFS_CRASH_TEST
-        if (psTestData->eCrashID != CRASH_ABORT_NONE) {
-            
-            // Execute post crash analysis
-            iErr = psTestData->pAbortFunc(psTestData,
-                                          gsCrashReport.eCrashID,
-                                          iFD,
-                                          gsCrashReport.psNode,
-                                          gsCrashReport.pSyncerThread);
-            
-            printf("Analysis [%s] finished with error code [%d]\n", psTestData->pcTestName, iErr);
-            
-            if (iErr) {
-                HFSTest_DestroyEnv( iFD );
-                return(iErr);
-            }
-        } else
-    #endif
-        {
-            // close file
-            close(iFD);
-            
-            //assert(gCacheStat.buf_cache_size == 0);
-            
-            // Run fsck
-            char pcFsckCmd[512] = {0};
-            strcat( pcFsckCmd, PATH_TO_FSCK);
-            strcat( pcFsckCmd, " -fd /dev/disk");
+        goto exit;
+    }
 
-            strcat( pcFsckCmd, pcLastDevPathName );
-            if (pcDevNum[0] != '\0') {
-                strcat( pcFsckCmd, "s" );
-                strcat( pcFsckCmd, pcDevNum );
-            }
-            printf("Execute %s\n", pcFsckCmd);
-            iErr = system( pcFsckCmd );
-            if ( iErr )
-            {
-                printf( "*** Fsck CMD failed! (%d)\n", iErr);
-                HFSTest_DestroyEnv( iFD );
-                return(iErr);
-            } else {
-                printf( "*** Fsck CMD succeeded!\n");
-            }
+    iErr = HFSBench_Mount(iFD, &RootNode, &uRemountNs);
+    if (iErr) {
+        close(iFD);
+        goto exit;
+    }
 
-            HFSTest_DestroyEnv( iFD );
+    // Closes iFD.
+    iErr = HFSBench_Replay(iFD, RootNode, &uReplayNs);
+    if (iErr) {
+        goto exit;
+    }
+
+    fprintf(psOut, "  \"mount\": { \"mount_ms\": %.3f, \"unmount_ms\": %.3f, \"remount_ms\": %.3f, \"replay_mount_ms\": %.3f },\n",
+            HFSBench_Ms(uMountNs), HFSBench_Ms(uUnmountNs), HFSBench_Ms(uRemountNs), HFSBench_Ms(uReplayNs));
+
+    fprintf(psOut, "  \"ops\": {");
+    bool bFirst = true;
+    for (uint32_t uOp = 0; uOp < LFHFS_OP_AMOUNT; uOp++) {
+        LFHFSOpStats_S sStats;
+        LFHFS_StatsGet((LFHFSOp_e)uOp, &sStats);
+        if (sStats.uCalls == 0) {
+            continue;
         }
-    return(iErr);
-}
+        fprintf(psOut, "%s\n    \"%s\": { \"calls\": %llu, \"errors\": %llu, \"bytes\": %llu, \"avg_us\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f }",
+                bFirst ? "" : ",",
+                LFHFS_StatsOpName((LFHFSOp_e)uOp),
+                sStats.uCalls,
+                sStats.uErrors,
+                sStats.uBytes,
+                (double)sStats.uTotalNs / sStats.uCalls / 1000.0,
+                (double)LFHFS_StatsPercentileNs(&sStats, 50) / 1000.0,
+                (double)LFHFS_StatsPercentileNs(&sStats, 99) / 1000.0,
+                (double)sStats.uMaxNs / 1000.0);
+        bFirst = false;
+    }
+    fprintf(psOut, "\n  }\n}\n");
 
-#if HFS_CRASH_TEST
-int HFSTest_CrashAbort_Hanlder(CrashAbort_E eAbort, int iFD, UVFSFileNode psNode, pthread_t pSyncerThread) {
-    printf("HFSTest_CrashAbort_Hanlder (%u):\n", guCrashAbortCnt);
-    if (guCrashAbortCnt) {
-        guCrashAbortCnt--;
-        return(0);
-    }
+exit:
+    fclose(psOut);
+    HFSTest_DestroyEnv(iFD);
+    HFS_fsOps.fsops_fini();
 
-    close(iFD); // prevent additional writes to media
-    if (pSyncerThread == pthread_self()) {
-        printf("Crash Abort on Syncer Thread!\n");
+    if (!iErr) {
+        printf("*** Benchmark results written to %s\n", pcOutPath);
     }
-    
-    gsCrashReport.uCrashCount++;
-    gsCrashReport.eCrashID      = eAbort;
-    gsCrashReport.iFD           = iFD;
-    gsCrashReport.psNode        = psNode;
-    gsCrashReport.pSyncerThread = pSyncerThread;
-    
-    return(0);
+    return iErr;
 }
-#endif
 
+/*******************************************/
+/*******************************************/
+/*******************************************/
+// Benchmarks END.
+/*******************************************/
+/*******************************************/
+/*******************************************/
 
-int hfs_tester_run_fsck(void)
+/*
+ * Fragmentation and layout report for an unmounted device or image.
+ * The volume is mounted read-only and never written.
+ */
+int hfs_tester_run_fsinfo(const char *pcDevPath, uint32_t uTopForks)
 {
-    // Journaled
+    UVFSScanVolsRequest sScanVolsReq = {0};
+    UVFSScanVolsReply sScanVolsReply = {0};
+    UVFSFileNode RootNode = NULL;
+    LFHFSFsInfo_S sInfo;
+
+    int iFD = open(pcDevPath, O_RDONLY);
+    if (iFD < 0) {
+        printf("Failed to open [%s] errno %d\n", pcDevPath, errno);
+        return EBADF;
+    }
+
     int iErr = HFS_fsOps.fsops_init();
-    printf("Init err [%d]\n",iErr);
-    if (iErr)
-        exit(-1);
-    
-    TestData_S sTestData = {
-        .pcTestName = "hfs_tester_run_fsck",
-        .pcDMGPath  = "/Volumes/SSD_Shared/FS_DMGs/HFSJ-Empty.dmg",
-    };
+    if (iErr) {
+        printf("Init err [%d]\n", iErr);
+        goto exit;
+    }
 
-    int iFD = HFSTest_PrepareEnv(&sTestData);
-    
-    iErr = HFS_fsOps.fsops_taste( iFD );
-    printf("Taste err [%d]\n",iErr);
-    if ( iErr ) {
-        close(iFD);
-        HFSTest_DestroyEnv( iFD );
-        return(iErr);
+    iErr = HFS_fsOps.fsops_taste(iFD);
+    if (iErr) {
+        printf("Taste err [%d]\n", iErr);
+        goto fini;
     }
-    
-    iErr = HFS_fsOps.fsops_check(iFD, 0, NULL, QUICK_CHECK);
-    printf("Check err [%d]\n",iErr);
-    if (iErr)
-        exit(-1);
-    
+
+    iErr = HFS_fsOps.fsops_scanvols(iFD, &sScanVolsReq, &sScanVolsReply);
+    if (iErr) {
+        printf("ScanVols err [%d]\n", iErr);
+        goto fini;
+    }
+
+    iErr = HFS_fsOps.fsops_mount(iFD, sScanVolsReply.sr_volid, UVFS_MOUNT_RDONLY, NULL, &RootNode);
+    if (iErr) {
+        printf("Mount err [%d]\n", iErr);
+        goto fini;
+    }
+
+    iErr = LFHFS_FsInfoCollect(RootNode, uTopForks, &sInfo);
+    if (iErr) {
+        printf("FsInfoCollect err [%d]\n", iErr);
+    } else {
+        LFHFS_FsInfoDump(&sInfo, stdout);
+        LFHFS_FsInfoFree(&sInfo);
+    }
+
+    int iUnmountErr = HFS_fsOps.fsops_unmount(RootNode, UVFSUnmountHintNone);
+    if (iUnmountErr) {
+        printf("UnMount err [%d]\n", iUnmountErr);
+        if (!iErr) iErr = iUnmountErr;
+    }
+
+fini:
+    HFS_fsOps.fsops_fini();
+exit:
     close(iFD);
-    HFSTest_DestroyEnv( iFD );
+    return iErr;
+}
 
-    // Non-Journaled
-    iErr = HFS_fsOps.fsops_init();
-    printf("Init err [%d]\n",iErr);
-    if (iErr)
-        exit(-1);
-    
-    sTestData.pcDMGPath  = "/Volumes/SSD_Shared/FS_DMGs/HFSEmpty.dmg";
-    
-    iFD = HFSTest_PrepareEnv(&sTestData);
-    
-    iErr = HFS_fsOps.fsops_taste( iFD );
-    printf("Taste err [%d]\n",iErr);
-    if ( iErr ) {
-        close(iFD);
-        HFSTest_DestroyEnv( iFD );
-        return(iErr);
+/*
+ * Relocate the most fragmented files of an unmounted device or image
+ * into contiguous free space.
+ */
+int hfs_tester_run_defrag(const char *pcDevPath, uint32_t uMaxFiles, uint32_t uFlags)
+{
+    UVFSScanVolsRequest sScanVolsReq = {0};
+    UVFSScanVolsReply sScanVolsReply = {0};
+    UVFSFileNode RootNode = NULL;
+    LFHFSDefragStats_S sStats;
+
+    int iFD = open(pcDevPath, O_RDWR);
+    if (iFD < 0) {
+        printf("Failed to open [%s] errno %d\n", pcDevPath, errno);
+        return EBADF;
     }
-    
-    iErr = HFS_fsOps.fsops_check(iFD, 0, NULL, QUICK_CHECK);
-    printf("Check err [%d]\n",iErr);
-    if (iErr)
-        exit(-1);
-    
+
+    int iErr = HFS_fsOps.fsops_init();
+    if (iErr) {
+        printf("Init err [%d]\n", iErr);
+        goto exit;
+    }
+
+    iErr = HFS_fsOps.fsops_taste(iFD);
+    if (iErr) {
+        printf("Taste err [%d]\n", iErr);
+        goto fini;
+    }
+
+    iErr = HFS_fsOps.fsops_scanvols(iFD, &sScanVolsReq, &sScanVolsReply);
+    if (iErr) {
+        printf("ScanVols err [%d]\n", iErr);
+        goto fini;
+    }
+
+    iErr = HFS_fsOps.fsops_mount(iFD, sScanVolsReply.sr_volid, 0, NULL, &RootNode);
+    if (iErr) {
+        printf("Mount err [%d]\n", iErr);
+        goto fini;
+    }
+
+    iErr = LFHFS_Defrag(RootNode, uMaxFiles, uFlags, &sStats);
+    if (iErr) {
+        printf("Defrag err [%d]\n", iErr);
+    } else {
+        LFHFS_DefragDump(&sStats, stdout);
+    }
+
+    int iUnmountErr = HFS_fsOps.fsops_unmount(RootNode, UVFSUnmountHintNone);
+    if (iUnmountErr) {
+        printf("UnMount err [%d]\n", iUnmountErr);
+        if (!iErr) iErr = iUnmountErr;
+    }
+
+fini:
+    HFS_fsOps.fsops_fini();
+exit:
     close(iFD);
-    HFSTest_DestroyEnv( iFD );
     return iErr;
 }
 
-int hfs_tester_run(uint32_t uFirstTest, uint32_t uLastTest)
+/*
+ * Show, enable, disable or resize the journal of an unmounted device
+ * or image. uJournalSize 0 picks the default size.
+ */
+int hfs_tester_run_jnl(const char *pcDevPath, const char *pcAction, uint64_t uJournalSize)
 {
-    uint32_t uTestRan = 0;
+    UVFSScanVolsRequest sScanVolsReq = {0};
+    UVFSScanVolsReply sScanVolsReply = {0};
+    UVFSFileNode RootNode = NULL;
+    LFHFSJournalInfo_S sInfo;
+
+    int iFD = open(pcDevPath, O_RDWR);
+    if (iFD < 0) {
+        printf("Failed to open [%s] errno %d\n", pcDevPath, errno);
+        return EBADF;
+    }
+
     int iErr = HFS_fsOps.fsops_init();
-    printf("Init err [%d]\n",iErr);
-    if (iErr)
-        exit(-1);
-    
-    uint32_t uAvailTests = sizeof(gsTestsData)/sizeof(gsTestsData[0]);
-    if ((!uLastTest) ||
-        (uLastTest > uAvailTests)) {
-        
-        uLastTest = uAvailTests;
+    if (iErr) {
+        printf("Init err [%d]\n", iErr);
+        goto exit;
     }
-    
-    for ( unsigned uTestNum=uFirstTest; uTestNum < uLastTest ; uTestNum++ )
-    {
-        printf("******************************************************************************************\n");
-        printf("**** about to run test [%s] [%u] \n", gsTestsData[uTestNum].pcTestName, uTestNum);
-        printf("******************************************************************************************\n");
-        
-        #if HFS_CRASH_TEST
-            HFSTest_ClearCrashAbortFunctionArray();
-        
-            if (gsTestsData[uTestNum].eCrashID) {
-                // Inject Crach condition
-                CrashAbort_E eCrashID = gsTestsData[uTestNum].eCrashID;
-                printf( "Adding Crash-Abort Function at (%u), %s.\n", eCrashID, ppcCrashAbortDesc[eCrashID] );
-                guCrashAbortCnt = gsTestsData[uTestNum].uCrashAbortCnt;
-                gpsCrashAbortFunctionArray[eCrashID] = HFSTest_CrashAbort_Hanlder;
-                memset(&gsCrashReport, 0, sizeof(gsCrashReport));
-            }
-        #endif
-                
-        iErr = HFSTest_RunTest(&gsTestsData[uTestNum]);
 
+    iErr = HFS_fsOps.fsops_taste(iFD);
+    if (iErr) {
+        printf("Taste err [%d]\n", iErr);
+        goto fini;
+    }
+
+    iErr = HFS_fsOps.fsops_scanvols(iFD, &sScanVolsReq, &sScanVolsReply);
+    if (iErr) {
+        printf("ScanVols err [%d]\n", iErr);
+        goto fini;
+    }
+
+    iErr = HFS_fsOps.fsops_mount(iFD, sScanVolsReply.sr_volid, 0, NULL, &RootNode);
+    if (iErr) {
+        printf("Mount err [%d]\n", iErr);
+        goto fini;
+    }
+
+    if (strcmp(pcAction, "enable") == 0) {
+        iErr = LFHFS_MakeJournaled(RootNode, uJournalSize, 0);
+    } else if (strcmp(pcAction, "disable") == 0) {
+        iErr = LFHFS_UnJournal(RootNode);
+    } else if (strcmp(pcAction, "resize") == 0) {
+        iErr = LFHFS_ResizeJournal(RootNode, uJournalSize, 0);
+    } else if (strcmp(pcAction, "info") != 0) {
+        iErr = EINVAL;
+    }
+
+    if (iErr) {
+        printf("Journal %s err [%d]\n", pcAction, iErr);
+    } else {
+        iErr = LFHFS_GetJournalInfo(RootNode, &sInfo);
         if (iErr) {
-            exit(-1);
+            printf("GetJournalInfo err [%d]\n", iErr);
+        } else {
+            LFHFS_JournalInfoDump(&sInfo, stdout);
         }
-        uTestRan++;
     }
 
-    HFS_fsOps.fsops_fini();
-    
-    printf("*** Run %u out of %u tests successfully\n", uTestRan, uAvailTests);
+    int iUnmountErr = HFS_fsOps.fsops_unmount(RootNode, UVFSUnmountHintNone);
+    if (iUnmountErr) {
+        printf("UnMount err [%d]\n", iUnmountErr);
+        if (!iErr) iErr = iUnmountErr;
+    }
 
-    return 0;
+fini:
+    HFS_fsOps.fsops_fini();
+exit:
+    close(iFD);
+    return iErr;
 }
 
 /*******************************************/
@@ -4686,6 +7216,10 @@ int main( int argc, const char * argv[] ) {
     if ((argc < 2) || (argc > 5))
     {
         printf("Usage : livefiles_hfs_tester < dev-path / RUN_HFS_TESTS > [First Test] [Last Test] [Syncer Period (mS)]\n");
+        printf("        livefiles_hfs_tester RUN_HFS_BENCH [JSON output path (default "BENCH_DEFAULT_OUTPUT")]\n");
+        printf("        livefiles_hfs_tester RUN_HFS_FSINFO <dev-path> [Top forks (default %u)]\n", FSINFO_DEFAULT_TOP);
+        printf("        livefiles_hfs_tester RUN_HFS_DEFRAG <dev-path> [Max files (default %u)] [compact]\n", DEFRAG_DEFAULT_FILES);
+        printf("        livefiles_hfs_tester RUN_HFS_JNL <dev-path> <info / enable / disable / resize> [Journal size (k)]\n");
         exit(1);
     }
     
@@ -4710,6 +7244,62 @@ int main( int argc, const char * argv[] ) {
         if (err >= 256) err = -1; // exit code overflow
         exit(err);
         
+    } else if  ( strncmp(argv[1], HFS_RUN_BENCH, strlen(HFS_RUN_BENCH)) == 0 )
+    {
+        int err = hfs_tester_run_bench((argc >= 3) ? argv[2] : BENCH_DEFAULT_OUTPUT);
+        printf("*** hfs_tester_run_bench return status : %d ***\n", err);
+        if (err >= 256) err = -1; // exit code overflow
+        exit(err);
+
+    } else if  ( strncmp(argv[1], HFS_RUN_FSINFO, strlen(HFS_RUN_FSINFO)) == 0 )
+    {
+        if (argc < 3) {
+            printf("RUN_HFS_FSINFO needs a dev-path\n");
+            exit(1);
+        }
+        uint32_t uTopForks = FSINFO_DEFAULT_TOP;
+        if (argc >= 4) {
+            sscanf(argv[3], "%u", &uTopForks);
+        }
+        int err = hfs_tester_run_fsinfo(argv[2], uTopForks);
+        printf("*** hfs_tester_run_fsinfo return status : %d ***\n", err);
+        if (err >= 256) err = -1; // exit code overflow
+        exit(err);
+
+    } else if  ( strncmp(argv[1], HFS_RUN_DEFRAG, strlen(HFS_RUN_DEFRAG)) == 0 )
+    {
+        if (argc < 3) {
+            printf("RUN_HFS_DEFRAG needs a dev-path\n");
+            exit(1);
+        }
+        uint32_t uMaxFiles = DEFRAG_DEFAULT_FILES;
+        uint32_t uFlags = 0;
+        if (argc >= 4) {
+            sscanf(argv[3], "%u", &uMaxFiles);
+        }
+        if (argc >= 5 && strcmp(argv[4], "compact") == 0) {
+            uFlags |= LFHFS_DEFRAG_COMPACT;
+        }
+        int err = hfs_tester_run_defrag(argv[2], uMaxFiles, uFlags);
+        printf("*** hfs_tester_run_defrag return status : %d ***\n", err);
+        if (err >= 256) err = -1; // exit code overflow
+        exit(err);
+
+    } else if  ( strncmp(argv[1], HFS_RUN_JNL, strlen(HFS_RUN_JNL)) == 0 )
+    {
+        if (argc < 4) {
+            printf("RUN_HFS_JNL needs a dev-path and an action\n");
+            exit(1);
+        }
+        uint64_t uJournalSizeK = 0;
+        if (argc >= 5) {
+            sscanf(argv[4], "%llu", &uJournalSizeK);
+        }
+        int err = hfs_tester_run_jnl(argv[2], argv[3], uJournalSizeK * 1024);
+        printf("*** hfs_tester_run_jnl return status : %d ***\n", err);
+        if (err >= 256) err = -1; // exit code overflow
+        exit(err);
+
     } else if  ( strncmp(argv[1], HFS_RUN_FSCK, strlen(HFS_RUN_FSCK)) == 0 )
     {
         int err = hfs_tester_run_fsck();
@@ -0,0 +1,158 @@
+#!/usr/bin/python
+
+# Decode a livefiles_hfs trace dump (see lf_hfs_trace.h / LFHFS_TraceDump) into
+# a per-thread timeline and a per-event latency table.
+#
+# Event names are taken from core/hfs_kdebug.h so that the plugin and the
+# kernel share a single definition of the HFSDBG_* / DBG_JOURNAL_* codes.
+
+import os, re, sys, struct, argparse
+
+HEADER_FORMAT   = '<IIIIQQ'
+RECORD_FORMAT   = '<QQII5Q'
+TRACE_MAGIC     = 0x5448464C
+TRACE_VERSION   = 1
+
+DBG_FUNC_START  = 1
+DBG_FUNC_END    = 2
+DBG_FUNC_MASK   = 3
+
+SUBCLASSES      = { 'DBG_FSRW': 1, 'DBG_HFS': 8, 'DBG_JOURNAL': 0xD }
+DBG_FSYSTEM     = 3
+
+def fsdbg_code(subclass, code):
+    return (DBG_FSYSTEM << 24) | (subclass << 16) | (code << 2)
+
+def load_event_names(header_path):
+    names = {}
+    with open(header_path) as f:
+        text = f.read()
+    for name, code in re.findall(r'(HFSDBG_\w+)\s*=\s*HFSDBG_CODE\((\d+)\)', text):
+        names[fsdbg_code(SUBCLASSES['DBG_HFS'], int(code))] = name
+    for name, sub, code in re.findall(r'(\w+)\s*=\s*FSDBG_CODE\((DBG_\w+),\s*(\d+)\)', text):
+        names[fsdbg_code(SUBCLASSES[sub], int(code))] = name
+    for name, sub, code in re.findall(r'#define\s+(\w+)\s+FSDBG_CODE\((DBG_\w+),\s*(\d+)\)', text):
+        names[fsdbg_code(SUBCLASSES[sub], int(code))] = name
+    return names
+
+def read_trace(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    header_size = struct.calcsize(HEADER_FORMAT)
+    magic, version, record_size, _, count, dropped = struct.unpack_from(HEADER_FORMAT, data, 0)
+    if magic != TRACE_MAGIC:
+        raise Exception('{}: bad magic 0x{:08x}'.format(path, magic))
+    if version != TRACE_VERSION or record_size != struct.calcsize(RECORD_FORMAT):
+        raise Exception('{}: unsupported version {} / record size {}'.format(path, version, record_size))
+
+    records = []
+    for i in range(count):
+        ts, tid, debugid, _, a1, a2, a3, a4, a5 = struct.unpack_from(RECORD_FORMAT, data, header_size + i * record_size)
+        records.append((ts, tid, debugid, (a1, a2, a3, a4, a5)))
+    records.sort(key=lambda r: r[0])
+    return records, dropped
+
+def percentile(sorted_values, pct):
+    if not sorted_values:
+        return 0
+    idx = int((len(sorted_values) * pct + 99) // 100) - 1
+    return sorted_values[max(0, min(idx, len(sorted_values) - 1))]
+
+def main():
+    default_header = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'core', 'hfs_kdebug.h')
+
+    parser = argparse.ArgumentParser(description='Decode a livefiles_hfs trace dump')
+    parser.add_argument('trace', help='file written by LFHFS_TraceDump')
+    parser.add_argument('--kdebug-header', default=default_header, help='path to core/hfs_kdebug.h')
+    parser.add_argument('--timeline', action='store_true', help='print every event in time order')
+    parser.add_argument('--min-us', type=float, default=0.0, help='timeline: only print END events at least this long (and their START)')
+    parser.add_argument('--thread', type=lambda x: int(x, 0), help='only consider this thread id')
+    parser.add_argument('--event', help='only consider events whose name contains this string')
+    args = parser.parse_args()
+
+    names = load_event_names(args.kdebug_header)
+    records, dropped = read_trace(args.trace)
+    if args.thread is not None:
+        records = [r for r in records if r[1] == args.thread]
+
+    def event_name(debugid):
+        code = debugid & ~DBG_FUNC_MASK
+        return names.get(code, '0x{:08x}'.format(code))
+
+    if args.event:
+        records = [r for r in records if args.event in event_name(r[2])]
+
+    if not records:
+        print('No records ({} dropped)'.format(dropped))
+        return 0
+
+    base_ts = records[0][0]
+    stacks = {}         # (tid, code) -> [start record, ...]
+    latencies = {}      # name -> [ns, ...]
+    unmatched_end = {}
+    timeline = []
+
+    for rec in records:
+        ts, tid, debugid, evargs = rec
+        code = debugid & ~DBG_FUNC_MASK
+        func = debugid & DBG_FUNC_MASK
+        name = event_name(debugid)
+        duration = None
+
+        if func == DBG_FUNC_START:
+            stacks.setdefault((tid, code), []).append(rec)
+        elif func == DBG_FUNC_END:
+            stack = stacks.get((tid, code))
+            if stack:
+                start = stack.pop()
+                duration = ts - start[0]
+                latencies.setdefault(name, []).append(duration)
+            else:
+                unmatched_end[name] = unmatched_end.get(name, 0) + 1
+        if args.timeline:
+            timeline.append((rec, name, func, duration))
+
+    if args.timeline:
+        depth = {}
+        print('{:>14} {:>10}  {}'.format('time(us)', 'thread', 'event'))
+        for rec, name, func, duration in timeline:
+            ts, tid, debugid, evargs = rec
+            d = depth.get(tid, 0)
+            if func == DBG_FUNC_END:
+                d = max(0, d - 1)
+                depth[tid] = d
+            show = (args.min_us == 0.0) or (duration is not None and duration / 1000.0 >= args.min_us)
+            if show:
+                kind = { DBG_FUNC_START: 'START', DBG_FUNC_END: 'END  ' }.get(func, 'NONE ')
+                extra = '' if duration is None else '  [{:.1f} us]'.format(duration / 1000.0)
+                print('{:>14.1f} {:>10}  {}{} {} {}{}'.format((ts - base_ts) / 1000.0, tid, '  ' * d, kind, name,
+                      ' '.join('0x{:x}'.format(a) for a in evargs), extra))
+            if func == DBG_FUNC_START:
+                depth[tid] = d + 1
+        print('')
+
+    print('{} records, {} threads, {:.1f} ms, {} dropped'.format(len(records), len(set(r[1] for r in records)),
+          (records[-1][0] - base_ts) / 1e6, dropped))
+    print('')
+    print('{:<28} {:>9} {:>12} {:>10} {:>10} {:>10} {:>10}'.format('event', 'count', 'total(us)', 'avg(us)', 'p50(us)', 'p99(us)', 'max(us)'))
+    for name, values in sorted(latencies.items(), key=lambda kv: -sum(kv[1])):
+        values.sort()
+        total = sum(values)
+        print('{:<28} {:>9} {:>12.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}'.format(name, len(values), total / 1000.0,
+              total / 1000.0 / len(values), percentile(values, 50) / 1000.0, percentile(values, 99) / 1000.0, values[-1] / 1000.0))
+
+    unmatched_start = {}
+    for (tid, code), stack in stacks.items():
+        if stack:
+            name = names.get(code, '0x{:08x}'.format(code))
+            unmatched_start[name] = unmatched_start.get(name, 0) + len(stack)
+    if unmatched_start or unmatched_end:
+        print('')
+        print('Unmatched events (ring wrapped, trace reset or early return):')
+        for name in sorted(set(unmatched_start) | set(unmatched_end)):
+            print('  {:<28} start {:>6} end {:>6}'.format(name, unmatched_start.get(name, 0), unmatched_end.get(name, 0)))
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
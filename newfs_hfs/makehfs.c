@@ -1416,6 +1416,42 @@ clear_journal_dev(const char *dev_name)
     close(fd);
     return 0;
 }
+
+/*
+ * A journal kept in an image file (for the livefiles plugin, which is
+ * handed the journal as a file descriptor) has no media UUID to record.
+ * Make the file big enough to hold the journal and zero its header so
+ * that nothing stale gets replayed before the journal is initialized.
+ */
+static int
+clear_journal_file(const char *file_name, off_t journal_size, UInt32 sector_size)
+{
+    struct stat st;
+    void *zeroes;
+    int fd;
+
+    fd = open(file_name, O_RDWR);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+	printf("Failed to open the journal file %s (%s)\n", file_name, strerror(errno));
+	if (fd >= 0)
+	    close(fd);
+	return -1;
+    }
+
+    zeroes = calloc(1, sector_size);
+    if (zeroes == NULL ||
+        (st.st_size < journal_size && ftruncate(fd, journal_size) != 0) ||
+        pwrite(fd, zeroes, sector_size, 0) != (ssize_t)sector_size) {
+	printf("Failed to initialize the journal file %s (%s)\n", file_name, strerror(errno));
+	free(zeroes);
+	close(fd);
+	return -1;
+    }
+
+    free(zeroes);
+    close(fd);
+    return 0;
+}
 #endif /* !(TARGET_OS_IPHONE) */
 
 
@@ -1439,8 +1475,14 @@ WriteJournalInfo(const DriveInfo *driveInfo, UInt64 startingSector,
 		jibp->flags = 0;
 
 		char uuid_str[64];
+		struct stat st;
 
-		if (get_dev_uuid(dp->journalDevice, uuid_str, sizeof(uuid_str)) == 0) {
+		if (stat(dp->journalDevice, &st) == 0 && S_ISREG(st.st_mode)) {
+			// no uuid; whoever mounts the volume supplies the journal file.
+			if (clear_journal_file(dp->journalDevice, dp->journalSize, driveInfo->physSectorSize) != 0) {
+				return -1;
+			}
+		} else if (get_dev_uuid(dp->journalDevice, uuid_str, sizeof(uuid_str)) == 0) {
 			strlcpy((char *)&jibp->reserved[0], uuid_str, sizeof(jibp->reserved));
 
 			// we also need to blast out some zeros to the journal device
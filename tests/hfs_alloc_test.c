@@ -44,6 +44,8 @@
 #include <mach/mach.h>
 
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #define HFS_ALLOC_TEST 1
 #define RANGELIST_TEST 1
@@ -344,6 +346,9 @@ short MacToVFSError(OSErr err)
 #define min(a, b)	\
 	({ typeof(a) a_ = (a); typeof(b) b_ = (b); a_ < b_ ? a_ : b_; })
 
+#define max(a, b)	\
+	({ typeof(a) a_ = (a); typeof(b) b_ = (b); a_ > b_ ? a_ : b_; })
+
 errno_t hfs_find_free_extents(struct hfsmount *hfsmp,
 							  void (*callback)(void *data, off_t), void *callback_arg);
 
@@ -413,6 +418,18 @@ void hfs_assert_fail(const char *file, unsigned line, const char *expr)
 
 static void *bitmap;
 
+// Allocator work counted by the benchmark (-b)
+static struct {
+	bool		in_alloc;			// only count work done by BlockAllocate
+	uint64_t	bitmap_bytes;
+	uint64_t	bitmap_scans;
+	uint64_t	ext_cache_lookups;
+	uint64_t	ext_cache_hits;
+	uint64_t	summary_lookups;
+	uint64_t	summary_hits;
+	uint64_t	summary_skipped;	// blocks the summary table let us skip
+} alloc_stats;
+
 typedef struct buf {
 	void *ptr;
 	int size;
@@ -459,6 +476,9 @@ errno_t buf_meta_bread(__unused vnode_t vp, daddr64_t blkno, int size,
 	bp->ptr  = bitmap + blkno * 4096;
 	bp->size = size;
 
+	if (alloc_stats.in_alloc)
+		alloc_stats.bitmap_bytes += size;
+
 	*bpp = bp;
 
 	return 0;
@@ -602,8 +622,403 @@ hfs_find_free_extents_test(hfsmount_t *hfsmp)
 	return 0;
 }
 
-int main(void)
+/*
+ * Benchmark mode (-b): replay allocation/free traces against a bitmap that
+ * has been aged to the requested fragmentation and report how hard the
+ * allocator had to work.  Events are collected through the allocator's
+ * kdebug tracepoints, which VolumeAllocation.c routes to
+ * hfs_alloc_test_trace when HFS_ALLOC_TEST is set.
+ */
+
+#define ALLOC_BENCH_DEFAULT_BLOCKS		1000000
+#define ALLOC_BENCH_DEFAULT_FRAG		30
+#define ALLOC_BENCH_SEED				0x5eed
+
+void hfs_alloc_test_trace(uint32_t code, uintptr_t a, uintptr_t b,
+						  uintptr_t c, __unused uintptr_t d)
+{
+	if (!alloc_stats.in_alloc)
+		return;
+
+	switch (code) {
+		case HFSDBG_ALLOC_FIND_KNOWN | DBG_FUNC_END:
+			++alloc_stats.ext_cache_lookups;
+			if ((int)a == 0)
+				++alloc_stats.ext_cache_hits;
+			break;
+		case HFSDBG_FIND_SUMMARY_FREE | DBG_FUNC_END:
+			++alloc_stats.summary_lookups;
+			if ((int)a == 0) {
+				++alloc_stats.summary_hits;
+				alloc_stats.summary_skipped += c - b;
+			}
+			break;
+		case HFSDBG_ALLOC_ANY_BITMAP | DBG_FUNC_START:
+		case HFSDBG_BLOCK_FIND_CONTIG | DBG_FUNC_START:
+			++alloc_stats.bitmap_scans;
+			break;
+	}
+}
+
+typedef struct bench_file {
+	uint32_t	blocks;
+	uint32_t	nextents;
+	uint32_t	capacity;
+	HFSPlusExtentDescriptor *extents;
+} bench_file_t;
+
+typedef struct bench {
+	hfsmount_t	mnt;
+	cnode_t		alloc_cp;
+	struct journal jnl;
+	uint32_t	nfiles;
+	bench_file_t *files;
+	uint64_t	allocs;
+	uint64_t	alloc_ns;
+	uint64_t	seed;
+} bench_t;
+
+static uint32_t bench_rand(bench_t *b)
+{
+	// xorshift64*
+	b->seed ^= b->seed >> 12;
+	b->seed ^= b->seed << 25;
+	b->seed ^= b->seed >> 27;
+	return (uint32_t)((b->seed * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static uint32_t bench_range(bench_t *b, uint32_t lo, uint32_t hi)
+{
+	return lo + bench_rand(b) % (hi - lo + 1);
+}
+
+static uint64_t bench_time_ns(void)
+{
+	return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+static bool bench_bit_set(uint32_t block)
+{
+	return ((uint8_t *)bitmap)[block / 8] & (0x80 >> (block % 8));
+}
+
+/*
+ * Build a fresh volume and age it: walk the bitmap in runs of 1-32
+ * blocks, marking each run allocated with probability @frag percent.
+ */
+static void bench_mount(bench_t *b, uint32_t blocks, uint32_t frag)
+{
+	size_t bitmap_size = howmany(blocks, 8);
+
+	memset(b, 0, sizeof(*b));
+	b->seed = ALLOC_BENCH_SEED;
+	b->alloc_cp.c_blocks = (uint32_t)howmany(bitmap_size, 4096);
+
+	free(bitmap);
+	bitmap = calloc(b->alloc_cp.c_blocks, 4096);
+
+	b->mnt = (struct hfsmount){
+		.allocLimit = blocks,
+		.totalBlocks = blocks,
+		.freeBlocks = blocks,
+		.blockSize = 4096,
+		.vcbVBMIOSize = 4096,
+		.hfs_allocation_cp = &b->alloc_cp,
+		.vcbSigWord = kHFSPlusSigWord,
+		.jnl = &b->jnl,
+		.hfs_logical_bytes = (uint64_t)blocks * 4096,
+	};
+
+	assert(!hfs_init_summary(&b->mnt));
+
+	/*
+	 * Bits past the end of the volume are in use so that frees near the
+	 * end don't coalesce with blocks that don't exist.
+	 */
+	for (uint32_t block = blocks; block < b->alloc_cp.c_blocks * 4096 * 8; ++block)
+		((uint8_t *)bitmap)[block / 8] |= 0x80 >> (block % 8);
+
+	for (uint32_t block = 0; block < blocks; ) {
+		uint32_t run = min(bench_range(b, 1, 32), blocks - block);
+
+		if (bench_range(b, 0, 99) < frag) {
+			assert_no_err(BlockMarkAllocated(&b->mnt, block, run));
+			b->mnt.freeBlocks -= run;
+		}
+		block += run;
+	}
+
+	memset(&alloc_stats, 0, sizeof(alloc_stats));
+}
+
+static void bench_unmount(bench_t *b)
+{
+	for (uint32_t i = 0; i < b->nfiles; ++i)
+		free(b->files[i].extents);
+	free(b->files);
+	free(b->mnt.hfs_summary_table);
+}
+
+static bench_file_t *bench_new_file(bench_t *b)
+{
+	b->files = realloc(b->files, (b->nfiles + 1) * sizeof(bench_file_t));
+	assert(b->files);
+	memset(&b->files[b->nfiles], 0, sizeof(bench_file_t));
+	return &b->files[b->nfiles++];
+}
+
+static OSErr bench_allocate(bench_t *b, uint32_t hint, uint32_t min_blocks,
+							uint32_t max_blocks, uint32_t flags,
+							uint32_t *start, uint32_t *count)
+{
+	uint64_t t = bench_time_ns();
+	OSErr err;
+
+	alloc_stats.in_alloc = true;
+	err = BlockAllocate(&b->mnt, hint, min_blocks, max_blocks, flags, start, count);
+	alloc_stats.in_alloc = false;
+
+	b->alloc_ns += bench_time_ns() - t;
+	++b->allocs;
+
+	return err;
+}
+
+/*
+ * Grow @f by @blocks the way ExtendFileC does: ask for a contiguous run
+ * just past the file's last extent and, failing that, take whatever the
+ * allocator will give us.
+ */
+static OSErr bench_extend(bench_t *b, bench_file_t *f, uint32_t blocks)
+{
+	while (blocks) {
+		HFSPlusExtentDescriptor *last = f->nextents ? &f->extents[f->nextents - 1] : NULL;
+		uint32_t hint = last ? last->startBlock + last->blockCount : 0;
+		uint32_t start, count;
+		OSErr err;
+
+		err = bench_allocate(b, hint, blocks, blocks, HFS_ALLOC_FORCECONTIG,
+							 &start, &count);
+		if (err == dskFulErr)
+			err = bench_allocate(b, hint, 1, blocks, 0, &start, &count);
+		if (err)
+			return err;
+
+		if (last && start == hint) {
+			last->blockCount += count;
+		} else {
+			if (f->nextents == f->capacity) {
+				f->capacity = f->capacity ? f->capacity * 2 : 4;
+				f->extents = realloc(f->extents, f->capacity * sizeof(*f->extents));
+				assert(f->extents);
+			}
+			f->extents[f->nextents++] = (HFSPlusExtentDescriptor){
+				.startBlock = start,
+				.blockCount = count,
+			};
+		}
+		f->blocks += count;
+		blocks -= count;
+	}
+
+	return 0;
+}
+
+static void bench_delete(bench_t *b, uint32_t i)
 {
+	bench_file_t *f = &b->files[i];
+
+	for (uint32_t e = 0; e < f->nextents; ++e)
+		assert_no_err(BlockDeallocate(&b->mnt, f->extents[e].startBlock,
+									  f->extents[e].blockCount, 0));
+	free(f->extents);
+
+	b->files[i] = b->files[--b->nfiles];
+}
+
+static uint32_t bench_used_pct(bench_t *b)
+{
+	return (uint32_t)(100 - (uint64_t)b->mnt.freeBlocks * 100 / b->mnt.totalBlocks);
+}
+
+static OSErr bench_create(bench_t *b, uint32_t blocks)
+{
+	bench_file_t *f = bench_new_file(b);
+	OSErr err = bench_extend(b, f, blocks);
+
+	if (err && !f->blocks)
+		bench_delete(b, b->nfiles - 1);
+
+	return err;
+}
+
+static void bench_report(bench_t *b, const char *name)
+{
+	uint32_t free_extents = 0, largest = 0, run = 0, free_blocks = 0;
+	uint64_t file_extents = 0;
+	uint32_t max_file_extents = 0;
+
+	for (uint32_t block = 0; block <= b->mnt.totalBlocks; ++block) {
+		if (block < b->mnt.totalBlocks && !bench_bit_set(block)) {
+			++run;
+			continue;
+		}
+		if (run) {
+			++free_extents;
+			free_blocks += run;
+			largest = max(largest, run);
+			run = 0;
+		}
+	}
+	assert(free_blocks == b->mnt.freeBlocks);
+
+	for (uint32_t i = 0; i < b->nfiles; ++i) {
+		file_extents += b->files[i].nextents;
+		max_file_extents = max(max_file_extents, b->files[i].nextents);
+	}
+
+	printf("%-10s %8llu allocs %10.0f allocs/s %8.1f ns/alloc %9.1f bitmap B/alloc "
+		   "%6.2f scans/alloc ext-cache %5.1f%% (%llu) summary %5.1f%% (%llu, %.0f blks skipped) "
+		   "used %3u%% free-extents %u largest %u files %u extents/file %.2f (max %u)\n",
+		   name, (unsigned long long)b->allocs,
+		   b->alloc_ns ? (double)b->allocs * 1000000000.0 / b->alloc_ns : 0.0,
+		   b->allocs ? (double)b->alloc_ns / b->allocs : 0.0,
+		   b->allocs ? (double)alloc_stats.bitmap_bytes / b->allocs : 0.0,
+		   b->allocs ? (double)alloc_stats.bitmap_scans / b->allocs : 0.0,
+		   alloc_stats.ext_cache_lookups
+		   ? 100.0 * alloc_stats.ext_cache_hits / alloc_stats.ext_cache_lookups : 0.0,
+		   (unsigned long long)alloc_stats.ext_cache_lookups,
+		   alloc_stats.summary_lookups
+		   ? 100.0 * alloc_stats.summary_hits / alloc_stats.summary_lookups : 0.0,
+		   (unsigned long long)alloc_stats.summary_lookups,
+		   alloc_stats.summary_hits
+		   ? (double)alloc_stats.summary_skipped / alloc_stats.summary_hits : 0.0,
+		   bench_used_pct(b), free_extents, largest, b->nfiles,
+		   b->nfiles ? (double)file_extents / b->nfiles : 0.0, max_file_extents);
+}
+
+// Many files appended to in turn, e.g. logs or concurrent downloads
+static void bench_growth(uint32_t blocks, uint32_t frag)
+{
+	bench_t b;
+
+	bench_mount(&b, blocks, frag);
+
+	for (uint32_t i = 0; i < 64; ++i)
+		bench_new_file(&b);
+
+	while (bench_used_pct(&b) < frag + (100 - frag) / 2) {
+		uint32_t i = bench_rand(&b) % b.nfiles;
+
+		if (bench_extend(&b, &b.files[i], bench_range(&b, 1, 16)))
+			break;
+	}
+
+	bench_report(&b, "growth");
+	bench_unmount(&b);
+}
+
+// Lots of small files created one after another
+static void bench_small(uint32_t blocks, uint32_t frag)
+{
+	bench_t b;
+
+	bench_mount(&b, blocks, frag);
+
+	while (bench_used_pct(&b) < frag + (100 - frag) / 2) {
+		if (bench_create(&b, bench_range(&b, 1, 8)))
+			break;
+	}
+
+	bench_report(&b, "small");
+	bench_unmount(&b);
+}
+
+// Fill with small files, delete half of them, then write larger files
+static void bench_holes(uint32_t blocks, uint32_t frag)
+{
+	bench_t b;
+
+	bench_mount(&b, blocks, frag);
+
+	while (bench_used_pct(&b) < frag + (100 - frag) * 7 / 10) {
+		if (bench_create(&b, bench_range(&b, 1, 8)))
+			break;
+	}
+
+	for (uint32_t n = b.nfiles / 2; n; --n)
+		bench_delete(&b, bench_rand(&b) % b.nfiles);
+
+	b.allocs = b.alloc_ns = 0;
+	memset(&alloc_stats, 0, sizeof(alloc_stats));
+
+	while (bench_used_pct(&b) < 90) {
+		if (bench_create(&b, bench_range(&b, 16, 256)))
+			break;
+	}
+
+	bench_report(&b, "holes");
+	bench_unmount(&b);
+}
+
+// Churn on a volume that stays around 97% full
+static void bench_nearfull(uint32_t blocks, uint32_t frag)
+{
+	bench_t b;
+
+	bench_mount(&b, blocks, frag);
+
+	while (bench_used_pct(&b) < 97) {
+		if (bench_create(&b, bench_range(&b, 1, 64)))
+			break;
+	}
+
+	b.allocs = b.alloc_ns = 0;
+	memset(&alloc_stats, 0, sizeof(alloc_stats));
+
+	for (uint32_t n = 5000; n && b.nfiles; --n) {
+		bench_delete(&b, bench_rand(&b) % b.nfiles);
+		while (bench_used_pct(&b) < 97) {
+			if (bench_create(&b, bench_range(&b, 1, 64)))
+				break;
+		}
+	}
+
+	bench_report(&b, "nearfull");
+	bench_unmount(&b);
+}
+
+static int hfs_alloc_bench(int argc, char *argv[])
+{
+	uint32_t blocks = argc > 0 ? (uint32_t)strtoul(argv[0], NULL, 0)
+							   : ALLOC_BENCH_DEFAULT_BLOCKS;
+	uint32_t frag = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0)
+							 : ALLOC_BENCH_DEFAULT_FRAG;
+
+	if (blocks < 65536 || frag > 90) {
+		fprintf(stderr, "usage: hfs_alloc_test -b [blocks >= 65536] [fragmentation%% <= 90]\n");
+		return 1;
+	}
+
+	hfs_kdebug_allocation = HFSDBG_ALLOC_ENABLED | HFSDBG_BITMAP_ENABLED;
+
+	printf("bench: %u blocks, %u%% pre-allocated in 1-32 block runs\n", blocks, frag);
+
+	bench_growth(blocks, frag);
+	bench_small(blocks, frag);
+	bench_holes(blocks, frag);
+	bench_nearfull(blocks, frag);
+
+	hfs_kdebug_allocation = 0;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "-b"))
+		return hfs_alloc_bench(argc - 2, argv + 2);
+
 	const int blocks = 100000;
 
 	size_t bitmap_size = howmany(blocks, 8);
@@ -0,0 +1,1472 @@
+/*
+ * Copyright (c) 2026 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+//  Radar Component: HFS | X
+
+/*
+ * Userspace harness for the B-tree manager (core/BTree*.c).
+ *
+ * The B-tree sources are compiled against an in-memory node store that
+ * stands in for hfs_btreeio.c and the buffer cache.  Trees are laid out
+ * like the catalog file (HFSPlusCatalogKey keys, folder and file sized
+ * records) and driven through the public BT* interfaces.
+ *
+ *	hfs_btree_test				fixed-seed fuzz run plus a small benchmark
+ *	hfs_btree_test -f seed ops	differential fuzz against a sorted array
+ *	hfs_btree_test -b [records]	benchmark insert/search/iterate/scan/delete
+ *	hfs_btree_test -n nodesize	node size for -f and -b (4096-32768, default 8192)
+ */
+
+#include <sys/param.h>
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <libkern/OSByteOrder.h>
+#include <hfs/hfs_format.h>
+
+#include "test-utils.h"
+
+#include <stdio.h>
+
+#define HFS_BTREE_TEST 1
+#define KERNEL 1
+#define HFS 1
+#define DEBUG 1
+
+/*
+ * hfs_macos_defs.h, hfs_btreeio.h and hfs_endian.h pull in kernel-only
+ * headers; provide what the B-tree code needs from them here instead.
+ */
+#define __HFS_MACOS_TYPES__
+#define _HFS_BTREEIO_H_
+#define __HFS_ENDIAN_H__
+
+typedef int32_t				OSStatus;
+typedef int16_t				OSErr;
+typedef bool				Boolean;
+typedef char *				Ptr;
+typedef long				Size;
+typedef u_int32_t			ItemCount;
+typedef u_int32_t			ByteCount;
+typedef u_int8_t *			BytePtr;
+typedef u_int8_t			Byte;
+typedef u_int16_t			UniChar;
+typedef unsigned char		Str31[32];
+typedef const unsigned char *	ConstUTF8Param;
+typedef struct vnode*		FileReference;
+typedef struct filefork		FCB;
+typedef int64_t				daddr64_t;
+
+#define EXTERN_API(_type)				extern _type
+#define EXTERN_API_C(_type)				extern _type
+#define CALLBACK_API_C(_type, _name)	_type ( * _name)
+#define TARGET_API_MACOS_X				1
+
+#ifndef nil
+#define nil		NULL
+#endif
+
+enum {
+	noErr			= 0,
+	dskFulErr		= -34,		/*disk full*/
+	bdNamErr		= -37,		/*there may be no bad names in the final system!*/
+	paramErr		= -50,		/*error in user parameter list*/
+	memFullErr		= -108,		/*Not enough room in heap zone*/
+	fileBoundsErr		= -1309,	/*file's EOF, offset, mark or size is too big*/
+};
+
+#define BlockMoveData(src, dest, len)	bcopy((src), (dest), (len))
+#define ClearMemory(start, length)		bzero((start), (size_t)(length));
+#define REQUIRE_FILE_LOCK(vp, s)		((void)0)
+
+#define SWAP_BE16(x)		OSSwapBigToHostInt16(x)
+#define SWAP_BE32(x)		OSSwapBigToHostInt32(x)
+
+enum HFSBTSwapDirection {
+	kSwapBTNodeBigToHost		=	0,
+	kSwapBTNodeHostToBig		=	1,
+	kSwapBTNodeHeaderRecordOnly	=	3
+};
+
+#define E_NONE					0
+#define HFS_WRITEABLE_MEDIA		0x00004
+
+#ifndef NOCRED
+#define NOCRED					NULL
+#endif
+
+static void DebugStr(const char *debuggerMsg)
+{
+	assert_fail("%s", debuggerMsg);
+}
+
+struct journal;
+struct rl_entry;
+
+typedef struct hfsmount {
+	u_int32_t	blockSize;
+	u_int32_t	hfs_physical_block_size;
+	u_int32_t	hfs_logical_block_size;
+	u_int32_t	hfs_flags;
+	u_int16_t	vcbSigWord;
+	struct journal *jnl;
+	u_int8_t	vcbVN[256];
+} hfsmount_t;
+
+typedef hfsmount_t ExtendedVCB;
+
+typedef struct cnode {
+	u_int32_t	c_fileid;
+} cnode_t;
+
+struct filefork {
+	struct cnode   *ff_cp;
+	struct vnode   *ff_vp;
+	off_t			ff_size;
+	u_int32_t		ff_clumpsize;
+	void		   *ff_sysfileinfo;
+};
+
+#define fcbEOF			ff_size
+#define fcbBTCBPtr		ff_sysfileinfo
+
+/*
+ * The B-tree "file": every node is a separate allocation so that node
+ * pointers handed out by GetBTreeBlock stay valid while the file grows.
+ */
+typedef struct vnode {
+	struct filefork	v_fork;
+	struct cnode	v_cnode;
+	hfsmount_t	   *v_mount;
+	u_int32_t		v_node_size;
+	u_int32_t		v_node_count;
+	u_int8_t	  **v_nodes;
+
+	u_int64_t		v_gets;
+	u_int64_t		v_releases;
+	u_int64_t		v_dirty;
+	u_int64_t		v_extends;
+} *vnode_t;
+
+#define VTOF(vp)		(&(vp)->v_fork)
+#define FTOV(fp)		((fp)->ff_vp)
+#define FTOC(fp)		((fp)->ff_cp)
+#define VTOC(vp)		(&(vp)->v_cnode)
+#define VTOHFS(vp)		((vp)->v_mount)
+#define VTOVCB(vp)		((vp)->v_mount)
+#define FCBTOHFS(fp)	(FTOV(fp)->v_mount)
+#define FCBTOVCB(fp)	(FTOV(fp)->v_mount)
+
+#define _hfs_malloc_zero(size)                                 \
+({                                                             \
+        void *_ptr = NULL;                                     \
+        typeof(size) _size = size;                             \
+        _ptr = calloc(1, _size);                               \
+        _ptr;                                                  \
+})
+
+#define _hfs_free(ptr, size)                                   \
+({                                                             \
+        __unused typeof(size) _size = size;                    \
+        typeof(ptr) _ptr = ptr;                                \
+        if (_ptr) {                                            \
+                free(_ptr);                                    \
+        }                                                      \
+})
+
+#define hfs_malloc_type(type) _hfs_malloc_zero(sizeof(type))
+#define hfs_free_type(ptr, type) _hfs_free(ptr, sizeof(type))
+#define hfs_new_zero(type, count) ((type *)_hfs_malloc_zero(sizeof(type) * (count)))
+#define hfs_new_data(type, count) hfs_new_zero(type, count)
+#define hfs_delete(ptr, type, count) _hfs_free(ptr, sizeof(type) * (count))
+#define hfs_delete_data(ptr, type, count) hfs_delete(ptr, type, count)
+
+#define OSCompareAndSwap(oldValue, newValue, address) \
+	__sync_bool_compare_and_swap((address), (oldValue), (newValue))
+
+#define min(a, b)	\
+	({ typeof(a) a_ = (a); typeof(b) b_ = (b); a_ < b_ ? a_ : b_; })
+
+#define max(a, b)	\
+	({ typeof(a) a_ = (a); typeof(b) b_ = (b); a_ > b_ ? a_ : b_; })
+
+#include "../core/BTreesPrivate.h"
+#include "../core/BTreeScanner.h"
+
+typedef enum {
+	HFS_INCONSISTENCY_DETECTED,
+
+	// Used when unable to rollback an operation that failed
+	HFS_ROLLBACK_FAILED,
+
+	// Used when the latter part of an operation failed, but we chose not to roll back
+	HFS_OP_INCOMPLETE,
+
+	// Used when someone told us to force an fsck on next mount
+	HFS_FSCK_FORCED,
+} hfs_inconsistency_reason_t;
+
+static void hfs_mark_inconsistent(__unused struct hfsmount *hfsmp,
+								  __unused hfs_inconsistency_reason_t reason)
+{
+	assert(false);
+}
+
+Boolean NodesAreContiguous(__unused ExtendedVCB *vcb, __unused FCB *fcb,
+						   __unused u_int32_t nodeSize)
+{
+	return true;
+}
+
+short MacToVFSError(OSErr err)
+{
+	if (err >= 0)
+		return err;
+
+	switch (err) {
+		case dskFulErr:
+		case btNoSpaceAvail:
+			return ENOSPC;
+		case memFullErr:
+			return ENOMEM;
+		case btExists:
+			return EEXIST;
+		case btNotFound:
+			return ENOENT;
+		case paramErr:
+			return EINVAL;
+		default:
+			return EIO;
+	}
+}
+
+static void microuptime(struct timeval *tv)
+{
+	gettimeofday(tv, NULL);
+}
+
+// Nodes are kept in host order, so there is nothing to swap
+static int hfs_swap_BTNode(__unused BlockDescriptor *src, __unused vnode_t vp,
+						   __unused enum HFSBTSwapDirection direction,
+						   __unused u_int8_t allow_empty_node)
+{
+	return 0;
+}
+
+void BTUpdateReserve(__unused BTreeControlBlockPtr btreePtr, __unused int nodes)
+{
+}
+
+static void bt_store_grow(vnode_t vp, u_int32_t node_count)
+{
+	if (node_count <= vp->v_node_count)
+		return;
+
+	vp->v_nodes = realloc(vp->v_nodes, node_count * sizeof(vp->v_nodes[0]));
+	assert(vp->v_nodes);
+
+	for (u_int32_t i = vp->v_node_count; i < node_count; ++i) {
+		vp->v_nodes[i] = calloc(1, vp->v_node_size);
+		assert(vp->v_nodes[i]);
+	}
+
+	vp->v_node_count = node_count;
+	vp->v_fork.ff_size = (off_t)node_count * vp->v_node_size;
+}
+
+static void bt_store_free(vnode_t vp)
+{
+	for (u_int32_t i = 0; i < vp->v_node_count; ++i)
+		free(vp->v_nodes[i]);
+	free(vp->v_nodes);
+	free(vp->v_mount);
+	free(vp);
+}
+
+/*
+ * hfs_btreeio.c replacements.  The node pointer doubles as the block
+ * header since there is no buffer to track.
+ */
+
+OSStatus SetBTreeBlockSize(FileReference vp, ByteCount blockSize,
+						   __unused ItemCount minBlockCount)
+{
+	BTreeControlBlockPtr	bTreePtr;
+
+	assert(vp != NULL);
+	assert(blockSize >= kMinNodeSize);
+
+	bTreePtr = (BTreeControlBlockPtr)VTOF(vp)->fcbBTCBPtr;
+	bTreePtr->nodeSize = blockSize;
+
+	return E_NONE;
+}
+
+OSStatus GetBTreeBlock(FileReference vp, u_int32_t blockNum,
+					   __unused GetBlockOptions options, BlockDescriptor *block)
+{
+	off_t offset = (off_t)blockNum * block->blockSize;
+
+	if (block->blockSize > vp->v_node_size
+		|| offset + block->blockSize > vp->v_fork.ff_size) {
+		block->blockHeader = NULL;
+		block->buffer = NULL;
+		return EIO;
+	}
+
+	block->buffer = vp->v_nodes[offset / vp->v_node_size] + offset % vp->v_node_size;
+	block->blockHeader = block->buffer;
+	block->blockNum = blockNum;
+	block->blockReadFromDisk = false;
+	block->isModified = 0;
+
+	++vp->v_gets;
+
+	return E_NONE;
+}
+
+OSStatus ReleaseBTreeBlock(FileReference vp, BlockDescPtr blockPtr,
+						   ReleaseBlockOptions options)
+{
+	if (blockPtr->blockHeader == NULL)
+		return -1;
+
+	if (!(options & kTrashBlock)
+		&& (options & (kForceWriteBlock | kMarkBlockDirty))) {
+		++vp->v_dirty;
+	}
+
+	++vp->v_releases;
+	blockPtr->blockHeader = NULL;
+	blockPtr->isModified = 0;
+
+	return E_NONE;
+}
+
+OSStatus ExtendBTreeFile(FileReference vp, FSSize minEOF, __unused FSSize maxEOF)
+{
+	FCB		   *filePtr = VTOF(vp);
+	u_int64_t	bytesToAdd;
+
+	if ((off_t)minEOF > filePtr->fcbEOF) {
+		bytesToAdd = minEOF - filePtr->fcbEOF;
+
+		if (bytesToAdd < filePtr->ff_clumpsize)
+			bytesToAdd = filePtr->ff_clumpsize;
+
+		bytesToAdd = roundup(bytesToAdd, vp->v_node_size);
+
+		bt_store_grow(vp, (u_int32_t)((filePtr->fcbEOF + bytesToAdd)
+									  / vp->v_node_size));
+		++vp->v_extends;
+	}
+
+	return E_NONE;
+}
+
+void ModifyBlockStart(__unused FileReference vp, BlockDescPtr blockPtr)
+{
+	blockPtr->isModified = 1;
+}
+
+/*
+ * Buffer cache stubs for BTreeScanner.c and BTZeroUnusedNodes().
+ */
+
+typedef struct buf {
+	void *ptr;
+	int size;
+	bool owned;
+} *buf_t;
+
+#define BLK_META		0x00000008
+#define B_LOCKED		0x00000010
+
+static int hfs_bmap(struct vnode *vp, daddr64_t bn, struct vnode **vpp,
+					daddr64_t *bnp, unsigned int *runp)
+{
+	u_int32_t nodes = (u_int32_t)(vp->v_fork.ff_size / vp->v_node_size);
+
+	if (bn < 0 || bn >= nodes)
+		return EIO;
+
+	*vpp = vp;
+	*bnp = bn;
+	*runp = nodes - (u_int32_t)bn - 1;
+
+	return E_NONE;
+}
+
+static errno_t buf_meta_bread(vnode_t vp, daddr64_t blkno, int size,
+							  __unused void *cred, buf_t *bpp)
+{
+	buf_t bp = calloc(1, sizeof(struct buf));
+	u_int32_t count = size / vp->v_node_size;
+
+	assert(blkno + count <= vp->v_node_count);
+
+	bp->ptr = malloc(size);
+	bp->size = size;
+	bp->owned = true;
+
+	for (u_int32_t i = 0; i < count; ++i)
+		memcpy(bp->ptr + i * vp->v_node_size, vp->v_nodes[blkno + i], vp->v_node_size);
+
+	*bpp = bp;
+
+	return 0;
+}
+
+static buf_t buf_getblk(vnode_t vp, daddr64_t blkno, int size,
+						__unused int slpflag, __unused int slptimeo,
+						__unused int operation)
+{
+	buf_t bp;
+
+	if (blkno >= vp->v_node_count || (u_int32_t)size != vp->v_node_size)
+		return NULL;
+
+	bp = calloc(1, sizeof(struct buf));
+	bp->ptr = vp->v_nodes[blkno];
+	bp->size = size;
+
+	return bp;
+}
+
+static void buf_brelse(buf_t bp)
+{
+	if (bp->owned)
+		free(bp->ptr);
+	free(bp);
+}
+
+static uint32_t buf_count(buf_t bp)
+{
+	return bp->size;
+}
+
+static uintptr_t buf_dataptr(buf_t bp)
+{
+	return (uintptr_t)bp->ptr;
+}
+
+static int32_t buf_flags(__unused buf_t bp)
+{
+	return 0;
+}
+
+static void buf_markinvalid(__unused buf_t bp)
+{
+}
+
+static void buf_markaged(__unused buf_t bp)
+{
+}
+
+static void buf_clear(buf_t bp)
+{
+	bzero(bp->ptr, bp->size);
+}
+
+static void buf_bawrite(buf_t bp)
+{
+	buf_brelse(bp);
+}
+
+static int VNOP_BWRITE(buf_t bp)
+{
+	buf_brelse(bp);
+	return 0;
+}
+
+#include "../core/BTree.c"
+#include "../core/BTreeAllocate.c"
+#include "../core/BTreeMiscOps.c"
+#include "../core/BTreeNodeOps.c"
+#include "../core/BTreeTreeOps.c"
+#include "../core/BTreeScanner.c"
+
+#pragma mark -
+
+#define BT_TEST_DEFAULT_NODE_SIZE	8192
+#define BT_TEST_CLUMP_NODES			16
+#define BT_TEST_PARENTS				64
+#define BT_TEST_FUZZ_SEED			0x42547265
+#define BT_TEST_FUZZ_OPS			20000
+#define BT_TEST_FUZZ_CHECK_EVERY	500
+#define BT_TEST_BENCH_RECORDS		100000
+
+typedef struct bt_entry {
+	HFSPlusCatalogKey	key;
+	u_int32_t			cnid;
+	u_int16_t			rec_size;
+} bt_entry_t;
+
+typedef struct bt_model {
+	bt_entry_t		   *entries;
+	u_int32_t			count;
+	u_int32_t			capacity;
+} bt_model_t;
+
+typedef union bt_record {
+	int16_t					recordType;
+	HFSPlusCatalogFolder	folder;
+	HFSPlusCatalogFile		file;
+} bt_record_t;
+
+static u_int64_t bt_rand_state;
+
+static u_int32_t bt_rand(void)
+{
+	// xorshift64*
+	bt_rand_state ^= bt_rand_state >> 12;
+	bt_rand_state ^= bt_rand_state << 25;
+	bt_rand_state ^= bt_rand_state >> 27;
+	return (u_int32_t)((bt_rand_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static u_int64_t bt_time_ns(void)
+{
+	return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+/*
+ * Binary (case-sensitive) catalog key order: parent ID, then the raw
+ * UTF-16 name, shorter names first.
+ */
+static u_int64_t bt_tree_compares;
+static bool bt_sidecar;
+
+static int32_t bt_test_keycompare(HFSPlusCatalogKey *searchKey,
+								  HFSPlusCatalogKey *trialKey)
+{
+	u_int16_t len1, len2, n;
+
+	if (searchKey->parentID != trialKey->parentID)
+		return searchKey->parentID < trialKey->parentID ? -1 : 1;
+
+	len1 = searchKey->nodeName.length;
+	len2 = trialKey->nodeName.length;
+	n = min(len1, len2);
+
+	for (u_int16_t i = 0; i < n; ++i) {
+		UniChar c1 = searchKey->nodeName.unicode[i];
+		UniChar c2 = trialKey->nodeName.unicode[i];
+
+		if (c1 != c2)
+			return c1 < c2 ? -1 : 1;
+	}
+
+	if (len1 != len2)
+		return len1 < len2 ? -1 : 1;
+
+	return 0;
+}
+
+// What the B-tree calls, so that benchmarks can count compares
+static int32_t bt_tree_keycompare(HFSPlusCatalogKey *searchKey,
+								  HFSPlusCatalogKey *trialKey)
+{
+	++bt_tree_compares;
+	return bt_test_keycompare(searchKey, trialKey);
+}
+
+// Prefix summary for the -s sidecar mode, ordered like bt_test_keycompare
+static void bt_test_keyprefix(HFSPlusCatalogKey *key, u_int16_t skip,
+							  BTreeKeyPrefix *prefix)
+{
+	u_int16_t length = key->nodeName.length > skip ? key->nodeName.length - skip : 0;
+
+	prefix->major = key->parentID;
+	prefix->count = min(length, (u_int16_t)kBTKeyPrefixLength);
+	prefix->complete = length <= kBTKeyPrefixLength;
+	for (u_int16_t i = 0; i < prefix->count; ++i)
+		prefix->minor[i] = key->nodeName.unicode[skip + i];
+}
+
+static void bt_make_key(HFSPlusCatalogKey *key, u_int32_t parentID,
+						const UniChar *name, u_int16_t length)
+{
+	bzero(key, sizeof(*key));
+	key->parentID = parentID;
+	key->nodeName.length = length;
+	memcpy(key->nodeName.unicode, name, length * sizeof(UniChar));
+	key->keyLength = sizeof(key->parentID) + sizeof(key->nodeName.length)
+		+ length * sizeof(UniChar);
+}
+
+// Sequential, zero-padded names as a directory filled by a copy would get
+static void bt_make_seq_key(HFSPlusCatalogKey *key, u_int32_t parentID,
+							u_int32_t seq)
+{
+	char ascii[16];
+	UniChar name[16];
+	int len = snprintf(ascii, sizeof(ascii), "file_%08x", seq);
+
+	for (int i = 0; i < len; ++i)
+		name[i] = ascii[i];
+
+	bt_make_key(key, parentID, name, len);
+}
+
+/*
+ * Random names: mostly short names over a small alphabet (lots of shared
+ * prefixes and sibling collisions), some non-ASCII characters, and now
+ * and then a maximum length name to force large index keys.
+ */
+static void bt_make_random_key(HFSPlusCatalogKey *key)
+{
+	UniChar name[kHFSPlusMaxFileNameChars];
+	u_int32_t parentID = kHFSFirstUserCatalogNodeID + bt_rand() % BT_TEST_PARENTS;
+	u_int16_t len;
+
+	switch (bt_rand() % 32) {
+		case 0:
+			len = kHFSPlusMaxFileNameChars;
+			break;
+		case 1 ... 3:
+			len = 32 + bt_rand() % 96;
+			break;
+		default:
+			len = 1 + bt_rand() % 12;
+			break;
+	}
+
+	for (u_int16_t i = 0; i < len; ++i) {
+		if (bt_rand() % 16 == 0)
+			name[i] = 0x3040 + bt_rand() % 0x60;
+		else
+			name[i] = 'a' + bt_rand() % 6;
+	}
+
+	bt_make_key(key, parentID, name, len);
+}
+
+static u_int16_t bt_make_record(bt_record_t *rec, u_int32_t cnid, bool folder)
+{
+	bzero(rec, sizeof(*rec));
+
+	if (folder) {
+		rec->folder.recordType = kHFSPlusFolderRecord;
+		rec->folder.folderID = cnid;
+		rec->folder.createDate = cnid ^ 0x5a5a5a5a;
+		return sizeof(HFSPlusCatalogFolder);
+	}
+
+	rec->file.recordType = kHFSPlusFileRecord;
+	rec->file.fileID = cnid;
+	rec->file.createDate = cnid ^ 0x5a5a5a5a;
+	rec->file.dataFork.logicalSize = (u_int64_t)cnid << 12;
+
+	return sizeof(HFSPlusCatalogFile);
+}
+
+static void bt_check_record(const void *data, u_int16_t size,
+							const bt_entry_t *entry)
+{
+	bt_record_t expected;
+	u_int16_t expected_size;
+
+	expected_size = bt_make_record(&expected, entry->cnid,
+								   entry->rec_size == sizeof(HFSPlusCatalogFolder));
+
+	assert(size == entry->rec_size && size == expected_size);
+	assert(!memcmp(data, &expected, size));
+}
+
+static void bt_set_iterator(BTreeIterator *iterator, const HFSPlusCatalogKey *key)
+{
+	bzero(iterator, sizeof(*iterator));
+	memcpy(&iterator->key, key, key->keyLength + sizeof(key->keyLength));
+}
+
+#pragma mark -
+
+/*
+ * Create an empty catalog-shaped B-tree (header node only, with a clump
+ * of free nodes behind it) the same way hfs_create_attr_btree() lays out
+ * a new attributes file, then open it with BTOpenPath().
+ */
+static vnode_t bt_create(u_int16_t nodesize)
+{
+	vnode_t vp = calloc(1, sizeof(struct vnode));
+	hfsmount_t *hfsmp = calloc(1, sizeof(hfsmount_t));
+	BTNodeDescriptor *ndp;
+	BTHeaderRec *bthp;
+	u_int16_t *index;
+	u_int8_t *buffer;
+	u_int32_t offset;
+
+	hfsmp->blockSize = 4096;
+	hfsmp->hfs_physical_block_size = 4096;
+	hfsmp->hfs_logical_block_size = 512;
+	hfsmp->hfs_flags = HFS_WRITEABLE_MEDIA;
+	hfsmp->vcbSigWord = kHFSPlusSigWord;
+	strlcpy((char *)hfsmp->vcbVN, "hfs_btree_test", sizeof(hfsmp->vcbVN));
+
+	vp->v_mount = hfsmp;
+	vp->v_node_size = nodesize;
+	vp->v_cnode.c_fileid = kHFSCatalogFileID;
+	vp->v_fork.ff_cp = &vp->v_cnode;
+	vp->v_fork.ff_vp = vp;
+	vp->v_fork.ff_clumpsize = nodesize * BT_TEST_CLUMP_NODES;
+
+	bt_store_grow(vp, BT_TEST_CLUMP_NODES);
+
+	buffer = vp->v_nodes[0];
+	index = (u_int16_t *)buffer;
+
+	ndp = (BTNodeDescriptor *)buffer;
+	ndp->kind = kBTHeaderNode;
+	ndp->numRecords = 3;
+	offset = sizeof(BTNodeDescriptor);
+	index[(nodesize / 2) - 1] = offset;
+
+	bthp = (BTHeaderRec *)(buffer + offset);
+	bthp->nodeSize     = nodesize;
+	bthp->totalNodes   = BT_TEST_CLUMP_NODES;
+	bthp->freeNodes    = BT_TEST_CLUMP_NODES - 1;
+	bthp->clumpSize    = vp->v_fork.ff_clumpsize;
+	bthp->btreeType    = kHFSBTreeType;
+	bthp->attributes   = kBTVariableIndexKeysMask | kBTBigKeysMask;
+	bthp->maxKeyLength = kHFSPlusCatalogKeyMaximumLength;
+	bthp->keyCompareType = kHFSBinaryCompare;
+	offset += sizeof(BTHeaderRec);
+	index[(nodesize / 2) - 2] = offset;
+
+	offset += kBTreeHeaderUserBytes;
+	index[(nodesize / 2) - 3] = offset;
+
+	// Only the header node is in use
+	buffer[offset] = 0x80;
+
+	offset += nodesize - sizeof(BTNodeDescriptor) - sizeof(BTHeaderRec)
+			   - kBTreeHeaderUserBytes - (4 * sizeof(int16_t));
+	index[(nodesize / 2) - 4] = offset;
+
+	assert_no_err(BTOpenPath(VTOF(vp), (KeyCompareProcPtr)bt_tree_keycompare));
+	if (bt_sidecar)
+		assert_no_err(BTSetKeyPrefixProc(VTOF(vp), (KeyPrefixProcPtr)bt_test_keyprefix));
+
+	return vp;
+}
+
+static void bt_destroy(vnode_t vp)
+{
+	assert_no_err(BTClosePath(VTOF(vp)));
+	bt_store_free(vp);
+}
+
+static BTreeControlBlockPtr bt_btcb(vnode_t vp)
+{
+	return (BTreeControlBlockPtr)VTOF(vp)->fcbBTCBPtr;
+}
+
+static OSStatus bt_insert(vnode_t vp, const bt_entry_t *entry)
+{
+	BTreeIterator iterator;
+	bt_record_t rec;
+	FSBufferDescriptor btdata;
+
+	bt_set_iterator(&iterator, &entry->key);
+	btdata.bufferAddress = &rec;
+	btdata.itemSize = bt_make_record(&rec, entry->cnid,
+									 entry->rec_size == sizeof(HFSPlusCatalogFolder));
+	btdata.itemCount = 1;
+
+	return BTInsertRecord(VTOF(vp), &iterator, &btdata, btdata.itemSize);
+}
+
+static OSStatus bt_replace(vnode_t vp, const bt_entry_t *entry)
+{
+	BTreeIterator iterator;
+	bt_record_t rec;
+	FSBufferDescriptor btdata;
+
+	bt_set_iterator(&iterator, &entry->key);
+	btdata.bufferAddress = &rec;
+	btdata.itemSize = bt_make_record(&rec, entry->cnid,
+									 entry->rec_size == sizeof(HFSPlusCatalogFolder));
+	btdata.itemCount = 1;
+
+	return BTReplaceRecord(VTOF(vp), &iterator, &btdata, btdata.itemSize);
+}
+
+static OSStatus bt_delete(vnode_t vp, const HFSPlusCatalogKey *key)
+{
+	BTreeIterator iterator;
+
+	bt_set_iterator(&iterator, key);
+
+	return BTDeleteRecord(VTOF(vp), &iterator);
+}
+
+/*
+ * Look up a key.  If iterator is supplied its hint from a previous lookup
+ * is kept, which exercises the hint path in BTSearchRecord().
+ */
+static OSStatus bt_search(vnode_t vp, BTreeIterator *iterator,
+						  const HFSPlusCatalogKey *key,
+						  bt_record_t *rec, u_int16_t *size)
+{
+	BTreeIterator local;
+	FSBufferDescriptor btdata;
+
+	if (iterator == NULL) {
+		iterator = &local;
+		bt_set_iterator(iterator, key);
+	} else {
+		bzero(&iterator->key, sizeof(iterator->key));
+		memcpy(&iterator->key, key, key->keyLength + sizeof(key->keyLength));
+	}
+
+	btdata.bufferAddress = rec;
+	btdata.itemSize = sizeof(*rec);
+	btdata.itemCount = 1;
+
+	return BTSearchRecord(VTOF(vp), iterator, &btdata, size, iterator);
+}
+
+#pragma mark -
+
+static u_int32_t bt_model_find(const bt_model_t *model,
+							   const HFSPlusCatalogKey *key, bool *found)
+{
+	u_int32_t lo = 0, hi = model->count;
+
+	while (lo < hi) {
+		u_int32_t mid = lo + (hi - lo) / 2;
+		int32_t res = bt_test_keycompare((HFSPlusCatalogKey *)key,
+										 &model->entries[mid].key);
+
+		if (res == 0) {
+			*found = true;
+			return mid;
+		}
+		if (res < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	*found = false;
+	return lo;
+}
+
+static void bt_model_insert(bt_model_t *model, u_int32_t pos,
+							const bt_entry_t *entry)
+{
+	if (model->count == model->capacity) {
+		model->capacity = model->capacity ? model->capacity * 2 : 1024;
+		model->entries = realloc(model->entries,
+								 model->capacity * sizeof(bt_entry_t));
+		assert(model->entries);
+	}
+
+	memmove(&model->entries[pos + 1], &model->entries[pos],
+			(model->count - pos) * sizeof(bt_entry_t));
+	model->entries[pos] = *entry;
+	++model->count;
+}
+
+static void bt_model_remove(bt_model_t *model, u_int32_t pos)
+{
+	memmove(&model->entries[pos], &model->entries[pos + 1],
+			(model->count - pos - 1) * sizeof(bt_entry_t));
+	--model->count;
+}
+
+static bool bt_map_bit(vnode_t vp, u_int32_t node)
+{
+	BTreeControlBlockPtr btcb = bt_btcb(vp);
+	u_int32_t map_node = kHeaderNodeNum;
+	int record = 2;
+	u_int32_t first = 0;
+
+	for (;;) {
+		u_int8_t *buffer = vp->v_nodes[map_node];
+		u_int16_t *offsets = (u_int16_t *)(buffer + btcb->nodeSize);
+		u_int32_t bits = (offsets[-(record + 2)] - offsets[-(record + 1)]) * 8;
+
+		if (node < first + bits) {
+			u_int32_t bit = node - first;
+			return (buffer[offsets[-(record + 1)] + bit / 8] & (0x80 >> (bit % 8))) != 0;
+		}
+
+		first += bits;
+		map_node = ((BTNodeDescriptor *)buffer)->fLink;
+		record = 0;
+		assert(map_node != 0);
+	}
+}
+
+typedef struct bt_walk {
+	bt_model_t		   *model;
+	u_int8_t		   *seen;
+	u_int32_t			records;
+	u_int32_t			nodes;
+	u_int32_t			prev_leaf;
+	u_int32_t			last_leaf;
+	u_int64_t			leaf_bytes;
+	u_int32_t			leaf_nodes;
+} bt_walk_t;
+
+/*
+ * Check one node and everything below it.  Returns the node's first key.
+ */
+static BTreeKeyPtr bt_walk_node(vnode_t vp, bt_walk_t *walk, u_int32_t nodeNum,
+								u_int8_t height)
+{
+	BTreeControlBlockPtr btcb = bt_btcb(vp);
+	NodeDescPtr node;
+	BTreeKeyPtr first_key = NULL, prev_key = NULL;
+
+	assert(nodeNum != 0 && nodeNum < btcb->totalNodes);
+	assert(!walk->seen[nodeNum]);
+	walk->seen[nodeNum] = 1;
+	++walk->nodes;
+
+	assert(bt_map_bit(vp, nodeNum));
+
+	node = (NodeDescPtr)vp->v_nodes[nodeNum];
+	assert(node->height == height);
+	assert(node->kind == (height == 1 ? kBTLeafNode : kBTIndexNode));
+	assert(node->numRecords > 0);
+
+	// Record offsets must be increasing and stay inside the node
+	for (u_int16_t i = 0; i <= node->numRecords; ++i) {
+		u_int16_t off = GetRecordOffset(btcb, node, i);
+
+		assert(off >= sizeof(BTNodeDescriptor));
+		assert(off <= btcb->nodeSize - (node->numRecords + 1) * sizeof(u_int16_t));
+		if (i)
+			assert(off > GetRecordOffset(btcb, node, i - 1));
+	}
+
+	for (u_int16_t i = 0; i < node->numRecords; ++i) {
+		BTreeKeyPtr key;
+		u_int8_t *data;
+		u_int16_t size;
+
+		assert_no_err(GetRecordByIndex(btcb, node, i, &key, &data, &size));
+		assert(KeyLength(btcb, key) <= btcb->maxKeyLength);
+
+		if (prev_key)
+			assert(bt_test_keycompare((HFSPlusCatalogKey *)prev_key,
+									  (HFSPlusCatalogKey *)key) < 0);
+		else
+			first_key = key;
+		prev_key = key;
+
+		if (node->kind == kBTLeafNode) {
+			bt_entry_t *entry;
+
+			assert(walk->records < walk->model->count);
+			entry = &walk->model->entries[walk->records++];
+			assert(bt_test_keycompare((HFSPlusCatalogKey *)key, &entry->key) == 0);
+			bt_check_record(data, size, entry);
+		} else {
+			u_int32_t child;
+			BTreeKeyPtr child_key;
+
+			assert(size == sizeof(u_int32_t));
+			memcpy(&child, data, sizeof(child));
+
+			child_key = bt_walk_node(vp, walk, child, height - 1);
+
+			// Variable length index keys are copies of the child's first key
+			assert(CalcKeySize(btcb, key) == CalcKeySize(btcb, child_key));
+			assert(!memcmp(key, child_key, CalcKeySize(btcb, key)));
+		}
+	}
+
+	if (node->kind == kBTLeafNode) {
+		assert(node->bLink == walk->prev_leaf);
+		if (walk->prev_leaf)
+			assert(((NodeDescPtr)vp->v_nodes[walk->prev_leaf])->fLink == nodeNum);
+		else
+			assert(btcb->firstLeafNode == nodeNum);
+		walk->prev_leaf = nodeNum;
+		walk->last_leaf = nodeNum;
+		walk->leaf_bytes += GetNodeDataSize(btcb, node);
+		++walk->leaf_nodes;
+	}
+
+	return first_key;
+}
+
+/*
+ * Check the tree against the model: a structural walk from the root, the
+ * node allocation map, forward and backward iteration, and a full scan
+ * with BTScanNextRecord().
+ */
+static void bt_verify(vnode_t vp, bt_model_t *model, bool zero_unused)
+{
+	BTreeControlBlockPtr btcb = bt_btcb(vp);
+	BTreeInfoRec info;
+	bt_walk_t walk = { .model = model };
+	u_int32_t in_use = 0, map_nodes = 0;
+	BTreeIterator iterator;
+	bt_record_t rec;
+	FSBufferDescriptor btdata = { .bufferAddress = &rec, .itemSize = sizeof(rec), .itemCount = 1 };
+	u_int16_t size;
+	OSStatus err;
+	u_int32_t count;
+
+	if (zero_unused)
+		assert_no_err(BTZeroUnusedNodes(VTOF(vp)));
+
+	assert_no_err(BTGetInformation(VTOF(vp), 0, &info));
+	assert(info.numRecords == model->count);
+	assert(info.numNodes == btcb->totalNodes);
+	assert(btcb->totalNodes <= vp->v_node_count);
+
+	walk.seen = calloc(1, btcb->totalNodes);
+
+	// Map nodes
+	for (u_int32_t n = ((NodeDescPtr)vp->v_nodes[kHeaderNodeNum])->fLink; n;
+		 n = ((NodeDescPtr)vp->v_nodes[n])->fLink) {
+		assert(((NodeDescPtr)vp->v_nodes[n])->kind == kBTMapNode);
+		assert(bt_map_bit(vp, n));
+		walk.seen[n] = 1;
+		++map_nodes;
+	}
+
+	if (model->count == 0) {
+		assert(btcb->rootNode == 0 && btcb->treeDepth == 0);
+		assert(btcb->firstLeafNode == 0 && btcb->lastLeafNode == 0);
+	} else {
+		assert(btcb->treeDepth > 0 && btcb->treeDepth <= kMaxTreeDepth);
+		assert(((NodeDescPtr)vp->v_nodes[btcb->rootNode])->height == btcb->treeDepth);
+		bt_walk_node(vp, &walk, btcb->rootNode, btcb->treeDepth);
+		assert(walk.records == model->count);
+		assert(btcb->lastLeafNode == walk.last_leaf);
+		assert(((NodeDescPtr)vp->v_nodes[walk.last_leaf])->fLink == 0);
+	}
+
+	// Every in-use map bit belongs to the header, a map node or a tree node
+	for (u_int32_t n = 0; n < btcb->totalNodes; ++n) {
+		if (bt_map_bit(vp, n)) {
+			++in_use;
+		} else if (zero_unused) {
+			for (u_int32_t i = 0; i < btcb->nodeSize; ++i)
+				assert(vp->v_nodes[n][i] == 0);
+		}
+	}
+	assert(in_use == 1 + map_nodes + walk.nodes);
+	assert(btcb->freeNodes == btcb->totalNodes - in_use);
+
+	free(walk.seen);
+
+	// Forward iteration
+	bzero(&iterator, sizeof(iterator));
+	count = 0;
+	err = BTIterateRecord(VTOF(vp), kBTreeFirstRecord, &iterator, &btdata, &size);
+	while (err == noErr) {
+		assert(count < model->count);
+		assert(bt_test_keycompare((HFSPlusCatalogKey *)&iterator.key,
+								  &model->entries[count].key) == 0);
+		bt_check_record(&rec, size, &model->entries[count]);
+		++count;
+		err = BTIterateRecord(VTOF(vp), kBTreeNextRecord, &iterator, &btdata, &size);
+	}
+	assert(err == fsBTRecordNotFoundErr || err == fsBTEmptyErr
+		   || err == fsBTEndOfIterationErr);
+	assert(count == model->count);
+
+	// Backward iteration
+	bzero(&iterator, sizeof(iterator));
+	err = BTIterateRecord(VTOF(vp), kBTreeLastRecord, &iterator, &btdata, &size);
+	while (err == noErr) {
+		assert(count > 0);
+		--count;
+		assert(bt_test_keycompare((HFSPlusCatalogKey *)&iterator.key,
+								  &model->entries[count].key) == 0);
+		err = BTIterateRecord(VTOF(vp), kBTreePrevRecord, &iterator, &btdata, &size);
+	}
+	assert(count == 0);
+
+	// Physical order scan
+	BTScanState scan;
+	void *key, *data;
+	u_int32_t data_size, node, record, found;
+
+	assert_no_err(BTScanInitialize(VTOF(vp), 0, 0, 0, kCatSearchBufferSize, &scan));
+	count = 0;
+	while (!(err = BTScanNextRecord(&scan, false, &key, &data, &data_size))) {
+		bool exists;
+		u_int32_t pos = bt_model_find(model, key, &exists);
+
+		assert(exists);
+		bt_check_record(data, data_size, &model->entries[pos]);
+		++count;
+	}
+	assert(err == btNotFound);
+	assert(count == model->count);
+	assert_no_err(BTScanTerminate(&scan, &node, &record, &found));
+	assert(found == model->count);
+}
+
+/*
+ * Differential fuzzer: apply a random mix of operations to the tree and
+ * to a sorted array, compare every result, and verify the whole tree
+ * periodically.
+ */
+static void bt_fuzz(u_int64_t seed, u_int32_t ops, u_int16_t nodesize)
+{
+	vnode_t vp = bt_create(nodesize);
+	bt_model_t model = {};
+	BTreeIterator hint_iterator;
+	u_int32_t next_cnid = kHFSFirstUserCatalogNodeID;
+	u_int32_t counts[6] = {};
+
+	bt_rand_state = seed ? seed : 1;
+	bzero(&hint_iterator, sizeof(hint_iterator));
+
+	for (u_int32_t op = 0; op < ops; ++op) {
+		bt_entry_t entry;
+		bt_record_t rec;
+		u_int16_t size;
+		bool exists;
+		u_int32_t pos;
+
+		// Grow for the first half of the run and shrink in the second
+		u_int32_t dice = bt_rand() % 100;
+		bool growing = op < ops / 2;
+
+		if (dice < (growing ? 45 : 15) || model.count == 0) {
+			// Insert a new key (or hit a duplicate)
+			bt_make_random_key(&entry.key);
+			entry.cnid = next_cnid++;
+			entry.rec_size = (bt_rand() & 1) ? sizeof(HFSPlusCatalogFolder)
+											 : sizeof(HFSPlusCatalogFile);
+			pos = bt_model_find(&model, &entry.key, &exists);
+			if (exists) {
+				assert(bt_insert(vp, &entry) == fsBTDuplicateRecordErr);
+			} else {
+				assert_no_err(bt_insert(vp, &entry));
+				bt_model_insert(&model, pos, &entry);
+			}
+			++counts[0];
+		} else if (dice < (growing ? 55 : 50)) {
+			// Delete an existing key
+			pos = bt_rand() % model.count;
+			assert_no_err(bt_delete(vp, &model.entries[pos].key));
+			bt_model_remove(&model, pos);
+			++counts[1];
+		} else if (dice < (growing ? 60 : 55)) {
+			// Delete a key that is probably missing
+			bt_make_random_key(&entry.key);
+			pos = bt_model_find(&model, &entry.key, &exists);
+			if (exists) {
+				assert_no_err(bt_delete(vp, &entry.key));
+				bt_model_remove(&model, pos);
+			} else {
+				assert(bt_delete(vp, &entry.key) == fsBTRecordNotFoundErr);
+			}
+			++counts[2];
+		} else if (dice < 85) {
+			// Look up an existing key, sometimes with a stale hint
+			pos = bt_rand() % model.count;
+			assert_no_err(bt_search(vp, (bt_rand() & 1) ? &hint_iterator : NULL,
+									&model.entries[pos].key, &rec, &size));
+			bt_check_record(&rec, size, &model.entries[pos]);
+			++counts[3];
+		} else if (dice < 92) {
+			// Look up a key that is probably missing
+			bt_make_random_key(&entry.key);
+			pos = bt_model_find(&model, &entry.key, &exists);
+			if (exists) {
+				assert_no_err(bt_search(vp, NULL, &entry.key, &rec, &size));
+				bt_check_record(&rec, size, &model.entries[pos]);
+			} else {
+				assert(bt_search(vp, NULL, &entry.key, &rec, &size) == fsBTRecordNotFoundErr);
+			}
+			++counts[4];
+		} else {
+			// Replace a record, switching between folder and file sizes
+			pos = bt_rand() % model.count;
+			entry = model.entries[pos];
+			entry.cnid = next_cnid++;
+			entry.rec_size = (entry.rec_size == sizeof(HFSPlusCatalogFolder))
+				? sizeof(HFSPlusCatalogFile) : sizeof(HFSPlusCatalogFolder);
+			assert_no_err(bt_replace(vp, &entry));
+			model.entries[pos] = entry;
+
+			bt_make_random_key(&entry.key);
+			bt_model_find(&model, &entry.key, &exists);
+			if (!exists)
+				assert(bt_replace(vp, &entry) == fsBTRecordNotFoundErr);
+			++counts[5];
+		}
+
+		if ((op + 1) % BT_TEST_FUZZ_CHECK_EVERY == 0)
+			bt_verify(vp, &model, (op / BT_TEST_FUZZ_CHECK_EVERY) % 4 == 3);
+	}
+
+	// Drain the tree completely so that collapsing to empty is checked too
+	while (model.count) {
+		u_int32_t pos = bt_rand() % model.count;
+
+		assert_no_err(bt_delete(vp, &model.entries[pos].key));
+		bt_model_remove(&model, pos);
+		if (model.count % (BT_TEST_FUZZ_CHECK_EVERY * 4) == 0)
+			bt_verify(vp, &model, false);
+	}
+	bt_verify(vp, &model, true);
+
+	printf("fuzz: seed %#llx, %u ops (%u insert, %u delete, %u delete-missing, "
+		   "%u search, %u search-missing, %u replace), %u nodes\n",
+		   (unsigned long long)seed, ops, counts[0], counts[1], counts[2],
+		   counts[3], counts[4], counts[5], bt_btcb(vp)->totalNodes);
+
+	free(model.entries);
+	bt_destroy(vp);
+}
+
+#pragma mark -
+
+typedef struct bt_phase {
+	u_int64_t	start_ns;
+	u_int64_t	gets;
+	u_int64_t	dirty;
+	u_int64_t	compares;
+	u_int32_t	splits;
+	u_int32_t	append_splits;
+} bt_phase_t;
+
+static void bt_phase_start(vnode_t vp, bt_phase_t *phase)
+{
+	phase->gets = vp->v_gets;
+	phase->dirty = vp->v_dirty;
+	phase->compares = bt_tree_compares;
+	phase->splits = bt_btcb(vp)->numSplits;
+	phase->append_splits = bt_btcb(vp)->numAppendSplits;
+	phase->start_ns = bt_time_ns();
+}
+
+static void bt_phase_end(vnode_t vp, bt_phase_t *phase, const char *name,
+						 u_int32_t ops)
+{
+	u_int64_t elapsed = bt_time_ns() - phase->start_ns;
+	BTreeControlBlockPtr btcb = bt_btcb(vp);
+	u_int64_t leaf_bytes = 0;
+	u_int32_t leaf_nodes = 0;
+
+	for (u_int32_t n = btcb->firstLeafNode; n; n = ((NodeDescPtr)vp->v_nodes[n])->fLink) {
+		leaf_bytes += GetNodeDataSize(btcb, (NodeDescPtr)vp->v_nodes[n]);
+		++leaf_nodes;
+	}
+
+	printf("%-14s %9u ops %10.0f ops/s %8.1f ns/op %6.2f gets/op %6.2f dirty/op "
+		   "%6.2f cmp/op depth %u nodes %u leaves %u fill %5.1f%% splits %u (%u append)\n",
+		   name, ops,
+		   elapsed ? (double)ops * 1000000000.0 / elapsed : 0.0,
+		   ops ? (double)elapsed / ops : 0.0,
+		   ops ? (double)(vp->v_gets - phase->gets) / ops : 0.0,
+		   ops ? (double)(vp->v_dirty - phase->dirty) / ops : 0.0,
+		   ops ? (double)(bt_tree_compares - phase->compares) / ops : 0.0,
+		   btcb->treeDepth, btcb->totalNodes - btcb->freeNodes, leaf_nodes,
+		   leaf_nodes ? 100.0 * leaf_bytes / ((u_int64_t)leaf_nodes * btcb->nodeSize) : 0.0,
+		   btcb->numSplits - phase->splits, btcb->numAppendSplits - phase->append_splits);
+}
+
+static void bt_bench_tree(const char *label, bt_entry_t *entries,
+						  u_int32_t records, u_int16_t nodesize)
+{
+	vnode_t vp = bt_create(nodesize);
+	bt_phase_t phase;
+	char name[32];
+	bt_record_t rec;
+	u_int16_t size;
+	u_int32_t *order = malloc(records * sizeof(u_int32_t));
+
+	for (u_int32_t i = 0; i < records; ++i)
+		order[i] = i;
+
+	snprintf(name, sizeof(name), "insert-%s", label);
+	bt_phase_start(vp, &phase);
+	for (u_int32_t i = 0; i < records; ++i)
+		assert_no_err(bt_insert(vp, &entries[i]));
+	bt_phase_end(vp, &phase, name, records);
+
+	// Random lookups
+	for (u_int32_t i = records; i > 1; --i) {
+		u_int32_t j = bt_rand() % i;
+		u_int32_t t = order[i - 1];
+		order[i - 1] = order[j];
+		order[j] = t;
+	}
+
+	bt_phase_start(vp, &phase);
+	for (u_int32_t i = 0; i < records; ++i)
+		assert_no_err(bt_search(vp, NULL, &entries[order[i]].key, &rec, &size));
+	bt_phase_end(vp, &phase, "search", records);
+
+	BTreeIterator iterator;
+	FSBufferDescriptor btdata = { .bufferAddress = &rec, .itemSize = sizeof(rec), .itemCount = 1 };
+	u_int32_t count = 0;
+	OSStatus err;
+
+	bzero(&iterator, sizeof(iterator));
+	bt_phase_start(vp, &phase);
+	err = BTIterateRecord(VTOF(vp), kBTreeFirstRecord, &iterator, &btdata, &size);
+	while (err == noErr) {
+		++count;
+		err = BTIterateRecord(VTOF(vp), kBTreeNextRecord, &iterator, &btdata, &size);
+	}
+	bt_phase_end(vp, &phase, "iterate", count);
+	assert(count == records);
+
+	BTScanState scan;
+	void *key, *data;
+	u_int32_t data_size, node, record, found;
+
+	count = 0;
+	bt_phase_start(vp, &phase);
+	assert_no_err(BTScanInitialize(VTOF(vp), 0, 0, 0, kCatSearchBufferSize, &scan));
+	while (!BTScanNextRecord(&scan, false, &key, &data, &data_size))
+		++count;
+	assert_no_err(BTScanTerminate(&scan, &node, &record, &found));
+	bt_phase_end(vp, &phase, "scan", count);
+	assert(count == records);
+
+	bt_phase_start(vp, &phase);
+	for (u_int32_t i = 0; i < records; ++i)
+		assert_no_err(bt_delete(vp, &entries[order[i]].key));
+	bt_phase_end(vp, &phase, "delete", records);
+
+	assert(bt_btcb(vp)->leafRecords == 0);
+
+	free(order);
+	bt_destroy(vp);
+}
+
+static void bt_bench(u_int32_t records, u_int16_t nodesize)
+{
+	bt_entry_t *entries = malloc(records * sizeof(bt_entry_t));
+	u_int32_t per_dir = 1000;
+
+	assert(entries);
+	bt_rand_state = BT_TEST_FUZZ_SEED;
+
+	printf("bench: %u records, node size %u\n", records, nodesize);
+
+	// Keys in sorted order: directories populated one after another
+	for (u_int32_t i = 0; i < records; ++i) {
+		bt_make_seq_key(&entries[i].key, kHFSFirstUserCatalogNodeID + i / per_dir,
+						i % per_dir);
+		entries[i].cnid = kHFSFirstUserCatalogNodeID + i;
+		entries[i].rec_size = (i % 8) ? sizeof(HFSPlusCatalogFile)
+									  : sizeof(HFSPlusCatalogFolder);
+	}
+	bt_bench_tree("seq", entries, records, nodesize);
+
+	// A few files in every directory, then the rest copied into one in the middle
+	for (u_int32_t i = 0; i < records; ++i) {
+		if (i < BT_TEST_PARENTS * 16) {
+			bt_make_seq_key(&entries[i].key, kHFSFirstUserCatalogNodeID + i % BT_TEST_PARENTS,
+							i / BT_TEST_PARENTS);
+		} else {
+			bt_make_seq_key(&entries[i].key, kHFSFirstUserCatalogNodeID + BT_TEST_PARENTS / 2,
+							i - BT_TEST_PARENTS * 16 + 16);
+		}
+		entries[i].cnid = kHFSFirstUserCatalogNodeID + i;
+		entries[i].rec_size = (i % 8) ? sizeof(HFSPlusCatalogFile)
+									  : sizeof(HFSPlusCatalogFolder);
+	}
+	bt_bench_tree("middir", entries, records, nodesize);
+
+	// The same keys in random order
+	for (u_int32_t i = records; i > 1; --i) {
+		u_int32_t j = bt_rand() % i;
+		bt_entry_t t = entries[i - 1];
+		entries[i - 1] = entries[j];
+		entries[j] = t;
+	}
+	bt_bench_tree("rand", entries, records, nodesize);
+
+	free(entries);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n nodesize] [-s] [-f seed ops] [-b [records]]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	u_int16_t nodesize = BT_TEST_DEFAULT_NODE_SIZE;
+	int i = 1;
+
+	if (argc > 2 && !strcmp(argv[1], "-n")) {
+		nodesize = strtoul(argv[2], NULL, 0);
+		if (nodesize < 4096 || nodesize > 32768 || (nodesize & (nodesize - 1)))
+			usage(argv[0]);
+		i = 3;
+	}
+
+	// Search index nodes through key prefix sidecars
+	if (i < argc && !strcmp(argv[i], "-s")) {
+		bt_sidecar = true;
+		++i;
+	}
+
+	if (i < argc) {
+		if (!strcmp(argv[i], "-f") && i + 2 < argc) {
+			bt_fuzz(strtoull(argv[i + 1], NULL, 0), strtoul(argv[i + 2], NULL, 0),
+					nodesize);
+		} else if (!strcmp(argv[i], "-b")) {
+			bt_bench(i + 1 < argc ? strtoul(argv[i + 1], NULL, 0)
+								  : BT_TEST_BENCH_RECORDS, nodesize);
+		} else {
+			usage(argv[0]);
+		}
+		return 0;
+	}
+
+	// Small nodes split, rotate and collapse far more often
+	bt_fuzz(BT_TEST_FUZZ_SEED, BT_TEST_FUZZ_OPS, 4096);
+	bt_fuzz(BT_TEST_FUZZ_SEED + 1, BT_TEST_FUZZ_OPS, BT_TEST_DEFAULT_NODE_SIZE);
+	bt_bench(10000, BT_TEST_DEFAULT_NODE_SIZE);
+
+	bt_sidecar = true;
+	bt_fuzz(BT_TEST_FUZZ_SEED + 2, BT_TEST_FUZZ_OPS, 4096);
+	bt_fuzz(BT_TEST_FUZZ_SEED + 3, BT_TEST_FUZZ_OPS, BT_TEST_DEFAULT_NODE_SIZE);
+
+	printf("[PASSED] hfs_btree_test\n");
+
+	return 0;
+}